@@ -1,94 +1,191 @@
-#ifndef AST_H
-#define AST_H
-
-#include "common.h"
-#include "lexer.h"
-
-// AST node types
-typedef enum {
-    AST_PROGRAM,
-    AST_BLOCK,
-    AST_IF,
-    AST_WHILE,
-    AST_PRINT,
-    AST_ASSIGN,
-    AST_BINARY_OP,
-    AST_UNARY_OP,
-    AST_VARIABLE,
-    AST_NUMBER,
-    AST_STRING,
-    AST_BOOLEAN
-} ASTNodeType;
-
-// Forward declaration of ASTNode
-typedef struct ASTNode ASTNode;
-
-// AST node structure
-struct ASTNode {
-    ASTNodeType type;
-    union {
-        struct {
-            ASTNode **statements;
-            int count;
-        } program;
-        struct {
-            ASTNode **statements;
-            int count;
-        } block;
-        struct {
-            ASTNode *condition;
-            ASTNode *if_body;
-            ASTNode *else_body;
-        } if_stmt;
-        struct {
-            ASTNode *condition;
-            ASTNode *body;
-        } while_loop;
-        struct {
-            ASTNode *expression;
-        } print_stmt;
-        struct {
-            char *name;
-            ASTNode *value;
-        } assign;
-        struct {
-            TokenType op;
-            ASTNode *left;
-            ASTNode *right;
-        } binary_op;
-        struct {
-            TokenType op;
-            ASTNode *operand;
-        } unary_op;
-        struct {
-            char *name;
-        } variable;
-        int number;
-        char *string;
-        bool boolean;
-    } data;
-    int line;
-};
-
-// Function prototypes
-ASTNode *create_ast_node(ASTNodeType type);
-void free_ast(ASTNode *node);
-
-// Helper functions for creating specific node types
-ASTNode *create_program_node(ASTNode **statements, int count);
-ASTNode *create_block_node(ASTNode **statements, int count);
-ASTNode *create_if_node(ASTNode *condition, ASTNode *if_body, ASTNode *else_body);
-ASTNode *create_while_node(ASTNode *condition, ASTNode *body);
-ASTNode *create_print_node(ASTNode *expression);
-ASTNode *create_assign_node(char *name, ASTNode *value);
-ASTNode *create_binary_op_node(TokenType op, ASTNode *left, ASTNode *right);
-ASTNode *create_unary_op_node(TokenType op, ASTNode *operand);
-ASTNode *create_variable_node(char *name);
-ASTNode *create_number_node(int value);
-ASTNode *create_string_node(char *value);
-ASTNode *create_boolean_node(bool value);
-
-// Function to print the AST (for debugging)
-void print_ast(ASTNode *node, int indent);
-
+#ifndef AST_H
+#define AST_H
+
+#include "common.h"
+#include "lexer.h"
+
+// AST node types
+typedef enum {
+    AST_PROGRAM,
+    AST_BLOCK,
+    AST_IF,
+    AST_WHILE,
+    AST_FOR,
+    AST_PRINT,
+    AST_ASSIGN,
+    AST_STORE_INDEX,
+    AST_EXPRESSION,
+    AST_IMPORT,
+    AST_GENERATOR,
+    AST_YIELD,
+    AST_FUNCTION,
+    AST_RETURN,
+    AST_BINARY_OP,
+    AST_UNARY_OP,
+    AST_VARIABLE,
+    AST_LIST,
+    AST_DICT,
+    AST_INDEX,
+    AST_CALL,
+    AST_NUMBER,
+    AST_FLOAT,
+    AST_STRING,
+    AST_BOOLEAN,
+    AST_NONE
+} ASTNodeType;
+
+// Forward declaration of ASTNode
+typedef struct ASTNode ASTNode;
+
+// AST node structure
+struct ASTNode {
+    ASTNodeType type;
+    union {
+        struct {
+            ASTNode **statements;
+            int count;
+        } program;
+        struct {
+            ASTNode **statements;
+            int count;
+        } block;
+        struct {
+            ASTNode *condition;
+            ASTNode *if_body;
+            ASTNode *else_body;
+        } if_stmt;
+        struct {
+            ASTNode *condition;
+            ASTNode *body;
+        } while_loop;
+        struct {
+            const char *variable;   // Interned; not owned by the node
+            ASTNode *start;         // NULL for 0
+            ASTNode *stop;          // NULL when looping over `iterable`
+            ASTNode *step;          // NULL for 1
+            ASTNode *iterable;      // A generator to take values from; NULL for a range
+            ASTNode *body;
+            bool parallel;          // Iterations may run at once; see parallel.h
+        } for_loop;
+        struct {
+            ASTNode *expression;
+        } print_stmt;
+        struct {
+            const char *name;   // Interned; not owned by the node
+            ASTNode *value;
+        } assign;
+        struct {
+            ASTNode *object;
+            ASTNode *index;
+            ASTNode *value;
+        } store_index;
+        struct {
+            ASTNode *expression;
+        } expression_stmt;
+        struct {
+            const char *module; // Interned; not owned by the node
+        } import_stmt;
+        struct {
+            const char *name;           // Interned
+            const char **parameters;    // Interned names; the array is owned
+            int parameter_count;
+            ASTNode *body;
+        } generator;
+        struct {
+            ASTNode *value;
+        } yield_stmt;
+        struct {
+            const char *name;           // Interned
+            const char **parameters;    // Interned names; the array is owned
+            int parameter_count;
+            ASTNode *body;
+        } function;
+        struct {
+            ASTNode *value;     // NULL to return ಶೂನ್ಯ
+        } return_stmt;
+        struct {
+            TokenType op;
+            ASTNode *left;
+            ASTNode *right;
+        } binary_op;
+        struct {
+            TokenType op;
+            ASTNode *operand;
+        } unary_op;
+        struct {
+            const char *name;   // Interned; not owned by the node
+        } variable;
+        struct {
+            ASTNode **elements;
+            int count;
+        } list;
+        struct {
+            ASTNode **entries;  // Key, value, key, value, ...
+            int count;          // Pairs
+        } dict;
+        struct {
+            ASTNode *object;
+            ASTNode *index;
+        } index;
+        struct {
+            const char *name;   // Interned; a builtin, generator or function, checked by semantic analysis
+            ASTNode **arguments;
+            int count;
+        } call;
+        Integer number;
+        double real;
+        char *string;
+        bool boolean;
+    } data;
+    int line;
+    int references;     // Occurrences in the tree; more than 1 once hash-consed
+};
+
+// Function prototypes
+ASTNode *create_ast_node(ASTNodeType type);
+// Free a tree; shared nodes go once their last occurrence does
+void free_ast(ASTNode *node);
+// Drop one reference to `node` itself, freeing it if that was the last.
+// Its children are left alone.
+void release_ast_node(ASTNode *node);
+
+// Helper functions for creating specific node types
+ASTNode *create_program_node(ASTNode **statements, int count);
+ASTNode *create_block_node(ASTNode **statements, int count);
+ASTNode *create_if_node(ASTNode *condition, ASTNode *if_body, ASTNode *else_body);
+ASTNode *create_while_node(ASTNode *condition, ASTNode *body);
+ASTNode *create_for_node(const char *variable, ASTNode *start, ASTNode *stop, ASTNode *step, ASTNode *body);
+// ಪ್ರತಿ variable ಒಳಗೆ iterable { body }
+ASTNode *create_for_in_node(const char *variable, ASTNode *iterable, ASTNode *body);
+// The child index of a for loop's body; its bounds or iterable come first
+int for_body_index(const ASTNode *node);
+ASTNode *create_print_node(ASTNode *expression);
+ASTNode *create_assign_node(const char *name, ASTNode *value);
+ASTNode *create_store_index_node(ASTNode *object, ASTNode *index, ASTNode *value);
+ASTNode *create_expression_node(ASTNode *expression);
+ASTNode *create_import_node(const char *module);
+// Takes ownership of the `parameters` array
+ASTNode *create_generator_node(const char *name, const char **parameters, int parameter_count, ASTNode *body);
+ASTNode *create_yield_node(ASTNode *value);
+// Takes ownership of the `parameters` array
+ASTNode *create_function_node(const char *name, const char **parameters, int parameter_count, ASTNode *body);
+// `value` may be NULL
+ASTNode *create_return_node(ASTNode *value);
+ASTNode *create_binary_op_node(TokenType op, ASTNode *left, ASTNode *right);
+ASTNode *create_unary_op_node(TokenType op, ASTNode *operand);
+ASTNode *create_variable_node(const char *name);
+ASTNode *create_list_node(ASTNode **elements, int count);
+// `entries` holds 2 * `count` nodes, alternating keys and values
+ASTNode *create_dict_node(ASTNode **entries, int count);
+ASTNode *create_index_node(ASTNode *object, ASTNode *index);
+ASTNode *create_call_node(const char *name, ASTNode **arguments, int count);
+ASTNode *create_number_node(Integer value);
+ASTNode *create_float_node(double value);
+ASTNode *create_string_node(char *value);
+ASTNode *create_boolean_node(bool value);
+ASTNode *create_none_node(void);
+
+// Function to print the AST (for debugging)
+void print_ast(ASTNode *node, int indent);
+
 #endif // AST_H
\ No newline at end of file
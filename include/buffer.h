@@ -0,0 +1,24 @@
+#ifndef BUFFER_H
+#define BUFFER_H
+
+#include "common.h"
+
+// Output buffer used by the code generator. A buffer either grows on the
+// heap or writes into fixed caller-provided storage; a fixed buffer keeps
+// counting past its capacity so callers can learn the size they need.
+typedef struct {
+    char *data;
+    size_t length;    // Bytes produced so far (may exceed capacity if fixed)
+    size_t capacity;
+    bool fixed;       // Storage belongs to the caller and never grows
+} Buffer;
+
+void buffer_init(Buffer *buffer);
+void buffer_init_fixed(Buffer *buffer, char *storage, size_t capacity);
+void buffer_free(Buffer *buffer);
+void buffer_append(Buffer *buffer, const char *data, size_t length);
+void buffer_append_str(Buffer *buffer, const char *str);
+void buffer_appendf(Buffer *buffer, const char *format, ...);
+bool buffer_overflowed(const Buffer *buffer);
+
+#endif // BUFFER_H
@@ -0,0 +1,36 @@
+#ifndef BUILTINS_H
+#define BUILTINS_H
+
+#include "value.h"
+
+// Functions built into the language, called by name
+typedef enum {
+    BUILTIN_LENGTH,      // ಉದ್ದ(sequence or dict)
+    BUILTIN_APPEND,      // ಸೇರಿಸು(list, value): add to the end, in place
+    BUILTIN_SUM,         // ಮೊತ್ತ(list)
+    BUILTIN_MIN,         // ಕನಿಷ್ಠ(list)
+    BUILTIN_MAX,         // ಗರಿಷ್ಠ(list)
+    BUILTIN_ADD,         // ಕೂಡಿಸು(a, b): elementwise +
+    BUILTIN_MULTIPLY,    // ಗುಣಿಸು(a, b): elementwise *
+    BUILTIN_SORT,        // ವಿಂಗಡಿಸು(list): a sorted copy
+    BUILTIN_KEYS,        // ಕೀಲಿಗಳು(dict): its keys as a list, in insertion order
+    BUILTIN_VALUES,      // ಮೌಲ್ಯಗಳು(dict)
+    BUILTIN_CONTAINS,    // ಹೊಂದಿದೆ(dict, key)
+    BUILTIN_REMOVE,      // ಅಳಿಸು(dict, key): delete the entry
+    BUILTIN_READ,        // ಓದು(path): the file's contents as a string
+    BUILTIN_LINES,       // ಸಾಲುಗಳು(path): the file's lines, for a ಪ್ರತಿ loop
+    BUILTIN_SPLIT,       // ವಿಭಜಿಸು(string, delimiter): a list of the parts
+    BUILTIN_COUNT
+} Builtin;
+
+// The builtin called `name`, or -1 if there is none
+int find_builtin(const char *name);
+const char *builtin_name(Builtin builtin);
+int builtin_arity(Builtin builtin);
+
+// Call `builtin` on its builtin_arity() arguments. Returns false and
+// writes a message of up to MAX_ERROR_MESSAGE_LENGTH bytes to `error` if
+// the arguments are unsuitable.
+bool call_builtin(Heap *heap, Builtin builtin, Value *arguments, Value *result, char *error);
+
+#endif // BUILTINS_H
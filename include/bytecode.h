@@ -0,0 +1,238 @@
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include "common.h"
+#include "symbol_table.h"
+#include "value.h"
+#include "visitor.h"
+#include "loop.h"
+#include "expression_table.h"
+#include "parallel.h"
+
+// Instructions for the stack machine in vm.h. Operands follow the opcode
+// as 32-bit little-endian words; jump operands are absolute offsets.
+typedef enum {
+    OP_CONSTANT,               // index: push constants[index]
+    OP_NONE,
+    OP_TRUE,
+    OP_FALSE,
+    OP_POP,
+    OP_GET_GLOBAL,             // slot
+    OP_SET_GLOBAL,             // slot: pop into the variable
+    OP_APPEND_GLOBAL,          // slot: pop and add to the variable, in place for strings
+    OP_INCREMENT_GLOBAL,       // slot, index: add constants[index] to a variable holding an integer
+    OP_GET_ACCUMULATOR,        // slot: like OP_GET_GLOBAL, finishing a string builder
+    OP_FINISH_ACCUMULATOR,     // slot: turn a string builder back into a string
+    OP_REDUCE,                 // slot, kind: pop and combine into a parallel loop's reduction
+    OP_ADD,
+    OP_SUBTRACT,
+    OP_MULTIPLY,
+    OP_DIVIDE,
+    OP_MODULO,
+    OP_NEGATE,
+    OP_NOT,
+    OP_EQUAL,
+    OP_NOT_EQUAL,
+    OP_LESS,
+    OP_LESS_EQUAL,
+    OP_GREATER,
+    OP_GREATER_EQUAL,
+    OP_BUILD_LIST,             // count: pop that many elements into a new list
+    OP_BUILD_DICT,             // count: pop that many key-value pairs into a new dict
+    OP_INDEX,                  // pop index or key and container, push the element
+    OP_STORE_INDEX,            // pop value, index and container; store the value
+    OP_CALL_BUILTIN,           // builtin: pop its arguments, push the result
+    OP_FOR_PREPARE,            // slot, exit: start counting over range(start, stop, step)
+    OP_FOR_LOOP,               // slot, body: step the counted loop, or end it
+    OP_PARALLEL,               // loop: pop start, stop and step and run parallel_loops[loop]
+    OP_END_ITERATION,          // the body of a parallel loop is done
+    OP_MAKE_GENERATOR,         // generator: pop its arguments, push a new generator on the heap
+    OP_GENERATOR_FRAME,        // generator: the same, with its frame in place on the stack
+    OP_FOR_GENERATOR,          // slot, exit: resume the generator on the stack, or put the
+                               // next line of a file in the slot; or end the loop
+    OP_YIELD,                  // pop a value for the loop that resumed the running generator
+    OP_END_GENERATOR,          // the running generator is done
+    OP_CALL,                   // function: pop its arguments and run its body, which pushes the result
+    OP_RETURN,                 // depth, function: leave the running call, whose body has taken
+                               // the stack `depth` deep, with the value on top
+    OP_JUMP,                   // target
+    OP_JUMP_IF_FALSE,          // target: pop the condition
+    OP_JUMP_IF_FALSE_OR_POP,   // target: keep the value if jumping, else pop it
+    OP_JUMP_IF_TRUE_OR_POP,    // target
+    OP_JUMP_IF_NOT_INTEGER,    // target: pop a value, jumping unless it is an integer
+    OP_PRINT,
+    OP_LINE,                   // line: a statement starts; only in code compiled for profiling
+    OP_HALT
+} OpCode;
+
+// A parallel loop. OP_PARALLEL hands its range to the scheduler, which
+// runs the body, from `body` up to its OP_END_ITERATION, once for each
+// value; execution then goes on at `exit`.
+typedef struct {
+    uint32_t slot;                  // The loop variable
+    size_t body;
+    size_t exit;
+    int line;
+    uint32_t *reduction_slots;
+    ReductionKind *reduction_kinds;
+    int reduction_count;
+    // The variables the body assigns otherwise, the loop variable first
+    uint32_t *private_slots;
+    int private_count;
+} ParallelLoop;
+
+// A generator's body, from `entry` up to its OP_END_GENERATOR. Its
+// variables live in global slots like any other, and a frame keeps their
+// values while another call of the same generator has them; see vm.h.
+typedef struct {
+    size_t entry;
+    int parameter_count;
+    uint32_t first_slot;            // Its variables take the slots from here, parameters first
+    int slot_count;
+    int max_stack;                  // Deepest its body takes the stack
+} GeneratorDefinition;
+
+// A function's body, from `entry` up to its final OP_RETURN. Its
+// variables live in global slots too; a call saves their values on the
+// stack and the return puts them back, so a recursive call has its own.
+typedef struct {
+    size_t entry;                   // 0 while it is called before it is compiled
+    int parameter_count;
+    uint32_t first_slot;            // Its variables take the slots from here, parameters first
+    int slot_count;
+    int max_stack;                  // Deepest its body takes the stack
+} FunctionDefinition;
+
+typedef struct {
+    uint8_t *code;
+    int *lines;             // Source line of each byte of code
+    size_t count;
+    size_t capacity;
+
+    Value *constants;       // Objects among them belong to the compiling heap
+    int constant_count;
+    int constant_capacity;
+
+    // Name of each global slot the code uses, for runtime errors. The
+    // names belong to the symbol table the chunk was compiled against.
+    const char **global_names;
+    int global_count;
+
+    int max_stack;          // Deepest the value stack gets while running
+
+    ParallelLoop *parallel_loops;
+    int parallel_loop_count;
+    int parallel_loop_capacity;
+
+    GeneratorDefinition *generators;
+    int generator_count;
+    int generator_capacity;
+
+    FunctionDefinition *functions;
+    int function_count;
+    int function_capacity;
+} Chunk;
+
+void init_chunk(Chunk *chunk);
+void free_chunk(Chunk *chunk);
+void write_chunk(Chunk *chunk, uint8_t byte, int line);
+// Drop the code from offset `count` on, with the parallel loops,
+// generators and functions compiled into it or called from it
+void truncate_chunk(Chunk *chunk, size_t count);
+
+typedef struct {
+    const ASTNode *node;
+    bool computed;                  // Its hidden variable holds its value
+} CommonExpression;
+
+typedef struct {
+    Chunk *chunk;
+    Heap *heap;             // Holds constant strings and large integers
+    SymbolTable *symbol_table;
+    ErrorList *errors;
+
+    // Jumps waiting for their target, and loop starts, innermost last
+    size_t *pending;
+    int pending_count;
+    int pending_capacity;
+
+    int stack_depth;
+
+    // Variables that loops being compiled update only with `x = x + e;`.
+    // Those updates compile to OP_APPEND_GLOBAL, which builds strings in
+    // place instead of copying them on every iteration.
+    const char **accumulators;
+    int accumulator_count;
+    int accumulator_capacity;
+    // The `x + e` of the append being compiled, and its `x`, which emit nothing
+    const ASTNode *append_value;
+    const ASTNode *append_variable;
+
+    // Counting while loops are specialized as loop.h describes. The
+    // specialized copies of the body come after the loop, and the loop
+    // itself runs the iterations they leave over.
+    int unroll_factor;              // Most iterations per test; 1 to never unroll
+    const ASTNode *planned_loop;    // The loop being compiled that has a plan
+    LoopPlan plan;
+    bool specializing;              // Emitting the copies
+    uint32_t step_constant;         // Constant index of the plan's step
+    uint32_t *product_slots;        // Variable holding each multiplier's product
+    uint32_t *product_steps;        // Constant index of what each product steps by
+    int skip_depth;                 // Inside a node the copies replace; emit nothing
+
+    // Common subexpressions. In a hash-consed tree, the expressions a block
+    // repeats in straight-line code are kept in hidden variables once
+    // computed, and repeats read them back. `commons` holds those of the
+    // blocks being compiled, innermost last.
+    CommonExpression *commons;
+    int common_count;
+    int common_capacity;
+    uint32_t *common_slots;         // Hidden variable of each position in `commons`
+    int common_slot_count;
+    int first_common;               // Where the innermost block's expressions start
+    int conditional_depth;          // In code of that block that may not run, or may run again
+    int statement_line;             // Shared nodes report errors at their statement's line
+
+    bool profiling;                 // Start each statement with OP_LINE
+
+    // The parallel loop being compiled. Loops marked parallel inside it
+    // run as ordinary loops on whichever thread runs its iteration.
+    const ASTNode *parallel_loop;
+    ParallelPlan parallel_plan;
+    int parallel_index;             // Its entry in the chunk's parallel_loops
+    const ASTNode *reduction;       // The assignment being compiled as an OP_REDUCE
+    ReductionKind reduction_kind;
+
+    // The generator whose body is being compiled, by its index among the
+    // chunk's generators; -1 in the program's own code. Its hidden
+    // variables are its own, and the stack it takes is counted apart from
+    // the program's, whose depth and hidden variables are kept meanwhile.
+    int generator;
+    int outer_max_stack;
+    uint32_t *outer_common_slots;
+    int outer_common_slot_count;
+    int outer_common_count;         // The program's entries in `commons`, which the body cannot use
+    // Likewise the function being compiled, whose stack and hidden
+    // variables are kept apart the same way
+    int function;
+    // The call a loop of the program iterates over directly. That
+    // generator cannot outlive the loop, so its frame goes on the stack.
+    const ASTNode *frame_call;
+} BytecodeContext;
+
+// Loops are unrolled up to DEFAULT_UNROLL_FACTOR times; set
+// `unroll_factor` after initializing to change that, and `profiling` to
+// compile for the profiler
+void init_bytecode_context(BytecodeContext *context, Chunk *chunk, Heap *heap,
+                           SymbolTable *symbol_table, ErrorList *errors);
+void free_bytecode_context(BytecodeContext *context);
+
+// Emits code for each statement walked. Variables are resolved to the
+// slots the semantic pass assigns, so it must come before semantic_visitor
+// in the same walk: post hooks run in reverse, and the semantic pass then
+// declares an assigned name before its store is emitted.
+// The chunk is not terminated; emit OP_HALT when the program is complete.
+ASTVisitor bytecode_visitor(BytecodeContext *context);
+void emit_halt(BytecodeContext *context, int line);
+
+#endif // BYTECODE_H
@@ -1,11 +1,14 @@
-#ifndef CODE_GENERATOR_H
-#define CODE_GENERATOR_H
-
-#include "common.h"
-#include "ast.h"
-#include "symbol_table.h"
-#include <stdio.h>
-// Function prototypes for code generation
-void generate_code(ASTNode *ast, FILE *output);
-
-#endif // CODE_GENERATOR_H
\ No newline at end of file
+#ifndef CODE_GENERATOR_H
+#define CODE_GENERATOR_H
+
+#include "common.h"
+#include "ast.h"
+#include "buffer.h"
+#include "symbol_table.h"
+#include "visitor.h"
+// Function prototypes for code generation
+void generate_code(ASTNode *ast, Buffer *output);
+// Code generation as a visitor, for fusing with other passes
+ASTVisitor codegen_visitor(Buffer *output);
+
+#endif // CODE_GENERATOR_H
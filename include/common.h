@@ -1,54 +1,81 @@
-#ifndef COMMON_H
-#define COMMON_H
-
-#include <stddef.h>
-#include <stdint.h>
-#include <stdbool.h>
-
-// Version information
-#define COMPILER_VERSION "0.1.0"
-#define COMPILER_NAME "KannadaPython"
-#define _POSIX_C_SOURCE 200809L // Define POSIX source version for strdup
-
-// Maximum lengths
-#define MAX_IDENTIFIER_LENGTH 256
-#define MAX_STRING_LENGTH 1024
-#define MAX_ERROR_MESSAGE_LENGTH 512
-
-// Error handling
-typedef enum {
-    ERROR_NONE,
-    ERROR_LEXER,
-    ERROR_PARSER,
-    ERROR_SEMANTIC,
-    ERROR_CODEGEN
-} ErrorType;
-
-typedef struct {
-    ErrorType type;
-    int line;
-    char message[MAX_ERROR_MESSAGE_LENGTH];
-} Error;
-
-// Memory management
-void *safe_malloc(size_t size);
-void *safe_realloc(void *ptr, size_t size);
-char *safe_strdup(const char *str);
-
-// Utility functions
-// bool is_kannada_digit(uint32_t ch);
-// bool is_kannada_letter(uint32_t ch);
-// int kannada_digit_to_int(uint32_t ch);
-
-// UTF-8 handling
-size_t utf8_strlen(const char *str);
-uint32_t utf8_nextchar(const char **ptr);
-
-// Debugging
-#ifdef DEBUG
-    #define DEBUG_PRINT(fmt, ...) fprintf(stderr, "DEBUG: " fmt "\n", ##__VA_ARGS__)
-#else
-    #define DEBUG_PRINT(fmt, ...)
-#endif
-
-#endif // COMMON_H
\ No newline at end of file
+#ifndef COMMON_H
+#define COMMON_H
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <setjmp.h>
+
+// Version information
+#define COMPILER_VERSION "0.1.0"
+#define COMPILER_NAME "KannadaPython"
+#define _POSIX_C_SOURCE 200809L // Define POSIX source version for strdup
+
+// Maximum lengths
+#define MAX_IDENTIFIER_LENGTH 256
+#define MAX_STRING_LENGTH 1024
+#define MAX_ERROR_MESSAGE_LENGTH 512
+
+// Error handling
+typedef enum {
+    ERROR_NONE,
+    ERROR_LEXER,
+    ERROR_PARSER,
+    ERROR_SEMANTIC,
+    ERROR_CODEGEN,
+    ERROR_RUNTIME
+} ErrorType;
+
+typedef struct {
+    ErrorType type;
+    int line;
+    char message[MAX_ERROR_MESSAGE_LENGTH];
+} Error;
+
+// Diagnostics collected by a compilation instead of terminating the process
+typedef struct {
+    Error *errors;
+    int count;
+    int capacity;
+} ErrorList;
+
+void init_error_list(ErrorList *list);
+void free_error_list(ErrorList *list);
+void report_error(ErrorList *list, ErrorType type, int line, const char *format, ...);
+void print_errors(const ErrorList *list, FILE *stream);
+const char *error_type_to_string(ErrorType type);
+
+// Memory management
+void *safe_malloc(size_t size);
+void *safe_realloc(void *ptr, size_t size);
+char *safe_strdup(const char *str);
+
+// Allocation failure recovery. While a jump target is armed, failed
+// allocations longjmp to it instead of exiting; pass NULL to disarm.
+jmp_buf *set_alloc_failure_jump(jmp_buf *target);
+
+// Hashing (64-bit FNV-1a), used for interning and content-addressed caches
+uint64_t hash_bytes(const void *data, size_t length);
+
+// Utility functions
+// bool is_kannada_digit(uint32_t ch);
+// bool is_kannada_letter(uint32_t ch);
+// int kannada_digit_to_int(uint32_t ch);
+
+// UTF-8 handling
+size_t utf8_strlen(const char *str);
+uint32_t utf8_nextchar(const char **ptr);
+// Count the codepoints in `length` bytes, decoding them as utf8_nextchar()
+// does. Returns false if the bytes are not well-formed UTF-8: truncated or
+// overlong sequences, surrogates or codepoints past U+10FFFF.
+bool utf8_validate(const char *chars, size_t length, size_t *codepoints);
+
+// Debugging
+#ifdef DEBUG
+    #define DEBUG_PRINT(fmt, ...) fprintf(stderr, "DEBUG: " fmt "\n", ##__VA_ARGS__)
+#else
+    #define DEBUG_PRINT(fmt, ...)
+#endif
+
+#endif // COMMON_H
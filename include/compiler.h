@@ -1,14 +1,63 @@
-#ifndef COMPILER_H
-#define COMPILER_H
-
-#include <stdio.h>
-#include "ast.h"
-#include "lexer.h"
-#include "parser.h"
-#include "semantic_analyzer.h"
-#include "symbol_table.h"
-#include "codegen.h"
-
-void compile(const char *source_code, FILE *output);
-
-#endif // COMPILER_H
\ No newline at end of file
+#ifndef COMPILER_H
+#define COMPILER_H
+
+#include <stdio.h>
+#include "ast.h"
+#include "buffer.h"
+#include "lexer.h"
+#include "parser.h"
+#include "semantic_analyzer.h"
+#include "symbol_table.h"
+#include "codegen.h"
+#include "intern.h"
+#include "bytecode.h"
+#include "vm.h"
+
+// Compile `length` bytes of source into `output`. Diagnostics are appended
+// to `errors`; returns true if compilation succeeded. Identifiers are
+// interned in `names`, or in a table private to this call if it is NULL.
+bool compile_source(const char *source_code, size_t length, Buffer *output, ErrorList *errors,
+                    InternTable *names);
+
+// Lex and parse `length` bytes of source. Returns NULL if there were errors.
+// With `share_expressions`, repeated pure expressions become one node, as
+// expression_table.h describes.
+ASTNode *parse_source(const char *source_code, size_t length, ErrorList *errors, InternTable *names,
+                      bool share_expressions);
+
+// Analyze an already parsed program against `symbol_table` and generate
+// code for it. Each ಕಾರ್ಯ is analyzed and emitted as a task of its own, on
+// a pool of threads once a program has COMPILE_FUNCTIONS_PER_THREAD of them
+// for a second thread; the code and errors come out as one walk in source
+// order would give them.
+#define COMPILE_FUNCTIONS_PER_THREAD 64
+bool compile_ast(ASTNode *ast, SymbolTable *symbol_table, Buffer *output, ErrorList *errors);
+
+// Analyze an already parsed program and compile it to bytecode for the VM,
+// terminated with OP_HALT. Constants are allocated in `heap`. Counting
+// loops are unrolled up to `unroll_factor` times, or the default if it is 0.
+// With `profile`, statements are marked for the profiler.
+bool compile_bytecode(ASTNode *ast, SymbolTable *symbol_table, Chunk *chunk, Heap *heap, ErrorList *errors,
+                      int unroll_factor, bool profile);
+
+typedef struct {
+    bool gc_stats;          // Print collector statistics to stderr afterwards
+    size_t heap_limit;      // Most bytes of live objects allowed; 0 for no limit
+    int unroll_factor;      // Most copies of a loop body; 0 for the default, 1 for none
+    bool eliminate_common;  // Share repeated expressions and compute each once per block
+    // Profile the run: print the hottest lines to stderr and write collapsed
+    // stacks for flame graphs to this file. NULL to not profile.
+    const char *profile_path;
+    int threads;            // Most threads a parallel loop runs on; 0 for one per core
+} RunOptions;
+
+// Compile `length` bytes of source to bytecode and run it, printing to
+// `output`. Compile and runtime errors are appended to `errors`. `options`
+// may be NULL for the defaults.
+bool run_source(const char *source_code, size_t length, FILE *output, ErrorList *errors,
+                const RunOptions *options);
+
+// Compile a NUL-terminated source to a stream, printing diagnostics to stderr
+bool compile(const char *source_code, FILE *output);
+
+#endif // COMPILER_H
@@ -0,0 +1,79 @@
+#ifndef DICT_H
+#define DICT_H
+
+#include "value.h"
+
+// A dictionary. Entries live in a dense array in insertion order, which
+// is the order keys come back in. A separate open-addressed index maps
+// hashes to entry positions, laid out SwissTable style: one control byte
+// per slot holds 7 bits of the key's hash, or marks the slot empty or
+// deleted, and a probe compares a whole group of control bytes at once.
+// Only slots whose byte matches are checked against their entry, so a
+// lookup usually reads one group, one slot and one entry.
+//
+// Each entry keeps its key's hash, so growing the index never rehashes a
+// key. Growth is incremental: the new index is filled a few entries per
+// insertion or deletion while the old one still answers lookups, so no
+// single operation pays for rebuilding a large table.
+
+typedef struct {
+    Value key;          // VALUE_UNDEFINED once deleted
+    Value value;
+    uint64_t hash;
+} DictEntry;
+
+typedef struct {
+    uint8_t *control;   // `capacity` bytes, then the first group again
+    uint32_t *slots;    // Entry position of each full slot
+    size_t capacity;    // Slots: a power of two, or 0 before the first insertion
+    size_t used;        // Slots that are full or deleted
+} DictIndex;
+
+typedef struct {
+    Object object;
+    DictEntry *entries;
+    size_t entry_count;     // Deleted entries included
+    size_t entry_capacity;
+    size_t count;           // Live entries
+    DictIndex index;
+    // While growing, the index being replaced. Entries below `migrated`
+    // are in `index`; those from there up to `migrate_end` only in here.
+    DictIndex old_index;
+    size_t migrated;
+    size_t migrate_end;
+} DictObject;
+
+static inline DictObject *value_as_dict(Value value) {
+    return (DictObject *)value_as_object(value);
+}
+
+static inline bool value_is_dict(Value value) {
+    return value_is_object_type(value, OBJECT_DICT);
+}
+
+// Hash a key. Returns false if the value cannot be a key, that is if it is
+// mutable; equal values hash alike.
+bool value_hash(Value value, uint64_t *hash);
+
+DictObject *dict_create(Heap *heap);
+// A dictionary of `count` pairs, keys at even positions of `entries`.
+// Returns false and sets `error` if a key cannot be hashed.
+bool dict_from_entries(Heap *heap, const Value *entries, size_t count, Value *result, char *error);
+
+// Each returns false and sets `error` if `key` cannot be hashed; `error`
+// has room for MAX_ERROR_MESSAGE_LENGTH bytes. A missing key is not an
+// error here; `found` says whether it was there.
+bool dict_get(const DictObject *dict, Value key, Value *value, bool *found, char *error);
+bool dict_set(Heap *heap, DictObject *dict, Value key, Value value, char *error);
+bool dict_delete(DictObject *dict, Value key, bool *found, char *error);
+
+// The keys or values, in insertion order, as a new list
+Value dict_keys(Heap *heap, const DictObject *dict);
+Value dict_values(Heap *heap, const DictObject *dict);
+
+// Bytes of the buffers the dictionary owns
+size_t dict_external_size(const DictObject *dict);
+// Free the buffers; used by the collector
+void release_dict(DictObject *dict);
+
+#endif // DICT_H
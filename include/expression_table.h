@@ -0,0 +1,66 @@
+#ifndef EXPRESSION_TABLE_H
+#define EXPRESSION_TABLE_H
+
+#include "ast.h"
+
+// Hash-consing for the parser. Pure expressions (literals, variables and
+// operators over them) that are built the same way from the same children
+// come back as one shared node, so a formula repeated across a block is
+// stored once and later passes can tell the repeats apart by pointer.
+//
+// A variable is only the same as an earlier one if the name has not been
+// assigned in between. Each assignment gives the name a new version, and
+// loop boundaries give every name one, since a loop body can run after
+// assignments that come later in the source.
+//
+// `references` on a shared node counts its occurrences in the tree, so
+// free_ast releases it once every occurrence is gone. While the table is
+// alive it holds one more on each node it contains.
+typedef struct ExpressionEntry {
+    struct ExpressionEntry *next;  // For chaining in case of hash collisions
+    uint64_t hash;
+    int version;                   // A variable's version; 0 for other nodes
+    ASTNode *node;
+} ExpressionEntry;
+
+typedef struct VersionEntry {
+    struct VersionEntry *next;
+    const char *name;              // Interned
+    int version;
+} VersionEntry;
+
+typedef struct {
+    ExpressionEntry **buckets;
+    size_t size;                   // Number of buckets
+    size_t count;
+    VersionEntry **versions;       // Last assignment of each name, by pointer
+    size_t version_size;
+    int clock;                     // Last version handed out
+    int barrier;                   // Version of every name not assigned since
+} ExpressionTable;
+
+ExpressionTable *create_expression_table(void);
+// Drop the table's hold on its nodes; the AST keeps the ones it uses
+void free_expression_table(ExpressionTable *table);
+
+// Return the table's node equal to `node`, freeing `node`, or add `node`
+// and return it. Nodes that are not pure, or whose children were not
+// shared themselves, are returned as they are.
+ASTNode *share_expression(ExpressionTable *table, ASTNode *node);
+// `name` has been assigned; later uses are new variables
+void expression_assigned(ExpressionTable *table, const char *name);
+// Start or end of a loop: every name may hold a new value
+void expression_barrier(ExpressionTable *table);
+
+// Whether the value of `node` is certainly not a list or dictionary, so
+// reusing it cannot alias a mutable object
+bool is_immutable_expression(const ASTNode *node);
+
+// The shared operator nodes that a block evaluates more than once in its
+// own straight-line code, leaving out loop conditions, nested blocks and
+// the right side of `ಮತ್ತು`/`ಅಥವಾ`. A repeat is not looked inside, since
+// its value will be reused rather than computed. Returns a new array of
+// `*count` nodes.
+const ASTNode **find_repeated_expressions(const ASTNode *block, int *count);
+
+#endif // EXPRESSION_TABLE_H
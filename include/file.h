@@ -0,0 +1,60 @@
+#ifndef FILE_H
+#define FILE_H
+
+#include "value.h"
+
+// Reading files. A file's bytes stay where they were mapped or read, in a
+// FileData, and the strings taken from them are slices pointing into it
+// rather than copies:
+//
+//  - Regular files of FILE_MAP_MIN bytes or more are mapped with mmap, so
+//    reading one copies nothing; smaller ones are read whole.
+//  - Pipes and other files that cannot be mapped are read into blocks of
+//    FILE_BLOCK_SIZE bytes, as much as each read() gives. A line that runs
+//    past the end of a block is moved to the start of the next.
+//
+// A slice keeps its whole FileData alive, so a line kept from a large file
+// keeps the file's mapping, or the line's block of a pipe.
+#define FILE_MAP_MIN (64 * 1024)
+#define FILE_BLOCK_SIZE (1024 * 1024)
+
+typedef struct {
+    Object object;
+    char *data;
+    size_t length;          // Bytes filled
+    size_t capacity;
+    bool mapped;            // Otherwise `data` was allocated
+} FileData;
+
+// A file read a line at a time by a ಪ್ರತಿ loop
+typedef struct {
+    Object object;
+    int fd;                 // -1 once the rest of the file is in `data`
+    Value data;             // The FileData lines are taken from
+    size_t position;        // Where the next line starts in it
+    size_t scanned;         // Bytes from `position` known to hold no newline
+} LineReader;
+
+static inline bool value_is_line_reader(Value value) {
+    return value_is_object_type(value, OBJECT_LINE_READER);
+}
+
+static inline LineReader *value_as_line_reader(Value value) {
+    return (LineReader *)value_as_object(value);
+}
+
+// The contents of the file named by the string `path`. Each of these
+// returns false and writes a message of up to MAX_ERROR_MESSAGE_LENGTH
+// bytes to `error` if the file cannot be read.
+bool file_read(Heap *heap, Value path, Value *result, char *error);
+// A LineReader over the file named by `path`
+bool file_lines(Heap *heap, Value path, Value *result, char *error);
+// The next line of `reader`, without its "\n" or "\r\n", or VALUE_NONE
+// after the last one
+bool line_reader_next(Heap *heap, LineReader *reader, Value *line, char *error);
+
+// Free what the objects own besides themselves; used by the collector
+void release_file_data(FileData *data);
+void release_line_reader(LineReader *reader);
+
+#endif // FILE_H
@@ -0,0 +1,37 @@
+#ifndef FLOATING_H
+#define FLOATING_H
+
+#include "common.h"
+#include "buffer.h"
+#include "integer.h"
+
+// Conversions between doubles and decimal text. Both directions depend
+// only on their input, never on the platform's strtod or printf or on the
+// locale, so a program reads and prints the same numbers everywhere:
+//
+//  - Reading rounds to the nearest double, ties to even. Up to 19
+//    significant digits take Clinger's fast path when the digits and the
+//    power of ten are both exact doubles, and otherwise the Eisel-Lemire
+//    algorithm: the digits times a 128-bit truncated power of five, which
+//    decides all but a vanishing few cases. Those, and longer numbers the
+//    first 19 digits do not settle, are worked out exactly with Integer.
+//  - Printing uses Ryu to find the fewest digits that read back as the
+//    same double, closest to it on a tie, laid out as Python's repr() does:
+//    0.1, 1.0, 1e+16, 1e-05.
+//
+// Both algorithms' tables of powers of five are worked out with Integer on
+// first use.
+
+// The double nearest to the ASCII digits `digits` times 10^`exponent`
+double float_from_decimal(const char *digits, size_t length, int64_t exponent);
+// Append `value` in the fewest digits that read back as it, in `style`
+void float_append(Buffer *buffer, double value, DigitStyle style);
+
+// The double nearest to `value`, ties to even
+double float_from_integer(Integer value);
+// The sign of `a` - `b`, exactly; `a` must not be NaN
+int float_compare_integer(double a, Integer b);
+// `value` as an Integer; it must be finite and whole
+Integer float_to_integer(double value);
+
+#endif // FLOATING_H
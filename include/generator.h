@@ -0,0 +1,60 @@
+#ifndef GENERATOR_H
+#define GENERATOR_H
+
+#include "value.h"
+
+// A generator is a call of a ಉತ್ಪಾದಕ that has not run to its end. It runs
+// as a stackless coroutine: nothing of it stays on the C stack or the
+// value stack between values, only its frame, which holds
+//
+//   FRAME_RESUME      where its code goes on, as a tagged offset; or
+//                     FRAME_DONE, or FRAME_RUNNING while it runs
+//   FRAME_DEPTH       how many values it left on the stack at its last
+//                     ನೀಡು, tagged; those of the loops it was inside
+//   FRAME_DEFINITION  its GeneratorDefinition in the chunk, tagged
+//
+// followed by its variables and then room for the values it leaves on the
+// stack. Every frame word is a Value the collector may look at.
+//
+// Frames normally live in a GeneratorObject on the heap. A loop that
+// iterates directly over a call keeps the frame on the value stack below
+// its own state instead, as the generator cannot outlive the loop.
+enum {
+    FRAME_RESUME,
+    FRAME_DEPTH,
+    FRAME_DEFINITION,
+    FRAME_HEADER
+};
+
+#define FRAME_DONE    ((Value)0x01)     // Tagged 0: no code starts at offset 0
+#define FRAME_RUNNING ((Value)-1)       // Tagged -1
+
+typedef struct {
+    Object object;
+    uint32_t size;          // Values in `frame`
+    Value frame[];
+} GeneratorObject;
+
+static inline bool value_is_generator(Value value) {
+    return value_is_object_type(value, OBJECT_GENERATOR);
+}
+
+static inline GeneratorObject *value_as_generator(Value value) {
+    return (GeneratorObject *)value_as_object(value);
+}
+
+// Values in the frame of a generator with `slot_count` variables whose
+// body takes the stack `max_stack` deep
+static inline uint32_t generator_frame_size(int slot_count, int max_stack) {
+    return FRAME_HEADER + (uint32_t)slot_count + (uint32_t)max_stack;
+}
+
+// Start the `size` values of `frame` for a call of generator `definition`,
+// whose body begins at `entry`. The arguments are already in place after
+// the header; the other variables start unassigned.
+void generator_frame_init(Value *frame, uint32_t size, int definition, size_t entry,
+                          int parameter_count, int slot_count);
+// A generator on the heap, with room for a frame of `size` values
+GeneratorObject *generator_create(Heap *heap, uint32_t size);
+
+#endif // GENERATOR_H
@@ -0,0 +1,137 @@
+#ifndef HEAP_H
+#define HEAP_H
+
+#include "common.h"
+
+// A runtime value; see value.h for its encoding
+typedef uint64_t Value;
+
+typedef enum {
+    OBJECT_INTEGER,   // Integer outside the small range
+    OBJECT_FLOAT,
+    OBJECT_STRING,
+    OBJECT_BUILDER,   // Loop accumulator; never seen by user code
+    OBJECT_LIST,
+    OBJECT_DICT,
+    OBJECT_GENERATOR, // Suspended call of a generator; see generator.h
+    OBJECT_FILE_DATA, // Bytes of a file, mapped or read; see file.h
+    OBJECT_LINE_READER,
+    OBJECT_FORWARDED  // Nursery object already copied; `next` is the copy
+} ObjectType;
+
+typedef struct Object {
+    // In the old generation, the next old object. In the nursery, unused
+    // until the object is promoted, then its new address.
+    struct Object *next;
+    size_t size;           // Bytes allocated, header included
+    ObjectType type;
+    bool marked;
+    bool remembered;       // In the heap's remembered set
+    uint8_t owner;         // Tag of the heap that allocated it
+} Object;
+
+typedef struct {
+    size_t minor_collections;
+    size_t major_collections;
+    size_t bytes_allocated;    // Everything requested since the heap was created
+    size_t bytes_promoted;     // Copied out of the nursery
+    size_t bytes_freed;        // Reclaimed from the old generation
+    size_t peak_old_bytes;
+    uint64_t pause_ns;         // Total time spent collecting
+    uint64_t max_pause_ns;
+    uint64_t start_ns;         // When the heap was created
+} GCStats;
+
+// A run of slots that may hold references
+typedef struct {
+    Value *values;
+    size_t count;
+} RootRange;
+
+#define NURSERY_SIZE (1024 * 1024)
+#define LARGE_OBJECT_SIZE (64 * 1024)        // Larger objects skip the nursery
+#define MIN_MAJOR_THRESHOLD (8 * 1024 * 1024)
+
+// The objects of one running program. Each VM owns its heap and runs on a
+// single thread, so allocation takes no locks.
+//
+// New objects are bump-allocated in a fixed nursery. A minor collection
+// copies the nursery's survivors into the old generation, where each
+// object is its own allocation, and the nursery is reused from the start.
+// Once the old generation has doubled since the last full collection, a
+// mark-sweep pass reclaims it as well.
+//
+// Collections only happen inside collect_garbage(), called where the VM
+// knows every reference it holds. Until then a full nursery overflows
+// into the old generation and a collection is requested.
+typedef struct {
+    char *nursery;
+    char *nursery_top;         // Next free byte
+    char *nursery_end;
+
+    Object *old_objects;
+    // Old objects allocated since the last collection. They may point into
+    // the nursery, so a minor collection treats their fields as roots.
+    Object *recent_objects;
+    // Older objects that have been made to point into the nursery since
+    // the last collection; see heap_write_barrier()
+    Object **remembered;
+    size_t remembered_count;
+    size_t remembered_capacity;
+    // Old objects, including the buffers they own
+    size_t old_bytes;
+    size_t young_external_bytes;   // Buffers allocated for nursery objects
+    size_t major_threshold;    // Old bytes at which a full collection is due
+    size_t limit;              // Most old bytes a full collection may leave; 0 for none
+    bool collect_requested;
+
+    // Interned strings, open addressed by hash; see runtime_string.h. They
+    // are allocated old and live as long as the heap.
+    struct StringObject **strings;
+    size_t string_count;
+    size_t string_capacity;
+
+    // Marks the objects this heap owns. Heaps running a parallel loop on
+    // other threads may refer to objects of the heap that started it; a
+    // collection leaves objects with another tag alone.
+    uint8_t tag;
+
+    GCStats stats;
+} Heap;
+
+void init_heap(Heap *heap);
+void free_heap(Heap *heap);
+Object *allocate_object(Heap *heap, ObjectType type, size_t size);
+// Allocate directly in the old generation, for objects expected to live long
+Object *allocate_old_object(Heap *heap, ObjectType type, size_t size);
+
+// Account for a buffer of `bytes` that `owner` allocated outside the heap,
+// so large buffers hasten the next collection
+void heap_note_external(Heap *heap, const Object *owner, size_t bytes);
+void heap_remember(Heap *heap, Object *object);
+
+static inline bool heap_in_nursery(const Heap *heap, const void *pointer) {
+    return (const char *)pointer >= heap->nursery && (const char *)pointer < heap->nursery_end;
+}
+
+// Call after storing `value` into a field of `container`. Objects are
+// otherwise never changed to refer to younger ones, so these stores are
+// the only old-to-young references a minor collection has to look for.
+static inline void heap_write_barrier(Heap *heap, Object *container, Value value) {
+    if ((value & 7) == 0 && heap_in_nursery(heap, (const void *)(uintptr_t)value) &&
+        !container->remembered && !heap_in_nursery(heap, container)) {
+        heap_remember(heap, container);
+    }
+}
+
+// Collect garbage. `roots` must cover every reference the caller holds;
+// they are updated to where their objects moved. Returns false if the live
+// data exceeds the heap's limit.
+bool collect_garbage(Heap *heap, const RootRange *roots, int root_count);
+// Take over the objects of `donor` that `roots` reach, with every object
+// they lead to, and free the rest. The roots then refer into `heap`, and
+// `donor` is left empty. Its statistics are added to the heap's.
+void heap_adopt(Heap *heap, Heap *donor, const RootRange *roots, int root_count);
+void print_gc_stats(const Heap *heap, FILE *stream);
+
+#endif // HEAP_H
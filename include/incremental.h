@@ -0,0 +1,112 @@
+#ifndef INCREMENTAL_H
+#define INCREMENTAL_H
+
+#include "ast.h"
+#include "intern.h"
+#include "lexer.h"
+
+// Incremental documents for editor integrations. A document keeps the
+// token stream and the parsed statements of its source between edits. An
+// edit re-lexes from the first token it touches until the new tokens line
+// up with the old ones again, then re-parses from the statement enclosing
+// the change until the statement boundaries line up again. Statements
+// outside that window are kept as they are.
+//
+// Statements inside blocks are kept the same way. An edit between the
+// braces of a block re-parses only the statements of the innermost such
+// block, and the block's node takes the new statements in place of the
+// old. Should those not parse cleanly, or run past the block's closing
+// brace, they are left as a stale range, since how the parser recovers
+// from an error depends on everything around it. Until its stale ranges
+// are edited into shape again, the top-level statement they are in is
+// parsed in full whenever its errors or program are asked for.
+//
+// Tokens and statements after an edit move by the edit's size. Rather than
+// touching all of them, the shift is recorded as pending from some index
+// onwards and only applied to the entries between one edit and the next,
+// so a keystroke costs about the same in a short file as in a long one.
+// Positions inside a statement are kept relative to it, so they move with
+// it for free.
+
+typedef struct Block Block;
+
+// A parsed statement and the tokens it was parsed from. Top-level
+// statements own their node; the nodes of statements in blocks belong to
+// the block's node.
+typedef struct {
+    ASTNode *node;        // NULL if the statement failed to parse; ಶೂನ್ಯ for a stale range
+    int first_token;      // From the start of the enclosing block's '{', or of the text
+    int token_count;
+    int line_bias;        // Lines still to be added to the node and errors
+    ErrorList errors;     // Lexer and parser errors inside the statement
+    Block *blocks;        // Its blocks in source order, if it parsed cleanly
+    int block_count;
+    int stale;            // Stale ranges in its blocks, or 1 if it is one itself
+    int covers;           // Top-level statements after it that its errors account for
+} Segment;
+
+typedef struct {
+    Segment *segments;
+    int count;
+    int capacity;
+    int shift_from;       // Segments from here on are off by the shift below
+    int token_shift;
+    int line_shift;
+} SegmentList;
+
+struct Block {
+    ASTNode *node;        // The AST_BLOCK node
+    int open;             // Its braces, from the start of the statement
+    int close;
+    int depth;            // The parser's depth for the statements inside
+    int line_bias;        // Lines still to be added to the node
+    SegmentList statements;
+};
+
+typedef struct {
+    char *text;
+    size_t length;
+    size_t capacity;
+
+    Token **tokens;       // Always ends with TOKEN_EOF
+    int token_count;
+    int token_capacity;
+    int token_shift_from; // Tokens from here on are off by the shift below
+    ptrdiff_t token_offset_shift;
+    int token_line_shift;
+
+    SegmentList statements;   // The top-level statements
+
+    // Blocks of the statement being parsed that are not yet inside another
+    Block *pending;
+    int pending_count;
+    int pending_capacity;
+
+    InternTable *names;
+    ASTNode **program_statements; // Backing store for the program node
+    ASTNode program;
+
+    bool resolved;        // Errors of stale top-level statements are up to date
+
+    // Work done by the most recent edit
+    int relexed_tokens;
+    int reparsed_statements;  // At any depth
+    int reparsed_tokens;      // Spanned by those statements
+} Document;
+
+Document *create_document(const char *text, size_t length, InternTable *names);
+void free_document(Document *document);
+
+// Replace `old_length` bytes at `start` with `new_length` bytes of `text`
+void document_edit(Document *document, size_t start, size_t old_length,
+                   const char *text, size_t new_length);
+
+// Append the document's lexer and parser errors to `errors`, in the order
+// a full compile of its text reports them: lexer errors first
+void document_errors(Document *document, ErrorList *errors);
+
+// The program node for the current text, or NULL if it has parse errors.
+// The node belongs to the document and is valid until the next edit.
+ASTNode *document_program(Document *document);
+
+#endif // INCREMENTAL_H
@@ -0,0 +1,101 @@
+#ifndef INTEGER_H
+#define INTEGER_H
+
+#include "common.h"
+#include "buffer.h"
+
+// Arbitrary-precision integer: sign and magnitude in base-2^32 limbs,
+// least significant first, with no leading zero limbs. Immutable once
+// built; every operation returns a new value.
+typedef struct {
+    int sign;             // -1, 0 or 1
+    size_t length;        // Limbs in use; 0 for zero
+    uint32_t limbs[];
+} BigInt;
+
+// An integer that is stored inline while it fits in 64 bits. `big` is
+// NULL in that case, so the common path never allocates. A non-NULL `big`
+// never holds a value that would fit in `small`; results are narrowed
+// back as soon as they fit.
+typedef struct {
+    int64_t small;
+    BigInt *big;          // Owned
+} Integer;
+
+// Parse ASCII decimal digits (no sign)
+Integer integer_from_decimal(const char *digits, size_t length);
+Integer integer_copy(Integer value);
+void integer_free(Integer *value);
+void integer_append(Buffer *buffer, Integer value);
+
+typedef enum {
+    DIGITS_ASCII,
+    DIGITS_KANNADA    // U+0CE6 to U+0CEF, three bytes each in UTF-8
+} DigitStyle;
+
+// Room for any int64_t in either style, sign included
+#define INTEGER_FORMAT_MAX 64
+
+// Write `value` in decimal to `out` without a terminator; returns its length
+size_t integer_format_int64(char out[INTEGER_FORMAT_MAX], int64_t value, DigitStyle style);
+void integer_append_digits(Buffer *buffer, Integer value, DigitStyle style);
+int integer_compare(Integer a, Integer b);
+
+// Overflowing and bignum cases; use the inline operations below
+Integer integer_add_slow(Integer a, Integer b);
+Integer integer_sub_slow(Integer a, Integer b);
+Integer integer_mul_slow(Integer a, Integer b);
+Integer integer_neg_slow(Integer a);
+
+// Python semantics: the quotient rounds toward negative infinity and the
+// remainder takes the sign of the divisor. Both return false if `b` is zero.
+bool integer_floordiv(Integer a, Integer b, Integer *result);
+bool integer_mod(Integer a, Integer b, Integer *result);
+bool integer_divmod(Integer a, Integer b, Integer *quotient, Integer *remainder);
+
+// Bits of the magnitude: how many there are, and the 64 of them from bit
+// `start` up, setting `below` if any bit under `start` is set
+size_t integer_bit_length(Integer value);
+uint64_t integer_bits(Integer value, size_t start, bool *below);
+Integer integer_shift_left(Integer value, size_t bits);
+
+static inline Integer integer_from_int64(int64_t value) {
+    return (Integer){value, NULL};
+}
+
+static inline bool integer_is_small(Integer value) {
+    return value.big == NULL;
+}
+
+static inline Integer integer_add(Integer a, Integer b) {
+    Integer result = {0, NULL};
+    if (a.big == NULL && b.big == NULL && !__builtin_add_overflow(a.small, b.small, &result.small)) {
+        return result;
+    }
+    return integer_add_slow(a, b);
+}
+
+static inline Integer integer_sub(Integer a, Integer b) {
+    Integer result = {0, NULL};
+    if (a.big == NULL && b.big == NULL && !__builtin_sub_overflow(a.small, b.small, &result.small)) {
+        return result;
+    }
+    return integer_sub_slow(a, b);
+}
+
+static inline Integer integer_mul(Integer a, Integer b) {
+    Integer result = {0, NULL};
+    if (a.big == NULL && b.big == NULL && !__builtin_mul_overflow(a.small, b.small, &result.small)) {
+        return result;
+    }
+    return integer_mul_slow(a, b);
+}
+
+static inline Integer integer_neg(Integer a) {
+    if (a.big == NULL && a.small != INT64_MIN) {
+        return (Integer){-a.small, NULL};
+    }
+    return integer_neg_slow(a);
+}
+
+#endif // INTEGER_H
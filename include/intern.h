@@ -0,0 +1,29 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+#include "common.h"
+#include <pthread.h>
+
+// Interned strings. Each distinct string is stored once and lives as long
+// as the table, so interned names can be compared by pointer and shared by
+// tokens and AST nodes without copying. Tables are safe to share between
+// threads.
+typedef struct InternEntry {
+    struct InternEntry *next;  // For chaining in case of hash collisions
+    uint64_t hash;
+    size_t length;
+    char text[];
+} InternEntry;
+
+typedef struct {
+    InternEntry **buckets;
+    size_t size;      // Number of buckets
+    size_t count;     // Number of interned strings
+    pthread_mutex_t lock;
+} InternTable;
+
+InternTable *create_intern_table(size_t size);
+void free_intern_table(InternTable *table);
+const char *intern_string(InternTable *table, const char *text, size_t length);
+
+#endif // INTERN_H
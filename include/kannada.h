@@ -0,0 +1,70 @@
+#ifndef KANNADA_H
+#define KANNADA_H
+
+// Embeddable compiler API (libkannada.a / libkannada.so).
+// Nothing in this API writes to stdout/stderr or terminates the process.
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#define KPY_MAX_MESSAGE_LENGTH 512
+
+typedef enum {
+    KPY_OK = 0,
+    KPY_ERROR_COMPILE,          // Source has errors; see diagnostics
+    KPY_ERROR_BUFFER_TOO_SMALL, // Caller buffer overflowed; output_length is the size needed
+    KPY_ERROR_NO_MEMORY,
+    KPY_ERROR_INVALID_ARGUMENT
+} kpy_status;
+
+typedef enum {
+    KPY_DIAGNOSTIC_LEXER = 1,
+    KPY_DIAGNOSTIC_PARSER,
+    KPY_DIAGNOSTIC_SEMANTIC,
+    KPY_DIAGNOSTIC_CODEGEN
+} kpy_diagnostic_kind;
+
+typedef struct {
+    kpy_diagnostic_kind kind;
+    int line;
+    char message[KPY_MAX_MESSAGE_LENGTH];
+} kpy_diagnostic;
+
+typedef struct {
+    // Optional caller-provided output storage. When NULL the result owns a
+    // heap buffer that grows as needed and is released by kpy_result_free.
+    char *buffer;
+    size_t buffer_size;
+} kpy_options;
+
+typedef struct {
+    char *output;               // NUL-terminated generated code
+    size_t output_length;       // Bytes generated (excluding the NUL)
+    kpy_diagnostic *diagnostics;
+    size_t diagnostic_count;
+    bool owns_output;           // output was allocated by the library
+} kpy_result;
+
+// Compile `len` bytes of `src`. `options` may be NULL. The result must be
+// released with kpy_result_free whatever the returned status.
+kpy_status kpy_compile(const char *src, size_t len, const kpy_options *options, kpy_result *result);
+void kpy_result_free(kpy_result *result);
+
+const char *kpy_status_string(kpy_status status);
+
+// Incremental documents for editors. A document keeps its tokens and
+// parsed statements between edits, so an edit only re-lexes and re-parses
+// the text around it.
+typedef struct kpy_document kpy_document;
+
+kpy_document *kpy_document_open(const char *src, size_t len);
+void kpy_document_close(kpy_document *document);
+
+// Replace `old_length` bytes at byte offset `start` with `new_length` bytes of `text`
+kpy_status kpy_document_edit(kpy_document *document, size_t start, size_t old_length,
+                             const char *text, size_t new_length);
+
+// Compile the document's current text; same contract as kpy_compile
+kpy_status kpy_document_compile(kpy_document *document, const kpy_options *options, kpy_result *result);
+
+#endif // KANNADA_H
@@ -1,61 +1,105 @@
-#ifndef LEXER_H
-#define LEXER_H
-
-#include "common.h"
-
-// Token types
-typedef enum {
-    TOKEN_EOF,
-    TOKEN_ERROR,
-
-    // Literals
-    TOKEN_IDENTIFIER,
-    TOKEN_NUMBER,
-    TOKEN_STRING,
-
-    // Keywords
-    TOKEN_IF,
-    TOKEN_ELSE,
-    TOKEN_WHILE,
-    TOKEN_PRINT,
-    TOKEN_TRUE,
-    TOKEN_FALSE,
-    TOKEN_NONE,
-
-    // Operators
-    TOKEN_PLUS,
-    TOKEN_MINUS,
-    TOKEN_MULTIPLY,
-    TOKEN_DIVIDE,
-    TOKEN_ASSIGN,
-    TOKEN_STAR,
-    TOKEN_SLASH,
-    TOKEN_EQUAL,
-
-    // Delimiters
-    TOKEN_LPAREN,
-    TOKEN_RPAREN,
-    TOKEN_LBRACE,
-    TOKEN_RBRACE,
-    TOKEN_SEMICOLON
-} TokenType;
-
-// Token structure
-typedef struct {
-    TokenType type;
-    union {
-        int number;
-        char *string;
-    } value;
-    int line;
-} Token;
-
-// Function prototypes
-void init_lexer(const char *input);
-Token *get_next_token(void);
-void free_token(Token *token);
-
-// Helper function to convert TokenType to string (for debugging)
-const char *token_type_to_string(TokenType type);
-
+#ifndef LEXER_H
+#define LEXER_H
+
+#include "common.h"
+#include "integer.h"
+#include "intern.h"
+
+// Token types
+typedef enum {
+    TOKEN_EOF,
+    TOKEN_ERROR,
+
+    // Literals
+    TOKEN_IDENTIFIER,
+    TOKEN_NUMBER,
+    TOKEN_FLOAT,
+    TOKEN_STRING,
+
+    // Keywords
+    TOKEN_IF,
+    TOKEN_ELSE,
+    TOKEN_WHILE,
+    TOKEN_FOR,
+    TOKEN_PARALLEL,
+    TOKEN_IN,
+    TOKEN_RANGE,
+    TOKEN_PRINT,
+    TOKEN_TRUE,
+    TOKEN_FALSE,
+    TOKEN_NONE,
+    TOKEN_IMPORT,
+    TOKEN_GENERATOR,
+    TOKEN_YIELD,
+    TOKEN_FUNCTION,
+    TOKEN_RETURN,
+    TOKEN_AND,
+    TOKEN_OR,
+    TOKEN_NOT,
+
+    // Operators
+    TOKEN_PLUS,
+    TOKEN_MINUS,
+    TOKEN_MULTIPLY,
+    TOKEN_DIVIDE,
+    TOKEN_ASSIGN,
+    TOKEN_STAR,
+    TOKEN_SLASH,
+    TOKEN_EQUAL,
+    TOKEN_NOT_EQUAL,
+    TOKEN_LESS,
+    TOKEN_LESS_EQUAL,
+    TOKEN_GREATER,
+    TOKEN_GREATER_EQUAL,
+    TOKEN_PERCENT,
+
+    // Delimiters
+    TOKEN_LPAREN,
+    TOKEN_RPAREN,
+    TOKEN_LBRACE,
+    TOKEN_RBRACE,
+    TOKEN_LBRACKET,
+    TOKEN_RBRACKET,
+    TOKEN_COMMA,
+    TOKEN_COLON,
+    TOKEN_SEMICOLON,
+
+    TOKEN_TYPE_COUNT    // Number of token types; keep last
+} TokenType;
+
+// Token structure
+typedef struct {
+    TokenType type;
+    union {
+        Integer number;     // TOKEN_NUMBER, owned by the token
+        double real;        // TOKEN_FLOAT
+        char *string;       // TOKEN_STRING and TOKEN_ERROR message, owned by the token
+        const char *name;   // TOKEN_IDENTIFIER, interned
+    } value;
+    int line;
+    size_t offset;          // Byte offset of the token in the input
+    size_t length;          // Length of the token in bytes
+} Token;
+
+// Lexer state. Each compilation owns its own lexer so several sources can
+// be tokenized at once; the input need not be NUL-terminated.
+typedef struct {
+    const char *start;
+    const char *current;
+    const char *end;
+    int line;
+    ErrorList *errors;
+    InternTable *names;  // Identifiers are interned here
+} Lexer;
+
+// Function prototypes
+void init_lexer(Lexer *lexer, const char *input, size_t length, ErrorList *errors, InternTable *names);
+// Resume lexing at `offset` (a token boundary) on source line `line`
+void seek_lexer(Lexer *lexer, size_t offset, int line);
+Token *get_next_token(Lexer *lexer);
+void free_token(Token *token);
+
+// Helper function to convert TokenType to string (for debugging)
+const char *token_type_to_string(TokenType type);
+
 #endif // LEXER_H
\ No newline at end of file
@@ -0,0 +1,63 @@
+#ifndef LIST_H
+#define LIST_H
+
+#include "value.h"
+
+// A list: elements stored contiguously in a buffer that doubles as it
+// grows. While every element is a small integer the buffer holds plain
+// int64_t values (`unboxed`), which the bulk operations below process a
+// vector at a time. Storing anything else converts the buffer to tagged
+// Values in place.
+typedef struct {
+    Object object;
+    size_t count;
+    size_t capacity;
+    bool unboxed;
+    union {
+        int64_t *ints;      // unboxed
+        Value *values;
+    } items;
+} ListObject;
+
+static inline ListObject *value_as_list(Value value) {
+    return (ListObject *)value_as_object(value);
+}
+
+static inline bool value_is_list(Value value) {
+    return value_is_object_type(value, OBJECT_LIST);
+}
+
+// An empty list with room for `capacity` elements
+ListObject *list_create(Heap *heap, size_t capacity);
+// A list holding `values`
+Value list_from_values(Heap *heap, const Value *values, size_t count);
+
+static inline Value list_get(const ListObject *list, size_t index) {
+    return list->unboxed ? value_from_small_int(list->items.ints[index]) : list->items.values[index];
+}
+
+void list_set(Heap *heap, ListObject *list, size_t index, Value value);
+void list_append(Heap *heap, ListObject *list, Value value);
+
+// Resolve a Python-style index, negative counting from the end, against a
+// sequence of `count` elements. Returns false if it is out of range or not
+// an integer.
+bool sequence_index(Value index, size_t count, size_t *result);
+
+Value list_concat(Heap *heap, const ListObject *a, const ListObject *b);
+
+// Bulk operations. Each returns false and sets `error` if an element has
+// the wrong type; `error` has room for MAX_ERROR_MESSAGE_LENGTH bytes.
+bool list_sum(Heap *heap, const ListObject *list, Value *result, char *error);
+// `want_max` picks the largest element instead; the list must not be empty
+bool list_extreme(const ListObject *list, bool want_max, Value *result, char *error);
+// Elementwise a + b or a * b. Either may be a scalar applied to every
+// element of the other; two lists must have the same length.
+bool list_elementwise(Heap *heap, Value a, Value b, bool multiply, Value *result, char *error);
+// A sorted copy, smallest first; equal elements keep their order
+bool list_sorted(Heap *heap, const ListObject *list, Value *result, char *error);
+
+// Free the element buffer; used by the collector
+void release_list(ListObject *list);
+
+#endif // LIST_H
@@ -0,0 +1,47 @@
+#ifndef LOOP_H
+#define LOOP_H
+
+#include "ast.h"
+
+// How the bytecode compiler may specialize a while loop that counts with
+// a single induction variable:
+//
+//     ಆಗಿರುವ i < n { ... i = i + c; ... }
+//
+// where `i = i + c;` (or `i - c`) is the body's only assignment to i, it
+// is a statement of the body itself so it runs once per iteration, n is a
+// number or a variable the body never assigns, and c moves i towards n.
+// Once i and n are known to be integers, i + (factor - 1) * c passing the
+// condition means the next `factor` iterations all do, so they can run
+// back to back with one test; and each `i * k` in the body can be kept
+// up to date by adding c * k whenever i steps.
+typedef struct {
+    const char *variable;       // i; interned
+    const ASTNode *update;      // The `i = i + c;` statement
+    Integer step;               // c, negated for `i - c`; owned
+    const ASTNode *bound;       // n: an AST_VARIABLE or AST_NUMBER
+    int factor;                 // Iterations per test; 1 to only reduce products
+
+    // The `i * k` and `k * i` nodes of the body, and for each the index
+    // of its k among the distinct `multipliers`
+    const ASTNode **products;
+    int *product_multipliers;
+    int product_count;
+    const Integer **multipliers;
+    int multiplier_count;
+} LoopPlan;
+
+#define DEFAULT_UNROLL_FACTOR 4
+
+// Decide whether and how far to specialize `loop`, an AST_WHILE, unrolling
+// at most `max_factor` times. The cost model only unrolls bodies with no
+// loops of their own, whose overhead is not already amortized, and keeps
+// the copies within a fixed size. Returns false if the loop does not
+// qualify or nothing would be gained; otherwise fill in `plan`.
+bool plan_loop(const ASTNode *loop, int max_factor, LoopPlan *plan);
+void free_loop_plan(LoopPlan *plan);
+
+// The index of `node` among the plan's products, or -1
+int find_product(const LoopPlan *plan, const ASTNode *node);
+
+#endif // LOOP_H
@@ -0,0 +1,70 @@
+#ifndef MODULE_H
+#define MODULE_H
+
+#include "ast.h"
+#include "intern.h"
+
+// Multi-module builds. Starting from an entry file, `ಆಮದು name;` statements
+// are resolved to `name.kpy` in the search paths and the resulting
+// dependency graph is compiled on a pool of threads, each module as soon as
+// everything it imports is done.
+//
+// For every module the build writes `<name>.kpyc` (generated code) and
+// `<name>.kpyi` (its interface: the names it exports, plus the hashes used
+// to decide whether it is up to date). A module is recompiled only if its
+// source changed or the interface of something it imports changed.
+
+typedef enum {
+    MODULE_PENDING,
+    MODULE_COMPILED,
+    MODULE_UP_TO_DATE,
+    MODULE_FAILED,
+    MODULE_SKIPPED      // Not compiled because an import failed
+} ModuleState;
+
+typedef struct Module {
+    const char *name;            // Interned
+    char *path;
+    char *source;
+    size_t source_length;
+    uint64_t source_hash;
+    ASTNode *ast;                // Parsed on demand
+
+    struct Module **imports;
+    int import_count;
+    int *import_lines;
+    struct Module **dependents;
+    int dependent_count;
+    int pending_imports;         // Imports not finished yet
+
+    // Interface recorded by the previous build, if its source matches
+    bool cache_valid;
+    uint64_t cached_interface_hash;
+    const char **cached_import_names;
+    uint64_t *cached_import_hashes;
+    int *cached_import_lines;
+    int cached_import_count;
+    const char **cached_exports;
+    int cached_export_count;
+
+    // Interface after this build
+    const char **exports;
+    int export_count;
+    uint64_t interface_hash;
+
+    ModuleState state;
+    ErrorList errors;
+} Module;
+
+typedef struct {
+    const char **search_paths;   // Searched in order for `<name>.kpy`
+    int search_path_count;
+    const char *output_dir;
+    int jobs;                    // Worker threads; 0 means one per CPU
+} BuildOptions;
+
+// Build `entry_file` and everything it imports. Diagnostics go to stderr;
+// returns true if every module compiled or was already up to date.
+bool build_modules(const char *entry_file, const BuildOptions *options);
+
+#endif // MODULE_H
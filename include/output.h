@@ -0,0 +1,45 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <stdio.h>
+#include "common.h"
+#include "buffer.h"
+
+#define OUTPUT_BUFFER_SIZE (64 * 1024)
+
+// What a running program prints. Writes collect in a large buffer that
+// goes to the stream when it fills, on output_flush() and when the output
+// is freed. When the stream is a terminal, each finished line is flushed
+// as well, so interactive output appears as it is printed.
+typedef struct {
+    FILE *stream;
+    Buffer *capture;        // Where flushes go when there is no stream
+    char *data;
+    size_t length;
+    bool line_buffered;
+} Output;
+
+// With a NULL stream, set `capture` before writing: output is then kept
+// there, for a thread whose output must come out in order with others'
+void output_init(Output *output, FILE *stream);
+// Flushes whatever is still buffered
+void output_free(Output *output);
+void output_flush(Output *output);
+void output_write(Output *output, const char *data, size_t length);
+// Finish a printed line
+void output_end_line(Output *output);
+
+// Space for up to `length` bytes (at most OUTPUT_BUFFER_SIZE) written in
+// place; output_commit() then keeps the bytes actually used
+static inline char *output_reserve(Output *output, size_t length) {
+    if (OUTPUT_BUFFER_SIZE - output->length < length) {
+        output_flush(output);
+    }
+    return output->data + output->length;
+}
+
+static inline void output_commit(Output *output, size_t length) {
+    output->length += length;
+}
+
+#endif // OUTPUT_H
@@ -0,0 +1,60 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include "ast.h"
+#include "symbol_table.h"
+
+// A ಸಮಾನಾಂತರ loop may run its iterations on several threads at once, so
+// they must not depend on one another. Every variable its body assigns is
+// one of:
+//
+//  - private: each iteration assigns it at the top level of the body
+//    before anything reads it, or never reads it. Every thread has its
+//    own copy. After the loop it holds what the last iteration to assign
+//    it left there, as after a sequential loop; so does the loop variable.
+//  - a reduction: the body only ever updates it with `x = x + e;`,
+//    `x = ಕನಿಷ್ಠ([x, e]);` or `x = ಗರಿಷ್ಠ([x, e]);` and reads it nowhere
+//    else. The iterations each thread runs are combined on their own and
+//    the results combined in iteration order, so `+` on strings and lists
+//    gives what a sequential loop would. A float sum is grouped
+//    differently, so it may round differently.
+//
+// A call of a ಕಾರ್ಯ counts as reading every global the function reads,
+// directly or through the functions it calls, so a function cannot see a
+// reduction part way through.
+//
+// Lists and dictionaries that the iterations share must not be changed,
+// and the body cannot ನೀಡು values for a generator or ಹಿಂತಿರುಗಿಸು from a
+// function.
+// Storing into or appending to a variable that is not private is caught
+// here; other changes to shared objects are caught when the loop runs.
+typedef enum {
+    REDUCE_SUM,
+    REDUCE_MIN,
+    REDUCE_MAX
+} ReductionKind;
+
+typedef struct {
+    const char *name;       // Interned
+    ReductionKind kind;
+} Reduction;
+
+typedef struct {
+    Reduction *reductions;
+    int reduction_count;
+    const char **privates;  // Interned, the loop variable first
+    int private_count;
+} ParallelPlan;
+
+// Sort out the variables of the parallel `loop`, an AST_FOR. The functions
+// it calls are looked up in `symbol_table`. Returns false if its
+// iterations could depend on each other, reporting why to `errors` unless
+// it is NULL.
+bool plan_parallel_loop(const ASTNode *loop, ParallelPlan *plan, SymbolTable *symbol_table, ErrorList *errors);
+void free_parallel_plan(ParallelPlan *plan);
+
+// If the assignment `assign` has the form of a reduction, the operand it
+// combines into its variable, setting `kind`; otherwise NULL
+const ASTNode *reduction_operand(const ASTNode *assign, ReductionKind *kind);
+
+#endif // PARALLEL_H
@@ -1,30 +1,71 @@
-#ifndef PARSER_H
-#define PARSER_H
-
-#include "ast.h"
-#include "lexer.h"
-
-// Function declarations for the parser
-
-typedef struct {
-    Token **tokens;
-    int current;
-    int length;
-} Parser;
-
-Parser *create_parser(Token **tokens, int length);
-void free_parser(Parser *parser);
-
-ASTNode *parse_program(Parser *parser);
-ASTNode *parse_block(Parser *parser);
-ASTNode *parse_statement(Parser *parser);
-ASTNode *parse_if_statement(Parser *parser);
-ASTNode *parse_while_statement(Parser *parser);
-ASTNode *parse_print_statement(Parser *parser);
-ASTNode *parse_assign_statement(Parser *parser);
-ASTNode *parse_expression(Parser *parser);
-ASTNode *parse_term(Parser *parser);
-ASTNode *parse_factor(Parser *parser);
-ASTNode *parse_primary(Parser *parser);
-
-#endif // PARSER_H
+#ifndef PARSER_H
+#define PARSER_H
+
+#include "ast.h"
+#include "lexer.h"
+#include "expression_table.h"
+
+// Function declarations for the parser
+
+// Told about each block parsed without errors, inner blocks before the
+// blocks around them, so that an incremental parser can later re-parse the
+// statements of one block on their own. `open` and `close` are the token
+// indices of its braces and `starts` those where each of its statements
+// starts; the listener takes ownership of `starts`. `depth` is the
+// parser's depth for the statements inside the block.
+typedef struct {
+    void (*block)(ASTNode *block, int open, int close, int *starts, int depth, void *context);
+    void *context;
+} BlockListener;
+
+typedef struct {
+    Token **tokens;
+    int current;
+    int length;
+    ErrorList *errors;
+    ExpressionTable *expressions;   // Hash-conses pure expressions if not NULL
+    int depth;                      // Expressions and blocks being parsed, each inside the last
+    bool too_deep;                  // Gave up on the statement for nesting past MAX_NESTING_DEPTH
+    BlockListener *listener;        // Told where blocks and their statements are, if not NULL
+} Parser;
+
+// Expressions and blocks may nest this deep. The parser recurses for each
+// level, so deeper input is reported as an error rather than left to run
+// out of stack.
+#define MAX_NESTING_DEPTH 1000
+
+// Parse functions report problems to the parser's error list and return
+// NULL; the token stream must end with TOKEN_EOF. Nesting too deep skips
+// the rest of the tokens, since every level left open would otherwise
+// report its own missing bracket. Expressions are not
+// shared unless the caller sets `expressions`.
+Parser *create_parser(Token **tokens, int length, ErrorList *errors);
+void free_parser(Parser *parser);
+
+ASTNode *parse_program(Parser *parser);
+// Parse one statement of a program. On error, skips to where the next
+// statement can start and returns NULL.
+ASTNode *parse_top_level_statement(Parser *parser);
+ASTNode *parse_block(Parser *parser);
+ASTNode *parse_statement(Parser *parser);
+ASTNode *parse_if_statement(Parser *parser);
+ASTNode *parse_while_statement(Parser *parser);
+// ಪ್ರತಿ name ಒಳಗೆ ವ್ಯಾಪ್ತಿ([start,] stop[, step]) { ... }, or a parallel
+// loop with ಸಮಾನಾಂತರ in place of ಪ್ರತಿ; or ಪ್ರತಿ name ಒಳಗೆ generator { ... }
+ASTNode *parse_for_statement(Parser *parser);
+ASTNode *parse_print_statement(Parser *parser);
+// A statement starting with an identifier: an assignment to a variable or
+// list element, or an expression such as a call evaluated for its effect
+ASTNode *parse_assign_statement(Parser *parser);
+ASTNode *parse_import_statement(Parser *parser);
+// ಉತ್ಪಾದಕ name(parameters) { ... }, only at the top level of a program
+ASTNode *parse_generator_definition(Parser *parser);
+// ನೀಡು value;
+ASTNode *parse_yield_statement(Parser *parser);
+// ಕಾರ್ಯ name(parameters) { ... }, only at the top level of a program
+ASTNode *parse_function_definition(Parser *parser);
+// ಹಿಂತಿರುಗಿಸು value; or ಹಿಂತಿರುಗಿಸು;
+ASTNode *parse_return_statement(Parser *parser);
+ASTNode *parse_expression(Parser *parser);
+
+#endif // PARSER_H
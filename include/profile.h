@@ -0,0 +1,109 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <pthread.h>
+#include "ast.h"
+
+// How often the sampler looks at the running program
+#define PROFILE_INTERVAL_NS 1000000
+// Hottest lines shown in the report
+#define PROFILE_REPORT_LINES 20
+// Calls recorded in a stack; the line running in a deeper call stands in
+// for the innermost recorded one
+#define PROFILE_CALL_DEPTH 1024
+
+// Where a profiled program spends its time, by source line and call path.
+// Code compiled for profiling marks the start of each statement with
+// OP_LINE, which counts a hit and records the line as the one running in
+// the current call. Calls and resumed generators push a call and their
+// returns and yields pop it. A sampler thread wakes every
+// PROFILE_INTERVAL_NS and charges the time since its last wake-up to the
+// stack it finds: to the innermost line as its own time, and to every line
+// on the stack, with the statements around each, as their total time. So
+// the VM itself never reads the clock.
+typedef struct {
+    uint64_t hits;          // Times a statement on this line started
+    uint64_t samples;       // Ticks that found it the innermost line
+    uint64_t nanoseconds;   // Time spent on it, not counting other lines
+    uint64_t total_nanoseconds; // Time spent on it, the statements inside it and what they call
+} LineProfile;
+
+// A call path in the collapsed stacks: a line, under the line it hangs
+// from. Node 0 is the root.
+typedef struct {
+    int line;
+    int parent;
+    int first_child;
+    int next_sibling;
+    uint64_t nanoseconds;   // Time with this path the whole stack
+} StackNode;
+
+typedef struct {
+    LineProfile *lines;     // By line number; line 0 is time before the first statement of a call
+    int *parents;           // Line of the statement enclosing each line's, or 0
+    bool *definitions;      // Whether each line starts a function or generator
+    int line_count;
+    int nesting;            // Most lines one call's statements nest
+
+    // The line running in each call, outermost first
+    atomic_int *calls;
+    atomic_int call_depth;  // Of the innermost call; 0 outside any
+    atomic_bool running;
+    pthread_t sampler;
+    uint64_t start_ns;
+    uint64_t stop_ns;
+    uint64_t elapsed_ns;
+
+    // Kept by the sampler
+    StackNode *nodes;
+    int node_count;
+    int node_capacity;
+    uint64_t *seen;         // By line, the last tick that charged it total time
+    int *chain;             // Scratch for one call's lines
+} Profile;
+
+// A profile sized for the lines of `program`, recording how its
+// statements nest for the collapsed stacks
+Profile *create_profile(ASTNode *program);
+void free_profile(Profile *profile);
+
+// Start and stop the sampler around a run
+bool start_profile(Profile *profile);
+void stop_profile(Profile *profile);
+
+static inline void profile_enter(Profile *profile, int line) {
+    profile->lines[line].hits++;
+    int depth = atomic_load_explicit(&profile->call_depth, memory_order_relaxed);
+    if (depth >= PROFILE_CALL_DEPTH) {
+        depth = PROFILE_CALL_DEPTH - 1;
+    }
+    atomic_store_explicit(&profile->calls[depth], line, memory_order_relaxed);
+}
+
+// A function called or a generator resumed, which runs no line yet
+static inline void profile_call(Profile *profile) {
+    int depth = atomic_load_explicit(&profile->call_depth, memory_order_relaxed) + 1;
+    if (depth < PROFILE_CALL_DEPTH) {
+        atomic_store_explicit(&profile->calls[depth], 0, memory_order_relaxed);
+    }
+    atomic_store_explicit(&profile->call_depth, depth, memory_order_relaxed);
+}
+
+// A return or yield, back to the line that made the call
+static inline void profile_return(Profile *profile) {
+    atomic_store_explicit(&profile->call_depth, atomic_load_explicit(&profile->call_depth, memory_order_relaxed) - 1,
+                          memory_order_relaxed);
+}
+
+// The lines with the most total time, each with its own time and its text
+// from `source`
+void print_profile_report(const Profile *profile, const char *source, size_t length, FILE *stream);
+// One line per call path that was sampled, in the collapsed-stack format
+// flame graph tools read: from the outermost, each call's line and the
+// statements around it up to its function, separated by semicolons, then
+// the time in microseconds with that path the whole stack
+void write_collapsed_stacks(const Profile *profile, const char *source, size_t length, FILE *stream);
+
+#endif // PROFILE_H
@@ -0,0 +1,19 @@
+#ifndef REPL_H
+#define REPL_H
+
+#include "compiler.h"
+
+// An interactive session. Each input is compiled against the symbol table
+// the session has built up and appended to its one chunk, then run at
+// once in the same VM, so variables, functions, generators and heap
+// objects carry over from one input to the next. Only the new input is
+// lexed, parsed, analyzed and compiled, so a response takes as long as
+// its input does however long the session has run.
+//
+// An input ends at a line that closes every bracket and string it opens.
+// One that does not compile is dropped whole, names and code; one that
+// stops with a runtime error keeps what it did up to there. Prompts are
+// shown only when `input` is a terminal. Returns true if no input failed.
+bool run_repl(FILE *input, FILE *output, const RunOptions *options);
+
+#endif // REPL_H
@@ -0,0 +1,104 @@
+#ifndef RUNTIME_STRING_H
+#define RUNTIME_STRING_H
+
+#include "value.h"
+
+// Strings are immutable UTF-8 byte sequences. Three representations share
+// one interface:
+//
+//  - Up to SHORT_STRING_MAX bytes are stored in the Value word itself, so
+//    single characters and short separators never allocate.
+//  - Longer strings are StringObjects holding their bytes.
+//  - Concatenations of ROPE_MIN_LENGTH bytes or more make a rope node that
+//    refers to both halves. It is flattened on the first read of its
+//    bytes, so building a long string piece by piece copies it only once.
+//  - A slice points at bytes inside another object, a file's data or a
+//    string it was split from, and keeps that object alive. Its bytes are
+//    not NUL-terminated.
+//
+// Every string of up to SHORT_STRING_MAX bytes is short, so short strings
+// compare as words and a short string never equals an object.
+//
+// Strings made in the program are valid UTF-8. Bytes read from a file are
+// only decoded by what counts characters, which fails on invalid ones.
+
+#define ROPE_MIN_LENGTH 64
+// Indexing records the byte offset of every this-many codepoints
+#define STRING_BREADCRUMB_STRIDE 64
+// The codepoint count of a string whose bytes are not valid UTF-8
+#define STRING_INVALID_UTF8 (SIZE_MAX - 1)
+
+typedef struct StringObject {
+    Object object;
+    size_t length;          // Bytes
+    size_t codepoints;      // SIZE_MAX until counted, or STRING_INVALID_UTF8
+    uint64_t hash;          // 0 until computed
+    bool interned;          // Two interned strings are equal only if identical
+    char *chars;            // NUL-terminated unless a slice; NULL while a rope
+    Value left;             // Halves of a rope; VALUE_NONE once flat. A slice
+    Value right;            // keeps what it points into in `left`.
+    size_t *breadcrumbs;    // Built by the first index into a non-ASCII string
+    char storage[];         // Holds `chars` for strings created flat
+} StringObject;
+
+// A string under construction by a loop that appends to one variable. The
+// compiler keeps it out of reach of everything but appends, and turns it
+// back into a string before the variable is otherwise read.
+typedef struct {
+    Object object;
+    char *chars;
+    size_t length;
+    size_t capacity;
+} StringBuilder;
+
+static inline StringObject *value_as_string(Value value) {
+    return (StringObject *)value_as_object(value);
+}
+
+static inline bool string_is_slice(const StringObject *string) {
+    return string->chars != NULL && string->chars != string->storage && string->left != VALUE_NONE;
+}
+
+Value string_from_chars(Heap *heap, const char *chars, size_t length);
+// The single shared copy of a string, used for literals
+Value string_intern(Heap *heap, const char *chars, size_t length);
+Value string_concat(Heap *heap, Value a, Value b);
+// A string of the `length` bytes at `chars`, which lie inside `owner` and
+// never move: a FileData, or a string whose bytes are outside the nursery
+Value string_slice(Heap *heap, Value owner, const char *chars, size_t length);
+// The parts of `string` between occurrences of the non-empty `delimiter`,
+// as a list of slices of it
+Value string_split(Heap *heap, Value string, Value delimiter);
+
+// The string's bytes, NUL-terminated unless it is a slice. A short string
+// is copied into `scratch`; a rope is flattened first.
+const char *string_chars(Value string, char scratch[SHORT_STRING_MAX + 1]);
+size_t string_byte_length(Value string);
+// Length in codepoints; counted once and cached. Returns false if the
+// string is not valid UTF-8.
+bool string_length(Value string, size_t *length);
+// The codepoint at `index` as a string. Returns false if out of range or
+// the string is not valid UTF-8.
+bool string_index(Value string, size_t index, Value *result);
+
+bool string_equal(Value a, Value b);
+int string_compare(Value a, Value b);
+uint64_t string_hash(Value string);
+
+// Flatten a string and fill in what reads would otherwise compute and
+// cache on first use: its hash, its length and its breadcrumbs. A settled
+// string is never written again, so threads may share it.
+void string_settle(Value string);
+
+// Start a builder holding a copy of `string`
+StringBuilder *builder_create(Heap *heap, Value string);
+void builder_append(StringBuilder *builder, Value string);
+// The built string. The builder is left empty.
+Value builder_finish(Heap *heap, StringBuilder *builder);
+
+// Free what the objects own besides themselves; used by the collector
+void release_string_object(StringObject *string);
+void release_builder(StringBuilder *builder);
+void free_string_table(Heap *heap);
+
+#endif // RUNTIME_STRING_H
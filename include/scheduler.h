@@ -0,0 +1,54 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include "vm.h"
+
+#define PARALLEL_MAX_THREADS 64
+// A batch of iterations is sized to take between these times, so each
+// costs little to hand out yet the load still evens out at the end
+#define PARALLEL_BATCH_MIN_NS 100000
+#define PARALLEL_BATCH_MAX_NS 1000000
+// How long the calling thread runs a loop alone before sharing it out
+#define PARALLEL_INLINE_NS 100000
+
+// Runs parallel loops on a pool of threads, which a VM starts for its
+// first parallel loop and keeps until it is freed. Every thread has a VM
+// of its own, with its own heap and copy of the globals, so iterations
+// allocate and assign variables without locks; they share the objects the
+// globals refer to, which are settled first so reading them changes
+// nothing.
+//
+// The calling thread starts on the loop alone. A loop that is done within
+// PARALLEL_INLINE_NS, as one with few short iterations is, never wakes the
+// pool. Otherwise what is left of the range is split evenly between the
+// threads, each of which takes batches of iterations from the front of
+// its part. A thread that runs out takes the back half of another's, so
+// the load evens out whatever the iterations cost. Batch sizes double
+// while batches take under PARALLEL_BATCH_MIN_NS and halve while they
+// take over PARALLEL_BATCH_MAX_NS. A parallel loop inside an iteration
+// runs on that iteration's thread.
+//
+// Each batch keeps what it printed, its partial reductions and the last
+// values it gave the private variables. Once every thread is done, the
+// output is written, the reductions combined and the private variables
+// set in iteration order, so a program prints and computes what the loop
+// would sequentially. If iterations fail, only the work of those up to the
+// first failure is kept, and that failure is reported.
+
+typedef struct ThreadPool ThreadPool;
+
+// Run `loop` of `chunk`, whose range has `count` values from `start` by
+// `step`, on up to vm->threads threads. Returns false after reporting an
+// error to `errors`.
+bool run_parallel_loop(VM *vm, Chunk *chunk, const ParallelLoop *loop, Value start, Value step,
+                       uint64_t count, ErrorList *errors);
+
+// Combine `value` into the reduction `total`. Returns false and sets
+// `error`, which has room for MAX_ERROR_MESSAGE_LENGTH bytes, if the two
+// cannot be combined. A sum of strings may leave a string builder.
+bool reduce_values(Heap *heap, ReductionKind kind, Value *total, Value value, char *error);
+
+// Stop the pool's threads and free it and their VMs. `pool` may be NULL.
+void free_thread_pool(ThreadPool *pool);
+
+#endif // SCHEDULER_H
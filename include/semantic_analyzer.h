@@ -1,10 +1,29 @@
-#ifndef SEMANTIC_ANALYZER_H
-#define SEMANTIC_ANALYZER_H
-
-#include "ast.h"
-#include "symbol_table.h"
-
-// Function prototype for performing semantic analysis on the AST
-void semantic_analysis(ASTNode *ast, SymbolTable *symbol_table);
-
-#endif // SEMANTIC_ANALYZER_H
\ No newline at end of file
+#ifndef SEMANTIC_ANALYZER_H
+#define SEMANTIC_ANALYZER_H
+
+#include "ast.h"
+#include "symbol_table.h"
+#include "visitor.h"
+
+typedef struct {
+    SymbolTable *symbol_table;
+    ErrorList *errors;
+    int statement_line;  // Where errors in shared nodes are reported
+    const ASTNode *generator;   // The generator whose body is being checked, or NULL
+    const ASTNode *function;    // Likewise for a function
+    bool functions_declared;    // declare_functions has run on the program being checked
+} SemanticContext;
+
+// Function prototype for performing semantic analysis on the AST.
+// Errors are appended to `errors`; returns true if none were found.
+bool semantic_analysis(ASTNode *ast, SymbolTable *symbol_table, ErrorList *errors);
+// The same checks as a visitor, for fusing with other passes
+ASTVisitor semantic_visitor(SemanticContext *context);
+
+// Declare every ಕಾರ್ಯ of `program` up front, so each may call any other
+// wherever it is defined. Otherwise a definition is declared as the walk
+// reaches it. Either way a function's body sees the globals assigned
+// before the definition, as a generator's does.
+void declare_functions(ASTNode *program, SymbolTable *symbol_table, ErrorList *errors);
+
+#endif // SEMANTIC_ANALYZER_H
@@ -0,0 +1,33 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "common.h"
+
+// Resident compile server on a Unix domain socket.
+//
+// Every message is framed as a one-byte code followed by a 32-bit
+// big-endian payload length and the payload:
+//   request:  SERVER_REQUEST_COMPILE, source code
+//   response: SERVER_RESPONSE_OK, generated code
+//             SERVER_RESPONSE_ERROR, diagnostics (one per line)
+//             SERVER_RESPONSE_BAD_REQUEST, reason
+// A connection may carry any number of requests; each one is answered in
+// order. Results are cached by content hash, so a warm compile is a table
+// lookup.
+enum {
+    SERVER_REQUEST_COMPILE = 'C',
+    SERVER_RESPONSE_OK = 0,
+    SERVER_RESPONSE_ERROR = 1,
+    SERVER_RESPONSE_BAD_REQUEST = 2
+};
+
+#define SERVER_MAX_MESSAGE_LENGTH (64u * 1024u * 1024u)
+
+// Serve until SIGINT/SIGTERM; returns a process exit status
+int run_compile_server(const char *socket_path);
+
+// Send one compile request; writes the result to `output` on success and
+// the diagnostics to stderr otherwise. Returns a process exit status.
+int run_compile_client(const char *socket_path, const char *source_file, const char *output_file);
+
+#endif // SERVER_H
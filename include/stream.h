@@ -0,0 +1,16 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include "common.h"
+
+// Streaming compilation for inputs too large to hold in memory, or that
+// arrive through a pipe. Input is read in chunks; each top-level statement
+// is parsed, analyzed, emitted and freed as soon as it is complete, so
+// memory stays bounded by the largest statement rather than the program.
+//
+// Output is flushed whenever the compiler waits for more input. Once an
+// error is found nothing more is emitted, but the rest of the input is
+// still checked. Diagnostics go to stderr as they are found.
+bool compile_stream(FILE *input, FILE *output);
+
+#endif // STREAM_H
@@ -1,42 +1,81 @@
-#ifndef SYMBOL_TABLE_H
-#define SYMBOL_TABLE_H
-
-#include "common.h"
-
-// Symbol types
-typedef enum {
-    SYMBOL_VARIABLE,
-    SYMBOL_FUNCTION
-} SymbolType;
-
-// Symbol structure
-typedef struct Symbol {
-    char *name;
-    SymbolType type;
-    union {
-        // Variable-specific information
-        struct {
-            // Variable type information (e.g., int, float)
-        } variable;
-        // Function-specific information
-        struct {
-            // Function parameters and return type information
-        } function;
-    } info;
-    struct Symbol *next; // For chaining in case of hash collisions
-} Symbol;
-
-// Symbol table structure
-typedef struct {
-    Symbol **table;  // Array of symbol pointers
-    size_t size;     // Size of the table (number of buckets)
-} SymbolTable;
-
-// Function prototypes
-SymbolTable *create_symbol_table(size_t size);
-void free_symbol_table(SymbolTable *symbol_table);
-Symbol *insert_symbol(SymbolTable *symbol_table, const char *name, SymbolType type);
-Symbol *lookup_symbol(SymbolTable *symbol_table, const char *name);
-void print_symbol_table(SymbolTable *symbol_table);
-
+#ifndef SYMBOL_TABLE_H
+#define SYMBOL_TABLE_H
+
+#include "common.h"
+
+// Symbol types
+typedef enum {
+    SYMBOL_VARIABLE,
+    SYMBOL_FUNCTION,
+    SYMBOL_MODULE
+} SymbolType;
+
+// Symbol structure
+typedef struct Symbol {
+    char *name;
+    SymbolType type;
+    union {
+        // Variable-specific information
+        struct {
+            int slot;              // Index among the table's variables, in insertion order
+        } variable;
+        // Function-specific information, for a ಉತ್ಪಾದಕ or a ಕಾರ್ಯ
+        struct {
+            int index;             // Its definition among the chunk's generators or functions;
+                                   // -1 until compiled or called
+            int parameter_count;
+            bool generator;
+            // Names a ಕಾರ್ಯ's body uses that are not its own: the globals
+            // it reads and the functions it calls. Interned; the array is owned.
+            const char **uses;
+            int use_count;
+        } function;
+        // Module-specific information
+        struct {
+            const char **exports;  // Names an import of the module declares
+            int export_count;
+        } module;
+    } info;
+    int scope;           // 0 for a global, else the scope that declared it
+    int order;           // How many symbols were inserted into its table before it
+    struct Symbol *next; // For chaining in case of hash collisions
+} Symbol;
+
+// Symbol table structure. Symbols inserted while a scope is open belong to
+// it and hide any outer symbol of the same name until it closes. Every
+// variable keeps its own slot, so a closed scope's variables never share
+// slots with later ones.
+//
+// A table may look names it does not hold up in an `outer` one, seeing only
+// the symbols inserted there before its first `visible`. A function
+// analyzed on its own thread declares its variables in a table of its own
+// that way, while the program's stays as it was at the definition.
+typedef struct SymbolTable {
+    Symbol **table;  // Array of symbol pointers
+    size_t size;     // Number of buckets, doubled as symbols are added
+    int variable_count;
+    int symbol_count;
+    int scope;       // Innermost open scope; 0 at the top level
+    Symbol *closed;  // Symbols of closed scopes, kept for the names they lend chunks
+    Symbol **inserted;  // Every symbol by its order, so a scope closes without a scan of the buckets
+    int inserted_capacity;
+    int *scope_starts;  // The symbol_count at which each open scope opened
+    int scope_capacity;
+    struct SymbolTable *outer;  // NULL, or a table that must not change meanwhile
+    int visible;
+} SymbolTable;
+
+// Function prototypes
+SymbolTable *create_symbol_table(size_t size);
+void free_symbol_table(SymbolTable *symbol_table);
+Symbol *insert_symbol(SymbolTable *symbol_table, const char *name, SymbolType type);
+Symbol *lookup_symbol(SymbolTable *symbol_table, const char *name);
+void print_symbol_table(SymbolTable *symbol_table);
+void open_scope(SymbolTable *symbol_table);
+// Forget the symbols of the innermost scope
+void close_scope(SymbolTable *symbol_table);
+// Forget the symbols inserted since the table's symbol_count was `count`,
+// as if their scope had closed. Only at the top level.
+void forget_symbols(SymbolTable *symbol_table, int count);
+
 #endif // SYMBOL_TABLE_H
\ No newline at end of file
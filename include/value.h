@@ -0,0 +1,189 @@
+#ifndef VALUE_H
+#define VALUE_H
+
+#include "common.h"
+#include "buffer.h"
+#include "integer.h"
+#include "heap.h"
+
+// Runtime values are 64-bit words tagged in their low bits:
+//
+//   ...xxx1   small integer, 63-bit two's complement in the upper bits
+//   ...x000   pointer to a heap Object (8-byte aligned)
+//   ...x010   special constant: None, False, True
+//   ...x100   short string: length in bits 3-7, bytes in the upper 7 bytes
+//
+// Integers, booleans, None and strings of up to 7 bytes never allocate.
+// Integers outside 63 bits, floats and longer strings live on the heap.
+
+#define VALUE_NONE      ((Value)0x02)
+#define VALUE_FALSE     ((Value)0x12)
+#define VALUE_TRUE      ((Value)0x1A)
+#define VALUE_UNDEFINED ((Value)0x22)   // Unassigned variable; never an operand
+#define VALUE_EMPTY_STRING ((Value)0x04)
+
+#define SHORT_STRING_MAX 7
+
+#define SMALL_INT_MIN (-((int64_t)1 << 62))
+#define SMALL_INT_MAX (((int64_t)1 << 62) - 1)
+
+typedef struct {
+    Object object;
+    Integer value;        // Never within SMALL_INT_MIN..SMALL_INT_MAX
+} IntegerObject;
+
+typedef struct {
+    Object object;
+    double value;
+} FloatObject;
+
+Value value_from_integer(Heap *heap, Integer value);   // Takes ownership
+// A view of an integer value; the result is borrowed, not owned
+Integer value_to_integer(Value value);
+Value value_from_double(Heap *heap, double value);
+
+const char *value_type_name(Value value);
+// Append the value as print shows it
+void value_append(Buffer *buffer, Value value);
+// The same, but with strings quoted so their bounds show, as they are
+// inside a list or dictionary
+void value_append_quoted(Buffer *buffer, Value value);
+
+static inline bool value_is_small_int(Value value) {
+    return value & 1;
+}
+
+static inline bool value_is_object(Value value) {
+    return (value & 7) == 0;
+}
+
+static inline Object *value_as_object(Value value) {
+    return (Object *)(uintptr_t)value;
+}
+
+static inline bool value_is_object_type(Value value, ObjectType type) {
+    return value_is_object(value) && value_as_object(value)->type == type;
+}
+
+static inline bool value_is_int(Value value) {
+    return value_is_small_int(value) || value_is_object_type(value, OBJECT_INTEGER);
+}
+
+static inline bool value_is_float(Value value) {
+    return value_is_object_type(value, OBJECT_FLOAT);
+}
+
+static inline double value_as_double(Value value) {
+    return ((FloatObject *)value_as_object(value))->value;
+}
+
+static inline bool value_is_number(Value value) {
+    return value_is_int(value) || value_is_float(value);
+}
+
+static inline bool value_is_short_string(Value value) {
+    return (value & 7) == 4;
+}
+
+static inline bool value_is_string(Value value) {
+    return value_is_short_string(value) || value_is_object_type(value, OBJECT_STRING);
+}
+
+static inline int64_t value_as_small_int(Value value) {
+    return (int64_t)value >> 1;
+}
+
+// `value` must be within SMALL_INT_MIN..SMALL_INT_MAX
+static inline Value value_from_small_int(int64_t value) {
+    return ((uint64_t)value << 1) | 1;
+}
+
+static inline Value value_from_bool(bool value) {
+    return VALUE_FALSE | ((Value)value << 3);
+}
+
+// Operations on the uncommon cases. Each returns false if the operand
+// types are unsupported or, for division, the divisor is zero. An int
+// and a float make a float, as in Python.
+bool value_add_slow(Heap *heap, Value a, Value b, Value *result);
+bool value_sub_slow(Heap *heap, Value a, Value b, Value *result);
+bool value_mul_slow(Heap *heap, Value a, Value b, Value *result);
+bool value_neg_slow(Heap *heap, Value a, Value *result);
+bool value_floordiv(Heap *heap, Value a, Value b, Value *result);
+// `/`: floor division on ints, unlike Python's `/`, and true division if
+// either is a float
+bool value_divide(Heap *heap, Value a, Value b, Value *result);
+bool value_mod(Heap *heap, Value a, Value b, Value *result);
+bool value_equal_slow(Value a, Value b);
+bool value_less_slow(Value a, Value b, bool *result);
+bool value_is_truthy_slow(Value value);
+
+// On two small integers, (2a+1) + (2b+1) - 1 is the tagged sum, and it
+// overflows 64 bits exactly when a+b leaves the 63-bit range
+static inline bool value_add(Heap *heap, Value a, Value b, Value *result) {
+    if ((a & b & 1) && !__builtin_add_overflow((int64_t)a, (int64_t)(b - 1), (int64_t *)result)) {
+        return true;
+    }
+    return value_add_slow(heap, a, b, result);
+}
+
+static inline bool value_sub(Heap *heap, Value a, Value b, Value *result) {
+    if ((a & b & 1) && !__builtin_sub_overflow((int64_t)a, (int64_t)(b - 1), (int64_t *)result)) {
+        return true;
+    }
+    return value_sub_slow(heap, a, b, result);
+}
+
+static inline bool value_mul(Heap *heap, Value a, Value b, Value *result) {
+    int64_t product;
+    if ((a & b & 1) && !__builtin_mul_overflow((int64_t)(a - 1), value_as_small_int(b), &product)) {
+        *result = (Value)product | 1;
+        return true;
+    }
+    return value_mul_slow(heap, a, b, result);
+}
+
+static inline bool value_neg(Heap *heap, Value a, Value *result) {
+    if ((a & 1) && !__builtin_sub_overflow((int64_t)2, (int64_t)a, (int64_t *)result)) {
+        return true;
+    }
+    return value_neg_slow(heap, a, result);
+}
+
+// Integers, booleans and None are canonical, so equal words mean equal
+// values; only heap objects need a closer look, a float even against a
+// small integer. Like Python's containers, this takes a NaN to equal
+// itself when it is the same object; the == operator does not.
+static inline bool value_equal(Value a, Value b) {
+    if (a == b) {
+        return true;
+    }
+    if (!value_is_object(a) && !value_is_object(b)) {
+        return false;
+    }
+    return value_equal_slow(a, b);
+}
+
+// Tagging preserves order, so small integers compare as plain words
+static inline bool value_less(Value a, Value b, bool *result) {
+    if (a & b & 1) {
+        *result = (int64_t)a < (int64_t)b;
+        return true;
+    }
+    return value_less_slow(a, b, result);
+}
+
+// NaN compares false with everything
+static inline bool value_is_nan(Value value) {
+    return value_is_float(value) && value_as_double(value) != value_as_double(value);
+}
+
+static inline bool value_is_truthy(Value value) {
+    if (!value_is_object(value)) {
+        return value != VALUE_FALSE && value != VALUE_NONE && value != value_from_small_int(0) &&
+               value != VALUE_EMPTY_STRING;
+    }
+    return value_is_truthy_slow(value);
+}
+
+#endif // VALUE_H
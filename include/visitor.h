@@ -0,0 +1,24 @@
+#ifndef VISITOR_H
+#define VISITOR_H
+
+#include "ast.h"
+
+// One pass over the AST. Any hook may be NULL.
+typedef struct {
+    // Called on entering a node, before its children
+    void (*pre)(ASTNode *node, void *context);
+    // Called before the child at `index` is visited. Children are in source
+    // order; an if without an else has two.
+    void (*child)(ASTNode *node, int index, void *context);
+    // Called on leaving a node, after its children
+    void (*post)(ASTNode *node, void *context);
+    void *context;
+} ASTVisitor;
+
+// Walk the tree depth first with an explicit stack, so nesting depth is
+// bounded by memory rather than the C stack. Several passes can share one
+// walk: at each node the visitors' pre and child hooks run in array order
+// and their post hooks in reverse. A post hook may free its node.
+void walk_ast(ASTNode *root, const ASTVisitor *visitors, int count);
+
+#endif // VISITOR_H
@@ -0,0 +1,74 @@
+#ifndef VM_H
+#define VM_H
+
+#include "bytecode.h"
+#include "value.h"
+#include "output.h"
+#include "profile.h"
+
+// Runs compiled chunks. Globals and heap objects persist from one chunk to
+// the next, so a program may be run a statement at a time.
+//
+// A loop resumes a generator by moving its saved stack above the loop's
+// and jumping into its code, which runs on the same value stack and in
+// the same dispatch loop; ನೀಡು saves it and jumps back. So a pipeline of
+// generators costs no thread, C stack or copy of its data, and runs in
+// the memory of its frames whatever the length of the stream.
+//
+// A generator's variables are global slots of its own. Their values are
+// moved into its frame only when another call of the same generator is
+// resumed, which takes the slots over; a pipeline of different generators
+// never moves them at all.
+//
+// A function's variables are global slots of its own too. A call moves
+// the values they hold onto the stack, under the body's own stack and the
+// offset to return to, and the return moves them back, so each call of a
+// recursive function has its own variables and the others' wait below.
+// Calls may nest up to CALL_DEPTH_MAX deep.
+#define CALL_DEPTH_MAX 100000
+
+struct ThreadPool;
+
+typedef struct {
+    Heap heap;
+    Value *globals;         // By symbol slot; VALUE_UNDEFINED until assigned
+    int global_count;
+    Value *stack;
+    int stack_capacity;
+    Output output;          // Where print writes
+    Profile *profile;       // Counts OP_LINE hits and follows calls; set when running code compiled for profiling
+    int threads;            // Most threads a parallel loop runs on; 0 for one per core
+    struct ThreadPool *pool; // What parallel loops run on, once one has run
+    RootRange roots;        // Values kept outside the VM that collections must update
+
+    // The generators running, outermost first, each as three values: the
+    // offset of the OP_FOR_GENERATOR that resumed it and where its stack
+    // starts, both tagged, then the generator itself
+    Value *resumes;
+    int resume_count;       // Values, not generators
+    int resume_capacity;
+    // By definition, the call whose variables are in the generator's
+    // slots, or VALUE_NONE
+    Value *occupants;
+    int occupant_count;
+    int call_depth;         // Calls running
+} VM;
+
+// With a NULL `output`, what the program prints is kept in the buffer
+// vm->output.capture points at; see output.h
+void init_vm(VM *vm, FILE *output);
+void free_vm(VM *vm);
+
+// Execute `chunk` up to its OP_HALT. A runtime error stops execution and
+// is appended to `errors`; returns true if none occurred. The collector may
+// move the chunk's constants.
+bool run_chunk(VM *vm, Chunk *chunk, ErrorList *errors);
+// Execute `chunk` from `offset`, up to its OP_HALT or, for the body of a
+// parallel loop, to the OP_END_ITERATION that ends it
+bool run_code(VM *vm, Chunk *chunk, size_t offset, ErrorList *errors);
+// Collect if a collection is due, as the VM does while it runs. Between
+// chunks nothing is on the stack, so the globals and `chunk`'s constants
+// are the roots. Returns false if what is live exceeds the heap limit.
+bool collect_if_due(VM *vm, Chunk *chunk);
+
+#endif // VM_H
@@ -1,208 +1,382 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include "../include/ast.h"
-#include "../include/common.h"
-
-ASTNode *create_ast_node(ASTNodeType type) {
-    ASTNode *node = safe_malloc(sizeof(ASTNode));
-    node->type = type;
-    node->line = 0;  // Line number should be set by the parser
-    return node;
-}
-
-void free_ast(ASTNode *node) {
-    if (node == NULL) return;
-
-    switch (node->type) {
-        case AST_PROGRAM:
-        case AST_BLOCK:
-            for (int i = 0; i < node->data.program.count; i++) {
-                free_ast(node->data.program.statements[i]);
-            }
-            free(node->data.program.statements);
-            break;
-        case AST_IF:
-            free_ast(node->data.if_stmt.condition);
-            free_ast(node->data.if_stmt.if_body);
-            free_ast(node->data.if_stmt.else_body);
-            break;
-        case AST_WHILE:
-            free_ast(node->data.while_loop.condition);
-            free_ast(node->data.while_loop.body);
-            break;
-        case AST_PRINT:
-            free_ast(node->data.print_stmt.expression);
-            break;
-        case AST_ASSIGN:
-            free(node->data.assign.name);
-            free_ast(node->data.assign.value);
-            break;
-        case AST_BINARY_OP:
-            free_ast(node->data.binary_op.left);
-            free_ast(node->data.binary_op.right);
-            break;
-        case AST_UNARY_OP:
-            free_ast(node->data.unary_op.operand);
-            break;
-        case AST_VARIABLE:
-            free(node->data.variable.name);
-            break;
-        case AST_STRING:
-            free(node->data.string);
-            break;
-        default:
-            // AST_NUMBER and AST_BOOLEAN don't need additional freeing
-            break;
-    }
-
-    free(node);
-}
-
-ASTNode *create_program_node(ASTNode **statements, int count) {
-    ASTNode *node = create_ast_node(AST_PROGRAM);
-    node->data.program.statements = statements;
-    node->data.program.count = count;
-    return node;
-}
-
-ASTNode *create_block_node(ASTNode **statements, int count) {
-    ASTNode *node = create_ast_node(AST_BLOCK);
-    node->data.block.statements = statements;
-    node->data.block.count = count;
-    return node;
-}
-
-ASTNode *create_if_node(ASTNode *condition, ASTNode *if_body, ASTNode *else_body) {
-    ASTNode *node = create_ast_node(AST_IF);
-    node->data.if_stmt.condition = condition;
-    node->data.if_stmt.if_body = if_body;
-    node->data.if_stmt.else_body = else_body;
-    return node;
-}
-
-ASTNode *create_while_node(ASTNode *condition, ASTNode *body) {
-    ASTNode *node = create_ast_node(AST_WHILE);
-    node->data.while_loop.condition = condition;
-    node->data.while_loop.body = body;
-    return node;
-}
-
-ASTNode *create_print_node(ASTNode *expression) {
-    ASTNode *node = create_ast_node(AST_PRINT);
-    node->data.print_stmt.expression = expression;
-    return node;
-}
-
-ASTNode *create_assign_node(char *name, ASTNode *value) {
-    ASTNode *node = create_ast_node(AST_ASSIGN);
-    node->data.assign.name = safe_strdup(name);
-    node->data.assign.value = value;
-    return node;
-}
-
-ASTNode *create_binary_op_node(TokenType op, ASTNode *left, ASTNode *right) {
-    ASTNode *node = create_ast_node(AST_BINARY_OP);
-    node->data.binary_op.op = op;
-    node->data.binary_op.left = left;
-    node->data.binary_op.right = right;
-    return node;
-}
-
-ASTNode *create_unary_op_node(TokenType op, ASTNode *operand) {
-    ASTNode *node = create_ast_node(AST_UNARY_OP);
-    node->data.unary_op.op = op;
-    node->data.unary_op.operand = operand;
-    return node;
-}
-
-ASTNode *create_variable_node(char *name) {
-    ASTNode *node = create_ast_node(AST_VARIABLE);
-    node->data.variable.name = safe_strdup(name);
-    return node;
-}
-
-ASTNode *create_number_node(int value) {
-    ASTNode *node = create_ast_node(AST_NUMBER);
-    node->data.number = value;
-    return node;
-}
-
-ASTNode *create_string_node(char *value) {
-    ASTNode *node = create_ast_node(AST_STRING);
-    node->data.string = safe_strdup(value);
-    return node;
-}
-
-ASTNode *create_boolean_node(bool value) {
-    ASTNode *node = create_ast_node(AST_BOOLEAN);
-    node->data.boolean = value;
-    return node;
-}
-
-void print_ast(ASTNode *node, int indent) {
-    if (node == NULL) return;
-
-    for (int i = 0; i < indent; i++) {
-        printf("  ");
-    }
-
-    switch (node->type) {
-        case AST_PROGRAM:
-            printf("Program (%d statements)\n", node->data.program.count);
-            for (int i = 0; i < node->data.program.count; i++) {
-                print_ast(node->data.program.statements[i], indent + 1);
-            }
-            break;
-        case AST_BLOCK:
-            printf("Block (%d statements)\n", node->data.block.count);
-            for (int i = 0; i < node->data.block.count; i++) {
-                print_ast(node->data.block.statements[i], indent + 1);
-            }
-            break;
-        case AST_IF:
-            printf("If\n");
-            print_ast(node->data.if_stmt.condition, indent + 1);
-            print_ast(node->data.if_stmt.if_body, indent + 1);
-            if (node->data.if_stmt.else_body) {
-                for (int i = 0; i < indent; i++) printf("  ");
-                printf("Else\n");
-                print_ast(node->data.if_stmt.else_body, indent + 1);
-            }
-            break;
-        case AST_WHILE:
-            printf("While\n");
-            print_ast(node->data.while_loop.condition, indent + 1);
-            print_ast(node->data.while_loop.body, indent + 1);
-            break;
-        case AST_PRINT:
-            printf("Print\n");
-            print_ast(node->data.print_stmt.expression, indent + 1);
-            break;
-        case AST_ASSIGN:
-            printf("Assign: %s\n", node->data.assign.name);
-            print_ast(node->data.assign.value, indent + 1);
-            break;
-        case AST_BINARY_OP:
-            printf("Binary Op: %d\n", node->data.binary_op.op);
-            print_ast(node->data.binary_op.left, indent + 1);
-            print_ast(node->data.binary_op.right, indent + 1);
-            break;
-        case AST_UNARY_OP:
-            printf("Unary Op: %d\n", node->data.unary_op.op);
-            print_ast(node->data.unary_op.operand, indent + 1);
-            break;
-        case AST_VARIABLE:
-            printf("Variable: %s\n", node->data.variable.name);
-            break;
-        case AST_NUMBER:
-            printf("Number: %d\n", node->data.number);
-            break;
-        case AST_STRING:
-            printf("String: %s\n", node->data.string);
-            break;
-        case AST_BOOLEAN:
-            printf("Boolean: %s\n", node->data.boolean ? "true" : "false");
-            break;
-    }
-}
\ No newline at end of file
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/ast.h"
+#include "../include/floating.h"
+#include "../include/visitor.h"
+#include "../include/common.h"
+
+ASTNode *create_ast_node(ASTNodeType type) {
+    ASTNode *node = safe_malloc(sizeof(ASTNode));
+    node->type = type;
+    node->line = 0;  // Line number should be set by the parser
+    node->references = 1;
+    return node;
+}
+
+void release_ast_node(ASTNode *node) {
+    if (--node->references > 0) {
+        return;
+    }
+    switch (node->type) {
+        case AST_PROGRAM:
+        case AST_BLOCK:
+            free(node->data.block.statements);
+            break;
+        case AST_LIST:
+            free(node->data.list.elements);
+            break;
+        case AST_DICT:
+            free(node->data.dict.entries);
+            break;
+        case AST_CALL:
+            free(node->data.call.arguments);
+            break;
+        case AST_GENERATOR:
+            free(node->data.generator.parameters);
+            break;
+        case AST_FUNCTION:
+            free(node->data.function.parameters);
+            break;
+        case AST_NUMBER:
+            integer_free(&node->data.number);
+            break;
+        case AST_STRING:
+            free(node->data.string);
+            break;
+        default:
+            // Names are interned; free_ast frees children before their parent
+            break;
+    }
+    free(node);
+}
+
+static void free_node(ASTNode *node, void *context) {
+    (void)context;
+    release_ast_node(node);
+}
+
+void free_ast(ASTNode *node) {
+    ASTVisitor visitor = {NULL, NULL, free_node, NULL};
+    walk_ast(node, &visitor, 1);
+}
+
+ASTNode *create_program_node(ASTNode **statements, int count) {
+    ASTNode *node = create_ast_node(AST_PROGRAM);
+    node->data.program.statements = statements;
+    node->data.program.count = count;
+    return node;
+}
+
+ASTNode *create_block_node(ASTNode **statements, int count) {
+    ASTNode *node = create_ast_node(AST_BLOCK);
+    node->data.block.statements = statements;
+    node->data.block.count = count;
+    return node;
+}
+
+ASTNode *create_if_node(ASTNode *condition, ASTNode *if_body, ASTNode *else_body) {
+    ASTNode *node = create_ast_node(AST_IF);
+    node->data.if_stmt.condition = condition;
+    node->data.if_stmt.if_body = if_body;
+    node->data.if_stmt.else_body = else_body;
+    return node;
+}
+
+ASTNode *create_while_node(ASTNode *condition, ASTNode *body) {
+    ASTNode *node = create_ast_node(AST_WHILE);
+    node->data.while_loop.condition = condition;
+    node->data.while_loop.body = body;
+    return node;
+}
+
+ASTNode *create_for_node(const char *variable, ASTNode *start, ASTNode *stop, ASTNode *step, ASTNode *body) {
+    ASTNode *node = create_ast_node(AST_FOR);
+    node->data.for_loop.variable = variable;
+    node->data.for_loop.start = start;
+    node->data.for_loop.stop = stop;
+    node->data.for_loop.step = step;
+    node->data.for_loop.iterable = NULL;
+    node->data.for_loop.body = body;
+    node->data.for_loop.parallel = false;
+    return node;
+}
+
+ASTNode *create_for_in_node(const char *variable, ASTNode *iterable, ASTNode *body) {
+    ASTNode *node = create_for_node(variable, NULL, NULL, NULL, body);
+    node->data.for_loop.iterable = iterable;
+    return node;
+}
+
+int for_body_index(const ASTNode *node) {
+    if (node->data.for_loop.iterable) {
+        return 1;
+    }
+    return 1 + (node->data.for_loop.start != NULL) + (node->data.for_loop.step != NULL);
+}
+
+ASTNode *create_print_node(ASTNode *expression) {
+    ASTNode *node = create_ast_node(AST_PRINT);
+    node->data.print_stmt.expression = expression;
+    return node;
+}
+
+ASTNode *create_assign_node(const char *name, ASTNode *value) {
+    ASTNode *node = create_ast_node(AST_ASSIGN);
+    node->data.assign.name = name;
+    node->data.assign.value = value;
+    return node;
+}
+
+ASTNode *create_store_index_node(ASTNode *object, ASTNode *index, ASTNode *value) {
+    ASTNode *node = create_ast_node(AST_STORE_INDEX);
+    node->data.store_index.object = object;
+    node->data.store_index.index = index;
+    node->data.store_index.value = value;
+    return node;
+}
+
+ASTNode *create_expression_node(ASTNode *expression) {
+    ASTNode *node = create_ast_node(AST_EXPRESSION);
+    node->data.expression_stmt.expression = expression;
+    return node;
+}
+
+ASTNode *create_import_node(const char *module) {
+    ASTNode *node = create_ast_node(AST_IMPORT);
+    node->data.import_stmt.module = module;
+    return node;
+}
+
+ASTNode *create_generator_node(const char *name, const char **parameters, int parameter_count, ASTNode *body) {
+    ASTNode *node = create_ast_node(AST_GENERATOR);
+    node->data.generator.name = name;
+    node->data.generator.parameters = parameters;
+    node->data.generator.parameter_count = parameter_count;
+    node->data.generator.body = body;
+    return node;
+}
+
+ASTNode *create_yield_node(ASTNode *value) {
+    ASTNode *node = create_ast_node(AST_YIELD);
+    node->data.yield_stmt.value = value;
+    return node;
+}
+
+ASTNode *create_function_node(const char *name, const char **parameters, int parameter_count, ASTNode *body) {
+    ASTNode *node = create_ast_node(AST_FUNCTION);
+    node->data.function.name = name;
+    node->data.function.parameters = parameters;
+    node->data.function.parameter_count = parameter_count;
+    node->data.function.body = body;
+    return node;
+}
+
+ASTNode *create_return_node(ASTNode *value) {
+    ASTNode *node = create_ast_node(AST_RETURN);
+    node->data.return_stmt.value = value;
+    return node;
+}
+
+ASTNode *create_binary_op_node(TokenType op, ASTNode *left, ASTNode *right) {
+    ASTNode *node = create_ast_node(AST_BINARY_OP);
+    node->data.binary_op.op = op;
+    node->data.binary_op.left = left;
+    node->data.binary_op.right = right;
+    return node;
+}
+
+ASTNode *create_unary_op_node(TokenType op, ASTNode *operand) {
+    ASTNode *node = create_ast_node(AST_UNARY_OP);
+    node->data.unary_op.op = op;
+    node->data.unary_op.operand = operand;
+    return node;
+}
+
+ASTNode *create_variable_node(const char *name) {
+    ASTNode *node = create_ast_node(AST_VARIABLE);
+    node->data.variable.name = name;
+    return node;
+}
+
+ASTNode *create_list_node(ASTNode **elements, int count) {
+    ASTNode *node = create_ast_node(AST_LIST);
+    node->data.list.elements = elements;
+    node->data.list.count = count;
+    return node;
+}
+
+ASTNode *create_dict_node(ASTNode **entries, int count) {
+    ASTNode *node = create_ast_node(AST_DICT);
+    node->data.dict.entries = entries;
+    node->data.dict.count = count;
+    return node;
+}
+
+ASTNode *create_index_node(ASTNode *object, ASTNode *index) {
+    ASTNode *node = create_ast_node(AST_INDEX);
+    node->data.index.object = object;
+    node->data.index.index = index;
+    return node;
+}
+
+ASTNode *create_call_node(const char *name, ASTNode **arguments, int count) {
+    ASTNode *node = create_ast_node(AST_CALL);
+    node->data.call.name = name;
+    node->data.call.arguments = arguments;
+    node->data.call.count = count;
+    return node;
+}
+
+ASTNode *create_number_node(Integer value) {
+    ASTNode *node = create_ast_node(AST_NUMBER);
+    node->data.number = integer_copy(value);
+    return node;
+}
+
+ASTNode *create_float_node(double value) {
+    ASTNode *node = create_ast_node(AST_FLOAT);
+    node->data.real = value;
+    return node;
+}
+
+ASTNode *create_string_node(char *value) {
+    ASTNode *node = create_ast_node(AST_STRING);
+    node->data.string = safe_strdup(value);
+    return node;
+}
+
+ASTNode *create_boolean_node(bool value) {
+    ASTNode *node = create_ast_node(AST_BOOLEAN);
+    node->data.boolean = value;
+    return node;
+}
+
+ASTNode *create_none_node(void) {
+    return create_ast_node(AST_NONE);
+}
+
+static void print_indent(int indent) {
+    for (int i = 0; i < indent; i++) {
+        printf("  ");
+    }
+}
+
+static void print_node(ASTNode *node, void *context) {
+    int *indent = context;
+    print_indent((*indent)++);
+
+    switch (node->type) {
+        case AST_PROGRAM:
+            printf("Program (%d statements)\n", node->data.program.count);
+            break;
+        case AST_BLOCK:
+            printf("Block (%d statements)\n", node->data.block.count);
+            break;
+        case AST_IF:
+            printf("If\n");
+            break;
+        case AST_WHILE:
+            printf("While\n");
+            break;
+        case AST_FOR:
+            printf("%s: %s\n", node->data.for_loop.parallel ? "Parallel For" : "For",
+                   node->data.for_loop.variable);
+            break;
+        case AST_PRINT:
+            printf("Print\n");
+            break;
+        case AST_ASSIGN:
+            printf("Assign: %s\n", node->data.assign.name);
+            break;
+        case AST_STORE_INDEX:
+            printf("Store Index\n");
+            break;
+        case AST_EXPRESSION:
+            printf("Expression\n");
+            break;
+        case AST_IMPORT:
+            printf("Import: %s\n", node->data.import_stmt.module);
+            break;
+        case AST_GENERATOR:
+            printf("Generator: %s (%d parameters)\n", node->data.generator.name,
+                   node->data.generator.parameter_count);
+            break;
+        case AST_YIELD:
+            printf("Yield\n");
+            break;
+        case AST_FUNCTION:
+            printf("Function: %s (%d parameters)\n", node->data.function.name,
+                   node->data.function.parameter_count);
+            break;
+        case AST_RETURN:
+            printf("Return\n");
+            break;
+        case AST_BINARY_OP:
+            printf("Binary Op: %s\n", token_type_to_string(node->data.binary_op.op));
+            break;
+        case AST_UNARY_OP:
+            printf("Unary Op: %s\n", token_type_to_string(node->data.unary_op.op));
+            break;
+        case AST_VARIABLE:
+            printf("Variable: %s\n", node->data.variable.name);
+            break;
+        case AST_LIST:
+            printf("List (%d elements)\n", node->data.list.count);
+            break;
+        case AST_DICT:
+            printf("Dict (%d entries)\n", node->data.dict.count);
+            break;
+        case AST_INDEX:
+            printf("Index\n");
+            break;
+        case AST_CALL:
+            printf("Call: %s (%d arguments)\n", node->data.call.name, node->data.call.count);
+            break;
+        case AST_NUMBER:
+            {
+                Buffer digits;
+                buffer_init(&digits);
+                integer_append(&digits, node->data.number);
+                printf("Number: %.*s\n", (int)digits.length, digits.data);
+                buffer_free(&digits);
+            }
+            break;
+        case AST_FLOAT:
+            {
+                Buffer digits;
+                buffer_init(&digits);
+                float_append(&digits, node->data.real, DIGITS_ASCII);
+                printf("Float: %.*s\n", (int)digits.length, digits.data);
+                buffer_free(&digits);
+            }
+            break;
+        case AST_STRING:
+            printf("String: %s\n", node->data.string);
+            break;
+        case AST_BOOLEAN:
+            printf("Boolean: %s\n", node->data.boolean ? "true" : "false");
+            break;
+        case AST_NONE:
+            printf("None\n");
+            break;
+    }
+}
+
+static void print_else(ASTNode *node, int index, void *context) {
+    int *indent = context;
+    if (node->type == AST_IF && index == 2) {
+        print_indent(*indent - 1);
+        printf("Else\n");
+    }
+}
+
+static void end_print(ASTNode *node, void *context) {
+    (void)node;
+    (*(int *)context)--;
+}
+
+void print_ast(ASTNode *node, int indent) {
+    ASTVisitor visitor = {print_node, print_else, end_print, &indent};
+    walk_ast(node, &visitor, 1);
+}
@@ -0,0 +1,83 @@
+// buffer.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include "../include/buffer.h"
+#include "../include/common.h"
+
+void buffer_init(Buffer *buffer) {
+    buffer->data = NULL;
+    buffer->length = 0;
+    buffer->capacity = 0;
+    buffer->fixed = false;
+}
+
+void buffer_init_fixed(Buffer *buffer, char *storage, size_t capacity) {
+    buffer->data = storage;
+    buffer->length = 0;
+    buffer->capacity = capacity;
+    buffer->fixed = true;
+    if (capacity > 0) {
+        storage[0] = '\0';
+    }
+}
+
+void buffer_free(Buffer *buffer) {
+    if (!buffer->fixed) {
+        free(buffer->data);
+    }
+    buffer_init(buffer);
+}
+
+// Make room for `extra` more bytes plus a terminating NUL.
+// Returns false if a fixed buffer cannot hold them.
+static bool buffer_reserve(Buffer *buffer, size_t extra) {
+    size_t needed = buffer->length + extra + 1;
+    if (needed <= buffer->capacity) {
+        return true;
+    }
+    if (buffer->fixed) {
+        return false;
+    }
+    size_t capacity = buffer->capacity ? buffer->capacity : 256;
+    while (capacity < needed) {
+        capacity *= 2;
+    }
+    buffer->data = safe_realloc(buffer->data, capacity);
+    buffer->capacity = capacity;
+    return true;
+}
+
+void buffer_append(Buffer *buffer, const char *data, size_t length) {
+    if (buffer_reserve(buffer, length)) {
+        memcpy(buffer->data + buffer->length, data, length);
+        buffer->data[buffer->length + length] = '\0';
+    }
+    buffer->length += length;
+}
+
+void buffer_append_str(Buffer *buffer, const char *str) {
+    buffer_append(buffer, str, strlen(str));
+}
+
+void buffer_appendf(Buffer *buffer, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(NULL, 0, format, args);
+    va_end(args);
+    if (length < 0) {
+        return;
+    }
+
+    if (buffer_reserve(buffer, (size_t)length)) {
+        va_start(args, format);
+        vsnprintf(buffer->data + buffer->length, (size_t)length + 1, format, args);
+        va_end(args);
+    }
+    buffer->length += (size_t)length;
+}
+
+bool buffer_overflowed(const Buffer *buffer) {
+    return buffer->fixed && buffer->length >= buffer->capacity;
+}
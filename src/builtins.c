@@ -0,0 +1,172 @@
+//builtins.c
+#include <stdio.h>
+#include <string.h>
+#include "../include/builtins.h"
+#include "../include/list.h"
+#include "../include/dict.h"
+#include "../include/runtime_string.h"
+#include "../include/file.h"
+
+static const struct {
+    const char *name;
+    int arity;
+} builtins[BUILTIN_COUNT] = {
+    [BUILTIN_LENGTH] = {"ಉದ್ದ", 1},
+    [BUILTIN_APPEND] = {"ಸೇರಿಸು", 2},
+    [BUILTIN_SUM] = {"ಮೊತ್ತ", 1},
+    [BUILTIN_MIN] = {"ಕನಿಷ್ಠ", 1},
+    [BUILTIN_MAX] = {"ಗರಿಷ್ಠ", 1},
+    [BUILTIN_ADD] = {"ಕೂಡಿಸು", 2},
+    [BUILTIN_MULTIPLY] = {"ಗುಣಿಸು", 2},
+    [BUILTIN_SORT] = {"ವಿಂಗಡಿಸು", 1},
+    [BUILTIN_KEYS] = {"ಕೀಲಿಗಳು", 1},
+    [BUILTIN_VALUES] = {"ಮೌಲ್ಯಗಳು", 1},
+    [BUILTIN_CONTAINS] = {"ಹೊಂದಿದೆ", 2},
+    [BUILTIN_REMOVE] = {"ಅಳಿಸು", 2},
+    [BUILTIN_READ] = {"ಓದು", 1},
+    [BUILTIN_LINES] = {"ಸಾಲುಗಳು", 1},
+    [BUILTIN_SPLIT] = {"ವಿಭಜಿಸು", 2},
+};
+
+int find_builtin(const char *name) {
+    for (int i = 0; i < BUILTIN_COUNT; i++) {
+        if (strcmp(builtins[i].name, name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+const char *builtin_name(Builtin builtin) {
+    return builtins[builtin].name;
+}
+
+int builtin_arity(Builtin builtin) {
+    return builtins[builtin].arity;
+}
+
+static bool call_dict_builtin(Heap *heap, Builtin builtin, Value *arguments, Value *result, char *error) {
+    if (!value_is_dict(arguments[0])) {
+        snprintf(error, MAX_ERROR_MESSAGE_LENGTH, "%s() expects a dict, not '%s'", builtins[builtin].name,
+                 value_type_name(arguments[0]));
+        return false;
+    }
+
+    DictObject *dict = value_as_dict(arguments[0]);
+    bool found;
+    switch (builtin) {
+        case BUILTIN_KEYS:
+            *result = dict_keys(heap, dict);
+            return true;
+        case BUILTIN_VALUES:
+            *result = dict_values(heap, dict);
+            return true;
+        case BUILTIN_CONTAINS:
+            {
+                Value value;
+                if (!dict_get(dict, arguments[1], &value, &found, error)) {
+                    return false;
+                }
+                *result = value_from_bool(found);
+                return true;
+            }
+        case BUILTIN_REMOVE:
+            if (!dict_delete(dict, arguments[1], &found, error)) {
+                return false;
+            }
+            if (!found) {
+                Buffer key;
+                buffer_init(&key);
+                value_append_quoted(&key, arguments[1]);
+                snprintf(error, MAX_ERROR_MESSAGE_LENGTH, "Key not found: %.*s", (int)key.length, key.data);
+                buffer_free(&key);
+                return false;
+            }
+            *result = VALUE_NONE;
+            return true;
+        default:
+            return false;
+    }
+}
+
+static bool call_string_builtin(Heap *heap, Builtin builtin, Value *arguments, Value *result, char *error) {
+    for (int i = 0; i < builtins[builtin].arity; i++) {
+        if (!value_is_string(arguments[i])) {
+            snprintf(error, MAX_ERROR_MESSAGE_LENGTH, "%s() expects a string, not '%s'", builtins[builtin].name,
+                     value_type_name(arguments[i]));
+            return false;
+        }
+    }
+
+    switch (builtin) {
+        case BUILTIN_READ:
+            return file_read(heap, arguments[0], result, error);
+        case BUILTIN_LINES:
+            return file_lines(heap, arguments[0], result, error);
+        case BUILTIN_SPLIT:
+            if (string_byte_length(arguments[1]) == 0) {
+                snprintf(error, MAX_ERROR_MESSAGE_LENGTH, "%s() of an empty delimiter", builtins[builtin].name);
+                return false;
+            }
+            *result = string_split(heap, arguments[0], arguments[1]);
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool call_builtin(Heap *heap, Builtin builtin, Value *arguments, Value *result, char *error) {
+    Value first = arguments[0];
+    if (builtin == BUILTIN_LENGTH && value_is_string(first)) {
+        size_t length;
+        if (!string_length(first, &length)) {
+            snprintf(error, MAX_ERROR_MESSAGE_LENGTH, "%s() of a string that is not valid UTF-8",
+                     builtins[builtin].name);
+            return false;
+        }
+        *result = value_from_small_int((int64_t)length);
+        return true;
+    }
+    if (builtin >= BUILTIN_READ) {
+        return call_string_builtin(heap, builtin, arguments, result, error);
+    }
+    if (builtin == BUILTIN_LENGTH && value_is_dict(first)) {
+        *result = value_from_small_int((int64_t)value_as_dict(first)->count);
+        return true;
+    }
+    if (builtin >= BUILTIN_KEYS) {
+        return call_dict_builtin(heap, builtin, arguments, result, error);
+    }
+    if (builtin == BUILTIN_ADD || builtin == BUILTIN_MULTIPLY) {
+        return list_elementwise(heap, first, arguments[1], builtin == BUILTIN_MULTIPLY, result, error);
+    }
+    if (!value_is_list(first)) {
+        snprintf(error, MAX_ERROR_MESSAGE_LENGTH, "%s() expects a list%s, not '%s'", builtins[builtin].name,
+                 builtin == BUILTIN_LENGTH ? ", string or dict" : "", value_type_name(first));
+        return false;
+    }
+
+    ListObject *list = value_as_list(first);
+    switch (builtin) {
+        case BUILTIN_LENGTH:
+            *result = value_from_small_int((int64_t)list->count);
+            return true;
+        case BUILTIN_APPEND:
+            list_append(heap, list, arguments[1]);
+            *result = VALUE_NONE;
+            return true;
+        case BUILTIN_SUM:
+            return list_sum(heap, list, result, error);
+        case BUILTIN_MIN:
+        case BUILTIN_MAX:
+            if (list->count == 0) {
+                snprintf(error, MAX_ERROR_MESSAGE_LENGTH, "%s() of an empty list", builtins[builtin].name);
+                return false;
+            }
+            return list_extreme(list, builtin == BUILTIN_MAX, result, error);
+        case BUILTIN_SORT:
+            return list_sorted(heap, list, result, error);
+        default:
+            return false;
+    }
+}
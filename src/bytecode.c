@@ -0,0 +1,1214 @@
+//bytecode.c
+#include <stdlib.h>
+#include <string.h>
+#include "../include/bytecode.h"
+#include "../include/runtime_string.h"
+#include "../include/builtins.h"
+#include "../include/generator.h"
+
+void init_chunk(Chunk *chunk) {
+    chunk->code = NULL;
+    chunk->lines = NULL;
+    chunk->count = 0;
+    chunk->capacity = 0;
+    chunk->constants = NULL;
+    chunk->constant_count = 0;
+    chunk->constant_capacity = 0;
+    chunk->global_names = NULL;
+    chunk->global_count = 0;
+    chunk->max_stack = 0;
+    chunk->parallel_loops = NULL;
+    chunk->parallel_loop_count = 0;
+    chunk->parallel_loop_capacity = 0;
+    chunk->generators = NULL;
+    chunk->generator_count = 0;
+    chunk->generator_capacity = 0;
+    chunk->functions = NULL;
+    chunk->function_count = 0;
+    chunk->function_capacity = 0;
+}
+
+void free_chunk(Chunk *chunk) {
+    free(chunk->code);
+    free(chunk->lines);
+    free(chunk->constants);
+    free(chunk->global_names);
+    for (int i = 0; i < chunk->parallel_loop_count; i++) {
+        free(chunk->parallel_loops[i].reduction_slots);
+        free(chunk->parallel_loops[i].reduction_kinds);
+        free(chunk->parallel_loops[i].private_slots);
+    }
+    free(chunk->parallel_loops);
+    free(chunk->generators);
+    free(chunk->functions);
+    init_chunk(chunk);
+}
+
+void write_chunk(Chunk *chunk, uint8_t byte, int line) {
+    if (chunk->count == chunk->capacity) {
+        chunk->capacity = chunk->capacity ? chunk->capacity * 2 : 256;
+        chunk->code = safe_realloc(chunk->code, chunk->capacity);
+        chunk->lines = safe_realloc(chunk->lines, chunk->capacity * sizeof(int));
+    }
+    chunk->code[chunk->count] = byte;
+    chunk->lines[chunk->count] = line;
+    chunk->count++;
+}
+
+void truncate_chunk(Chunk *chunk, size_t count) {
+    chunk->count = count;
+    while (chunk->parallel_loop_count > 0 && chunk->parallel_loops[chunk->parallel_loop_count - 1].body >= count) {
+        ParallelLoop *loop = &chunk->parallel_loops[--chunk->parallel_loop_count];
+        free(loop->reduction_slots);
+        free(loop->reduction_kinds);
+        free(loop->private_slots);
+    }
+    while (chunk->generator_count > 0 && chunk->generators[chunk->generator_count - 1].entry >= count) {
+        chunk->generator_count--;
+    }
+    // A function only called so far has no entry yet
+    while (chunk->function_count > 0 && (chunk->functions[chunk->function_count - 1].entry >= count ||
+                                         chunk->functions[chunk->function_count - 1].entry == 0)) {
+        chunk->function_count--;
+    }
+}
+
+static int add_constant(Chunk *chunk, Value value) {
+    if (chunk->constant_count == chunk->constant_capacity) {
+        chunk->constant_capacity = chunk->constant_capacity ? chunk->constant_capacity * 2 : 16;
+        chunk->constants = safe_realloc(chunk->constants, chunk->constant_capacity * sizeof(Value));
+    }
+    chunk->constants[chunk->constant_count] = value;
+    return chunk->constant_count++;
+}
+
+void init_bytecode_context(BytecodeContext *context, Chunk *chunk, Heap *heap,
+                           SymbolTable *symbol_table, ErrorList *errors) {
+    context->chunk = chunk;
+    context->heap = heap;
+    context->symbol_table = symbol_table;
+    context->errors = errors;
+    context->pending = NULL;
+    context->pending_count = 0;
+    context->pending_capacity = 0;
+    context->stack_depth = 0;
+    context->accumulators = NULL;
+    context->accumulator_count = 0;
+    context->accumulator_capacity = 0;
+    context->append_value = NULL;
+    context->append_variable = NULL;
+    context->unroll_factor = DEFAULT_UNROLL_FACTOR;
+    context->planned_loop = NULL;
+    context->plan = (LoopPlan){0};
+    context->specializing = false;
+    context->step_constant = 0;
+    context->product_slots = NULL;
+    context->product_steps = NULL;
+    context->skip_depth = 0;
+    context->profiling = false;
+    context->commons = NULL;
+    context->common_count = 0;
+    context->common_capacity = 0;
+    context->common_slots = NULL;
+    context->common_slot_count = 0;
+    context->first_common = 0;
+    context->conditional_depth = 0;
+    context->statement_line = 0;
+    context->parallel_loop = NULL;
+    context->parallel_plan = (ParallelPlan){0};
+    context->parallel_index = 0;
+    context->reduction = NULL;
+    context->reduction_kind = REDUCE_SUM;
+    context->generator = -1;
+    context->function = -1;
+    context->outer_max_stack = 0;
+    context->outer_common_slots = NULL;
+    context->outer_common_slot_count = 0;
+    context->outer_common_count = 0;
+    context->frame_call = NULL;
+}
+
+void free_bytecode_context(BytecodeContext *context) {
+    free(context->pending);
+    context->pending = NULL;
+    context->pending_count = 0;
+    context->pending_capacity = 0;
+    free(context->accumulators);
+    context->accumulators = NULL;
+    context->accumulator_count = 0;
+    context->accumulator_capacity = 0;
+    // A compile abandoned part way through a loop leaves its plan behind
+    free_loop_plan(&context->plan);
+    context->planned_loop = NULL;
+    free_parallel_plan(&context->parallel_plan);
+    context->parallel_loop = NULL;
+    free(context->commons);
+    free(context->common_slots);
+    context->commons = NULL;
+    context->common_count = 0;
+    context->common_capacity = 0;
+    context->common_slots = NULL;
+    context->common_slot_count = 0;
+    // Or part way through a generator or function, with the program's hidden variables put aside
+    free(context->outer_common_slots);
+    context->outer_common_slots = NULL;
+    context->outer_common_slot_count = 0;
+    context->outer_common_count = 0;
+    context->generator = -1;
+    context->function = -1;
+}
+
+static void push_pending(BytecodeContext *context, size_t offset) {
+    if (context->pending_count == context->pending_capacity) {
+        context->pending_capacity = context->pending_capacity ? context->pending_capacity * 2 : 16;
+        context->pending = safe_realloc(context->pending, context->pending_capacity * sizeof(size_t));
+    }
+    context->pending[context->pending_count++] = offset;
+}
+
+static size_t pop_pending(BytecodeContext *context) {
+    return context->pending[--context->pending_count];
+}
+
+// Track the value stack's depth so the VM can size it once up front
+static void adjust_stack(BytecodeContext *context, int effect) {
+    context->stack_depth += effect;
+    if (context->stack_depth > context->chunk->max_stack) {
+        context->chunk->max_stack = context->stack_depth;
+    }
+}
+
+static void emit_op(BytecodeContext *context, OpCode op, int effect, int line) {
+    write_chunk(context->chunk, (uint8_t)op, line);
+    adjust_stack(context, effect);
+}
+
+static void emit_operand(BytecodeContext *context, uint32_t operand, int line) {
+    for (int i = 0; i < 4; i++) {
+        write_chunk(context->chunk, (uint8_t)(operand >> (8 * i)), line);
+    }
+}
+
+// Emit a jump with a placeholder target; returns the operand's offset
+static size_t emit_jump(BytecodeContext *context, OpCode op, int effect, int line) {
+    emit_op(context, op, effect, line);
+    size_t operand = context->chunk->count;
+    emit_operand(context, 0, line);
+    return operand;
+}
+
+static void patch_operand(BytecodeContext *context, size_t operand, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        context->chunk->code[operand + i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+// Point the jump whose operand is at `operand` to the next instruction
+static void patch_jump(BytecodeContext *context, size_t operand) {
+    patch_operand(context, operand, (uint32_t)context->chunk->count);
+}
+
+static void emit_constant(BytecodeContext *context, Value value, int line) {
+    emit_op(context, OP_CONSTANT, 1, line);
+    emit_operand(context, (uint32_t)add_constant(context->chunk, value), line);
+}
+
+// Make the chunk use at least `count` global slots
+static void reserve_globals(Chunk *chunk, int count) {
+    if (count > chunk->global_count) {
+        chunk->global_names = safe_realloc(chunk->global_names, count * sizeof(const char *));
+        for (int i = chunk->global_count; i < count; i++) {
+            chunk->global_names[i] = NULL;
+        }
+        chunk->global_count = count;
+    }
+}
+
+// The variable's slot, recorded with its name for runtime errors
+static uint32_t global_slot(BytecodeContext *context, const Symbol *symbol) {
+    Chunk *chunk = context->chunk;
+    int slot = symbol->info.variable.slot;
+    reserve_globals(chunk, slot + 1);
+    chunk->global_names[slot] = symbol->name;
+    return (uint32_t)slot;
+}
+
+// The symbol of a hidden variable. A generator has its own, since the code
+// that resumes it may use the program's in the meantime, and so does a
+// function, whose variables a recursive call saves.
+static Symbol *hidden_symbol(BytecodeContext *context, const char *name) {
+    Symbol *symbol = lookup_symbol(context->symbol_table, name);
+    if (symbol == NULL || ((context->generator >= 0 || context->function >= 0) && symbol->scope == 0)) {
+        symbol = insert_symbol(context->symbol_table, name, SYMBOL_VARIABLE);
+    }
+    return symbol;
+}
+
+static void emit_global(BytecodeContext *context, OpCode op, int effect, const Symbol *symbol, int line) {
+    uint32_t slot = global_slot(context, symbol);
+    emit_op(context, op, effect, line);
+    emit_operand(context, slot, line);
+}
+
+// `x = x + e;`, the one update an accumulator may have
+static bool is_append(const ASTNode *assign) {
+    const ASTNode *value = assign->data.assign.value;
+    return value->type == AST_BINARY_OP && value->data.binary_op.op == TOKEN_PLUS &&
+           value->data.binary_op.left->type == AST_VARIABLE &&
+           value->data.binary_op.left->data.variable.name == assign->data.assign.name;
+}
+
+static bool is_accumulator(const BytecodeContext *context, const char *name) {
+    for (int i = 0; i < context->accumulator_count; i++) {
+        if (context->accumulators[i] == name) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Whether `name` is a reduction of the parallel loop being compiled
+static bool is_reduction(const BytecodeContext *context, const char *name) {
+    for (int i = 0; context->parallel_loop != NULL && i < context->parallel_plan.reduction_count; i++) {
+        if (context->parallel_plan.reductions[i].name == name) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Assignments to each name in a loop body, counted by kind
+typedef struct {
+    const char **names;
+    int *appends;
+    int *others;
+    int count;
+    int capacity;
+} AssignmentCounts;
+
+static void count_assignment(ASTNode *node, void *context) {
+    AssignmentCounts *counts = context;
+    const char *name;
+    if (node->type == AST_ASSIGN) {
+        name = node->data.assign.name;
+    } else if (node->type == AST_FOR) {
+        name = node->data.for_loop.variable;
+    } else {
+        return;
+    }
+    int i = 0;
+    while (i < counts->count && counts->names[i] != name) {
+        i++;
+    }
+    if (i == counts->count) {
+        if (counts->count == counts->capacity) {
+            counts->capacity = counts->capacity ? counts->capacity * 2 : 8;
+            counts->names = safe_realloc(counts->names, counts->capacity * sizeof(const char *));
+            counts->appends = safe_realloc(counts->appends, counts->capacity * sizeof(int));
+            counts->others = safe_realloc(counts->others, counts->capacity * sizeof(int));
+        }
+        counts->names[i] = name;
+        counts->appends[i] = 0;
+        counts->others[i] = 0;
+        counts->count++;
+    }
+    if (node->type == AST_ASSIGN && is_append(node)) {
+        counts->appends[i]++;
+    } else {
+        counts->others[i]++;
+    }
+}
+
+// Make accumulators of the variables that a loop `body` only ever appends
+// to. Names already managed by an enclosing loop, or reduced by a parallel
+// one, are left to it.
+static void find_accumulators(BytecodeContext *context, ASTNode *body) {
+    AssignmentCounts counts = {NULL, NULL, NULL, 0, 0};
+    ASTVisitor visitor = {count_assignment, NULL, NULL, &counts};
+    walk_ast(body, &visitor, 1);
+
+    for (int i = 0; i < counts.count; i++) {
+        // A name first assigned in the loop is undeclared there; the
+        // semantic pass reports it
+        if (counts.appends[i] == 0 || counts.others[i] > 0 || is_accumulator(context, counts.names[i]) ||
+            is_reduction(context, counts.names[i]) || lookup_symbol(context->symbol_table, counts.names[i]) == NULL) {
+            continue;
+        }
+        if (context->accumulator_count == context->accumulator_capacity) {
+            context->accumulator_capacity = context->accumulator_capacity ? context->accumulator_capacity * 2 : 8;
+            context->accumulators = safe_realloc(context->accumulators,
+                                                 context->accumulator_capacity * sizeof(const char *));
+        }
+        context->accumulators[context->accumulator_count++] = counts.names[i];
+    }
+
+    free(counts.names);
+    free(counts.appends);
+    free(counts.others);
+}
+
+// Leave the accumulators of a loop that is ending as plain strings
+static void finish_accumulators(BytecodeContext *context, int first_accumulator, int line) {
+    for (int i = first_accumulator; i < context->accumulator_count; i++) {
+        Symbol *symbol = lookup_symbol(context->symbol_table, context->accumulators[i]);
+        emit_global(context, OP_FINISH_ACCUMULATOR, 0, symbol, line);
+    }
+    context->accumulator_count = first_accumulator;
+}
+
+static OpCode binary_opcode(TokenType op) {
+    switch (op) {
+        case TOKEN_PLUS: return OP_ADD;
+        case TOKEN_MINUS: return OP_SUBTRACT;
+        case TOKEN_MULTIPLY: return OP_MULTIPLY;
+        case TOKEN_DIVIDE: return OP_DIVIDE;
+        case TOKEN_PERCENT: return OP_MODULO;
+        case TOKEN_EQUAL: return OP_EQUAL;
+        case TOKEN_NOT_EQUAL: return OP_NOT_EQUAL;
+        case TOKEN_LESS: return OP_LESS;
+        case TOKEN_LESS_EQUAL: return OP_LESS_EQUAL;
+        case TOKEN_GREATER: return OP_GREATER;
+        default: return OP_GREATER_EQUAL;
+    }
+}
+
+static void emit_variable(BytecodeContext *context, const char *name, int line) {
+    Symbol *symbol = lookup_symbol(context->symbol_table, name);
+    if (symbol && symbol->type == SYMBOL_VARIABLE) {
+        // A specialized loop's counter is an integer, never a string builder.
+        // A generator may be resumed, and a function called, from a loop
+        // appending to a global.
+        bool accumulator = (is_accumulator(context, name) &&
+                            !(context->specializing && name == context->plan.variable)) ||
+                           ((context->generator >= 0 || context->function >= 0) && symbol->scope == 0);
+        emit_global(context, accumulator ? OP_GET_ACCUMULATOR : OP_GET_GLOBAL, 1, symbol, line);
+    }
+}
+
+static void emit_number(BytecodeContext *context, Integer number, int line) {
+    emit_constant(context, value_from_integer(context->heap, integer_copy(number)), line);
+}
+
+static void emit_increment(BytecodeContext *context, uint32_t slot, uint32_t constant, int line) {
+    emit_op(context, OP_INCREMENT_GLOBAL, 0, line);
+    emit_operand(context, slot, line);
+    emit_operand(context, constant, line);
+}
+
+// The variable holding `i * k` in a specialized loop. Its name cannot be
+// written in a program, so it never clashes with one.
+static uint32_t product_slot(BytecodeContext *context, const Integer *multiplier) {
+    Buffer name;
+    buffer_init(&name);
+    buffer_append_str(&name, context->plan.variable);
+    buffer_append_str(&name, "*");
+    integer_append(&name, *multiplier);
+    buffer_append(&name, "", 1);
+    Symbol *symbol = hidden_symbol(context, name.data);
+    buffer_free(&name);
+    return global_slot(context, symbol);
+}
+
+// One operand of the loop condition, with the counter advanced by `advance`
+static void emit_guard_operand(BytecodeContext *context, const ASTNode *operand, Value advance, int line) {
+    if (operand->type == AST_NUMBER) {
+        emit_number(context, operand->data.number, line);
+        return;
+    }
+    emit_variable(context, operand->data.variable.name, line);
+    if (operand->data.variable.name == context->plan.variable && advance != value_from_small_int(0)) {
+        emit_constant(context, advance, line);
+        emit_op(context, OP_ADD, -1, line);
+    }
+}
+
+// Mark the start of a statement for the profiler
+static void emit_line(BytecodeContext *context, int line) {
+    if (context->profiling) {
+        emit_op(context, OP_LINE, 0, line);
+        emit_operand(context, (uint32_t)line, line);
+    }
+}
+
+// Emit the specialized form of the planned `loop`, whose plain form starts
+// at `original`. It first checks that the counter and bound are integers,
+// falling back to the plain loop if not. Then, while the condition holds
+// `factor` iterations on, it runs that many copies of the body; the plain
+// loop finishes what is left.
+static void emit_specialized_loop(BytecodeContext *context, ASTNode *loop, size_t original) {
+    LoopPlan *plan = &context->plan;
+    const ASTNode *condition = loop->data.while_loop.condition;
+    int line = condition->line;
+    Symbol *counter = lookup_symbol(context->symbol_table, plan->variable);
+    if (counter == NULL || (plan->bound->type == AST_VARIABLE &&
+                            lookup_symbol(context->symbol_table, plan->bound->data.variable.name) == NULL)) {
+        // Undeclared; the semantic pass has reported it
+        emit_op(context, OP_JUMP, 0, line);
+        emit_operand(context, (uint32_t)original, line);
+        return;
+    }
+
+    emit_global(context, OP_GET_GLOBAL, 1, counter, line);
+    emit_op(context, OP_JUMP_IF_NOT_INTEGER, -1, line);
+    emit_operand(context, (uint32_t)original, line);
+    if (plan->bound->type == AST_VARIABLE) {
+        emit_variable(context, plan->bound->data.variable.name, line);
+        emit_op(context, OP_JUMP_IF_NOT_INTEGER, -1, line);
+        emit_operand(context, (uint32_t)original, line);
+    }
+
+    Heap *heap = context->heap;
+    context->step_constant = (uint32_t)add_constant(context->chunk, value_from_integer(heap, integer_copy(plan->step)));
+    context->product_slots = safe_malloc((plan->multiplier_count + 1) * sizeof(uint32_t));
+    context->product_steps = safe_malloc((plan->multiplier_count + 1) * sizeof(uint32_t));
+    for (int i = 0; i < plan->multiplier_count; i++) {
+        const Integer *multiplier = plan->multipliers[i];
+        context->product_slots[i] = product_slot(context, multiplier);
+        Value step = value_from_integer(heap, integer_mul(plan->step, *multiplier));
+        context->product_steps[i] = (uint32_t)add_constant(context->chunk, step);
+        emit_global(context, OP_GET_GLOBAL, 1, counter, line);
+        emit_number(context, *multiplier, line);
+        emit_op(context, OP_MULTIPLY, -1, line);
+        emit_op(context, OP_SET_GLOBAL, -1, line);
+        emit_operand(context, context->product_slots[i], line);
+    }
+
+    size_t top = context->chunk->count;
+    emit_line(context, loop->line);
+    Integer advance = integer_mul(integer_from_int64(plan->factor - 1), plan->step);
+    Value advance_value = value_from_integer(heap, advance);
+    emit_guard_operand(context, condition->data.binary_op.left, advance_value, line);
+    emit_guard_operand(context, condition->data.binary_op.right, advance_value, line);
+    emit_op(context, binary_opcode(condition->data.binary_op.op), -1, line);
+    emit_op(context, OP_JUMP_IF_FALSE, -1, line);
+    emit_operand(context, (uint32_t)original, line);
+
+    context->specializing = true;
+    ASTVisitor visitor = bytecode_visitor(context);
+    for (int i = 0; i < plan->factor; i++) {
+        // Each copy is an iteration for the profiler
+        if (i > 0) {
+            emit_line(context, loop->line);
+        }
+        walk_ast(loop->data.while_loop.body, &visitor, 1);
+    }
+    context->specializing = false;
+    emit_op(context, OP_JUMP, 0, loop->line);
+    emit_operand(context, (uint32_t)top, loop->line);
+
+    free(context->product_slots);
+    free(context->product_steps);
+    context->product_slots = NULL;
+    context->product_steps = NULL;
+}
+
+// Shared nodes stand for several places in the source, so errors in them
+// are reported at the statement being compiled
+static int node_line(const BytecodeContext *context, const ASTNode *node) {
+    return node->references > 1 ? context->statement_line : node->line;
+}
+
+// The position of `node` in `commons` if its value has been kept, looking
+// from the innermost block out; or -1
+static int find_computed(const BytecodeContext *context, const ASTNode *node) {
+    if (node->references < 2 || (node->type != AST_BINARY_OP && node->type != AST_UNARY_OP)) {
+        return -1;
+    }
+    for (int i = context->common_count - 1; i >= context->outer_common_count; i--) {
+        if (context->commons[i].node == node && context->commons[i].computed) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// The hidden variable for a position in `commons`. Positions are reused
+// by later blocks, whose values no longer overlap. Its name cannot be
+// written in a program, so it never clashes with one.
+static uint32_t common_slot(BytecodeContext *context, int position) {
+    while (context->common_slot_count <= position) {
+        char name[32];
+        snprintf(name, sizeof(name), "$%d", context->common_slot_count);
+        Symbol *symbol = hidden_symbol(context, name);
+        context->common_slots = safe_realloc(context->common_slots,
+                                             (context->common_slot_count + 1) * sizeof(uint32_t));
+        context->common_slots[context->common_slot_count++] = global_slot(context, symbol);
+    }
+    return context->common_slots[position];
+}
+
+// Blocks are where common expressions are computed and forgotten
+static void open_common_scope(BytecodeContext *context, const ASTNode *block) {
+    push_pending(context, (size_t)context->first_common);
+    push_pending(context, (size_t)context->conditional_depth);
+    context->first_common = context->common_count;
+    context->conditional_depth = 0;
+
+    int count;
+    const ASTNode **repeated = find_repeated_expressions(block, &count);
+    for (int i = 0; i < count; i++) {
+        if (context->common_count == context->common_capacity) {
+            context->common_capacity = context->common_capacity ? context->common_capacity * 2 : 16;
+            context->commons = safe_realloc(context->commons, context->common_capacity * sizeof(CommonExpression));
+        }
+        context->commons[context->common_count++] = (CommonExpression){repeated[i], false};
+    }
+    free(repeated);
+}
+
+static void close_common_scope(BytecodeContext *context) {
+    context->common_count = context->first_common;
+    context->conditional_depth = (int)pop_pending(context);
+    context->first_common = (int)pop_pending(context);
+}
+
+// `node` has just been computed. If that happened in straight-line code
+// of a block that repeats it, keep the value for the repeats.
+static void keep_common(BytecodeContext *context, const ASTNode *node) {
+    if (node->references < 2 || context->conditional_depth > 0) {
+        return;
+    }
+    for (int i = context->first_common; i < context->common_count; i++) {
+        if (context->commons[i].node == node && !context->commons[i].computed) {
+            uint32_t slot = common_slot(context, i);
+            int line = node_line(context, node);
+            emit_op(context, OP_SET_GLOBAL, -1, line);
+            emit_operand(context, slot, line);
+            emit_op(context, OP_GET_GLOBAL, 1, line);
+            emit_operand(context, slot, line);
+            context->commons[i].computed = true;
+            return;
+        }
+    }
+}
+
+// Whether `node` is replaced, in a specialized copy, by a common
+// expression's value or by the operand of a reduction; if so, its subtree
+// emits nothing and replace_node emits its code when it closes
+static bool is_replaced(const BytecodeContext *context, const ASTNode *node) {
+    if (context->reduction != NULL && node == context->reduction->data.assign.value) {
+        return true;
+    }
+    if (context->specializing && (node == context->plan.update || find_product(&context->plan, node) >= 0)) {
+        return true;
+    }
+    // The `x + e` of an append emits no addition, so it has no value to reuse
+    return node != context->append_value && find_computed(context, node) >= 0;
+}
+
+static void replace_node(BytecodeContext *context, const ASTNode *node) {
+    LoopPlan *plan = &context->plan;
+    int line = node_line(context, node);
+    int product = context->specializing ? find_product(plan, node) : -1;
+    if (context->reduction != NULL && node == context->reduction->data.assign.value) {
+        // Only the operand is computed; OP_REDUCE combines it
+        ReductionKind kind;
+        ASTNode *operand = (ASTNode *)reduction_operand(context->reduction, &kind);
+        ASTVisitor visitor = bytecode_visitor(context);
+        walk_ast(operand, &visitor, 1);
+    } else if (context->specializing && node == plan->update) {
+        // The counter steps, and every product with it
+        Symbol *counter = lookup_symbol(context->symbol_table, plan->variable);
+        emit_line(context, node->line);
+        emit_increment(context, global_slot(context, counter), context->step_constant, line);
+        for (int i = 0; i < plan->multiplier_count; i++) {
+            emit_increment(context, context->product_slots[i], context->product_steps[i], line);
+        }
+    } else if (product >= 0) {
+        emit_op(context, OP_GET_GLOBAL, 1, line);
+        emit_operand(context, context->product_slots[plan->product_multipliers[product]], line);
+    } else {
+        emit_op(context, OP_GET_GLOBAL, 1, line);
+        emit_operand(context, common_slot(context, find_computed(context, node)), line);
+    }
+}
+
+// Start the parallel loop `loop` once its range is on the stack. Its body
+// follows, to be run by the scheduler.
+static void emit_parallel_loop(BytecodeContext *context, const ASTNode *loop) {
+    Chunk *chunk = context->chunk;
+    if (chunk->parallel_loop_count == chunk->parallel_loop_capacity) {
+        chunk->parallel_loop_capacity = chunk->parallel_loop_capacity ? chunk->parallel_loop_capacity * 2 : 4;
+        chunk->parallel_loops = safe_realloc(chunk->parallel_loops,
+                                             chunk->parallel_loop_capacity * sizeof(ParallelLoop));
+    }
+    context->parallel_index = chunk->parallel_loop_count++;
+    emit_op(context, OP_PARALLEL, -3, loop->line);
+    emit_operand(context, (uint32_t)context->parallel_index, loop->line);
+    chunk->parallel_loops[context->parallel_index] = (ParallelLoop){0, chunk->count, 0, loop->line, NULL, NULL, 0, NULL, 0};
+}
+
+// End the parallel loop's body and record its variables, which the
+// semantic pass has all declared by now
+static void finish_parallel_loop(BytecodeContext *context, const ASTNode *loop) {
+    int first_accumulator = (int)pop_pending(context);
+    emit_op(context, OP_END_ITERATION, 0, loop->line);
+
+    ParallelLoop *parallel = &context->chunk->parallel_loops[context->parallel_index];
+    ParallelPlan *plan = &context->parallel_plan;
+    Symbol *symbol = lookup_symbol(context->symbol_table, loop->data.for_loop.variable);
+    parallel->slot = symbol ? global_slot(context, symbol) : 0;
+    parallel->exit = context->chunk->count;
+    parallel->reduction_count = plan->reduction_count;
+    parallel->reduction_slots = safe_malloc((plan->reduction_count + 1) * sizeof(uint32_t));
+    parallel->reduction_kinds = safe_malloc((plan->reduction_count + 1) * sizeof(ReductionKind));
+    for (int i = 0; i < plan->reduction_count; i++) {
+        symbol = lookup_symbol(context->symbol_table, plan->reductions[i].name);
+        parallel->reduction_slots[i] = symbol ? global_slot(context, symbol) : 0;
+        parallel->reduction_kinds[i] = plan->reductions[i].kind;
+    }
+    parallel->private_count = plan->private_count;
+    parallel->private_slots = safe_malloc((plan->private_count + 1) * sizeof(uint32_t));
+    for (int i = 0; i < plan->private_count; i++) {
+        symbol = lookup_symbol(context->symbol_table, plan->privates[i]);
+        parallel->private_slots[i] = symbol ? global_slot(context, symbol) : 0;
+    }
+
+    finish_accumulators(context, first_accumulator, loop->line);
+    free_parallel_plan(plan);
+    context->parallel_loop = NULL;
+}
+
+// The index of the generator `name` among the chunk's, or -1
+static int generator_index(const BytecodeContext *context, const char *name) {
+    Symbol *symbol = lookup_symbol(context->symbol_table, name);
+    return symbol != NULL && symbol->type == SYMBOL_FUNCTION && symbol->info.function.generator
+               ? symbol->info.function.index
+               : -1;
+}
+
+static int add_function(Chunk *chunk) {
+    if (chunk->function_count == chunk->function_capacity) {
+        chunk->function_capacity = chunk->function_capacity ? chunk->function_capacity * 2 : 4;
+        chunk->functions = safe_realloc(chunk->functions, chunk->function_capacity * sizeof(FunctionDefinition));
+    }
+    chunk->functions[chunk->function_count] = (FunctionDefinition){0, 0, 0, 0, 0};
+    return chunk->function_count++;
+}
+
+// The index of the function `name` among the chunk's, or -1. A call may
+// come before the definition, so the first call takes its place.
+static int function_index(BytecodeContext *context, const char *name) {
+    Symbol *symbol = lookup_symbol(context->symbol_table, name);
+    if (symbol == NULL || symbol->type != SYMBOL_FUNCTION || symbol->info.function.generator) {
+        return -1;
+    }
+    if (symbol->info.function.index < 0) {
+        symbol->info.function.index = add_function(context->chunk);
+    }
+    return symbol->info.function.index;
+}
+
+// Definitions are statements of the program, so its stack is empty while
+// their bodies are compiled
+static void set_program_aside(BytecodeContext *context) {
+    context->outer_max_stack = context->chunk->max_stack;
+    context->chunk->max_stack = 0;
+    context->outer_common_slots = context->common_slots;
+    context->outer_common_slot_count = context->common_slot_count;
+    context->common_slots = NULL;
+    context->common_slot_count = 0;
+    context->outer_common_count = context->common_count;
+}
+
+// Back to the program, which jumps over the body just compiled
+static void restore_program(BytecodeContext *context) {
+    context->chunk->max_stack = context->outer_max_stack;
+    free(context->common_slots);
+    context->common_slots = context->outer_common_slots;
+    context->common_slot_count = context->outer_common_slot_count;
+    context->outer_common_slots = NULL;
+    context->outer_common_slot_count = 0;
+    context->outer_common_count = 0;
+    patch_jump(context, pop_pending(context));
+}
+
+// Start the body of `generator`. The semantic pass has declared its
+// variables by now, in slots after any before it.
+static void begin_generator(BytecodeContext *context, const ASTNode *generator, uint32_t first_slot) {
+    Chunk *chunk = context->chunk;
+    if (chunk->generator_count == chunk->generator_capacity) {
+        chunk->generator_capacity = chunk->generator_capacity ? chunk->generator_capacity * 2 : 4;
+        chunk->generators = safe_realloc(chunk->generators, chunk->generator_capacity * sizeof(GeneratorDefinition));
+    }
+    context->generator = chunk->generator_count++;
+    chunk->generators[context->generator] =
+        (GeneratorDefinition){chunk->count, generator->data.generator.parameter_count, first_slot, 0, 0};
+    // A redefinition keeps the first; the semantic pass has reported it
+    Symbol *symbol = lookup_symbol(context->symbol_table, generator->data.generator.name);
+    if (symbol != NULL && symbol->type == SYMBOL_FUNCTION && symbol->info.function.generator &&
+        symbol->info.function.index < 0) {
+        symbol->info.function.index = context->generator;
+    }
+    for (int i = 0; i < generator->data.generator.parameter_count; i++) {
+        Symbol *parameter = lookup_symbol(context->symbol_table, generator->data.generator.parameters[i]);
+        if (parameter != NULL) {
+            global_slot(context, parameter);
+        }
+    }
+    set_program_aside(context);
+}
+
+static void end_generator(BytecodeContext *context, const ASTNode *generator) {
+    Chunk *chunk = context->chunk;
+    emit_op(context, OP_END_GENERATOR, 0, generator->line);
+    GeneratorDefinition *definition = &chunk->generators[context->generator];
+    definition->slot_count = context->symbol_table->variable_count - (int)definition->first_slot;
+    definition->max_stack = chunk->max_stack;
+    // Every variable moves in and out of frames, used or not
+    reserve_globals(chunk, context->symbol_table->variable_count);
+    context->generator = -1;
+    restore_program(context);
+}
+
+// Leave the running call with the value on top of the stack
+static void emit_return(BytecodeContext *context, int line) {
+    uint32_t depth = (uint32_t)context->stack_depth;
+    emit_op(context, OP_RETURN, -1, line);
+    emit_operand(context, depth, line);
+    emit_operand(context, (uint32_t)context->function, line);
+}
+
+// Start the body of `function`, as begin_generator does. Its calls so
+// far have given it an index; a redefinition, which the semantic pass
+// has reported, gets one no call refers to.
+static void begin_function(BytecodeContext *context, const ASTNode *function, uint32_t first_slot) {
+    Chunk *chunk = context->chunk;
+    Symbol *symbol = lookup_symbol(context->symbol_table, function->data.function.name);
+    int index = symbol != NULL && symbol->type == SYMBOL_FUNCTION && !symbol->info.function.generator
+                    ? function_index(context, function->data.function.name)
+                    : -1;
+    if (index < 0 || chunk->functions[index].entry != 0) {
+        index = add_function(chunk);
+    }
+    context->function = index;
+    chunk->functions[index] =
+        (FunctionDefinition){chunk->count, function->data.function.parameter_count, first_slot, 0, 0};
+    for (int i = 0; i < function->data.function.parameter_count; i++) {
+        Symbol *parameter = lookup_symbol(context->symbol_table, function->data.function.parameters[i]);
+        if (parameter != NULL) {
+            global_slot(context, parameter);
+        }
+    }
+    set_program_aside(context);
+}
+
+static void end_function(BytecodeContext *context, const ASTNode *function) {
+    Chunk *chunk = context->chunk;
+    // Falling off the end returns ಶೂನ್ಯ
+    emit_op(context, OP_NONE, 1, function->line);
+    emit_return(context, function->line);
+    FunctionDefinition *definition = &chunk->functions[context->function];
+    definition->slot_count = context->symbol_table->variable_count - (int)definition->first_slot;
+    definition->max_stack = chunk->max_stack;
+    // A call saves every variable, used or not
+    reserve_globals(chunk, context->symbol_table->variable_count);
+    context->function = -1;
+    restore_program(context);
+}
+
+static void open_node(ASTNode *ast, void *context) {
+    BytecodeContext *bytecode = context;
+
+    if (bytecode->skip_depth > 0 || is_replaced(bytecode, ast)) {
+        bytecode->skip_depth++;
+        return;
+    }
+
+    switch (ast->type) {
+        case AST_PROGRAM:
+        case AST_BLOCK:
+            open_common_scope(bytecode, ast);
+            break;
+        default:
+            break;
+    }
+    switch (ast->type) {
+        case AST_ASSIGN:
+        case AST_PRINT:
+        case AST_EXPRESSION:
+        case AST_STORE_INDEX:
+        case AST_IF:
+        case AST_WHILE:
+        case AST_FOR:
+        case AST_IMPORT:
+        case AST_GENERATOR:
+        case AST_YIELD:
+        case AST_FUNCTION:
+        case AST_RETURN:
+            bytecode->statement_line = ast->line;
+            // A loop marks its condition, which runs on every iteration
+            if (ast->type != AST_WHILE) {
+                emit_line(bytecode, ast->line);
+            }
+            break;
+        default:
+            break;
+    }
+
+    switch (ast->type) {
+        case AST_WHILE:
+            // The condition is evaluated again on every iteration, so no
+            // value it computes can be kept for the statements after it
+            bytecode->conditional_depth++;
+            // A loop with a plan is entered through its specialized form,
+            // emitted once the body's variables have all been declared
+            if (bytecode->planned_loop == NULL &&
+                plan_loop(ast, bytecode->unroll_factor, &bytecode->plan)) {
+                bytecode->planned_loop = ast;
+                push_pending(bytecode, emit_jump(bytecode, OP_JUMP, 0, ast->line));
+            }
+            // The loop jumps back to its condition. Its accumulators are
+            // those above the count recorded here.
+            push_pending(bytecode, bytecode->chunk->count);
+            push_pending(bytecode, (size_t)bytecode->accumulator_count);
+            emit_line(bytecode, ast->line);
+            find_accumulators(bytecode, ast->data.while_loop.body);
+            break;
+        case AST_FOR:
+            push_pending(bytecode, (size_t)bytecode->accumulator_count);
+            // The semantic pass reports a parallel loop without a plan
+            if (ast->data.for_loop.parallel && bytecode->parallel_loop == NULL &&
+                plan_parallel_loop(ast, &bytecode->parallel_plan, bytecode->symbol_table, NULL)) {
+                bytecode->parallel_loop = ast;
+            }
+            find_accumulators(bytecode, ast->data.for_loop.body);
+            if (ast->data.for_loop.iterable != NULL) {
+                const ASTNode *iterable = ast->data.for_loop.iterable;
+                // A return from inside the loop would leave the frame behind
+                if (bytecode->generator < 0 && bytecode->function < 0 && iterable->type == AST_CALL &&
+                    generator_index(bytecode, iterable->data.call.name) >= 0) {
+                    bytecode->frame_call = iterable;
+                }
+            } else if (ast->data.for_loop.start == NULL) {
+                emit_constant(bytecode, value_from_small_int(0), ast->line);
+            }
+            break;
+        case AST_GENERATOR:
+            // The body only runs when a loop resumes the generator. Its
+            // variables are declared from the next slot on.
+            push_pending(bytecode, emit_jump(bytecode, OP_JUMP, 0, ast->line));
+            push_pending(bytecode, (size_t)bytecode->symbol_table->variable_count);
+            break;
+        case AST_FUNCTION:
+            // Likewise the body only runs when it is called
+            push_pending(bytecode, emit_jump(bytecode, OP_JUMP, 0, ast->line));
+            push_pending(bytecode, (size_t)bytecode->symbol_table->variable_count);
+            break;
+        case AST_RETURN:
+            if (ast->data.return_stmt.value == NULL) {
+                emit_op(bytecode, OP_NONE, 1, ast->line);
+            }
+            break;
+        case AST_ASSIGN:
+            if (is_reduction(bytecode, ast->data.assign.name)) {
+                reduction_operand(ast, &bytecode->reduction_kind);
+                bytecode->reduction = ast;
+            } else if (is_append(ast) && is_accumulator(bytecode, ast->data.assign.name)) {
+                bytecode->append_value = ast->data.assign.value;
+                bytecode->append_variable = ast->data.assign.value->data.binary_op.left;
+            }
+            break;
+        case AST_IMPORT:
+            report_error(bytecode->errors, ERROR_CODEGEN, ast->line,
+                         "Imports cannot be run yet; build the program instead");
+            break;
+        case AST_VARIABLE:
+            // Undeclared names are reported by the semantic pass. A shared
+            // node can occur again in the same append, so only its first
+            // occurrence is left out.
+            if (ast == bytecode->append_variable) {
+                bytecode->append_variable = NULL;
+            } else {
+                emit_variable(bytecode, ast->data.variable.name, node_line(bytecode, ast));
+            }
+            break;
+        case AST_NUMBER:
+            emit_number(bytecode, ast->data.number, node_line(bytecode, ast));
+            break;
+        case AST_FLOAT:
+            emit_constant(bytecode, value_from_double(bytecode->heap, ast->data.real), node_line(bytecode, ast));
+            break;
+        case AST_STRING:
+            {
+                const char *chars = ast->data.string;
+                emit_constant(bytecode, string_intern(bytecode->heap, chars, strlen(chars)),
+                              node_line(bytecode, ast));
+            }
+            break;
+        case AST_BOOLEAN:
+            emit_op(bytecode, ast->data.boolean ? OP_TRUE : OP_FALSE, 1, node_line(bytecode, ast));
+            break;
+        case AST_NONE:
+            emit_op(bytecode, OP_NONE, 1, node_line(bytecode, ast));
+            break;
+        default:
+            break;
+    }
+}
+
+static void separate_children(ASTNode *ast, int index, void *context) {
+    BytecodeContext *bytecode = context;
+
+    if (bytecode->skip_depth > 0) {
+        return;
+    }
+
+    switch (ast->type) {
+        case AST_IF:
+            if (index == 1) {
+                push_pending(bytecode, emit_jump(bytecode, OP_JUMP_IF_FALSE, -1, ast->line));
+            } else if (index == 2) {
+                // The then-branch skips the else-branch
+                size_t skip_else = emit_jump(bytecode, OP_JUMP, 0, ast->line);
+                patch_jump(bytecode, pop_pending(bytecode));
+                push_pending(bytecode, skip_else);
+            }
+            break;
+        case AST_WHILE:
+            if (index == 1) {
+                bytecode->conditional_depth--;
+                push_pending(bytecode, emit_jump(bytecode, OP_JUMP_IF_FALSE, -1, ast->line));
+            }
+            break;
+        case AST_GENERATOR:
+            begin_generator(bytecode, ast, (uint32_t)pop_pending(bytecode));
+            break;
+        case AST_FUNCTION:
+            begin_function(bytecode, ast, (uint32_t)pop_pending(bytecode));
+            break;
+        case AST_FOR:
+            // The generator stays on the stack while the loop runs, with
+            // its frame below it if that is there too
+            if (ast->data.for_loop.iterable != NULL && index == 1) {
+                int state = 1;
+                if (bytecode->frame_call == ast->data.for_loop.iterable) {
+                    const GeneratorDefinition *definition =
+                        &bytecode->chunk->generators[generator_index(bytecode, bytecode->frame_call->data.call.name)];
+                    state += (int)generator_frame_size(definition->slot_count, definition->max_stack);
+                    bytecode->frame_call = NULL;
+                }
+                push_pending(bytecode, (size_t)state);
+                push_pending(bytecode, bytecode->chunk->count);
+                emit_op(bytecode, OP_FOR_GENERATOR, 0, ast->line);
+                push_pending(bytecode, bytecode->chunk->count);
+                emit_operand(bytecode, 0, ast->line);
+                push_pending(bytecode, bytecode->chunk->count);
+                emit_operand(bytecode, 0, ast->line);
+                break;
+            }
+            // Start, stop and step stay on the stack while the loop runs.
+            // The variable's slot is patched in once the semantic pass has
+            // declared it, which happens after this hook.
+            if (index == for_body_index(ast)) {
+                if (ast->data.for_loop.step == NULL) {
+                    emit_constant(bytecode, value_from_small_int(1), ast->line);
+                }
+                if (ast == bytecode->parallel_loop) {
+                    emit_parallel_loop(bytecode, ast);
+                    break;
+                }
+                emit_op(bytecode, OP_FOR_PREPARE, 0, ast->line);
+                push_pending(bytecode, bytecode->chunk->count);
+                emit_operand(bytecode, 0, ast->line);
+                push_pending(bytecode, bytecode->chunk->count);
+                emit_operand(bytecode, 0, ast->line);
+                push_pending(bytecode, bytecode->chunk->count);
+            }
+            break;
+        case AST_BINARY_OP:
+            // The right operand is only evaluated if the left does not decide
+            if (index == 1 && ast->data.binary_op.op == TOKEN_AND) {
+                push_pending(bytecode, emit_jump(bytecode, OP_JUMP_IF_FALSE_OR_POP, -1, node_line(bytecode, ast)));
+                bytecode->conditional_depth++;
+            } else if (index == 1 && ast->data.binary_op.op == TOKEN_OR) {
+                push_pending(bytecode, emit_jump(bytecode, OP_JUMP_IF_TRUE_OR_POP, -1, node_line(bytecode, ast)));
+                bytecode->conditional_depth++;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+static void close_node(ASTNode *ast, void *context) {
+    BytecodeContext *bytecode = context;
+
+    if (bytecode->skip_depth > 0) {
+        if (--bytecode->skip_depth == 0) {
+            replace_node(bytecode, ast);
+        }
+        return;
+    }
+
+    switch (ast->type) {
+        case AST_PROGRAM:
+        case AST_BLOCK:
+            close_common_scope(bytecode);
+            break;
+        case AST_IF:
+            patch_jump(bytecode, pop_pending(bytecode));
+            break;
+        case AST_WHILE:
+            {
+                size_t exit = pop_pending(bytecode);
+                int first_accumulator = (int)pop_pending(bytecode);
+                size_t start = pop_pending(bytecode);
+                emit_op(bytecode, OP_JUMP, 0, ast->line);
+                emit_operand(bytecode, (uint32_t)start, ast->line);
+                if (ast == bytecode->planned_loop) {
+                    patch_jump(bytecode, pop_pending(bytecode));
+                    emit_specialized_loop(bytecode, ast, start);
+                    free_loop_plan(&bytecode->plan);
+                    bytecode->planned_loop = NULL;
+                }
+                patch_jump(bytecode, exit);
+                finish_accumulators(bytecode, first_accumulator, ast->line);
+            }
+            break;
+        case AST_FOR:
+            if (ast == bytecode->parallel_loop) {
+                finish_parallel_loop(bytecode, ast);
+                break;
+            }
+            if (ast->data.for_loop.iterable != NULL) {
+                size_t exit = pop_pending(bytecode);
+                size_t slot_operand = pop_pending(bytecode);
+                size_t top = pop_pending(bytecode);
+                int state = (int)pop_pending(bytecode);
+                int first_accumulator = (int)pop_pending(bytecode);
+                Symbol *symbol = lookup_symbol(bytecode->symbol_table, ast->data.for_loop.variable);
+                patch_operand(bytecode, slot_operand,
+                              symbol && symbol->type == SYMBOL_VARIABLE ? global_slot(bytecode, symbol) : 0);
+                emit_line(bytecode, ast->line);
+                emit_op(bytecode, OP_JUMP, 0, ast->line);
+                emit_operand(bytecode, (uint32_t)top, ast->line);
+                patch_jump(bytecode, exit);
+                adjust_stack(bytecode, -state);
+                finish_accumulators(bytecode, first_accumulator, ast->line);
+                break;
+            }
+            {
+                size_t body = pop_pending(bytecode);
+                size_t exit = pop_pending(bytecode);
+                size_t slot_operand = pop_pending(bytecode);
+                int first_accumulator = (int)pop_pending(bytecode);
+                Symbol *symbol = lookup_symbol(bytecode->symbol_table, ast->data.for_loop.variable);
+                uint32_t slot = symbol && symbol->type == SYMBOL_VARIABLE ? global_slot(bytecode, symbol) : 0;
+                patch_operand(bytecode, slot_operand, slot);
+                // Each step of the loop counts as a hit of its first line
+                emit_line(bytecode, ast->line);
+                emit_op(bytecode, OP_FOR_LOOP, -3, ast->line);
+                emit_operand(bytecode, slot, ast->line);
+                emit_operand(bytecode, (uint32_t)body, ast->line);
+                patch_jump(bytecode, exit);
+                finish_accumulators(bytecode, first_accumulator, ast->line);
+            }
+            break;
+        case AST_GENERATOR:
+            end_generator(bytecode, ast);
+            break;
+        case AST_YIELD:
+            emit_op(bytecode, OP_YIELD, -1, ast->line);
+            break;
+        case AST_FUNCTION:
+            end_function(bytecode, ast);
+            break;
+        case AST_RETURN:
+            // One outside a function is reported by the semantic pass
+            if (bytecode->function >= 0) {
+                emit_return(bytecode, ast->line);
+            }
+            break;
+        case AST_PRINT:
+            emit_op(bytecode, OP_PRINT, -1, ast->line);
+            break;
+        case AST_ASSIGN:
+            {
+                Symbol *symbol = lookup_symbol(bytecode->symbol_table, ast->data.assign.name);
+                if (symbol && symbol->type != SYMBOL_VARIABLE) {
+                    symbol = NULL;
+                }
+                if (ast == bytecode->reduction) {
+                    if (symbol) {
+                        emit_global(bytecode, OP_REDUCE, -1, symbol, ast->line);
+                        emit_operand(bytecode, (uint32_t)bytecode->reduction_kind, ast->line);
+                    }
+                    bytecode->reduction = NULL;
+                } else if (symbol && ast->data.assign.value == bytecode->append_value) {
+                    emit_global(bytecode, OP_APPEND_GLOBAL, -1, symbol, ast->line);
+                    bytecode->append_value = NULL;
+                    bytecode->append_variable = NULL;
+                } else if (symbol) {
+                    emit_global(bytecode, OP_SET_GLOBAL, -1, symbol, ast->line);
+                }
+            }
+            break;
+        case AST_BINARY_OP:
+            if (ast->data.binary_op.op == TOKEN_AND || ast->data.binary_op.op == TOKEN_OR) {
+                bytecode->conditional_depth--;
+                patch_jump(bytecode, pop_pending(bytecode));
+            } else if (ast != bytecode->append_value) {
+                emit_op(bytecode, binary_opcode(ast->data.binary_op.op), -1, node_line(bytecode, ast));
+            } else {
+                break;
+            }
+            keep_common(bytecode, ast);
+            break;
+        case AST_UNARY_OP:
+            emit_op(bytecode, ast->data.unary_op.op == TOKEN_NOT ? OP_NOT : OP_NEGATE, 0, node_line(bytecode, ast));
+            keep_common(bytecode, ast);
+            break;
+        case AST_EXPRESSION:
+            emit_op(bytecode, OP_POP, -1, ast->line);
+            break;
+        case AST_LIST:
+            emit_op(bytecode, OP_BUILD_LIST, 1 - ast->data.list.count, ast->line);
+            emit_operand(bytecode, (uint32_t)ast->data.list.count, ast->line);
+            break;
+        case AST_DICT:
+            emit_op(bytecode, OP_BUILD_DICT, 1 - 2 * ast->data.dict.count, ast->line);
+            emit_operand(bytecode, (uint32_t)ast->data.dict.count, ast->line);
+            break;
+        case AST_INDEX:
+            emit_op(bytecode, OP_INDEX, -1, ast->line);
+            break;
+        case AST_STORE_INDEX:
+            emit_op(bytecode, OP_STORE_INDEX, -3, ast->line);
+            break;
+        case AST_CALL:
+            {
+                // Unknown builtins and wrong argument counts are reported
+                // by the semantic pass
+                int builtin = find_builtin(ast->data.call.name);
+                int generator = builtin < 0 ? generator_index(bytecode, ast->data.call.name) : -1;
+                int function = builtin < 0 && generator < 0 ? function_index(bytecode, ast->data.call.name) : -1;
+                if (builtin >= 0) {
+                    emit_op(bytecode, OP_CALL_BUILTIN, 1 - ast->data.call.count, ast->line);
+                    emit_operand(bytecode, (uint32_t)builtin, ast->line);
+                } else if (generator >= 0 && ast == bytecode->frame_call) {
+                    const GeneratorDefinition *definition = &bytecode->chunk->generators[generator];
+                    int size = (int)generator_frame_size(definition->slot_count, definition->max_stack);
+                    emit_op(bytecode, OP_GENERATOR_FRAME, size + 1 - ast->data.call.count, ast->line);
+                    emit_operand(bytecode, (uint32_t)generator, ast->line);
+                } else if (generator >= 0) {
+                    emit_op(bytecode, OP_MAKE_GENERATOR, 1 - ast->data.call.count, ast->line);
+                    emit_operand(bytecode, (uint32_t)generator, ast->line);
+                } else if (function >= 0) {
+                    emit_op(bytecode, OP_CALL, 1 - ast->data.call.count, ast->line);
+                    emit_operand(bytecode, (uint32_t)function, ast->line);
+                }
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+ASTVisitor bytecode_visitor(BytecodeContext *context) {
+    return (ASTVisitor){open_node, separate_children, close_node, context};
+}
+
+void emit_halt(BytecodeContext *context, int line) {
+    emit_op(context, OP_HALT, 0, line);
+}
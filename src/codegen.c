@@ -1,72 +1,251 @@
-//codegen.c
-#include <stdlib.h>
-#include "../include/codegen.h"
-#include "../include/common.h"
-
-// Function to generate code from the AST
-void generate_code(ASTNode *ast, FILE *output) {
-    switch (ast->type) {
-        case AST_PROGRAM:
-            for (int i = 0; i < ast->data.program.count; i++) {
-                generate_code(ast->data.program.statements[i], output);
-            }
-            break;
-        case AST_BLOCK:
-            for (int i = 0; i < ast->data.block.count; i++) {
-                generate_code(ast->data.block.statements[i], output);
-            }
-            break;
-        case AST_IF:
-            fprintf(output, "if (");
-            generate_code(ast->data.if_stmt.condition, output);
-            fprintf(output, ") {\n");
-            generate_code(ast->data.if_stmt.if_body, output);
-            if (ast->data.if_stmt.else_body) {
-                fprintf(output, "} else {\n");
-                generate_code(ast->data.if_stmt.else_body, output);
-            }
-            fprintf(output, "}\n");
-            break;
-        case AST_WHILE:
-            fprintf(output, "while (");
-            generate_code(ast->data.while_loop.condition, output);
-            fprintf(output, ") {\n");
-            generate_code(ast->data.while_loop.body, output);
-            fprintf(output, "}\n");
-            break;
-        case AST_PRINT:
-            fprintf(output, "print(");
-            generate_code(ast->data.print_stmt.expression, output);
-            fprintf(output, ");\n");
-            break;
-        case AST_ASSIGN:
-            fprintf(output, "%s = ", ast->data.assign.name);
-            generate_code(ast->data.assign.value, output);
-            fprintf(output, ";\n");
-            break;
-        case AST_BINARY_OP:
-            generate_code(ast->data.binary_op.left, output);
-            fprintf(output, " %s ", token_type_to_string(ast->data.binary_op.op));
-            generate_code(ast->data.binary_op.right, output);
-            break;
-        case AST_UNARY_OP:
-            fprintf(output, "%s", token_type_to_string(ast->data.unary_op.op));
-            generate_code(ast->data.unary_op.operand, output);
-            break;
-        case AST_VARIABLE:
-            fprintf(output, "%s", ast->data.variable.name);
-            break;
-        case AST_NUMBER:
-            fprintf(output, "%d", ast->data.number);
-            break;
-        case AST_STRING:
-            fprintf(output, "\"%s\"", ast->data.string);
-            break;
-        case AST_BOOLEAN:
-            fprintf(output, "%s", ast->data.boolean ? "true" : "false");
-            break;
-        default:
-            fprintf(stderr, "Error: Unknown AST node type at line %d\n", ast->line);
-            exit(EXIT_FAILURE);
-    }
-}
\ No newline at end of file
+//codegen.c
+#include <math.h>
+#include <stdlib.h>
+#include "../include/codegen.h"
+#include "../include/common.h"
+#include "../include/floating.h"
+
+static const char *operator_symbol(TokenType op) {
+    switch (op) {
+        case TOKEN_PLUS: return "+";
+        case TOKEN_MINUS: return "-";
+        case TOKEN_MULTIPLY: return "*";
+        case TOKEN_DIVIDE: return "/";
+        case TOKEN_PERCENT: return "%";
+        case TOKEN_EQUAL: return "==";
+        case TOKEN_NOT_EQUAL: return "!=";
+        case TOKEN_LESS: return "<";
+        case TOKEN_LESS_EQUAL: return "<=";
+        case TOKEN_GREATER: return ">";
+        case TOKEN_GREATER_EQUAL: return ">=";
+        case TOKEN_AND: return "&&";
+        case TOKEN_OR: return "||";
+        case TOKEN_NOT: return "!";
+        default: return token_type_to_string(op);
+    }
+}
+
+// Operands that are themselves operations are parenthesized, so the output
+// keeps the grouping the parser chose
+static bool is_operation(const ASTNode *node) {
+    return node->type == AST_BINARY_OP || node->type == AST_UNARY_OP;
+}
+
+// Emit everything that comes before a node's first child
+static void open_node(ASTNode *ast, void *context) {
+    Buffer *output = context;
+
+    switch (ast->type) {
+        case AST_IF:
+            buffer_append_str(output, "if (");
+            break;
+        case AST_WHILE:
+            buffer_append_str(output, "while (");
+            break;
+        case AST_FOR:
+            if (ast->data.for_loop.iterable != NULL) {
+                buffer_appendf(output, "for (%s in ", ast->data.for_loop.variable);
+                break;
+            }
+            buffer_appendf(output, "%sfor (%s in range(", ast->data.for_loop.parallel ? "parallel " : "",
+                           ast->data.for_loop.variable);
+            break;
+        case AST_GENERATOR:
+            buffer_appendf(output, "generator %s(", ast->data.generator.name);
+            for (int i = 0; i < ast->data.generator.parameter_count; i++) {
+                buffer_appendf(output, "%s%s", i > 0 ? ", " : "", ast->data.generator.parameters[i]);
+            }
+            buffer_append_str(output, ") {\n");
+            break;
+        case AST_YIELD:
+            buffer_append_str(output, "yield ");
+            break;
+        case AST_FUNCTION:
+            buffer_appendf(output, "function %s(", ast->data.function.name);
+            for (int i = 0; i < ast->data.function.parameter_count; i++) {
+                buffer_appendf(output, "%s%s", i > 0 ? ", " : "", ast->data.function.parameters[i]);
+            }
+            buffer_append_str(output, ") {\n");
+            break;
+        case AST_RETURN:
+            buffer_append_str(output, ast->data.return_stmt.value ? "return " : "return");
+            break;
+        case AST_PRINT:
+            buffer_append_str(output, "print(");
+            break;
+        case AST_ASSIGN:
+            buffer_appendf(output, "%s = ", ast->data.assign.name);
+            break;
+        case AST_IMPORT:
+            buffer_appendf(output, "import(%s);\n", ast->data.import_stmt.module);
+            break;
+        case AST_BINARY_OP:
+            if (is_operation(ast->data.binary_op.left)) {
+                buffer_append_str(output, "(");
+            }
+            break;
+        case AST_UNARY_OP:
+            buffer_append_str(output, operator_symbol(ast->data.unary_op.op));
+            if (is_operation(ast->data.unary_op.operand)) {
+                buffer_append_str(output, "(");
+            }
+            break;
+        case AST_VARIABLE:
+            buffer_append_str(output, ast->data.variable.name);
+            break;
+        case AST_LIST:
+            buffer_append_str(output, "[");
+            break;
+        case AST_DICT:
+            buffer_append_str(output, "{");
+            break;
+        case AST_INDEX:
+            if (is_operation(ast->data.index.object)) {
+                buffer_append_str(output, "(");
+            }
+            break;
+        case AST_CALL:
+            buffer_appendf(output, "%s(", ast->data.call.name);
+            break;
+        case AST_NUMBER:
+            integer_append(output, ast->data.number);
+            break;
+        case AST_FLOAT:
+            // Too large a literal reads back as infinity
+            if (isinf(ast->data.real)) {
+                buffer_append_str(output, "1e999");
+            } else {
+                float_append(output, ast->data.real, DIGITS_ASCII);
+            }
+            break;
+        case AST_STRING:
+            buffer_appendf(output, "\"%s\"", ast->data.string);
+            break;
+        case AST_BOOLEAN:
+            buffer_append_str(output, ast->data.boolean ? "true" : "false");
+            break;
+        case AST_NONE:
+            buffer_append_str(output, "null");
+            break;
+        default:
+            // Programs and blocks only contain statements; unknown node
+            // types are rejected by semantic analysis
+            break;
+    }
+}
+
+// Emit what separates one child from the previous one
+static void separate_children(ASTNode *ast, int index, void *context) {
+    Buffer *output = context;
+
+    switch (ast->type) {
+        case AST_IF:
+            if (index == 1) {
+                buffer_append_str(output, ") {\n");
+            } else if (index == 2) {
+                buffer_append_str(output, "} else {\n");
+            }
+            break;
+        case AST_WHILE:
+            if (index == 1) {
+                buffer_append_str(output, ") {\n");
+            }
+            break;
+        case AST_FOR:
+            if (index == for_body_index(ast)) {
+                buffer_append_str(output, ast->data.for_loop.iterable != NULL ? ") {\n" : ")) {\n");
+            } else if (index > 0) {
+                buffer_append_str(output, ", ");
+            }
+            break;
+        case AST_LIST:
+        case AST_CALL:
+            if (index > 0) {
+                buffer_append_str(output, ", ");
+            }
+            break;
+        case AST_DICT:
+            if (index > 0) {
+                buffer_append_str(output, index % 2 ? ": " : ", ");
+            }
+            break;
+        case AST_INDEX:
+            if (index == 1) {
+                buffer_append_str(output, is_operation(ast->data.index.object) ? ")[" : "[");
+            }
+            break;
+        case AST_STORE_INDEX:
+            if (index == 1) {
+                buffer_append_str(output, "[");
+            } else if (index == 2) {
+                buffer_append_str(output, "] = ");
+            }
+            break;
+        case AST_BINARY_OP:
+            if (index == 1) {
+                buffer_appendf(output, "%s %s %s", is_operation(ast->data.binary_op.left) ? ")" : "",
+                               operator_symbol(ast->data.binary_op.op),
+                               is_operation(ast->data.binary_op.right) ? "(" : "");
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+// Emit everything that follows a node's last child
+static void close_node(ASTNode *ast, void *context) {
+    Buffer *output = context;
+
+    switch (ast->type) {
+        case AST_IF:
+        case AST_WHILE:
+        case AST_FOR:
+        case AST_GENERATOR:
+        case AST_FUNCTION:
+            buffer_append_str(output, "}\n");
+            break;
+        case AST_PRINT:
+            buffer_append_str(output, ");\n");
+            break;
+        case AST_ASSIGN:
+        case AST_STORE_INDEX:
+        case AST_EXPRESSION:
+        case AST_YIELD:
+        case AST_RETURN:
+            buffer_append_str(output, ";\n");
+            break;
+        case AST_LIST:
+        case AST_INDEX:
+            buffer_append_str(output, "]");
+            break;
+        case AST_DICT:
+            buffer_append_str(output, "}");
+            break;
+        case AST_CALL:
+            buffer_append_str(output, ")");
+            break;
+        case AST_BINARY_OP:
+            if (is_operation(ast->data.binary_op.right)) {
+                buffer_append_str(output, ")");
+            }
+            break;
+        case AST_UNARY_OP:
+            if (is_operation(ast->data.unary_op.operand)) {
+                buffer_append_str(output, ")");
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+ASTVisitor codegen_visitor(Buffer *output) {
+    return (ASTVisitor){open_node, separate_children, close_node, output};
+}
+
+// Function to generate code from the AST
+void generate_code(ASTNode *ast, Buffer *output) {
+    ASTVisitor visitor = codegen_visitor(output);
+    walk_ast(ast, &visitor, 1);
+}
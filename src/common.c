@@ -1,98 +1,194 @@
-// common.c
-#include <stdio.h>
-#include <stdbool.h>
-#include <stdlib.h>
-#include <string.h>
-#include "../include/common.h"
-
-// Memory management functions
-void *safe_malloc(size_t size) {
-    void *ptr = malloc(size);
-    if (ptr == NULL) {
-        fprintf(stderr, "Error: Memory allocation failed\n");
-        exit(EXIT_FAILURE);
-    }
-    return ptr;
-}
-
-void *safe_realloc(void *ptr, size_t size) {
-    void *new_ptr = realloc(ptr, size);
-    if (new_ptr == NULL) {
-        fprintf(stderr, "Error: Memory reallocation failed\n");
-        exit(EXIT_FAILURE);
-    }
-    return new_ptr;
-}
-
-char *safe_strdup(const char *str) {
-    if (str == NULL) {
-        return NULL;
-    }
-    size_t len = strlen(str) + 1;
-    char *dup = safe_malloc(len);
-    if (dup == NULL) {
-        fprintf(stderr, "Error: String duplication failed\n");
-        exit(EXIT_FAILURE);
-    }
-    if (dup){
-        memcpy(dup, str, len);
-    }
-    return dup;
-}
-
-// Utility functions for Kannada character handling
-// bool is_kannada_digit(uint32_t ch) {
-//     return (ch >= 0x0CE6 && ch <= 0x0CEF);
-// }
-
-// bool is_kannada_letter(uint32_t ch) {
-//     return ((ch >= 0x0C80 && ch <= 0x0CFF) || (ch >= 0x1CD0 && ch <= 0x1CFA));
-// }
-
-// int kannada_digit_to_int(uint32_t ch) {
-//     if (is_kannada_digit(ch)) {
-//         return ch - 0x0CE6;
-//     }
-//     return -1;  // Invalid Kannada digit
-// }
-
-// UTF-8 handling functions
-size_t utf8_strlen(const char *str) {
-    size_t len = 0;
-    while (*str) {
-        if ((*str & 0xC0) != 0x80) {
-            len++;
-        }
-        str++;
-    }
-    return len;
-}
-
-uint32_t utf8_nextchar(const char **ptr) {
-    const unsigned char *str = (const unsigned char *)*ptr;
-    uint32_t ch = 0;
-    int bytes = 0;
-
-    if (*str < 0x80) {
-        ch = *str++;
-        bytes = 1;
-    } else if (*str < 0xE0) {
-        ch = (*str++ & 0x1F) << 6;
-        ch |= *str++ & 0x3F;
-        bytes = 2;
-    } else if (*str < 0xF0) {
-        ch = (*str++ & 0x0F) << 12;
-        ch |= (*str++ & 0x3F) << 6;
-        ch |= *str++ & 0x3F;
-        bytes = 3;
-    } else {
-        ch = (*str++ & 0x07) << 18;
-        ch |= (*str++ & 0x3F) << 12;
-        ch |= (*str++ & 0x3F) << 6;
-        ch |= *str++ & 0x3F;
-        bytes = 4;
-    }
-
-    *ptr += bytes;
-    return ch;
-}
\ No newline at end of file
+// common.c
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include "../include/common.h"
+
+// Per thread, so concurrent compiles each unwind to their own caller
+static _Thread_local jmp_buf *alloc_failure_jump = NULL;
+
+jmp_buf *set_alloc_failure_jump(jmp_buf *target) {
+    jmp_buf *previous = alloc_failure_jump;
+    alloc_failure_jump = target;
+    return previous;
+}
+
+static void alloc_failed(const char *message) {
+    if (alloc_failure_jump != NULL) {
+        longjmp(*alloc_failure_jump, 1);
+    }
+    fprintf(stderr, "Error: %s\n", message);
+    exit(EXIT_FAILURE);
+}
+
+// Memory management functions
+void *safe_malloc(size_t size) {
+    void *ptr = malloc(size);
+    if (ptr == NULL) {
+        alloc_failed("Memory allocation failed");
+    }
+    return ptr;
+}
+
+void *safe_realloc(void *ptr, size_t size) {
+    void *new_ptr = realloc(ptr, size);
+    if (new_ptr == NULL) {
+        alloc_failed("Memory reallocation failed");
+    }
+    return new_ptr;
+}
+
+char *safe_strdup(const char *str) {
+    if (str == NULL) {
+        return NULL;
+    }
+    size_t len = strlen(str) + 1;
+    char *dup = safe_malloc(len);
+    memcpy(dup, str, len);
+    return dup;
+}
+
+// Diagnostics
+void init_error_list(ErrorList *list) {
+    list->errors = NULL;
+    list->count = 0;
+    list->capacity = 0;
+}
+
+void free_error_list(ErrorList *list) {
+    free(list->errors);
+    init_error_list(list);
+}
+
+void report_error(ErrorList *list, ErrorType type, int line, const char *format, ...) {
+    if (list->count == list->capacity) {
+        list->capacity = list->capacity ? list->capacity * 2 : 8;
+        list->errors = safe_realloc(list->errors, list->capacity * sizeof(Error));
+    }
+    Error *error = &list->errors[list->count++];
+    error->type = type;
+    error->line = line;
+
+    va_list args;
+    va_start(args, format);
+    vsnprintf(error->message, sizeof(error->message), format, args);
+    va_end(args);
+}
+
+const char *error_type_to_string(ErrorType type) {
+    switch (type) {
+        case ERROR_LEXER: return "Lexer";
+        case ERROR_PARSER: return "Parser";
+        case ERROR_SEMANTIC: return "Semantic";
+        case ERROR_CODEGEN: return "Codegen";
+        case ERROR_RUNTIME: return "Runtime";
+        default: return "Unknown";
+    }
+}
+
+void print_errors(const ErrorList *list, FILE *stream) {
+    for (int i = 0; i < list->count; i++) {
+        const Error *error = &list->errors[i];
+        fprintf(stream, "%s error at line %d: %s\n",
+                error_type_to_string(error->type), error->line, error->message);
+    }
+}
+
+uint64_t hash_bytes(const void *data, size_t length) {
+    const unsigned char *bytes = (const unsigned char *)data;
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Utility functions for Kannada character handling
+// bool is_kannada_digit(uint32_t ch) {
+//     return (ch >= 0x0CE6 && ch <= 0x0CEF);
+// }
+
+// bool is_kannada_letter(uint32_t ch) {
+//     return ((ch >= 0x0C80 && ch <= 0x0CFF) || (ch >= 0x1CD0 && ch <= 0x1CFA));
+// }
+
+// int kannada_digit_to_int(uint32_t ch) {
+//     if (is_kannada_digit(ch)) {
+//         return ch - 0x0CE6;
+//     }
+//     return -1;  // Invalid Kannada digit
+// }
+
+// UTF-8 handling functions
+size_t utf8_strlen(const char *str) {
+    size_t len = 0;
+    while (*str) {
+        if ((*str & 0xC0) != 0x80) {
+            len++;
+        }
+        str++;
+    }
+    return len;
+}
+
+// Bytes in the sequence that starts with `lead`
+static int utf8_sequence_length(unsigned char lead) {
+    return lead < 0x80 ? 1 : lead < 0xE0 ? 2 : lead < 0xF0 ? 3 : 4;
+}
+
+// The codepoint of the `bytes`-byte sequence at `str`
+static uint32_t utf8_decode(const unsigned char *str, int bytes) {
+    static const unsigned char lead_bits[5] = {0, 0x7F, 0x1F, 0x0F, 0x07};
+    uint32_t ch = str[0] & lead_bits[bytes];
+    for (int i = 1; i < bytes; i++) {
+        ch = ch << 6 | (str[i] & 0x3F);
+    }
+    return ch;
+}
+
+uint32_t utf8_nextchar(const char **ptr) {
+    const unsigned char *str = (const unsigned char *)*ptr;
+    int bytes = utf8_sequence_length(*str);
+    *ptr += bytes;
+    return utf8_decode(str, bytes);
+}
+
+bool utf8_validate(const char *chars, size_t length, size_t *codepoints) {
+    // The least codepoint a sequence of each length may encode
+    static const uint32_t shortest[5] = {0, 0, 0x80, 0x800, 0x10000};
+    const unsigned char *str = (const unsigned char *)chars;
+    const unsigned char *end = str + length;
+    size_t count = 0;
+    while (str < end) {
+        // Runs of ASCII go a word at a time
+        if (end - str >= 8) {
+            uint64_t word;
+            memcpy(&word, str, 8);
+            if ((word & 0x8080808080808080ULL) == 0) {
+                str += 8;
+                count += 8;
+                continue;
+            }
+        }
+        int bytes = utf8_sequence_length(*str);
+        if ((*str >= 0x80 && *str < 0xC0) || *str > 0xF4 || end - str < bytes) {
+            return false;
+        }
+        for (int i = 1; i < bytes; i++) {
+            if ((str[i] & 0xC0) != 0x80) {
+                return false;
+            }
+        }
+        uint32_t ch = utf8_decode(str, bytes);
+        if (ch < shortest[bytes] || (ch >= 0xD800 && ch <= 0xDFFF) || ch > 0x10FFFF) {
+            return false;
+        }
+        str += bytes;
+        count++;
+    }
+    *codepoints = count;
+    return true;
+}
@@ -1,88 +1,351 @@
-// compiler.c
-#include <stdio.h>
-#include <stdlib.h>
-#include "../include/compiler.h"
-#include "../include/common.h"
-#include "../include/semantic_analyzer.h"
-
-void compile(const char *source_code, FILE *output) {
-    // Initialize the lexer
-    init_lexer(source_code);
-
-    // Tokenize the input
-    Token **tokens = NULL;
-    int token_count = 0;
-    Token *token;
-    do {
-        token = get_next_token();
-        token_count++;
-        tokens = (Token **)safe_realloc(tokens, token_count * sizeof(Token *));
-        tokens[token_count - 1] = token;
-    } while (token->type != TOKEN_EOF);
-
-    // Create a parser
-    Parser *parser = create_parser(tokens, token_count);
-
-    // Parse the source code to generate the AST
-    ASTNode *ast = parse_program(parser);
-
-    // Create a symbol table
-    SymbolTable *symbol_table = create_symbol_table(128);
-
-    // Perform semantic analysis
-    semantic_analysis(ast, symbol_table);
-
-    // Generate code
-    generate_code(ast, output);
-
-    // Free resources
-    free_ast(ast);
-    free_symbol_table(symbol_table);
-    free_parser(parser);
-    for (int i = 0; i < token_count; i++) {
-        free_token(tokens[i]);
-    }
-    free(tokens);
-}
-
-int main(int argc, char *argv[]) {
-    if (argc != 3) {
-        fprintf(stderr, "Usage: %s <source file> <output file>\n", argv[0]);
-        return EXIT_FAILURE;
-    }
-
-    const char *source_file = argv[1];
-    const char *output_file = argv[2];
-
-    // Read the source file
-    FILE *input = fopen(source_file, "r");
-    if (!input) {
-        perror("Error opening source file");
-        return EXIT_FAILURE;
-    }
-    fseek(input, 0, SEEK_END);
-    size_t length = ftell(input);
-    fseek(input, 0, SEEK_SET);
-
-    char *source_code = (char *)safe_malloc(length + 1);
-    fread(source_code, 1, length, input);
-    fclose(input);
-    source_code[length] = '\0';
-
-    // Open the output file
-    FILE *output = fopen(output_file, "w");
-    if (!output) {
-        perror("Error opening output file");
-        free(source_code);
-        return EXIT_FAILURE;
-    }
-
-    // Compile the source code
-    compile(source_code, output);
-
-    // Clean up
-    fclose(output);
-    free(source_code);
-
-    return EXIT_SUCCESS;
-}
\ No newline at end of file
+// compiler.c
+#include <pthread.h>
+#include <setjmp.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "../include/compiler.h"
+#include "../include/common.h"
+#include "../include/semantic_analyzer.h"
+
+// A ಕಾರ್ಯ compiled on its own. Its body is checked against a symbol table
+// of its own, which sees the program's names as they stood at the
+// definition, and its code and errors are kept apart until they are put
+// in their place among the program's.
+typedef struct {
+    ASTNode *function;
+    int visible;            // Symbols the program's table held at the definition
+    size_t output_at;       // Where its code goes in the program's output
+    int errors_at;          // And its errors among the program's
+    Buffer output;
+    ErrorList errors;
+    SymbolTable *symbol_table;
+    bool done;
+} FunctionTask;
+
+typedef struct {
+    FunctionTask *tasks;
+    int count;
+    SymbolTable *symbol_table;  // The program's, which nothing changes meanwhile
+    atomic_int next;            // The next task for a thread to take
+} FunctionCompile;
+
+static void compile_function(const FunctionCompile *compile, FunctionTask *task) {
+    task->symbol_table = create_symbol_table(64);
+    task->symbol_table->outer = compile->symbol_table;
+    task->symbol_table->visible = task->visible;
+    SemanticContext semantic = {task->symbol_table, &task->errors, 0, NULL, NULL, true};
+    ASTVisitor passes[] = {semantic_visitor(&semantic), codegen_visitor(&task->output)};
+    walk_ast(task->function, passes, 2);
+    free_symbol_table(task->symbol_table);
+    task->symbol_table = NULL;
+    task->done = true;
+}
+
+static void *function_worker(void *argument) {
+    FunctionCompile *compile = argument;
+    jmp_buf failure;
+    for (;;) {
+        int index = atomic_fetch_add(&compile->next, 1);
+        if (index >= compile->count) {
+            break;
+        }
+        FunctionTask *task = &compile->tasks[index];
+        if (setjmp(failure) == 0) {
+            set_alloc_failure_jump(&failure);
+            compile_function(compile, task);
+        } else {
+            // Left for the calling thread, where running out of memory
+            // fails the compile as it would have anyway
+            buffer_free(&task->output);
+            buffer_init(&task->output);
+            free_error_list(&task->errors);
+            init_error_list(&task->errors);
+            if (task->symbol_table != NULL) {
+                free_symbol_table(task->symbol_table);
+                task->symbol_table = NULL;
+            }
+        }
+        set_alloc_failure_jump(NULL);
+    }
+    return NULL;
+}
+
+// Compile the functions on up to a thread per core, with at least
+// COMPILE_FUNCTIONS_PER_THREAD for each, then whatever no thread finished
+// on this one
+static void compile_functions(FunctionTask *tasks, int count, SymbolTable *symbol_table) {
+    FunctionCompile compile = {tasks, count, symbol_table, 0};
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads > count / COMPILE_FUNCTIONS_PER_THREAD) {
+        threads = count / COMPILE_FUNCTIONS_PER_THREAD;
+    }
+    if (threads > 1) {
+        pthread_t *workers = safe_malloc(threads * sizeof(pthread_t));
+        int started = 0;
+        while (started < threads && pthread_create(&workers[started], NULL, function_worker, &compile) == 0) {
+            started++;
+        }
+        for (int i = 0; i < started; i++) {
+            pthread_join(workers[i], NULL);
+        }
+        free(workers);
+    }
+    for (int i = 0; i < count; i++) {
+        if (!tasks[i].done) {
+            compile_function(&compile, &tasks[i]);
+        }
+    }
+}
+
+bool compile_ast(ASTNode *ast, SymbolTable *symbol_table, Buffer *output, ErrorList *errors) {
+    // Name checking and emission share one walk over the tree; the output
+    // is only meaningful if no errors were reported
+    int error_count = errors->count;
+    if (ast->type != AST_PROGRAM) {
+        SemanticContext semantic = {symbol_table, errors, 0, NULL, NULL, false};
+        ASTVisitor passes[] = {semantic_visitor(&semantic), codegen_visitor(output)};
+        walk_ast(ast, passes, 2);
+        return errors->count == error_count;
+    }
+
+    // The program's own statements are walked here, leaving each function
+    // a gap that its task fills
+    declare_functions(ast, symbol_table, errors);
+    SemanticContext semantic = {symbol_table, errors, 0, NULL, NULL, true};
+    ASTVisitor passes[] = {semantic_visitor(&semantic), codegen_visitor(output)};
+    size_t start = output->length;
+    int first_error = errors->count;
+    FunctionTask *tasks = NULL;
+    int task_count = 0;
+    for (int i = 0; i < ast->data.program.count; i++) {
+        ASTNode *statement = ast->data.program.statements[i];
+        if (statement->type != AST_FUNCTION) {
+            walk_ast(statement, passes, 2);
+            continue;
+        }
+        tasks = safe_realloc(tasks, (task_count + 1) * sizeof(FunctionTask));
+        FunctionTask *task = &tasks[task_count++];
+        *task = (FunctionTask){statement, symbol_table->symbol_count, output->length, errors->count,
+                               {0}, {0}, NULL, false};
+        buffer_init(&task->output);
+        init_error_list(&task->errors);
+    }
+    if (task_count == 0) {
+        return errors->count == error_count;
+    }
+    compile_functions(tasks, task_count, symbol_table);
+
+    // Put each function's code and errors where a single walk would have
+    Buffer program;
+    buffer_init(&program);
+    buffer_append(&program, output->data + start, output->length - start);
+    ErrorList program_errors;
+    init_error_list(&program_errors);
+    for (int i = first_error; i < errors->count; i++) {
+        const Error *error = &errors->errors[i];
+        report_error(&program_errors, error->type, error->line, "%s", error->message);
+    }
+    output->length = start;
+    errors->count = first_error;
+    size_t copied = start;
+    int errors_copied = first_error;
+    for (int i = 0; i <= task_count; i++) {
+        size_t output_at = i < task_count ? tasks[i].output_at : start + program.length;
+        int errors_at = i < task_count ? tasks[i].errors_at : first_error + program_errors.count;
+        buffer_append(output, program.data + (copied - start), output_at - copied);
+        copied = output_at;
+        for (; errors_copied < errors_at; errors_copied++) {
+            const Error *error = &program_errors.errors[errors_copied - first_error];
+            report_error(errors, error->type, error->line, "%s", error->message);
+        }
+        if (i == task_count) {
+            break;
+        }
+        buffer_append(output, tasks[i].output.data, tasks[i].output.length);
+        for (int j = 0; j < tasks[i].errors.count; j++) {
+            const Error *error = &tasks[i].errors.errors[j];
+            report_error(errors, error->type, error->line, "%s", error->message);
+        }
+        buffer_free(&tasks[i].output);
+        free_error_list(&tasks[i].errors);
+    }
+    buffer_free(&program);
+    free_error_list(&program_errors);
+    free(tasks);
+    return errors->count == error_count;
+}
+
+bool compile_bytecode(ASTNode *ast, SymbolTable *symbol_table, Chunk *chunk, Heap *heap, ErrorList *errors,
+                      int unroll_factor, bool profile) {
+    int error_count = errors->count;
+    BytecodeContext bytecode;
+    init_bytecode_context(&bytecode, chunk, heap, symbol_table, errors);
+    if (unroll_factor > 0) {
+        bytecode.unroll_factor = unroll_factor;
+    }
+    bytecode.profiling = profile;
+    // Functions share the chunk's slots and the heap, so they are compiled
+    // in this same walk
+    declare_functions(ast, symbol_table, errors);
+    SemanticContext semantic = {symbol_table, errors, 0, NULL, NULL, true};
+    // Emission goes first so the semantic post hooks run before its own
+    ASTVisitor passes[] = {bytecode_visitor(&bytecode), semantic_visitor(&semantic)};
+    walk_ast(ast, passes, 2);
+    emit_halt(&bytecode, ast->line);
+    free_bytecode_context(&bytecode);
+    return errors->count == error_count;
+}
+
+ASTNode *parse_source(const char *source_code, size_t length, ErrorList *errors, InternTable *names,
+                      bool share_expressions) {
+    int error_count = errors->count;
+
+    // Initialize the lexer
+    Lexer lexer;
+    init_lexer(&lexer, source_code, length, errors, names);
+
+    // Tokenize the input
+    Token **tokens = NULL;
+    int token_count = 0;
+    int token_capacity = 0;
+    Token *token;
+    do {
+        token = get_next_token(&lexer);
+        if (token_count == token_capacity) {
+            token_capacity = token_capacity ? token_capacity * 2 : 64;
+            tokens = (Token **)safe_realloc(tokens, token_capacity * sizeof(Token *));
+        }
+        tokens[token_count++] = token;
+    } while (token->type != TOKEN_EOF);
+
+    // Create a parser
+    Parser *parser = create_parser(tokens, token_count, errors);
+    if (share_expressions) {
+        parser->expressions = create_expression_table();
+    }
+
+    // Parse the source code to generate the AST
+    ASTNode *ast = parse_program(parser);
+
+    // Lexer errors leave TOKEN_ERROR holes that the parser skips over
+    if (ast != NULL && errors->count > error_count) {
+        free_ast(ast);
+        ast = NULL;
+    }
+
+    // Free resources. The tree keeps the shared nodes it uses.
+    if (parser->expressions) {
+        free_expression_table(parser->expressions);
+    }
+    free_parser(parser);
+    for (int i = 0; i < token_count; i++) {
+        free_token(tokens[i]);
+    }
+    free(tokens);
+
+    return ast;
+}
+
+bool compile_source(const char *source_code, size_t length, Buffer *output, ErrorList *errors,
+                    InternTable *names) {
+    InternTable *own_names = names ? NULL : create_intern_table(256);
+
+    ASTNode *ast = parse_source(source_code, length, errors, names ? names : own_names, false);
+    bool ok = false;
+    if (ast != NULL) {
+        SymbolTable *symbol_table = create_symbol_table(128);
+        ok = compile_ast(ast, symbol_table, output, errors);
+        free_symbol_table(symbol_table);
+        free_ast(ast);
+    }
+
+    if (own_names) {
+        free_intern_table(own_names);
+    }
+    return ok;
+}
+
+// Print the report for a profiled run and write its collapsed stacks to `path`
+static void write_profile(const Profile *profile, const char *source_code, size_t length, const char *path) {
+    print_profile_report(profile, source_code, length, stderr);
+    FILE *stacks = fopen(path, "w");
+    if (!stacks) {
+        perror("Error opening profile output file");
+        return;
+    }
+    write_collapsed_stacks(profile, source_code, length, stacks);
+    fclose(stacks);
+}
+
+bool run_source(const char *source_code, size_t length, FILE *output, ErrorList *errors,
+                const RunOptions *options) {
+    InternTable *names = create_intern_table(256);
+    bool share_expressions = options != NULL && options->eliminate_common;
+    ASTNode *ast = parse_source(source_code, length, errors, names, share_expressions);
+    bool ok = false;
+    if (ast != NULL) {
+        SymbolTable *symbol_table = create_symbol_table(128);
+        Chunk chunk;
+        init_chunk(&chunk);
+        VM vm;
+        init_vm(&vm, output);
+        if (options != NULL) {
+            vm.heap.limit = options->heap_limit;
+            vm.threads = options->threads;
+        }
+
+        int unroll_factor = options ? options->unroll_factor : 0;
+        const char *profile_path = options ? options->profile_path : NULL;
+        if (profile_path != NULL) {
+            vm.profile = create_profile(ast);
+        }
+        ok = compile_bytecode(ast, symbol_table, &chunk, &vm.heap, errors, unroll_factor, vm.profile != NULL);
+        bool ran = ok;
+        if (ok) {
+            bool sampling = vm.profile != NULL && start_profile(vm.profile);
+            ok = run_chunk(&vm, &chunk, errors);
+            if (sampling) {
+                stop_profile(vm.profile);
+            }
+        }
+        output_flush(&vm.output);
+        if (options != NULL && options->gc_stats) {
+            print_gc_stats(&vm.heap, stderr);
+        }
+        if (vm.profile != NULL) {
+            // A program stopped by an error is still worth a profile
+            if (ran) {
+                write_profile(vm.profile, source_code, length, profile_path);
+            }
+            free_profile(vm.profile);
+        }
+
+        free_vm(&vm);
+        free_chunk(&chunk);
+        free_symbol_table(symbol_table);
+        free_ast(ast);
+    }
+    free_intern_table(names);
+    return ok;
+}
+
+bool compile(const char *source_code, FILE *output) {
+    ErrorList errors;
+    init_error_list(&errors);
+    Buffer buffer;
+    buffer_init(&buffer);
+
+    bool ok = compile_source(source_code, strlen(source_code), &buffer, &errors, NULL);
+    if (ok) {
+        fwrite(buffer.data, 1, buffer.length, output);
+    } else {
+        print_errors(&errors, stderr);
+    }
+
+    buffer_free(&buffer);
+    free_error_list(&errors);
+    return ok;
+}
@@ -0,0 +1,379 @@
+//dict.c
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/dict.h"
+#include "../include/list.h"
+#include "../include/runtime_string.h"
+#include "../include/floating.h"
+
+// Control bytes. A full slot holds the low 7 bits of its key's hash, so
+// its top bit is clear; empty and deleted slots both have it set.
+#define CONTROL_EMPTY ((uint8_t)0x80)
+#define CONTROL_DELETED ((uint8_t)0xFE)
+
+// Groups are compared with GCC vector extensions, as in list.c; 16 bytes
+// is one SSE2 or NEON register.
+#define GROUP_WIDTH 16
+typedef uint8_t Group __attribute__((vector_size(GROUP_WIDTH)));
+
+// The index never has fewer slots than a group, so the mirrored bytes
+// after the last slot are always a copy of the first group
+#define MIN_CAPACITY GROUP_WIDTH
+// Entries moved into a growing index per insertion or deletion. Growth
+// leaves the new index at most 7/16 full, so it cannot fill up before
+// every entry has moved.
+#define MIGRATE_STEP 8
+
+static inline Group load_group(const uint8_t *control) {
+    Group group;
+    memcpy(&group, control, sizeof(group));
+    return group;
+}
+
+// Gather the top bit of each byte into a mask, bit i for byte i. The
+// multiplication moves the top bit of byte i to bit 56 + i of each half.
+static inline uint32_t group_mask(Group bytes) {
+    const uint64_t top_bits = 0x8080808080808080ULL;
+    const uint64_t gather = 0x0002040810204081ULL;
+    uint64_t halves[2];
+    memcpy(halves, &bytes, sizeof(halves));
+    return (uint32_t)(((halves[0] & top_bits) * gather) >> 56) |
+           (uint32_t)(((halves[1] & top_bits) * gather) >> 56) << 8;
+}
+
+static inline uint32_t match_byte(Group group, uint8_t control) {
+    Group zero = {0};
+    return group_mask((Group)(group == zero + control));
+}
+
+static inline uint32_t match_free(Group group) {
+    return group_mask(group);
+}
+
+static inline uint64_t mix(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xFF51AFD7ED558CCDULL;
+    x ^= x >> 33;
+    x *= 0xC4CEB9FE1A85EC53ULL;
+    return x ^ (x >> 33);
+}
+
+// Of an integer outside the small range
+static uint64_t hash_integer(Integer integer) {
+    if (integer_is_small(integer)) {
+        return mix((uint64_t)integer.small);
+    }
+    return mix(hash_bytes(integer.big->limbs, integer.big->length * sizeof(uint32_t)) ^
+               (uint64_t)(integer.big->sign < 0));
+}
+
+bool value_hash(Value value, uint64_t *hash) {
+    if (value_is_string(value)) {
+        // Cached in the string, so interned keys are hashed only once
+        *hash = mix(string_hash(value));
+    } else if (value_is_object_type(value, OBJECT_INTEGER)) {
+        *hash = hash_integer(value_to_integer(value));
+    } else if (value_is_float(value)) {
+        // A whole float equals an int, so it must hash as that int does
+        double number = value_as_double(value);
+        if (!isfinite(number) || trunc(number) != number) {
+            uint64_t bits;
+            memcpy(&bits, &number, sizeof(bits));
+            *hash = mix(bits);
+        } else if (number >= -0x1p62 && number < 0x1p62) {
+            *hash = mix(value_from_small_int((int64_t)number));
+        } else {
+            Integer integer = float_to_integer(number);
+            *hash = hash_integer(integer);
+            integer_free(&integer);
+        }
+    } else if (value_is_object(value)) {
+        return false;
+    } else {
+        // Small integers, booleans and None are canonical words
+        *hash = mix(value);
+    }
+    return true;
+}
+
+static bool hash_key(Value key, uint64_t *hash, char *error) {
+    if (!value_hash(key, hash)) {
+        snprintf(error, MAX_ERROR_MESSAGE_LENGTH, "'%s' cannot be a dictionary key", value_type_name(key));
+        return false;
+    }
+    return true;
+}
+
+static size_t index_bytes(size_t capacity) {
+    return capacity ? capacity + GROUP_WIDTH + capacity * sizeof(uint32_t) : 0;
+}
+
+static void index_init(Heap *heap, DictObject *dict, DictIndex *index, size_t capacity) {
+    index->control = safe_malloc(capacity + GROUP_WIDTH);
+    memset(index->control, CONTROL_EMPTY, capacity + GROUP_WIDTH);
+    index->slots = safe_malloc(capacity * sizeof(uint32_t));
+    index->capacity = capacity;
+    index->used = 0;
+    heap_note_external(heap, &dict->object, index_bytes(capacity));
+}
+
+static void index_free(DictIndex *index) {
+    free(index->control);
+    free(index->slots);
+    memset(index, 0, sizeof(*index));
+}
+
+static inline void set_control(DictIndex *index, size_t slot, uint8_t control) {
+    index->control[slot] = control;
+    if (slot < GROUP_WIDTH) {
+        index->control[index->capacity + slot] = control;
+    }
+}
+
+// Probe one group at a time, stepping a group further each time. With a
+// power-of-two capacity this visits every group.
+static size_t index_find(const DictIndex *index, const DictEntry *entries, Value key, uint64_t hash) {
+    if (index->capacity == 0) {
+        return SIZE_MAX;
+    }
+    size_t mask = index->capacity - 1;
+    size_t position = (hash >> 7) & mask;
+    for (size_t step = GROUP_WIDTH;; step += GROUP_WIDTH) {
+        Group group = load_group(index->control + position);
+        for (uint32_t matches = match_byte(group, hash & 0x7F); matches != 0; matches &= matches - 1) {
+            size_t slot = (position + (size_t)__builtin_ctz(matches)) & mask;
+            const DictEntry *entry = &entries[index->slots[slot]];
+            if (entry->key == key || (entry->hash == hash && value_equal(entry->key, key))) {
+                return slot;
+            }
+        }
+        if (match_byte(group, CONTROL_EMPTY) != 0) {
+            return SIZE_MAX;
+        }
+        position = (position + step) & mask;
+    }
+}
+
+// Add an entry known not to be in the index
+static void index_insert(DictIndex *index, uint64_t hash, size_t entry) {
+    size_t mask = index->capacity - 1;
+    size_t position = (hash >> 7) & mask;
+    for (size_t step = GROUP_WIDTH;; step += GROUP_WIDTH) {
+        uint32_t free_slots = match_free(load_group(index->control + position));
+        if (free_slots != 0) {
+            size_t slot = (position + (size_t)__builtin_ctz(free_slots)) & mask;
+            if (index->control[slot] == CONTROL_EMPTY) {
+                index->used++;
+            }
+            set_control(index, slot, hash & 0x7F);
+            index->slots[slot] = (uint32_t)entry;
+            return;
+        }
+        position = (position + step) & mask;
+    }
+}
+
+// Keep at least one slot in eight empty so every probe ends
+static bool index_full(const DictIndex *index) {
+    return (index->used + 1) * 8 > index->capacity * 7;
+}
+
+// The smallest capacity that leaves `count` entries at most 7/16 full
+static size_t capacity_for(size_t count) {
+    size_t capacity = MIN_CAPACITY;
+    while (capacity * 7 < count * 16) {
+        capacity *= 2;
+    }
+    return capacity;
+}
+
+// Find `key` in the new index, then in the old one while it is still in
+// use. Returns the slot and sets `index` to the index holding it, or
+// returns SIZE_MAX.
+static size_t lookup(DictObject *dict, Value key, uint64_t hash, DictIndex **index) {
+    *index = &dict->index;
+    size_t slot = index_find(&dict->index, dict->entries, key, hash);
+    if (slot == SIZE_MAX && dict->old_index.capacity > 0) {
+        *index = &dict->old_index;
+        slot = index_find(&dict->old_index, dict->entries, key, hash);
+    }
+    return slot;
+}
+
+// Move up to `limit` entries into the new index, freeing the old index
+// once all have moved
+static void migrate(DictObject *dict, size_t limit) {
+    while (limit > 0 && dict->migrated < dict->migrate_end) {
+        const DictEntry *entry = &dict->entries[dict->migrated];
+        if (entry->key != VALUE_UNDEFINED) {
+            index_insert(&dict->index, entry->hash, dict->migrated);
+        }
+        dict->migrated++;
+        limit--;
+    }
+    if (dict->migrated == dict->migrate_end && dict->old_index.capacity > 0) {
+        index_free(&dict->old_index);
+    }
+}
+
+// Squeeze out deleted entries and rebuild the index at once. Positions
+// change, so the old index cannot serve lookups meanwhile; this only runs
+// after at least as many deletions as there are live entries.
+static void compact(Heap *heap, DictObject *dict) {
+    size_t live = 0;
+    for (size_t i = 0; i < dict->entry_count; i++) {
+        if (dict->entries[i].key != VALUE_UNDEFINED) {
+            dict->entries[live++] = dict->entries[i];
+        }
+    }
+    dict->entry_count = live;
+    dict->migrated = dict->migrate_end = 0;
+    index_free(&dict->index);
+    index_init(heap, dict, &dict->index, capacity_for(live + 1));
+    for (size_t i = 0; i < live; i++) {
+        index_insert(&dict->index, dict->entries[i].hash, i);
+    }
+}
+
+// Start moving to an index with room for twice the live entries
+static void grow(Heap *heap, DictObject *dict) {
+    // A previous growth is nearly finished by the time this one is due
+    migrate(dict, SIZE_MAX);
+    if (dict->entry_count - dict->count > dict->count) {
+        compact(heap, dict);
+        return;
+    }
+    index_free(&dict->old_index);
+    dict->old_index = dict->index;
+    index_init(heap, dict, &dict->index, capacity_for(dict->count + 1));
+    dict->migrated = 0;
+    dict->migrate_end = dict->entry_count;
+    migrate(dict, MIGRATE_STEP);
+}
+
+static void reserve_entries(Heap *heap, DictObject *dict) {
+    if (dict->entry_count < dict->entry_capacity) {
+        return;
+    }
+    size_t capacity = dict->entry_capacity ? dict->entry_capacity * 2 : 8;
+    dict->entries = safe_realloc(dict->entries, capacity * sizeof(DictEntry));
+    heap_note_external(heap, &dict->object, (capacity - dict->entry_capacity) * sizeof(DictEntry));
+    dict->entry_capacity = capacity;
+}
+
+DictObject *dict_create(Heap *heap) {
+    DictObject *dict = (DictObject *)allocate_object(heap, OBJECT_DICT, sizeof(DictObject));
+    dict->entries = NULL;
+    dict->entry_count = 0;
+    dict->entry_capacity = 0;
+    dict->count = 0;
+    memset(&dict->index, 0, sizeof(dict->index));
+    memset(&dict->old_index, 0, sizeof(dict->old_index));
+    dict->migrated = 0;
+    dict->migrate_end = 0;
+    return dict;
+}
+
+bool dict_from_entries(Heap *heap, const Value *entries, size_t count, Value *result, char *error) {
+    DictObject *dict = dict_create(heap);
+    for (size_t i = 0; i < count; i++) {
+        if (!dict_set(heap, dict, entries[i * 2], entries[i * 2 + 1], error)) {
+            return false;
+        }
+    }
+    *result = (Value)(uintptr_t)dict;
+    return true;
+}
+
+bool dict_get(const DictObject *dict, Value key, Value *value, bool *found, char *error) {
+    uint64_t hash;
+    if (!hash_key(key, &hash, error)) {
+        return false;
+    }
+    DictIndex *index;
+    size_t slot = lookup((DictObject *)dict, key, hash, &index);
+    *found = slot != SIZE_MAX;
+    if (*found) {
+        *value = dict->entries[index->slots[slot]].value;
+    }
+    return true;
+}
+
+bool dict_set(Heap *heap, DictObject *dict, Value key, Value value, char *error) {
+    uint64_t hash;
+    if (!hash_key(key, &hash, error)) {
+        return false;
+    }
+    DictIndex *index;
+    size_t slot = lookup(dict, key, hash, &index);
+    if (slot != SIZE_MAX) {
+        dict->entries[index->slots[slot]].value = value;
+        heap_write_barrier(heap, &dict->object, value);
+        return true;
+    }
+
+    if (index_full(&dict->index)) {
+        grow(heap, dict);
+    } else {
+        migrate(dict, MIGRATE_STEP);
+    }
+    reserve_entries(heap, dict);
+    dict->entries[dict->entry_count] = (DictEntry){key, value, hash};
+    index_insert(&dict->index, hash, dict->entry_count);
+    dict->entry_count++;
+    dict->count++;
+    heap_write_barrier(heap, &dict->object, key);
+    heap_write_barrier(heap, &dict->object, value);
+    return true;
+}
+
+bool dict_delete(DictObject *dict, Value key, bool *found, char *error) {
+    uint64_t hash;
+    if (!hash_key(key, &hash, error)) {
+        return false;
+    }
+    DictIndex *index;
+    size_t slot = lookup(dict, key, hash, &index);
+    *found = slot != SIZE_MAX;
+    if (*found) {
+        DictEntry *entry = &dict->entries[index->slots[slot]];
+        entry->key = VALUE_UNDEFINED;
+        entry->value = VALUE_NONE;
+        set_control(index, slot, CONTROL_DELETED);
+        dict->count--;
+        migrate(dict, MIGRATE_STEP);
+    }
+    return true;
+}
+
+static Value collect(Heap *heap, const DictObject *dict, bool keys) {
+    ListObject *list = list_create(heap, dict->count);
+    for (size_t i = 0; i < dict->entry_count; i++) {
+        const DictEntry *entry = &dict->entries[i];
+        if (entry->key != VALUE_UNDEFINED) {
+            list_append(heap, list, keys ? entry->key : entry->value);
+        }
+    }
+    return (Value)(uintptr_t)list;
+}
+
+Value dict_keys(Heap *heap, const DictObject *dict) {
+    return collect(heap, dict, true);
+}
+
+Value dict_values(Heap *heap, const DictObject *dict) {
+    return collect(heap, dict, false);
+}
+
+size_t dict_external_size(const DictObject *dict) {
+    return dict->entry_capacity * sizeof(DictEntry) + index_bytes(dict->index.capacity) +
+           index_bytes(dict->old_index.capacity);
+}
+
+void release_dict(DictObject *dict) {
+    free(dict->entries);
+    index_free(&dict->index);
+    index_free(&dict->old_index);
+}
@@ -0,0 +1,402 @@
+//expression_table.c
+#include <stdlib.h>
+#include <string.h>
+#include "../include/expression_table.h"
+#include "../include/common.h"
+
+#define INITIAL_BUCKETS 256
+
+// How far is_immutable_expression looks into nested `+`, `ಮತ್ತು` and `ಅಥವಾ`
+// before giving up and calling the value possibly mutable
+#define IMMUTABLE_DEPTH 32
+
+ExpressionTable *create_expression_table(void) {
+    ExpressionTable *table = safe_malloc(sizeof(ExpressionTable));
+    table->size = INITIAL_BUCKETS;
+    table->buckets = safe_malloc(table->size * sizeof(ExpressionEntry *));
+    table->version_size = INITIAL_BUCKETS;
+    table->versions = safe_malloc(table->version_size * sizeof(VersionEntry *));
+    for (size_t i = 0; i < INITIAL_BUCKETS; i++) {
+        table->buckets[i] = NULL;
+        table->versions[i] = NULL;
+    }
+    table->count = 0;
+    table->clock = 0;
+    table->barrier = 0;
+    return table;
+}
+
+void free_expression_table(ExpressionTable *table) {
+    for (size_t i = 0; i < table->size; i++) {
+        ExpressionEntry *entry = table->buckets[i];
+        while (entry) {
+            ExpressionEntry *next = entry->next;
+            release_ast_node(entry->node);
+            free(entry);
+            entry = next;
+        }
+    }
+    for (size_t i = 0; i < table->version_size; i++) {
+        VersionEntry *entry = table->versions[i];
+        while (entry) {
+            VersionEntry *next = entry->next;
+            free(entry);
+            entry = next;
+        }
+    }
+    free(table->buckets);
+    free(table->versions);
+    free(table);
+}
+
+static size_t name_bucket(const ExpressionTable *table, const char *name) {
+    return (size_t)(((uintptr_t)name >> 3) % table->version_size);
+}
+
+static int current_version(const ExpressionTable *table, const char *name) {
+    for (VersionEntry *entry = table->versions[name_bucket(table, name)]; entry; entry = entry->next) {
+        if (entry->name == name) {
+            return entry->version > table->barrier ? entry->version : table->barrier;
+        }
+    }
+    return table->barrier;
+}
+
+void expression_assigned(ExpressionTable *table, const char *name) {
+    size_t bucket = name_bucket(table, name);
+    VersionEntry *entry = table->versions[bucket];
+    while (entry && entry->name != name) {
+        entry = entry->next;
+    }
+    if (entry == NULL) {
+        entry = safe_malloc(sizeof(VersionEntry));
+        entry->name = name;
+        entry->next = table->versions[bucket];
+        table->versions[bucket] = entry;
+    }
+    entry->version = ++table->clock;
+}
+
+void expression_barrier(ExpressionTable *table) {
+    table->barrier = ++table->clock;
+}
+
+// Nodes in the table have a reference from it as well as from the tree;
+// nodes outside it are still only in the tree while the parser builds it
+static bool is_shared(const ASTNode *node) {
+    return node->references > 1;
+}
+
+static bool is_shareable(const ASTNode *node) {
+    switch (node->type) {
+        case AST_NUMBER:
+        case AST_FLOAT:
+        case AST_STRING:
+        case AST_BOOLEAN:
+        case AST_NONE:
+        case AST_VARIABLE:
+            return true;
+        case AST_UNARY_OP:
+            return is_shared(node->data.unary_op.operand);
+        case AST_BINARY_OP:
+            return is_shared(node->data.binary_op.left) && is_shared(node->data.binary_op.right);
+        default:
+            return false;
+    }
+}
+
+static uint64_t expression_hash(const ASTNode *node, int version) {
+    uint64_t parts[4] = {(uint64_t)node->type, 0, 0, 0};
+    switch (node->type) {
+        case AST_NUMBER:
+            if (node->data.number.big) {
+                const BigInt *big = node->data.number.big;
+                parts[1] = (uint64_t)big->sign;
+                parts[2] = hash_bytes(big->limbs, big->length * sizeof(uint32_t));
+            } else {
+                parts[2] = (uint64_t)node->data.number.small;
+            }
+            break;
+        case AST_FLOAT:
+            memcpy(&parts[2], &node->data.real, sizeof(double));
+            break;
+        case AST_STRING:
+            parts[2] = hash_bytes(node->data.string, strlen(node->data.string));
+            break;
+        case AST_BOOLEAN:
+            parts[1] = node->data.boolean;
+            break;
+        case AST_VARIABLE:
+            parts[1] = (uint64_t)version;
+            parts[2] = (uint64_t)(uintptr_t)node->data.variable.name;
+            break;
+        case AST_UNARY_OP:
+            parts[1] = (uint64_t)node->data.unary_op.op;
+            parts[2] = (uint64_t)(uintptr_t)node->data.unary_op.operand;
+            break;
+        case AST_BINARY_OP:
+            parts[1] = (uint64_t)node->data.binary_op.op;
+            parts[2] = (uint64_t)(uintptr_t)node->data.binary_op.left;
+            parts[3] = (uint64_t)(uintptr_t)node->data.binary_op.right;
+            break;
+        default:
+            break;
+    }
+    return hash_bytes(parts, sizeof(parts));
+}
+
+static bool same_expression(const ExpressionEntry *entry, const ASTNode *node, int version) {
+    const ASTNode *other = entry->node;
+    if (other->type != node->type) {
+        return false;
+    }
+    switch (node->type) {
+        case AST_NUMBER:
+            return integer_compare(other->data.number, node->data.number) == 0;
+        case AST_FLOAT:
+            // By bits, so 0.0 and -0.0 stay apart
+            return memcmp(&other->data.real, &node->data.real, sizeof(double)) == 0;
+        case AST_STRING:
+            return strcmp(other->data.string, node->data.string) == 0;
+        case AST_BOOLEAN:
+            return other->data.boolean == node->data.boolean;
+        case AST_VARIABLE:
+            return other->data.variable.name == node->data.variable.name && entry->version == version;
+        case AST_UNARY_OP:
+            return other->data.unary_op.op == node->data.unary_op.op &&
+                   other->data.unary_op.operand == node->data.unary_op.operand;
+        case AST_BINARY_OP:
+            return other->data.binary_op.op == node->data.binary_op.op &&
+                   other->data.binary_op.left == node->data.binary_op.left &&
+                   other->data.binary_op.right == node->data.binary_op.right;
+        default:
+            return true;
+    }
+}
+
+// Double the bucket count once the average chain gets longer than one entry
+static void grow_expression_table(ExpressionTable *table) {
+    size_t size = table->size * 2;
+    ExpressionEntry **buckets = safe_malloc(size * sizeof(ExpressionEntry *));
+    for (size_t i = 0; i < size; i++) {
+        buckets[i] = NULL;
+    }
+    for (size_t i = 0; i < table->size; i++) {
+        ExpressionEntry *entry = table->buckets[i];
+        while (entry) {
+            ExpressionEntry *next = entry->next;
+            size_t index = entry->hash % size;
+            entry->next = buckets[index];
+            buckets[index] = entry;
+            entry = next;
+        }
+    }
+    free(table->buckets);
+    table->buckets = buckets;
+    table->size = size;
+}
+
+ASTNode *share_expression(ExpressionTable *table, ASTNode *node) {
+    if (!is_shareable(node)) {
+        return node;
+    }
+    int version = node->type == AST_VARIABLE ? current_version(table, node->data.variable.name) : 0;
+    uint64_t hash = expression_hash(node, version);
+
+    for (ExpressionEntry *entry = table->buckets[hash % table->size]; entry; entry = entry->next) {
+        if (entry->hash == hash && same_expression(entry, node, version)) {
+            // The children already count this occurrence; only the shell goes
+            entry->node->references++;
+            release_ast_node(node);
+            return entry->node;
+        }
+    }
+
+    if (table->count >= table->size) {
+        grow_expression_table(table);
+    }
+    ExpressionEntry *entry = safe_malloc(sizeof(ExpressionEntry));
+    entry->hash = hash;
+    entry->version = version;
+    entry->node = node;
+    size_t index = hash % table->size;
+    entry->next = table->buckets[index];
+    table->buckets[index] = entry;
+    table->count++;
+    node->references++;
+    return node;
+}
+
+static bool is_immutable_within(const ASTNode *node, int depth) {
+    switch (node->type) {
+        case AST_NUMBER:
+        case AST_FLOAT:
+        case AST_STRING:
+        case AST_BOOLEAN:
+        case AST_NONE:
+        case AST_UNARY_OP:
+            return true;
+        case AST_BINARY_OP:
+            {
+                TokenType op = node->data.binary_op.op;
+                if (op != TOKEN_PLUS && op != TOKEN_AND && op != TOKEN_OR) {
+                    return true;
+                }
+                if (depth == 0) {
+                    return false;
+                }
+                bool left = is_immutable_within(node->data.binary_op.left, depth - 1);
+                if (op == TOKEN_PLUS && left) {
+                    // Adding anything else to a list is an error
+                    return true;
+                }
+                bool right = is_immutable_within(node->data.binary_op.right, depth - 1);
+                return op == TOKEN_PLUS ? right : left && right;
+            }
+        default:
+            return false;
+    }
+}
+
+bool is_immutable_expression(const ASTNode *node) {
+    return is_immutable_within(node, IMMUTABLE_DEPTH);
+}
+
+static bool is_candidate(const ASTNode *node) {
+    return (node->type == AST_BINARY_OP || node->type == AST_UNARY_OP) && node->references > 1 &&
+           is_immutable_expression(node);
+}
+
+typedef struct {
+    const ASTNode **items;
+    int count;
+    int capacity;
+} NodeStack;
+
+static void push_node(NodeStack *stack, const ASTNode *node) {
+    if (node == NULL) {
+        return;
+    }
+    if (stack->count == stack->capacity) {
+        stack->capacity = stack->capacity ? stack->capacity * 2 : 32;
+        stack->items = safe_realloc(stack->items, stack->capacity * sizeof(ASTNode *));
+    }
+    stack->items[stack->count++] = node;
+}
+
+static void push_nodes(NodeStack *stack, ASTNode **nodes, int count) {
+    for (int i = 0; i < count; i++) {
+        push_node(stack, nodes[i]);
+    }
+}
+
+// The parts of a statement that run once, in line, whenever it does
+static void push_straight_line(NodeStack *stack, const ASTNode *statement) {
+    switch (statement->type) {
+        case AST_ASSIGN:
+            push_node(stack, statement->data.assign.value);
+            break;
+        case AST_PRINT:
+            push_node(stack, statement->data.print_stmt.expression);
+            break;
+        case AST_EXPRESSION:
+            push_node(stack, statement->data.expression_stmt.expression);
+            break;
+        case AST_STORE_INDEX:
+            push_node(stack, statement->data.store_index.object);
+            push_node(stack, statement->data.store_index.index);
+            push_node(stack, statement->data.store_index.value);
+            break;
+        case AST_IF:
+            push_node(stack, statement->data.if_stmt.condition);
+            break;
+        case AST_YIELD:
+            push_node(stack, statement->data.yield_stmt.value);
+            break;
+        case AST_RETURN:
+            push_node(stack, statement->data.return_stmt.value);
+            break;
+        case AST_FOR:
+            push_node(stack, statement->data.for_loop.iterable);
+            push_node(stack, statement->data.for_loop.start);
+            push_node(stack, statement->data.for_loop.stop);
+            push_node(stack, statement->data.for_loop.step);
+            break;
+        default:
+            break;
+    }
+}
+
+const ASTNode **find_repeated_expressions(const ASTNode *block, int *count) {
+    NodeStack pending = {NULL, 0, 0};
+    NodeStack seen = {NULL, 0, 0};
+    int *occurrences = NULL;
+
+    ASTNode **statements = block->type == AST_PROGRAM ? block->data.program.statements
+                                                      : block->data.block.statements;
+    int statement_count = block->type == AST_PROGRAM ? block->data.program.count : block->data.block.count;
+    for (int i = 0; i < statement_count; i++) {
+        push_straight_line(&pending, statements[i]);
+        while (pending.count > 0) {
+            const ASTNode *node = pending.items[--pending.count];
+            if (is_candidate(node)) {
+                int index = 0;
+                while (index < seen.count && seen.items[index] != node) {
+                    index++;
+                }
+                if (index < seen.count) {
+                    occurrences[index]++;
+                    continue;
+                }
+                int capacity = seen.capacity;
+                push_node(&seen, node);
+                if (seen.capacity != capacity) {
+                    occurrences = safe_realloc(occurrences, seen.capacity * sizeof(int));
+                }
+                occurrences[index] = 1;
+            }
+            switch (node->type) {
+                case AST_BINARY_OP:
+                    // The right side of and/or may not run
+                    if (node->data.binary_op.op != TOKEN_AND && node->data.binary_op.op != TOKEN_OR) {
+                        push_node(&pending, node->data.binary_op.right);
+                    }
+                    push_node(&pending, node->data.binary_op.left);
+                    break;
+                case AST_UNARY_OP:
+                    push_node(&pending, node->data.unary_op.operand);
+                    break;
+                case AST_LIST:
+                    push_nodes(&pending, node->data.list.elements, node->data.list.count);
+                    break;
+                case AST_DICT:
+                    push_nodes(&pending, node->data.dict.entries, node->data.dict.count * 2);
+                    break;
+                case AST_CALL:
+                    push_nodes(&pending, node->data.call.arguments, node->data.call.count);
+                    break;
+                case AST_INDEX:
+                    push_node(&pending, node->data.index.object);
+                    push_node(&pending, node->data.index.index);
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+
+    int repeated = 0;
+    for (int i = 0; i < seen.count; i++) {
+        if (occurrences[i] > 1) {
+            seen.items[repeated++] = seen.items[i];
+        }
+    }
+    free(pending.items);
+    free(occurrences);
+    *count = repeated;
+    if (repeated == 0) {
+        free(seen.items);
+        return NULL;
+    }
+    return seen.items;
+}
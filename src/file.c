@@ -0,0 +1,208 @@
+//file.c
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "../include/file.h"
+#include "../include/runtime_string.h"
+
+typedef struct {
+    int fd;             // -1 if the file was mapped
+    char *mapping;      // NULL unless mapped
+    size_t size;        // Of a regular file; 0 if unknown
+} OpenFile;
+
+static FileData *create_data(Heap *heap, char *bytes, size_t length, size_t capacity, bool mapped) {
+    FileData *data = (FileData *)allocate_object(heap, OBJECT_FILE_DATA, sizeof(FileData));
+    data->data = bytes;
+    data->length = length;
+    data->capacity = capacity;
+    data->mapped = mapped;
+    // A mapping is the page cache's to manage, so only buffers count
+    if (!mapped) {
+        heap_note_external(heap, &data->object, capacity);
+    }
+    return data;
+}
+
+void release_file_data(FileData *data) {
+    if (data->mapped) {
+        munmap(data->data, data->capacity);
+    } else {
+        free(data->data);
+    }
+}
+
+void release_line_reader(LineReader *reader) {
+    if (reader->fd >= 0) {
+        close(reader->fd);
+        reader->fd = -1;
+    }
+}
+
+static bool open_file(Value path, OpenFile *file, char *error) {
+    char scratch[SHORT_STRING_MAX + 1];
+    const char *chars = string_chars(path, scratch);
+    size_t length = string_byte_length(path);
+    if (memchr(chars, '\0', length) != NULL) {
+        snprintf(error, MAX_ERROR_MESSAGE_LENGTH, "A file name cannot contain a NUL byte");
+        return false;
+    }
+    char *name = safe_malloc(length + 1);
+    memcpy(name, chars, length);
+    name[length] = '\0';
+    file->fd = open(name, O_RDONLY | O_CLOEXEC);
+    if (file->fd < 0) {
+        snprintf(error, MAX_ERROR_MESSAGE_LENGTH, "Cannot open '%.256s': %s", name, strerror(errno));
+        free(name);
+        return false;
+    }
+    free(name);
+
+    file->mapping = NULL;
+    file->size = 0;
+    struct stat info;
+    if (fstat(file->fd, &info) == 0 && S_ISREG(info.st_mode)) {
+        file->size = (size_t)info.st_size;
+    }
+    if (file->size >= FILE_MAP_MIN) {
+        void *mapping = mmap(NULL, file->size, PROT_READ, MAP_PRIVATE, file->fd, 0);
+        // Otherwise it is read like a pipe
+        if (mapping != MAP_FAILED) {
+            // Read front to back, so the kernel can read ahead and drop what is behind
+            posix_madvise(mapping, file->size, POSIX_MADV_SEQUENTIAL);
+            file->mapping = mapping;
+            close(file->fd);
+            file->fd = -1;
+        }
+    }
+    return true;
+}
+
+// Room for the whole of a small regular file, with a byte to spare for
+// the read that finds its end
+static size_t first_capacity(const OpenFile *file) {
+    return file->size > 0 && file->size < FILE_BLOCK_SIZE ? file->size + 1 : FILE_BLOCK_SIZE;
+}
+
+// Read what the next read() gives into the room left in `data`, setting
+// `end` if the file has no more
+static bool read_more(int fd, FileData *data, bool *end, char *error) {
+    ssize_t count;
+    do {
+        count = read(fd, data->data + data->length, data->capacity - data->length);
+    } while (count < 0 && errno == EINTR);
+    if (count < 0) {
+        snprintf(error, MAX_ERROR_MESSAGE_LENGTH, "Cannot read the file: %s", strerror(errno));
+        return false;
+    }
+    data->length += (size_t)count;
+    *end = count == 0;
+    return true;
+}
+
+bool file_read(Heap *heap, Value path, Value *result, char *error) {
+    OpenFile file;
+    if (!open_file(path, &file, error)) {
+        return false;
+    }
+    FileData *data;
+    if (file.mapping != NULL) {
+        data = create_data(heap, file.mapping, file.size, file.size, true);
+    } else {
+        size_t capacity = first_capacity(&file);
+        data = create_data(heap, safe_malloc(capacity), 0, capacity, false);
+        bool end = false;
+        while (!end) {
+            if (data->length == data->capacity) {
+                heap_note_external(heap, &data->object, data->capacity);
+                data->capacity *= 2;
+                data->data = safe_realloc(data->data, data->capacity);
+            }
+            if (!read_more(file.fd, data, &end, error)) {
+                close(file.fd);
+                return false;
+            }
+        }
+        close(file.fd);
+    }
+    *result = string_slice(heap, (Value)(uintptr_t)data, data->data, data->length);
+    return true;
+}
+
+bool file_lines(Heap *heap, Value path, Value *result, char *error) {
+    OpenFile file;
+    if (!open_file(path, &file, error)) {
+        return false;
+    }
+    FileData *data;
+    if (file.mapping != NULL) {
+        data = create_data(heap, file.mapping, file.size, file.size, true);
+    } else {
+        size_t capacity = first_capacity(&file);
+        data = create_data(heap, safe_malloc(capacity), 0, capacity, false);
+    }
+    LineReader *reader = (LineReader *)allocate_object(heap, OBJECT_LINE_READER, sizeof(LineReader));
+    reader->fd = file.fd;
+    reader->data = (Value)(uintptr_t)data;
+    reader->position = 0;
+    reader->scanned = 0;
+    *result = (Value)(uintptr_t)reader;
+    return true;
+}
+
+// Read more of the file after the bytes `reader` has yet to use. Once its
+// block is full they move to a new one; lines already taken keep the old.
+static bool fill(Heap *heap, LineReader *reader, char *error) {
+    FileData *data = (FileData *)value_as_object(reader->data);
+    if (data->length == data->capacity) {
+        size_t carry = data->length - reader->position;
+        size_t capacity = carry < FILE_BLOCK_SIZE / 2 ? FILE_BLOCK_SIZE : carry * 2;
+        FileData *next = create_data(heap, safe_malloc(capacity), carry, capacity, false);
+        memcpy(next->data, data->data + reader->position, carry);
+        reader->data = (Value)(uintptr_t)next;
+        heap_write_barrier(heap, &reader->object, reader->data);
+        reader->position = 0;
+        data = next;
+    }
+    bool end;
+    if (!read_more(reader->fd, data, &end, error)) {
+        return false;
+    }
+    if (end) {
+        close(reader->fd);
+        reader->fd = -1;
+    }
+    return true;
+}
+
+bool line_reader_next(Heap *heap, LineReader *reader, Value *line, char *error) {
+    for (;;) {
+        FileData *data = (FileData *)value_as_object(reader->data);
+        const char *start = data->data + reader->position;
+        size_t available = data->length - reader->position;
+        const char *newline = memchr(start + reader->scanned, '\n', available - reader->scanned);
+        // The last line need not end in a newline
+        if (newline != NULL || (reader->fd < 0 && available > 0)) {
+            size_t length = newline != NULL ? (size_t)(newline - start) : available;
+            reader->position += length + (newline != NULL);
+            reader->scanned = 0;
+            if (length > 0 && start[length - 1] == '\r') {
+                length--;
+            }
+            *line = string_slice(heap, reader->data, start, length);
+            return true;
+        }
+        if (reader->fd < 0) {
+            *line = VALUE_NONE;
+            return true;
+        }
+        reader->scanned = available;
+        if (!fill(heap, reader, error)) {
+            return false;
+        }
+    }
+}
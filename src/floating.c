@@ -0,0 +1,616 @@
+//floating.c
+#include <math.h>
+#include <pthread.h>
+#include <string.h>
+#include "../include/floating.h"
+
+typedef unsigned __int128 uint128_t;
+
+#define MANTISSA_BITS 52
+#define EXPONENT_BIAS 1023
+#define EXPONENT_INFINITE 0x7FF
+
+// Up to 19 digits fit in a uint64_t
+#define FAST_DIGITS_MAX 19
+// A number between two doubles is closer to one of them than any of the
+// halfway points' 767 significant digits can tell apart, so digits past
+// this many only matter in being nonzero
+#define EXACT_DIGITS_MAX 800
+
+// Eisel-Lemire's powers of five, 5^q for q in this range, in the top 128
+// bits. Past them, 19 digits are sure to round to zero or infinity.
+#define LEMIRE_MIN_EXPONENT (-342)
+#define LEMIRE_MAX_EXPONENT 308
+// Ryu's powers of five and their inverses, in 125 bits
+#define RYU_POW5_COUNT 326
+#define RYU_POW5_INV_COUNT 342
+#define RYU_POW5_BITS 125
+
+static uint64_t lemire_powers[LEMIRE_MAX_EXPONENT - LEMIRE_MIN_EXPONENT + 1][2];   // High word first
+static uint64_t ryu_pow5[RYU_POW5_COUNT][2];                                       // Low word first
+static uint64_t ryu_pow5_inv[RYU_POW5_INV_COUNT][2];
+static pthread_once_t tables_once = PTHREAD_ONCE_INIT;
+
+// Every power of ten a double holds exactly
+static const double exact_powers[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+// The top `width` bits of `value`, truncated, or `value` shifted up to
+// fill them
+static void top_bits(Integer value, size_t width, uint64_t *low, uint64_t *high) {
+    size_t length = integer_bit_length(value);
+    Integer scaled = length < width ? integer_shift_left(value, width - length) : integer_copy(value);
+    size_t start = length > width ? length - width : 0;
+    bool below;
+    *low = integer_bits(scaled, start, &below);
+    *high = integer_bits(scaled, start + 64, &below);
+    integer_free(&scaled);
+}
+
+// floor(2^bits / divisor) + 1, a reciprocal that errs high
+static Integer reciprocal(size_t bits, Integer divisor) {
+    Integer power = integer_shift_left(integer_from_int64(1), bits);
+    Integer quotient;
+    integer_floordiv(power, divisor, &quotient);
+    Integer result = integer_add(quotient, integer_from_int64(1));
+    integer_free(&power);
+    integer_free(&quotient);
+    return result;
+}
+
+static void build_tables(void) {
+    Integer power = integer_from_int64(1);
+    for (int i = 0; i <= -LEMIRE_MIN_EXPONENT; i++) {
+        // power is 5^i
+        size_t length = integer_bit_length(power);
+        if (i <= LEMIRE_MAX_EXPONENT) {
+            uint64_t *entry = lemire_powers[i - LEMIRE_MIN_EXPONENT];
+            top_bits(power, 128, &entry[1], &entry[0]);
+        }
+        if (i > 0) {
+            // Once 5^i outgrows 64 bits the reciprocal is worked out to
+            // more bits than are kept
+            size_t bits = i <= 27 ? length + 127 : 2 * length + 128;
+            Integer inverse = reciprocal(bits, power);
+            uint64_t *entry = lemire_powers[-i - LEMIRE_MIN_EXPONENT];
+            top_bits(inverse, 128, &entry[1], &entry[0]);
+            integer_free(&inverse);
+        }
+        if (i < RYU_POW5_COUNT) {
+            top_bits(power, RYU_POW5_BITS, &ryu_pow5[i][0], &ryu_pow5[i][1]);
+        }
+        if (i < RYU_POW5_INV_COUNT) {
+            Integer inverse = reciprocal(length - 1 + RYU_POW5_BITS, power);
+            bool below;
+            ryu_pow5_inv[i][0] = integer_bits(inverse, 0, &below);
+            ryu_pow5_inv[i][1] = integer_bits(inverse, 64, &below);
+            integer_free(&inverse);
+        }
+        Integer next = integer_mul(power, integer_from_int64(5));
+        integer_free(&power);
+        power = next;
+    }
+    integer_free(&power);
+}
+
+static double from_bits(uint64_t bits) {
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// The double nearest to (`top` + f) * 2^`exponent`, where the high bit of
+// `top` is set and the fraction f, below one, is nonzero if `sticky`
+static double round_bits(uint64_t top, bool sticky, int64_t exponent) {
+    int64_t leading = exponent + 63;
+    if (leading > EXPONENT_BIAS) {
+        return HUGE_VAL;
+    }
+    // A double keeps 53 bits, and fewer below the normal range
+    int64_t dropped = 64 - (MANTISSA_BITS + 1);
+    if (leading < 1 - EXPONENT_BIAS) {
+        dropped += 1 - EXPONENT_BIAS - leading;
+    }
+    if (dropped > 64) {
+        return 0.0;
+    }
+    uint64_t kept = dropped == 64 ? 0 : top >> dropped;
+    uint64_t rest = dropped == 64 ? top : top & (((uint64_t)1 << dropped) - 1);
+    uint64_t half = (uint64_t)1 << (dropped - 1);
+    if (rest > half || (rest == half && (sticky || (kept & 1)))) {
+        kept++;
+    }
+    // Exact: `kept` has at most 53 bits, on the grid of the result's binade
+    return ldexp((double)kept, (int)(exponent + dropped));
+}
+
+double float_from_integer(Integer value) {
+    if (integer_is_small(value)) {
+        return (double)value.small;
+    }
+    size_t length = integer_bit_length(value);
+    bool below;
+    uint64_t top = integer_bits(value, length - 64, &below);
+    double magnitude = round_bits(top, below, (int64_t)length - 64);
+    return value.big->sign < 0 ? -magnitude : magnitude;
+}
+
+Integer float_to_integer(double value) {
+    if (value > -0x1p63 && value < 0x1p63) {
+        return integer_from_int64((int64_t)value);
+    }
+    int exponent;
+    double fraction = frexp(value, &exponent);
+    Integer mantissa = integer_from_int64((int64_t)ldexp(fraction, MANTISSA_BITS + 1));
+    return integer_shift_left(mantissa, (size_t)(exponent - (MANTISSA_BITS + 1)));
+}
+
+int float_compare_integer(double a, Integer b) {
+    if (isinf(a)) {
+        return a > 0 ? 1 : -1;
+    }
+    // Rounding keeps order, so a difference after it is a difference before
+    double rounded = float_from_integer(b);
+    if (a != rounded) {
+        return a < rounded ? -1 : 1;
+    }
+    // Either `b` converted exactly, or `a` is large enough to be whole
+    Integer whole = float_to_integer(a);
+    int order = integer_compare(whole, b);
+    integer_free(&whole);
+    return order;
+}
+
+// base^exponent by repeated squaring
+static Integer power_of(int64_t base, int64_t exponent) {
+    Integer result = integer_from_int64(1);
+    Integer square = integer_from_int64(base);
+    while (exponent > 0) {
+        if (exponent & 1) {
+            Integer product = integer_mul(result, square);
+            integer_free(&result);
+            result = product;
+        }
+        exponent >>= 1;
+        if (exponent > 0) {
+            Integer next = integer_mul(square, square);
+            integer_free(&square);
+            square = next;
+        }
+    }
+    integer_free(&square);
+    return result;
+}
+
+// Correctly rounded with exact arithmetic, for the cases the fast paths
+// cannot settle
+static double exact_decimal(const char *digits, size_t length, int64_t exponent) {
+    Integer value = integer_from_decimal(digits, length);
+    double result;
+    if (exponent >= 0) {
+        Integer scale = power_of(10, exponent);
+        Integer scaled = integer_mul(value, scale);
+        result = float_from_integer(scaled);
+        integer_free(&scale);
+        integer_free(&scaled);
+        integer_free(&value);
+        return result;
+    }
+
+    // value / 10^k is value / 5^k * 2^-k. Scale the division by 5^k to give
+    // a quotient of exactly 64 bits; its remainder is the sticky fraction.
+    Integer divisor = power_of(5, -exponent);
+    int64_t shift = 63 + (int64_t)integer_bit_length(divisor) - (int64_t)integer_bit_length(value);
+    for (;;) {
+        Integer numerator = shift > 0 ? integer_shift_left(value, (size_t)shift) : integer_copy(value);
+        Integer denominator = shift < 0 ? integer_shift_left(divisor, (size_t)-shift) : integer_copy(divisor);
+        Integer quotient;
+        Integer remainder;
+        integer_divmod(numerator, denominator, &quotient, &remainder);
+        size_t quotient_length = integer_bit_length(quotient);
+        bool sticky = integer_bit_length(remainder) > 0;
+        bool below;
+        uint64_t top = integer_bits(quotient, 0, &below);
+        integer_free(&numerator);
+        integer_free(&denominator);
+        integer_free(&quotient);
+        integer_free(&remainder);
+        if (quotient_length == 64) {
+            result = round_bits(top, sticky, exponent - shift);
+            break;
+        }
+        shift += quotient_length < 64 ? 1 : -1;
+    }
+    integer_free(&divisor);
+    integer_free(&value);
+    return result;
+}
+
+// Clinger: with both operands exact, one rounding gives the answer
+static bool clinger(uint64_t w, int64_t q, double *result) {
+    if (w > (uint64_t)1 << (MANTISSA_BITS + 1) || q < -22 || q > 22) {
+        return false;
+    }
+    *result = q < 0 ? (double)w / exact_powers[-q] : (double)w * exact_powers[q];
+    return true;
+}
+
+// Eisel-Lemire: w * 10^q as w * 5^q * 2^q, with 5^q truncated to 128 bits.
+// Returns false in the rare cases where the truncation leaves the rounding
+// in doubt. `w` is nonzero.
+static bool lemire(uint64_t w, int64_t q, double *result) {
+    if (q < LEMIRE_MIN_EXPONENT) {
+        *result = 0.0;
+        return true;
+    }
+    if (q > LEMIRE_MAX_EXPONENT) {
+        *result = HUGE_VAL;
+        return true;
+    }
+    pthread_once(&tables_once, build_tables);
+    int zeros = __builtin_clzll(w);
+    w <<= zeros;
+    const uint64_t *power = lemire_powers[q - LEMIRE_MIN_EXPONENT];
+    uint128_t product = (uint128_t)w * power[0];
+    uint64_t high = (uint64_t)(product >> 64);
+    uint64_t low = (uint64_t)product;
+    // 55 bits are needed; if the rest of the high word is all ones, the
+    // power's second word could carry into them
+    const uint64_t precision_mask = UINT64_MAX >> (MANTISSA_BITS + 3);
+    if ((high & precision_mask) == precision_mask) {
+        uint64_t carry = (uint64_t)(((uint128_t)w * power[1]) >> 64);
+        low += carry;
+        high += carry > low;
+    }
+    if (low == UINT64_MAX && (q < -27 || q > 55)) {
+        return false;
+    }
+
+    int upper = (int)(high >> 63);
+    int shift = upper + 64 - MANTISSA_BITS - 3;
+    uint64_t mantissa = high >> shift;
+    // floor(log2(10^q)) + 63, shifted to the biased exponent
+    int64_t power2 = (((152170 + 65536) * q) >> 16) + 63 + upper - zeros + EXPONENT_BIAS;
+    if (power2 <= 0) {
+        // Subnormal; no halfway case needs settling this far down
+        if (-power2 + 1 >= 64) {
+            *result = 0.0;
+            return true;
+        }
+        mantissa >>= -power2 + 1;
+        mantissa += mantissa & 1;
+        mantissa >>= 1;
+        power2 = mantissa < (uint64_t)1 << MANTISSA_BITS ? 0 : 1;
+        *result = from_bits(mantissa | (uint64_t)power2 << MANTISSA_BITS);
+        return true;
+    }
+    // Exactly halfway: only possible for small q, and then rounds to even
+    if (low <= 1 && q >= -4 && q <= 23 && (mantissa & 3) == 1 && (mantissa << shift) == high) {
+        mantissa &= ~(uint64_t)1;
+    }
+    mantissa += mantissa & 1;
+    mantissa >>= 1;
+    if (mantissa >= (uint64_t)2 << MANTISSA_BITS) {
+        mantissa = (uint64_t)1 << MANTISSA_BITS;
+        power2++;
+    }
+    mantissa &= ~((uint64_t)1 << MANTISSA_BITS);
+    if (power2 >= EXPONENT_INFINITE) {
+        *result = HUGE_VAL;
+        return true;
+    }
+    *result = from_bits(mantissa | (uint64_t)power2 << MANTISSA_BITS);
+    return true;
+}
+
+static uint64_t parse_digits(const char *digits, size_t length) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < length; i++) {
+        value = value * 10 + (uint64_t)(digits[i] - '0');
+    }
+    return value;
+}
+
+double float_from_decimal(const char *digits, size_t length, int64_t exponent) {
+    while (length > 0 && digits[0] == '0') {
+        digits++;
+        length--;
+    }
+    while (length > 0 && digits[length - 1] == '0') {
+        length--;
+        exponent++;
+    }
+    if (length == 0) {
+        return 0.0;
+    }
+    // The number is below 10^(length + exponent), and at least a tenth of it
+    if (exponent + (int64_t)length > 309) {
+        return HUGE_VAL;
+    }
+    if (exponent + (int64_t)length < -323) {
+        return 0.0;
+    }
+
+    double result;
+    if (length <= FAST_DIGITS_MAX) {
+        uint64_t w = parse_digits(digits, length);
+        if (clinger(w, exponent, &result) || lemire(w, exponent, &result)) {
+            return result;
+        }
+    } else {
+        // The number lies between w and w + 1 units of its 19th digit; if
+        // both round the same way, so does it
+        uint64_t w = parse_digits(digits, FAST_DIGITS_MAX);
+        int64_t q = exponent + (int64_t)(length - FAST_DIGITS_MAX);
+        double above;
+        if (lemire(w, q, &result) && lemire(w + 1, q, &above) && result == above) {
+            return result;
+        }
+    }
+    if (length <= EXACT_DIGITS_MAX) {
+        return exact_decimal(digits, length, exponent);
+    }
+    // The last digit is nonzero, so a 1 in place of the rest keeps the
+    // number on the same side of every halfway point
+    char kept[EXACT_DIGITS_MAX + 1];
+    memcpy(kept, digits, EXACT_DIGITS_MAX);
+    kept[EXACT_DIGITS_MAX] = '1';
+    return exact_decimal(kept, EXACT_DIGITS_MAX + 1, exponent + (int64_t)(length - EXACT_DIGITS_MAX - 1));
+}
+
+// Ryu's helpers, from its d2s.c
+
+static uint32_t pow5_bits(int32_t e) {
+    return (uint32_t)(((e * 1217359) >> 19) + 1);
+}
+
+static uint32_t log10_pow2(int32_t e) {
+    return (uint32_t)((e * 78913) >> 18);
+}
+
+static uint32_t log10_pow5(int32_t e) {
+    return (uint32_t)((e * 732923) >> 20);
+}
+
+static bool multiple_of_pow5(uint64_t value, uint32_t p) {
+    uint32_t count = 0;
+    while (value % 5 == 0) {
+        value /= 5;
+        count++;
+    }
+    return count >= p;
+}
+
+static bool multiple_of_pow2(uint64_t value, uint32_t p) {
+    return (value & (((uint64_t)1 << p) - 1)) == 0;
+}
+
+static uint64_t mul_shift(uint64_t m, const uint64_t *multiplier, int32_t j) {
+    uint128_t low = (uint128_t)m * multiplier[0];
+    uint128_t high = (uint128_t)m * multiplier[1];
+    return (uint64_t)(((low >> 64) + high) >> (j - 64));
+}
+
+typedef struct {
+    uint64_t digits;
+    int32_t exponent;
+} Decimal;
+
+// The shortest decimal that reads back as the positive finite double with
+// these fields, and the closest such if there are several
+static Decimal shortest(uint64_t ieee_mantissa, uint32_t ieee_exponent) {
+    int32_t e2;
+    uint64_t m2;
+    if (ieee_exponent == 0) {
+        e2 = 1 - EXPONENT_BIAS - MANTISSA_BITS - 2;
+        m2 = ieee_mantissa;
+    } else {
+        e2 = (int32_t)ieee_exponent - EXPONENT_BIAS - MANTISSA_BITS - 2;
+        m2 = ((uint64_t)1 << MANTISSA_BITS) | ieee_mantissa;
+    }
+    bool accept_bounds = (m2 & 1) == 0;
+
+    // The interval of decimals that read back as the double, [mm, mp]
+    // around mv, all four times the mantissa
+    uint64_t mv = 4 * m2;
+    uint32_t mm_shift = ieee_mantissa != 0 || ieee_exponent <= 1;
+
+    uint64_t vr, vp, vm;
+    int32_t e10;
+    bool vm_trailing_zeros = false;
+    bool vr_trailing_zeros = false;
+    if (e2 >= 0) {
+        uint32_t q = log10_pow2(e2) - (e2 > 3);
+        e10 = (int32_t)q;
+        int32_t k = RYU_POW5_BITS + (int32_t)pow5_bits((int32_t)q) - 1;
+        int32_t i = -e2 + (int32_t)q + k;
+        vr = mul_shift(4 * m2, ryu_pow5_inv[q], i);
+        vp = mul_shift(4 * m2 + 2, ryu_pow5_inv[q], i);
+        vm = mul_shift(4 * m2 - 1 - mm_shift, ryu_pow5_inv[q], i);
+        if (q <= 21) {
+            // At most one of mv, mp and mm is a multiple of 5
+            if (mv % 5 == 0) {
+                vr_trailing_zeros = multiple_of_pow5(mv, q);
+            } else if (accept_bounds) {
+                vm_trailing_zeros = multiple_of_pow5(mv - 1 - mm_shift, q);
+            } else {
+                vp -= multiple_of_pow5(mv + 2, q);
+            }
+        }
+    } else {
+        uint32_t q = log10_pow5(-e2) - (-e2 > 1);
+        e10 = (int32_t)q + e2;
+        int32_t i = -e2 - (int32_t)q;
+        int32_t k = (int32_t)pow5_bits(i) - RYU_POW5_BITS;
+        int32_t j = (int32_t)q - k;
+        vr = mul_shift(4 * m2, ryu_pow5[i], j);
+        vp = mul_shift(4 * m2 + 2, ryu_pow5[i], j);
+        vm = mul_shift(4 * m2 - 1 - mm_shift, ryu_pow5[i], j);
+        if (q <= 1) {
+            // mv has at least two trailing zero bits, mp at least one
+            vr_trailing_zeros = true;
+            if (accept_bounds) {
+                vm_trailing_zeros = mm_shift == 1;
+            } else {
+                vp--;
+            }
+        } else if (q < 63) {
+            vr_trailing_zeros = multiple_of_pow2(mv, q);
+        }
+    }
+
+    // Drop digits while the interval still holds a shorter decimal
+    int32_t removed = 0;
+    uint8_t last_removed = 0;
+    uint64_t output;
+    if (vm_trailing_zeros || vr_trailing_zeros) {
+        // Rare: the bounds or the value itself end in zeros
+        while (vp / 10 > vm / 10) {
+            vm_trailing_zeros &= vm % 10 == 0;
+            vr_trailing_zeros &= last_removed == 0;
+            last_removed = (uint8_t)(vr % 10);
+            vr /= 10;
+            vp /= 10;
+            vm /= 10;
+            removed++;
+        }
+        if (vm_trailing_zeros) {
+            while (vm % 10 == 0) {
+                vr_trailing_zeros &= last_removed == 0;
+                last_removed = (uint8_t)(vr % 10);
+                vr /= 10;
+                vp /= 10;
+                vm /= 10;
+                removed++;
+            }
+        }
+        // Exactly ...50...0 rounds to even
+        if (vr_trailing_zeros && last_removed == 5 && vr % 2 == 0) {
+            last_removed = 4;
+        }
+        output = vr + ((vr == vm && (!accept_bounds || !vm_trailing_zeros)) || last_removed >= 5);
+    } else {
+        bool round_up = false;
+        if (vp / 100 > vm / 100) {
+            round_up = vr % 100 >= 50;
+            vr /= 100;
+            vp /= 100;
+            vm /= 100;
+            removed += 2;
+        }
+        while (vp / 10 > vm / 10) {
+            round_up = vr % 10 >= 5;
+            vr /= 10;
+            vp /= 10;
+            vm /= 10;
+            removed++;
+        }
+        output = vr + (vr == vm || round_up);
+    }
+    return (Decimal){output, e10 + removed};
+}
+
+// Write `digits` as `length` ASCII digits ending before `end`
+static void write_digits(char *end, uint64_t digits, int length) {
+    for (int i = 0; i < length; i++) {
+        *--end = (char)('0' + digits % 10);
+        digits /= 10;
+    }
+}
+
+// Room for the longest layout: "-0.0000" and 17 digits, or 17 digits,
+// a point and "e-324"
+#define FLOAT_TEXT_MAX 48
+
+static void append_styled(Buffer *buffer, const char *text, size_t length, DigitStyle style) {
+    if (style == DIGITS_ASCII) {
+        buffer_append(buffer, text, length);
+        return;
+    }
+    char styled[3 * FLOAT_TEXT_MAX];
+    size_t styled_length = 0;
+    for (size_t i = 0; i < length; i++) {
+        if (text[i] >= '0' && text[i] <= '9') {
+            // U+0CE6 to U+0CEF
+            styled[styled_length++] = '\xE0';
+            styled[styled_length++] = '\xB3';
+            styled[styled_length++] = (char)(0xA6 + (text[i] - '0'));
+        } else {
+            styled[styled_length++] = text[i];
+        }
+    }
+    buffer_append(buffer, styled, styled_length);
+}
+
+void float_append(Buffer *buffer, double value, DigitStyle style) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint64_t ieee_mantissa = bits & (((uint64_t)1 << MANTISSA_BITS) - 1);
+    uint32_t ieee_exponent = (uint32_t)(bits >> MANTISSA_BITS) & EXPONENT_INFINITE;
+    if (ieee_exponent == EXPONENT_INFINITE && ieee_mantissa != 0) {
+        buffer_append_str(buffer, style == DIGITS_KANNADA ? "ಸಂಖ್ಯೆಯಲ್ಲ" : "nan");
+        return;
+    }
+    if (bits >> 63) {
+        buffer_append(buffer, "-", 1);
+    }
+    if (ieee_exponent == EXPONENT_INFINITE) {
+        buffer_append_str(buffer, style == DIGITS_KANNADA ? "ಅನಂತ" : "inf");
+        return;
+    }
+    if (ieee_exponent == 0 && ieee_mantissa == 0) {
+        append_styled(buffer, "0.0", 3, style);
+        return;
+    }
+
+    pthread_once(&tables_once, build_tables);
+    Decimal decimal = shortest(ieee_mantissa, ieee_exponent);
+    int count = 1;
+    for (uint64_t rest = decimal.digits; rest >= 10; rest /= 10) {
+        count++;
+    }
+    // Digits before the point; repr() switches to an exponent outside 1e-4 to 1e16
+    int point = count + decimal.exponent;
+    char text[FLOAT_TEXT_MAX];
+    size_t length = 0;
+    if (point - 1 < -4 || point - 1 >= 16) {
+        char digits[20];
+        write_digits(digits + count, decimal.digits, count);
+        text[length++] = digits[0];
+        if (count > 1) {
+            text[length++] = '.';
+            memcpy(text + length, digits + 1, (size_t)count - 1);
+            length += (size_t)count - 1;
+        }
+        int exponent = point - 1;
+        text[length++] = 'e';
+        text[length++] = exponent < 0 ? '-' : '+';
+        int magnitude = exponent < 0 ? -exponent : exponent;
+        int width = magnitude >= 100 ? 3 : 2;
+        write_digits(text + length + width, (uint64_t)magnitude, width);
+        length += (size_t)width;
+    } else if (point <= 0) {
+        memcpy(text, "0.", 2);
+        length = 2;
+        memset(text + length, '0', (size_t)-point);
+        length += (size_t)-point;
+        write_digits(text + length + count, decimal.digits, count);
+        length += (size_t)count;
+    } else if (point < count) {
+        // Room for the point, then move the whole part in front of it
+        write_digits(text + count + 1, decimal.digits, count);
+        memmove(text, text + 1, (size_t)point);
+        text[point] = '.';
+        length = (size_t)count + 1;
+    } else {
+        write_digits(text + count, decimal.digits, count);
+        length = (size_t)count;
+        memset(text + length, '0', (size_t)(point - count));
+        length += (size_t)(point - count);
+        memcpy(text + length, ".0", 2);
+        length += 2;
+    }
+    append_styled(buffer, text, length, style);
+}
@@ -0,0 +1,22 @@
+//generator.c
+#include "../include/generator.h"
+
+void generator_frame_init(Value *frame, uint32_t size, int definition, size_t entry,
+                          int parameter_count, int slot_count) {
+    frame[FRAME_RESUME] = value_from_small_int((int64_t)entry);
+    frame[FRAME_DEPTH] = value_from_small_int(0);
+    frame[FRAME_DEFINITION] = value_from_small_int(definition);
+    for (int i = parameter_count; i < slot_count; i++) {
+        frame[FRAME_HEADER + i] = VALUE_UNDEFINED;
+    }
+    for (uint32_t i = FRAME_HEADER + (uint32_t)slot_count; i < size; i++) {
+        frame[i] = VALUE_NONE;
+    }
+}
+
+GeneratorObject *generator_create(Heap *heap, uint32_t size) {
+    GeneratorObject *generator = (GeneratorObject *)allocate_object(heap, OBJECT_GENERATOR,
+                                                                    sizeof(GeneratorObject) + size * sizeof(Value));
+    generator->size = size;
+    return generator;
+}
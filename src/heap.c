@@ -0,0 +1,427 @@
+//heap.c
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../include/heap.h"
+#include "../include/value.h"
+#include "../include/runtime_string.h"
+#include "../include/list.h"
+#include "../include/dict.h"
+#include "../include/generator.h"
+#include "../include/file.h"
+
+static uint64_t now_ns(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64_t)time.tv_sec * 1000000000u + (uint64_t)time.tv_nsec;
+}
+
+void init_heap(Heap *heap) {
+    memset(heap, 0, sizeof(*heap));
+    heap->nursery = safe_malloc(NURSERY_SIZE);
+    heap->nursery_top = heap->nursery;
+    heap->nursery_end = heap->nursery + NURSERY_SIZE;
+    heap->major_threshold = MIN_MAJOR_THRESHOLD;
+    heap->stats.start_ns = now_ns();
+}
+
+// Free whatever an object owns besides its own memory
+static void release_object(Object *object) {
+    switch (object->type) {
+        case OBJECT_INTEGER:
+            integer_free(&((IntegerObject *)object)->value);
+            break;
+        case OBJECT_STRING:
+            release_string_object((StringObject *)object);
+            break;
+        case OBJECT_BUILDER:
+            release_builder((StringBuilder *)object);
+            break;
+        case OBJECT_LIST:
+            release_list((ListObject *)object);
+            break;
+        case OBJECT_DICT:
+            release_dict((DictObject *)object);
+            break;
+        case OBJECT_FILE_DATA:
+            release_file_data((FileData *)object);
+            break;
+        case OBJECT_LINE_READER:
+            release_line_reader((LineReader *)object);
+            break;
+        case OBJECT_FLOAT:
+        case OBJECT_GENERATOR:
+        case OBJECT_FORWARDED:
+            break;
+    }
+}
+
+// Bytes of the buffers an object owns outside the heap
+static size_t external_size(const Object *object) {
+    switch (object->type) {
+        case OBJECT_STRING:
+            {
+                const StringObject *string = (const StringObject *)object;
+                bool owned = string->chars != NULL && string->chars != string->storage && !string_is_slice(string);
+                return owned ? string->length + 1 : 0;
+            }
+        case OBJECT_FILE_DATA:
+            {
+                const FileData *data = (const FileData *)object;
+                return data->mapped ? 0 : data->capacity;
+            }
+        case OBJECT_BUILDER:
+            return ((const StringBuilder *)object)->capacity;
+        case OBJECT_LIST:
+            return ((const ListObject *)object)->capacity * sizeof(Value);
+        case OBJECT_DICT:
+            return dict_external_size((const DictObject *)object);
+        default:
+            return 0;
+    }
+}
+
+static void free_object_list(Object *object) {
+    while (object) {
+        Object *next = object->next;
+        release_object(object);
+        free(object);
+        object = next;
+    }
+}
+
+// Release every nursery object that was not promoted
+static void sweep_nursery(Heap *heap) {
+    char *p = heap->nursery;
+    while (p < heap->nursery_top) {
+        Object *object = (Object *)p;
+        release_object(object);
+        p += object->size;
+    }
+    heap->nursery_top = heap->nursery;
+}
+
+void free_heap(Heap *heap) {
+    sweep_nursery(heap);
+    free(heap->nursery);
+    free_object_list(heap->old_objects);
+    free_object_list(heap->recent_objects);
+    free(heap->remembered);
+    free_string_table(heap);
+    memset(heap, 0, sizeof(*heap));
+}
+
+static Object *allocate_old(Heap *heap, size_t size) {
+    Object *object = safe_malloc(size);
+    object->next = heap->recent_objects;
+    heap->recent_objects = object;
+    heap->old_bytes += size;
+    if (heap->old_bytes > heap->major_threshold) {
+        heap->collect_requested = true;
+    }
+    return object;
+}
+
+Object *allocate_object(Heap *heap, ObjectType type, size_t size) {
+    // Keep every object 8-byte aligned so its address can be tagged
+    size = (size + 7) & ~(size_t)7;
+    Object *object;
+    if (size <= LARGE_OBJECT_SIZE && (size_t)(heap->nursery_end - heap->nursery_top) >= size) {
+        object = (Object *)heap->nursery_top;
+        heap->nursery_top += size;
+    } else {
+        if (size <= LARGE_OBJECT_SIZE) {
+            heap->collect_requested = true;
+        }
+        object = allocate_old(heap, size);
+    }
+    object->size = size;
+    object->type = type;
+    object->marked = false;
+    object->remembered = false;
+    object->owner = heap->tag;
+    heap->stats.bytes_allocated += size;
+    return object;
+}
+
+Object *allocate_old_object(Heap *heap, ObjectType type, size_t size) {
+    size = (size + 7) & ~(size_t)7;
+    Object *object = allocate_old(heap, size);
+    object->size = size;
+    object->type = type;
+    object->marked = false;
+    object->remembered = false;
+    object->owner = heap->tag;
+    heap->stats.bytes_allocated += size;
+    return object;
+}
+
+void heap_note_external(Heap *heap, const Object *owner, size_t bytes) {
+    heap->stats.bytes_allocated += bytes;
+    if (heap_in_nursery(heap, owner)) {
+        heap->young_external_bytes += bytes;
+        if (heap->young_external_bytes > NURSERY_SIZE) {
+            heap->collect_requested = true;
+        }
+    } else {
+        heap->old_bytes += bytes;
+        if (heap->old_bytes > heap->major_threshold) {
+            heap->collect_requested = true;
+        }
+    }
+}
+
+void heap_remember(Heap *heap, Object *object) {
+    if (heap->remembered_count == heap->remembered_capacity) {
+        heap->remembered_capacity = heap->remembered_capacity ? heap->remembered_capacity * 2 : 64;
+        heap->remembered = safe_realloc(heap->remembered, heap->remembered_capacity * sizeof(Object *));
+    }
+    object->remembered = true;
+    heap->remembered[heap->remembered_count++] = object;
+}
+
+// Objects whose fields still need visiting
+typedef struct {
+    Object **objects;
+    size_t count;
+    size_t capacity;
+} Worklist;
+
+static void push_work(Worklist *list, Object *object) {
+    if (list->count == list->capacity) {
+        list->capacity = list->capacity ? list->capacity * 2 : 256;
+        list->objects = safe_realloc(list->objects, list->capacity * sizeof(Object *));
+    }
+    list->objects[list->count++] = object;
+}
+
+typedef void (*SlotVisitor)(Heap *heap, Value *slot, Worklist *work);
+
+// Apply `visit` to every field of `object` that may hold a reference
+static void visit_fields(Heap *heap, Object *object, SlotVisitor visit, Worklist *work) {
+    if (object->type == OBJECT_STRING) {
+        StringObject *string = (StringObject *)object;
+        visit(heap, &string->left, work);
+        visit(heap, &string->right, work);
+    } else if (object->type == OBJECT_LIST && !((ListObject *)object)->unboxed) {
+        ListObject *list = (ListObject *)object;
+        for (size_t i = 0; i < list->count; i++) {
+            visit(heap, &list->items.values[i], work);
+        }
+    } else if (object->type == OBJECT_DICT) {
+        DictObject *dict = (DictObject *)object;
+        for (size_t i = 0; i < dict->entry_count; i++) {
+            visit(heap, &dict->entries[i].key, work);
+            visit(heap, &dict->entries[i].value, work);
+        }
+    } else if (object->type == OBJECT_GENERATOR) {
+        GeneratorObject *generator = (GeneratorObject *)object;
+        for (uint32_t i = 0; i < generator->size; i++) {
+            visit(heap, &generator->frame[i], work);
+        }
+    } else if (object->type == OBJECT_LINE_READER) {
+        visit(heap, &((LineReader *)object)->data, work);
+    }
+}
+
+// Point `slot` at the old copy of the nursery object it refers to,
+// promoting the object if this is the first reference found
+static void evacuate(Heap *heap, Value *slot, Worklist *work) {
+    if (!value_is_object(*slot)) {
+        return;
+    }
+    Object *object = value_as_object(*slot);
+    if (!heap_in_nursery(heap, object)) {
+        return;
+    }
+    if (object->type != OBJECT_FORWARDED) {
+        Object *copy = safe_malloc(object->size);
+        memcpy(copy, object, object->size);
+        // A flat string's bytes are inside the object and move with it
+        if (copy->type == OBJECT_STRING) {
+            StringObject *string = (StringObject *)object;
+            if (string->chars == string->storage) {
+                ((StringObject *)copy)->chars = ((StringObject *)copy)->storage;
+            }
+        }
+        copy->next = heap->old_objects;
+        heap->old_objects = copy;
+        heap->old_bytes += copy->size + external_size(copy);
+        heap->stats.bytes_promoted += copy->size;
+
+        object->type = OBJECT_FORWARDED;
+        object->next = copy;
+        push_work(work, copy);
+    }
+    *slot = (Value)(uintptr_t)object->next;
+}
+
+static void minor_collection(Heap *heap, const RootRange *roots, int root_count) {
+    Worklist work = {NULL, 0, 0};
+
+    for (int i = 0; i < root_count; i++) {
+        for (size_t j = 0; j < roots[i].count; j++) {
+            evacuate(heap, &roots[i].values[j], &work);
+        }
+    }
+
+    for (size_t i = 0; i < heap->remembered_count; i++) {
+        heap->remembered[i]->remembered = false;
+        visit_fields(heap, heap->remembered[i], evacuate, &work);
+    }
+    heap->remembered_count = 0;
+
+    // Recent old objects may refer to the nursery; after this they join
+    // the rest of the old generation
+    Object *object = heap->recent_objects;
+    while (object) {
+        Object *next = object->next;
+        visit_fields(heap, object, evacuate, &work);
+        object->next = heap->old_objects;
+        heap->old_objects = object;
+        object = next;
+    }
+    heap->recent_objects = NULL;
+
+    // Promote everything reachable from what has been promoted
+    while (work.count > 0) {
+        visit_fields(heap, work.objects[--work.count], evacuate, &work);
+    }
+    free(work.objects);
+
+    sweep_nursery(heap);
+    heap->young_external_bytes = 0;
+    heap->stats.minor_collections++;
+}
+
+static void mark(Heap *heap, Value *slot, Worklist *work) {
+    // Another heap's objects are never changed to refer to this one's
+    if (value_is_object(*slot) && value_as_object(*slot)->owner == heap->tag && !value_as_object(*slot)->marked) {
+        value_as_object(*slot)->marked = true;
+        push_work(work, value_as_object(*slot));
+    }
+}
+
+// Runs after a minor collection, so every live object is old
+static void major_collection(Heap *heap, const RootRange *roots, int root_count) {
+    Worklist work = {NULL, 0, 0};
+
+    for (int i = 0; i < root_count; i++) {
+        for (size_t j = 0; j < roots[i].count; j++) {
+            mark(heap, &roots[i].values[j], &work);
+        }
+    }
+    for (size_t i = 0; i < heap->string_capacity; i++) {
+        if (heap->strings[i] != NULL) {
+            Value string = (Value)(uintptr_t)heap->strings[i];
+            mark(heap, &string, &work);
+        }
+    }
+    while (work.count > 0) {
+        visit_fields(heap, work.objects[--work.count], mark, &work);
+    }
+    free(work.objects);
+
+    // Buffers may have grown or been freed since they were counted, so
+    // the survivors are counted afresh
+    heap->old_bytes = 0;
+    Object **link = &heap->old_objects;
+    while (*link) {
+        Object *object = *link;
+        if (object->marked) {
+            object->marked = false;
+            heap->old_bytes += object->size + external_size(object);
+            link = &object->next;
+        } else {
+            *link = object->next;
+            heap->stats.bytes_freed += object->size + external_size(object);
+            release_object(object);
+            free(object);
+        }
+    }
+
+    heap->major_threshold = heap->old_bytes * 2 > MIN_MAJOR_THRESHOLD ? heap->old_bytes * 2 : MIN_MAJOR_THRESHOLD;
+    heap->stats.major_collections++;
+}
+
+bool collect_garbage(Heap *heap, const RootRange *roots, int root_count) {
+    uint64_t start = now_ns();
+
+    minor_collection(heap, roots, root_count);
+    if (heap->old_bytes > heap->major_threshold) {
+        major_collection(heap, roots, root_count);
+    }
+    heap->collect_requested = false;
+
+    if (heap->old_bytes > heap->stats.peak_old_bytes) {
+        heap->stats.peak_old_bytes = heap->old_bytes;
+    }
+    uint64_t pause = now_ns() - start;
+    heap->stats.pause_ns += pause;
+    if (pause > heap->stats.max_pause_ns) {
+        heap->stats.max_pause_ns = pause;
+    }
+    return heap->limit == 0 || heap->old_bytes <= heap->limit;
+}
+
+void heap_adopt(Heap *heap, Heap *donor, const RootRange *roots, int root_count) {
+    uint64_t start = now_ns();
+    minor_collection(donor, roots, root_count);
+    major_collection(donor, roots, root_count);
+
+    // The survivors may refer to this heap's nursery, so they join as
+    // recent objects, whose fields the next minor collection visits
+    Object *object = donor->old_objects;
+    while (object) {
+        Object *next = object->next;
+        object->owner = heap->tag;
+        object->next = heap->recent_objects;
+        heap->recent_objects = object;
+        object = next;
+    }
+    donor->old_objects = NULL;
+    heap->old_bytes += donor->old_bytes;
+    donor->old_bytes = 0;
+    if (heap->old_bytes > heap->major_threshold) {
+        heap->collect_requested = true;
+    }
+
+    uint64_t pause = now_ns() - start;
+    GCStats *stats = &heap->stats;
+    const GCStats *other = &donor->stats;
+    stats->minor_collections += other->minor_collections;
+    stats->major_collections += other->major_collections;
+    stats->bytes_allocated += other->bytes_allocated;
+    stats->bytes_promoted += other->bytes_promoted;
+    stats->bytes_freed += other->bytes_freed;
+    stats->pause_ns += other->pause_ns + pause;
+    if (other->max_pause_ns > stats->max_pause_ns) {
+        stats->max_pause_ns = other->max_pause_ns;
+    }
+    if (pause > stats->max_pause_ns) {
+        stats->max_pause_ns = pause;
+    }
+    if (heap->old_bytes > stats->peak_old_bytes) {
+        stats->peak_old_bytes = heap->old_bytes;
+    }
+    memset(&donor->stats, 0, sizeof(donor->stats));
+}
+
+void print_gc_stats(const Heap *heap, FILE *stream) {
+    const GCStats *stats = &heap->stats;
+    double elapsed = (double)(now_ns() - stats->start_ns) / 1e9;
+    double paused = (double)stats->pause_ns / 1e9;
+    size_t collections = stats->minor_collections;
+    const double mb = 1024.0 * 1024.0;
+
+    fprintf(stream, "GC: %zu minor, %zu major collections\n", stats->minor_collections,
+            stats->major_collections);
+    fprintf(stream, "GC: pauses %.3f ms total, %.3f ms max, %.3f ms mean\n", paused * 1e3,
+            (double)stats->max_pause_ns / 1e6, collections ? paused * 1e3 / (double)collections : 0.0);
+    fprintf(stream, "GC: %.1f MB allocated, %.1f MB promoted, %.1f MB freed, %.1f MB peak old generation\n",
+            (double)stats->bytes_allocated / mb, (double)stats->bytes_promoted / mb,
+            (double)stats->bytes_freed / mb, (double)stats->peak_old_bytes / mb);
+    fprintf(stream, "GC: %.1f%% of %.3f s spent collecting, %.1f MB/s allocated\n",
+            elapsed > 0 ? 100.0 * paused / elapsed : 0.0, elapsed,
+            elapsed > 0 ? (double)stats->bytes_allocated / mb / elapsed : 0.0);
+}
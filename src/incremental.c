@@ -0,0 +1,817 @@
+// incremental.c
+#include <stdlib.h>
+#include <string.h>
+#include "../include/incremental.h"
+#include "../include/parser.h"
+#include "../include/visitor.h"
+#include "../include/common.h"
+
+static void reserve_tokens(Document *document, int count) {
+    if (count > document->token_capacity) {
+        int capacity = document->token_capacity ? document->token_capacity : 64;
+        while (capacity < count) {
+            capacity *= 2;
+        }
+        document->tokens = safe_realloc(document->tokens, capacity * sizeof(Token *));
+        document->token_capacity = capacity;
+    }
+}
+
+static void reserve_segments(SegmentList *list, int count) {
+    if (count > list->capacity) {
+        int capacity = list->capacity ? list->capacity : 16;
+        while (capacity < count) {
+            capacity *= 2;
+        }
+        list->segments = safe_realloc(list->segments, capacity * sizeof(Segment));
+        list->capacity = capacity;
+    }
+}
+
+static void replace_text(Document *document, size_t start, size_t old_length,
+                         const char *text, size_t new_length) {
+    size_t length = document->length - old_length + new_length;
+    if (length + 1 > document->capacity) {
+        size_t capacity = document->capacity ? document->capacity : 256;
+        while (capacity < length + 1) {
+            capacity *= 2;
+        }
+        document->text = safe_realloc(document->text, capacity);
+        document->capacity = capacity;
+    }
+    memmove(document->text + start + new_length, document->text + start + old_length,
+            document->length - start - old_length);
+    memcpy(document->text + start, text, new_length);
+    document->length = length;
+    document->text[length] = '\0';
+}
+
+// Pending shifts. Entries from the *_shift_from index onwards are stored
+// unshifted; the accessors give their real values.
+
+static size_t token_offset(const Document *document, int index) {
+    size_t offset = document->tokens[index]->offset;
+    return index >= document->token_shift_from ? offset + document->token_offset_shift : offset;
+}
+
+static int token_line(const Document *document, int index) {
+    int line = document->tokens[index]->line;
+    return index >= document->token_shift_from ? line + document->token_line_shift : line;
+}
+
+// Apply the pending shift to tokens before `upto`
+static void settle_tokens(Document *document, int upto) {
+    if (upto > document->token_count) {
+        upto = document->token_count;
+    }
+    for (int i = document->token_shift_from; i < upto; i++) {
+        document->tokens[i]->offset += document->token_offset_shift;
+        document->tokens[i]->line += document->token_line_shift;
+    }
+    if (upto > document->token_shift_from) {
+        document->token_shift_from = upto;
+    }
+}
+
+// Make the pending shift start exactly at `from`, undoing it for tokens
+// that were settled past that point
+static void rebase_token_shift(Document *document, int from) {
+    if (document->token_shift_from <= from) {
+        settle_tokens(document, from);
+        return;
+    }
+    for (int i = from; i < document->token_shift_from && i < document->token_count; i++) {
+        document->tokens[i]->offset -= document->token_offset_shift;
+        document->tokens[i]->line -= document->token_line_shift;
+    }
+    document->token_shift_from = from;
+}
+
+static int segment_first_token(const SegmentList *list, int index) {
+    int first = list->segments[index].first_token;
+    return index >= list->shift_from ? first + list->token_shift : first;
+}
+
+static int segment_line_bias(const SegmentList *list, int index) {
+    int bias = list->segments[index].line_bias;
+    return index >= list->shift_from ? bias + list->line_shift : bias;
+}
+
+static void settle_segments(SegmentList *list, int upto) {
+    if (upto > list->count) {
+        upto = list->count;
+    }
+    for (int i = list->shift_from; i < upto; i++) {
+        list->segments[i].first_token += list->token_shift;
+        list->segments[i].line_bias += list->line_shift;
+    }
+    if (upto > list->shift_from) {
+        list->shift_from = upto;
+    }
+}
+
+static void rebase_segment_shift(SegmentList *list, int from) {
+    if (list->shift_from <= from) {
+        settle_segments(list, from);
+        return;
+    }
+    for (int i = from; i < list->shift_from && i < list->count; i++) {
+        list->segments[i].first_token -= list->token_shift;
+        list->segments[i].line_bias -= list->line_shift;
+    }
+    list->shift_from = from;
+}
+
+// Move the segments after the re-parsed window [from, reuse) along by an
+// edit, and replace those in it with `fresh`
+static void splice_segments(SegmentList *list, int from, int reuse, Segment *fresh, int fresh_count,
+                            int token_delta, int line_delta) {
+    rebase_segment_shift(list, reuse);
+    list->token_shift += token_delta;
+    list->line_shift += line_delta;
+
+    int kept = list->count - reuse;
+    reserve_segments(list, from + fresh_count + kept);
+    if (kept > 0) {
+        memmove(list->segments + from + fresh_count, list->segments + reuse, kept * sizeof(Segment));
+    }
+    if (fresh_count > 0) {
+        memcpy(list->segments + from, fresh, fresh_count * sizeof(Segment));
+    }
+    list->count = from + fresh_count + kept;
+    list->shift_from = from + fresh_count;
+}
+
+// Index of the first token that ends at or after `offset`. The trailing
+// TOKEN_EOF sits at the end of the text, so there always is one.
+static int find_token(const Document *document, size_t offset) {
+    int low = 0;
+    int high = document->token_count - 1;
+    while (low < high) {
+        int mid = low + (high - low) / 2;
+        if (token_offset(document, mid) + document->tokens[mid]->length >= offset) {
+            high = mid;
+        } else {
+            low = mid + 1;
+        }
+    }
+    return low;
+}
+
+// Index of the segment containing token `index`, counted from where the
+// list's positions start, or list->count if the token lies past the last
+static int find_segment(const SegmentList *list, int index) {
+    int low = 0;
+    int high = list->count;
+    while (low < high) {
+        int mid = low + (high - low) / 2;
+        if (segment_first_token(list, mid) + list->segments[mid].token_count <= index) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+static void shift_node_line(ASTNode *node, void *context) {
+    node->line += *(int *)context;
+}
+
+static void shift_ast_lines(ASTNode *node, int delta) {
+    ASTVisitor visitor = {shift_node_line, NULL, NULL, &delta};
+    walk_ast(node, &visitor, 1);
+}
+
+static void free_segments(SegmentList *list, bool owned);
+
+static void free_blocks(Block *blocks, int count) {
+    for (int i = 0; i < count; i++) {
+        free_segments(&blocks[i].statements, false);
+    }
+    free(blocks);
+}
+
+// `owned` if the segment's node is its own rather than part of a block's
+static void free_segment(Segment *segment, bool owned) {
+    if (owned) {
+        free_ast(segment->node);
+    }
+    free_error_list(&segment->errors);
+    free_blocks(segment->blocks, segment->block_count);
+}
+
+static void free_segments(SegmentList *list, bool owned) {
+    for (int i = 0; i < list->count; i++) {
+        free_segment(&list->segments[i], owned);
+    }
+    free(list->segments);
+}
+
+// Listener for the parser. Blocks come innermost first, so those pending
+// since this one opened lie inside it; each goes to the statement of this
+// block that holds it.
+static void record_block(ASTNode *node, int open, int close, int *starts, int depth, void *context) {
+    Document *document = context;
+    Block block = {node, open, close, depth, 0, {NULL, 0, 0, 0, 0, 0}};
+    int count = node->data.block.count;
+    reserve_segments(&block.statements, count);
+    for (int i = 0; i < count; i++) {
+        Segment *segment = &block.statements.segments[i];
+        memset(segment, 0, sizeof(Segment));
+        segment->node = node->data.block.statements[i];
+        segment->first_token = starts[i] - open;
+        segment->token_count = (i + 1 < count ? starts[i + 1] : close) - starts[i];
+    }
+    block.statements.count = count;
+    block.statements.shift_from = count;
+
+    int inner = document->pending_count;
+    while (inner > 0 && document->pending[inner - 1].open > open) {
+        inner--;
+    }
+    int statement = 0;
+    for (int i = inner; i < document->pending_count; i++) {
+        Block *child = &document->pending[i];
+        while (statement + 1 < count && starts[statement + 1] <= child->open) {
+            statement++;
+        }
+        Segment *segment = &block.statements.segments[statement];
+        child->open -= starts[statement];
+        child->close -= starts[statement];
+        segment->blocks = safe_realloc(segment->blocks, (segment->block_count + 1) * sizeof(Block));
+        segment->blocks[segment->block_count++] = *child;
+    }
+    free(starts);
+
+    document->pending_count = inner;
+    if (document->pending_count == document->pending_capacity) {
+        document->pending_capacity = document->pending_capacity ? document->pending_capacity * 2 : 8;
+        document->pending = safe_realloc(document->pending, document->pending_capacity * sizeof(Block));
+    }
+    document->pending[document->pending_count++] = block;
+}
+
+// Re-lex the edited region. Returns the number of tokens that replaced
+// the old range starting at *first_token and stores the line shift of the
+// tokens after it.
+static int relex(Document *document, size_t start, size_t old_length, size_t new_length,
+                 int *first_token, int *removed_tokens, int *line_delta) {
+    ptrdiff_t delta = (ptrdiff_t)new_length - (ptrdiff_t)old_length;
+    size_t old_end = start + old_length;
+    size_t new_end = start + new_length;
+
+    // The token before the edit is re-lexed too, since the edit may extend it
+    int first = find_token(document, start);
+    if (first > 0) {
+        first--;
+    }
+    size_t lex_offset = first > 0 ? token_offset(document, first) : 0;
+    int lex_line = first > 0 ? token_line(document, first) : 1;
+
+    ErrorList scratch;  // Error tokens carry their own messages
+    init_error_list(&scratch);
+    Lexer lexer;
+    init_lexer(&lexer, document->text, document->length, &scratch, document->names);
+    seek_lexer(&lexer, lex_offset, lex_line);
+
+    // Lexing from the same text gives the same tokens, so once a new token
+    // starts where an old one past the edit used to, the rest is unchanged
+    Token **fresh = NULL;
+    int fresh_count = 0;
+    int old = first;
+    int sync = document->token_count;
+    *line_delta = 0;
+    for (;;) {
+        Token *token = get_next_token(&lexer);
+        if (token->offset >= new_end) {
+            size_t old_offset = (size_t)((ptrdiff_t)token->offset - delta);
+            while (old < document->token_count &&
+                   (token_offset(document, old) < old_offset || token_offset(document, old) < old_end)) {
+                old++;
+            }
+            if (old < document->token_count && token_offset(document, old) == old_offset) {
+                sync = old;
+                *line_delta = token->line - token_line(document, old);
+                free_token(token);
+                break;
+            }
+        }
+        fresh = safe_realloc(fresh, (fresh_count + 1) * sizeof(Token *));
+        fresh[fresh_count++] = token;
+        if (token->type == TOKEN_EOF) {
+            break;
+        }
+    }
+    free_error_list(&scratch);
+
+    // Tokens after the edit join the pending shift
+    rebase_token_shift(document, sync);
+    document->token_offset_shift += delta;
+    document->token_line_shift += *line_delta;
+
+    int removed = sync - first;
+    for (int i = first; i < sync; i++) {
+        free_token(document->tokens[i]);
+    }
+    reserve_tokens(document, document->token_count - removed + fresh_count);
+    memmove(document->tokens + first + fresh_count, document->tokens + sync,
+            (document->token_count - sync) * sizeof(Token *));
+    if (fresh_count > 0) {
+        memcpy(document->tokens + first, fresh, fresh_count * sizeof(Token *));
+    }
+    free(fresh);
+    document->token_count += fresh_count - removed;
+    document->token_shift_from = first + fresh_count;
+
+    *first_token = first;
+    *removed_tokens = removed;
+    document->relexed_tokens = fresh_count;
+    return fresh_count;
+}
+
+static void drop_pending_blocks(Document *document) {
+    for (int i = 0; i < document->pending_count; i++) {
+        free_segments(&document->pending[i].statements, false);
+    }
+    document->pending_count = 0;
+}
+
+// Parse one statement into `segment`: a top-level one, or one of the
+// statements of `block`. Tokens it reads must have their pending shift
+// applied first; since its extent is unknown up front, a statement that
+// runs past the settled tokens is parsed again. Its first_token is left
+// counted from the start of the text.
+static void parse_segment(Document *document, Parser *parser, Segment *segment, const Block *block) {
+    int start = parser->current;
+    int window = 64;
+    for (;;) {
+        settle_tokens(document, start + window);
+        memset(segment, 0, sizeof(Segment));
+        parser->errors = &segment->errors;
+        parser->current = start;
+        if (block) {
+            parser->depth = block->depth;
+            parser->too_deep = false;
+            segment->node = parse_statement(parser);
+        } else {
+            segment->node = parse_top_level_statement(parser);
+        }
+
+        // The parser has looked at tokens up to and including `current`
+        if (parser->current < document->token_shift_from) {
+            break;
+        }
+        free_segment(segment, true);
+        drop_pending_blocks(document);
+        window = (parser->current - start + 1) * 2;
+    }
+
+    segment->first_token = start;
+    segment->token_count = parser->current - start;
+    for (int i = start; i < parser->current; i++) {
+        Token *token = document->tokens[i];
+        if (token->type == TOKEN_ERROR) {
+            report_error(&segment->errors, ERROR_LEXER, token->line, "%s", token->value.string);
+        }
+    }
+    if (segment->node == NULL || segment->errors.count > 0) {
+        drop_pending_blocks(document);
+        return;
+    }
+    if (document->pending_count > 0) {
+        segment->blocks = safe_malloc(document->pending_count * sizeof(Block));
+        for (int i = 0; i < document->pending_count; i++) {
+            segment->blocks[i] = document->pending[i];
+            segment->blocks[i].open -= start;
+            segment->blocks[i].close -= start;
+        }
+        segment->block_count = document->pending_count;
+        document->pending_count = 0;
+    }
+}
+
+static Parser *create_document_parser(Document *document, BlockListener *listener, int position) {
+    listener->block = record_block;
+    listener->context = document;
+    Parser *parser = create_parser(document->tokens, document->token_count, NULL);
+    parser->listener = listener;
+    parser->current = position;
+    return parser;
+}
+
+// A block on the way down to the one an edit is in: block `block` of the
+// segment `segment` of `list`
+typedef struct {
+    SegmentList *list;
+    int segment;
+    int block;
+} BlockStep;
+
+// Re-parse the statements around tokens [first, first + inserted) inside
+// the innermost block whose braces the edit left alone, reusing the old
+// statements once the boundaries line up again. If they no longer parse
+// cleanly up to its closing brace, the statements the edit touched become
+// one stale range instead. Returns false, having changed nothing but
+// settled tokens, if the edit is in no such block.
+static bool reparse_block(Document *document, int first, int inserted, int removed, int line_delta) {
+    int token_delta = inserted - removed;
+
+    BlockStep *path = NULL;
+    int depth = 0;
+    SegmentList *list = &document->statements;
+    int base = 0;           // Where the positions in `list` count from
+    int line_bias = 0;      // Lines pending on the blocks around `list`
+    Block *block = NULL;
+    int close = 0;
+    for (;;) {
+        int index = find_segment(list, first - 1 - base);
+        if (index >= list->count) {
+            break;
+        }
+        Segment *segment = &list->segments[index];
+        int start = base + segment_first_token(list, index);
+        // The token before an edit is re-lexed, which may be the '{' again
+        int inside = -1;
+        for (int i = 0; i < segment->block_count; i++) {
+            int open = start + segment->blocks[i].open;
+            if ((open < first || (open == first && document->tokens[first]->type == TOKEN_LBRACE)) &&
+                first + removed <= start + segment->blocks[i].close) {
+                inside = i;
+                break;
+            }
+        }
+        if (inside < 0) {
+            break;
+        }
+        path = safe_realloc(path, (depth + 1) * sizeof(BlockStep));
+        path[depth++] = (BlockStep){list, index, inside};
+        block = &segment->blocks[inside];
+        line_bias += segment_line_bias(list, index) + block->line_bias;
+        list = &block->statements;
+        base = start + block->open;
+        close = start + block->close + token_delta;
+    }
+    if (block == NULL) {
+        return false;
+    }
+
+    // As at the top level, start a statement early for its lookahead
+    int s0 = find_segment(list, first - 1 - base);
+    int position;
+    if (s0 < list->count) {
+        position = base + segment_first_token(list, s0);
+    } else if (list->count > 0) {
+        position = base + segment_first_token(list, list->count - 1) + list->segments[list->count - 1].token_count;
+    } else {
+        position = base + 1;
+    }
+
+    Segment *fresh = NULL;
+    int fresh_count = 0;
+    int reuse = s0;
+    bool clean = true;
+    BlockListener listener;
+    Parser *parser = create_document_parser(document, &listener, position);
+    for (;;) {
+        if (parser->current == close) {
+            reuse = list->count;
+            break;
+        }
+        TokenType type = document->tokens[parser->current]->type;
+        if (parser->current > close || type == TOKEN_RBRACE || type == TOKEN_EOF) {
+            clean = false;
+            break;
+        }
+        if (parser->current >= first + inserted) {
+            int old_position = parser->current - token_delta - base;
+            while (reuse < list->count && segment_first_token(list, reuse) < old_position) {
+                reuse++;
+            }
+            if (reuse < list->count && segment_first_token(list, reuse) == old_position) {
+                break;
+            }
+        }
+
+        fresh = safe_realloc(fresh, (fresh_count + 1) * sizeof(Segment));
+        Segment *segment = &fresh[fresh_count++];
+        parse_segment(document, parser, segment, block);
+        segment->first_token -= base;
+        // The new nodes have their lines already
+        segment->line_bias = -line_bias;
+        if (segment->node == NULL || segment->errors.count > 0) {
+            clean = false;
+            break;
+        }
+    }
+    int end = parser->current;
+    free_parser(parser);
+    if (!clean) {
+        for (int i = 0; i < fresh_count; i++) {
+            free_segment(&fresh[i], true);
+        }
+        reuse = s0;
+        while (reuse < list->count && base + segment_first_token(list, reuse) < first + removed) {
+            reuse++;
+        }
+        int stale_end = reuse < list->count ? base + segment_first_token(list, reuse) + token_delta : close;
+        fresh = safe_realloc(fresh, sizeof(Segment));
+        fresh_count = 1;
+        memset(fresh, 0, sizeof(Segment));
+        fresh->node = create_none_node();
+        fresh->first_token = position - base;
+        fresh->token_count = stale_end - position;
+        fresh->stale = 1;
+    }
+
+    // Statements [s0, reuse) of the block give way to the fresh ones, in
+    // the block's node as well
+    ASTNode *node = block->node;
+    int old_count = list->count;
+    int stale = 0;
+    for (int i = 0; i < fresh_count; i++) {
+        stale += fresh[i].stale;
+    }
+    for (int i = s0; i < reuse; i++) {
+        stale -= list->segments[i].stale;
+        free_segment(&list->segments[i], true);
+    }
+    splice_segments(list, s0, reuse, fresh, fresh_count, token_delta, line_delta);
+    if (list->count > old_count) {
+        node->data.block.statements = safe_realloc(node->data.block.statements, list->count * sizeof(ASTNode *));
+    }
+    memmove(node->data.block.statements + s0 + fresh_count, node->data.block.statements + reuse,
+            (old_count - reuse) * sizeof(ASTNode *));
+    for (int i = 0; i < fresh_count; i++) {
+        node->data.block.statements[s0 + i] = fresh[i].node;
+    }
+    node->data.block.count = list->count;
+    free(fresh);
+
+    // Everything after the edit in the blocks and statements around it
+    // moves along by the edit
+    for (int i = depth - 1; i >= 0; i--) {
+        SegmentList *outer = path[i].list;
+        Segment *segment = &outer->segments[path[i].segment];
+        segment->token_count += token_delta;
+        segment->stale += stale;
+        segment->blocks[path[i].block].close += token_delta;
+        for (int j = path[i].block + 1; j < segment->block_count; j++) {
+            segment->blocks[j].open += token_delta;
+            segment->blocks[j].close += token_delta;
+            segment->blocks[j].line_bias += line_delta;
+        }
+        splice_segments(outer, path[i].segment + 1, path[i].segment + 1, NULL, 0, token_delta, line_delta);
+    }
+    // Errors on the top-level statement came from parsing it with stale
+    // ranges, and are found again if it still has some
+    free_error_list(&path[0].list->segments[path[0].segment].errors);
+    free(path);
+    document->reparsed_statements = fresh_count;
+    document->reparsed_tokens = end - position;
+    return true;
+}
+
+// Re-parse the top-level statements around tokens [first, first + inserted)
+// and reuse the old statements once the boundaries line up again
+static void reparse(Document *document, int first, int inserted, int removed, int line_delta) {
+    SegmentList *list = &document->statements;
+    int token_delta = inserted - removed;
+
+    // Start one token early: the statement before may look ahead into the edit
+    int s0 = find_segment(list, first > 0 ? first - 1 : 0);
+    int position;
+    if (s0 < list->count) {
+        position = segment_first_token(list, s0);
+    } else if (list->count > 0) {
+        int last = list->count - 1;
+        position = segment_first_token(list, last) + list->segments[last].token_count;
+    } else {
+        position = 0;
+    }
+
+    Segment *fresh = NULL;
+    int fresh_count = 0;
+    int reuse = s0;
+    BlockListener listener;
+    Parser *parser = create_document_parser(document, &listener, position);
+
+    while (document->tokens[parser->current]->type != TOKEN_EOF) {
+        if (parser->current >= first + inserted) {
+            int old_position = parser->current - token_delta;
+            while (reuse < list->count && segment_first_token(list, reuse) < old_position) {
+                reuse++;
+            }
+            if (reuse < list->count && segment_first_token(list, reuse) == old_position) {
+                break;
+            }
+        }
+
+        fresh = safe_realloc(fresh, (fresh_count + 1) * sizeof(Segment));
+        parse_segment(document, parser, &fresh[fresh_count++], NULL);
+    }
+    if (document->tokens[parser->current]->type == TOKEN_EOF) {
+        reuse = list->count;
+    }
+    int end = parser->current;
+    free_parser(parser);
+
+    // Replace segments [s0, reuse) with the fresh ones; those after the
+    // re-parsed window join the pending shift
+    for (int i = s0; i < reuse; i++) {
+        free_segment(&list->segments[i], true);
+    }
+    splice_segments(list, s0, reuse, fresh, fresh_count, token_delta, line_delta);
+    document->reparsed_statements = fresh_count;
+    document->reparsed_tokens = end - position;
+    free(fresh);
+}
+
+Document *create_document(const char *text, size_t length, InternTable *names) {
+    Document *document = safe_malloc(sizeof(Document));
+    memset(document, 0, sizeof(Document));
+    document->names = names;
+    replace_text(document, 0, 0, "", 0);
+
+    // Start from an empty document holding just TOKEN_EOF
+    ErrorList scratch;
+    init_error_list(&scratch);
+    Lexer lexer;
+    init_lexer(&lexer, document->text, 0, &scratch, names);
+    reserve_tokens(document, 1);
+    document->tokens[document->token_count++] = get_next_token(&lexer);
+    document->token_shift_from = document->token_count;
+
+    document_edit(document, 0, 0, text, length);
+    return document;
+}
+
+void free_document(Document *document) {
+    free_segments(&document->statements, true);
+    drop_pending_blocks(document);
+    for (int i = 0; i < document->token_count; i++) {
+        free_token(document->tokens[i]);
+    }
+    free(document->pending);
+    free(document->tokens);
+    free(document->program_statements);
+    free(document->text);
+    free(document);
+}
+
+void document_edit(Document *document, size_t start, size_t old_length,
+                   const char *text, size_t new_length) {
+    if (start > document->length) {
+        start = document->length;
+    }
+    if (old_length > document->length - start) {
+        old_length = document->length - start;
+    }
+
+    replace_text(document, start, old_length, text, new_length);
+    document->resolved = false;
+
+    int first, removed, line_delta;
+    int inserted = relex(document, start, old_length, new_length, &first, &removed, &line_delta);
+    if (!reparse_block(document, first, inserted, removed, line_delta)) {
+        reparse(document, first, inserted, removed, line_delta);
+    }
+}
+
+// Parse a top-level statement with stale ranges in it afresh, along with
+// any after it that its error recovery runs into. If they parse cleanly
+// they replace the old ones. Otherwise the old statement is kept for the
+// edits to come, and holds the errors of the fresh parse. Returns the
+// index of the statement after those parsed.
+static int resolve_statement(Document *document, int index) {
+    SegmentList *list = &document->statements;
+    Segment *segment = &list->segments[index];
+    int end = segment->first_token + segment->token_count;
+
+    Segment *fresh = NULL;
+    int fresh_count = 0;
+    int next = index + 1;
+    bool clean = true;
+    BlockListener listener;
+    Parser *parser = create_document_parser(document, &listener, segment->first_token);
+    for (;;) {
+        fresh = safe_realloc(fresh, (fresh_count + 1) * sizeof(Segment));
+        Segment *statement = &fresh[fresh_count++];
+        parse_segment(document, parser, statement, NULL);
+        clean = clean && statement->node != NULL && statement->errors.count == 0;
+
+        while (next < list->count && list->segments[next].first_token < parser->current) {
+            next++;
+        }
+        if (document->tokens[parser->current]->type == TOKEN_EOF) {
+            next = list->count;
+            break;
+        }
+        if (parser->current >= end && next < list->count && list->segments[next].first_token == parser->current) {
+            break;
+        }
+    }
+    free_parser(parser);
+
+    if (clean) {
+        for (int i = index; i < next; i++) {
+            free_segment(&list->segments[i], true);
+        }
+        splice_segments(list, index, next, fresh, fresh_count, 0, 0);
+        free(fresh);
+        return index + fresh_count;
+    }
+
+    // The errors have their lines; the statement's bias is added back to them
+    free_error_list(&segment->errors);
+    for (int i = 0; i < fresh_count; i++) {
+        for (int j = 0; j < fresh[i].errors.count; j++) {
+            const Error *error = &fresh[i].errors.errors[j];
+            report_error(&segment->errors, error->type, error->line - segment->line_bias, "%s", error->message);
+        }
+        free_segment(&fresh[i], true);
+    }
+    free(fresh);
+    segment->covers = next - index - 1;
+    return next;
+}
+
+static void resolve_stale(Document *document) {
+    if (document->resolved) {
+        return;
+    }
+    SegmentList *list = &document->statements;
+    settle_segments(list, list->count);
+    for (int i = 0; i < list->count;) {
+        list->segments[i].covers = 0;
+        if (list->segments[i].stale > 0) {
+            i = resolve_statement(document, i);
+        } else {
+            i++;
+        }
+    }
+    document->resolved = true;
+}
+
+// A full compile lexes the whole source before parsing any of it, so all
+// its lexer errors come before its parser errors
+static void append_segment_errors(const Document *document, ErrorList *errors, bool lexer) {
+    const SegmentList *list = &document->statements;
+    for (int i = 0; i < list->count; i += 1 + list->segments[i].covers) {
+        const ErrorList *segment_errors = &list->segments[i].errors;
+        int bias = segment_line_bias(list, i);
+        for (int j = 0; j < segment_errors->count; j++) {
+            const Error *error = &segment_errors->errors[j];
+            if ((error->type == ERROR_LEXER) == lexer) {
+                report_error(errors, error->type, error->line + bias, "%s", error->message);
+            }
+        }
+    }
+}
+
+void document_errors(Document *document, ErrorList *errors) {
+    resolve_stale(document);
+    append_segment_errors(document, errors, true);
+    append_segment_errors(document, errors, false);
+}
+
+// Apply the lines pending on a statement to its nodes, and those pending
+// on the blocks and statements inside it, each on top of the ones outside
+static void settle_lines(Segment *segment) {
+    if (segment->line_bias != 0) {
+        shift_ast_lines(segment->node, segment->line_bias);
+        segment->line_bias = 0;
+    }
+    for (int i = 0; i < segment->block_count; i++) {
+        Block *block = &segment->blocks[i];
+        if (block->line_bias != 0) {
+            shift_ast_lines(block->node, block->line_bias);
+            block->line_bias = 0;
+        }
+        settle_segments(&block->statements, block->statements.count);
+        for (int j = 0; j < block->statements.count; j++) {
+            settle_lines(&block->statements.segments[j]);
+        }
+    }
+}
+
+ASTNode *document_program(Document *document) {
+    resolve_stale(document);
+    SegmentList *list = &document->statements;
+    document->program_statements = safe_realloc(document->program_statements,
+                                                (list->count + 1) * sizeof(ASTNode *));
+    for (int i = 0; i < list->count; i++) {
+        Segment *segment = &list->segments[i];
+        if (segment->node == NULL || segment->errors.count > 0 || segment->stale > 0) {
+            return NULL;
+        }
+        settle_lines(segment);
+        document->program_statements[i] = segment->node;
+    }
+
+    document->program.type = AST_PROGRAM;
+    document->program.line = 1;
+    document->program.data.program.statements = document->program_statements;
+    document->program.data.program.count = list->count;
+    return &document->program;
+}
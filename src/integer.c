@@ -0,0 +1,599 @@
+//integer.c
+#include <stdlib.h>
+#include <string.h>
+#include "../include/integer.h"
+
+#define LIMB_BITS 32
+#define LIMB_BASE ((uint64_t)1 << LIMB_BITS)
+#define DECIMAL_CHUNK 1000000000u   // 10^9, the largest power of ten in a limb
+#define DECIMAL_CHUNK_DIGITS 9
+
+static BigInt *big_alloc(size_t length) {
+    BigInt *big = safe_malloc(sizeof(BigInt) + length * sizeof(uint32_t));
+    big->sign = 0;
+    big->length = length;
+    memset(big->limbs, 0, length * sizeof(uint32_t));
+    return big;
+}
+
+// Drop leading zero limbs
+static void big_trim(BigInt *big) {
+    while (big->length > 0 && big->limbs[big->length - 1] == 0) {
+        big->length--;
+    }
+    if (big->length == 0) {
+        big->sign = 0;
+    }
+}
+
+static BigInt *big_from_int64(int64_t value) {
+    BigInt *big = big_alloc(2);
+    uint64_t magnitude = value < 0 ? -(uint64_t)value : (uint64_t)value;
+    big->limbs[0] = (uint32_t)magnitude;
+    big->limbs[1] = (uint32_t)(magnitude >> LIMB_BITS);
+    big->sign = value < 0 ? -1 : 1;
+    big_trim(big);
+    return big;
+}
+
+static BigInt *big_copy(const BigInt *big) {
+    BigInt *copy = big_alloc(big->length);
+    copy->sign = big->sign;
+    memcpy(copy->limbs, big->limbs, big->length * sizeof(uint32_t));
+    return copy;
+}
+
+// Narrow `big` to the inline form if it fits, taking ownership of it
+static Integer narrow(BigInt *big) {
+    if (big->length <= 2) {
+        uint64_t magnitude = big->length == 0 ? 0 : big->limbs[0];
+        if (big->length == 2) {
+            magnitude |= (uint64_t)big->limbs[1] << LIMB_BITS;
+        }
+        if (big->sign >= 0 && magnitude <= (uint64_t)INT64_MAX) {
+            free(big);
+            return (Integer){(int64_t)magnitude, NULL};
+        }
+        if (big->sign < 0 && magnitude <= (uint64_t)INT64_MAX + 1) {
+            free(big);
+            return (Integer){(int64_t)(0 - magnitude), NULL};
+        }
+    }
+    return (Integer){0, big};
+}
+
+// Borrow a BigInt view of `value`; the caller frees it if *owned is set
+static const BigInt *as_big(Integer value, BigInt **owned) {
+    if (value.big) {
+        *owned = NULL;
+        return value.big;
+    }
+    *owned = big_from_int64(value.small);
+    return *owned;
+}
+
+static int compare_magnitude(const BigInt *a, const BigInt *b) {
+    if (a->length != b->length) {
+        return a->length < b->length ? -1 : 1;
+    }
+    for (size_t i = a->length; i-- > 0;) {
+        if (a->limbs[i] != b->limbs[i]) {
+            return a->limbs[i] < b->limbs[i] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+static BigInt *add_magnitude(const BigInt *a, const BigInt *b) {
+    if (a->length < b->length) {
+        const BigInt *swap = a;
+        a = b;
+        b = swap;
+    }
+    BigInt *sum = big_alloc(a->length + 1);
+    uint64_t carry = 0;
+    for (size_t i = 0; i < a->length; i++) {
+        carry += (uint64_t)a->limbs[i] + (i < b->length ? b->limbs[i] : 0);
+        sum->limbs[i] = (uint32_t)carry;
+        carry >>= LIMB_BITS;
+    }
+    sum->limbs[a->length] = (uint32_t)carry;
+    sum->sign = 1;
+    big_trim(sum);
+    return sum;
+}
+
+// |a| - |b|, where |a| >= |b|
+static BigInt *sub_magnitude(const BigInt *a, const BigInt *b) {
+    BigInt *difference = big_alloc(a->length);
+    int64_t borrow = 0;
+    for (size_t i = 0; i < a->length; i++) {
+        int64_t t = (int64_t)a->limbs[i] - (i < b->length ? b->limbs[i] : 0) - borrow;
+        borrow = t < 0;
+        difference->limbs[i] = (uint32_t)t;
+    }
+    difference->sign = 1;
+    big_trim(difference);
+    return difference;
+}
+
+// a + b, with b's sign replaced by `b_sign`
+static BigInt *signed_add(const BigInt *a, const BigInt *b, int b_sign) {
+    BigInt *result;
+    if (b_sign == 0) {
+        return big_copy(a);
+    }
+    if (a->sign == 0) {
+        result = big_copy(b);
+        result->sign = b_sign;
+        return result;
+    }
+    if (a->sign == b_sign) {
+        result = add_magnitude(a, b);
+        result->sign = b_sign;
+        return result;
+    }
+    int order = compare_magnitude(a, b);
+    if (order >= 0) {
+        result = sub_magnitude(a, b);
+        result->sign = order == 0 ? 0 : a->sign;
+    } else {
+        result = sub_magnitude(b, a);
+        result->sign = b_sign;
+    }
+    big_trim(result);
+    return result;
+}
+
+static BigInt *mul_magnitude(const BigInt *a, const BigInt *b) {
+    BigInt *product = big_alloc(a->length + b->length);
+    for (size_t i = 0; i < a->length; i++) {
+        uint64_t carry = 0;
+        for (size_t j = 0; j < b->length; j++) {
+            carry += (uint64_t)a->limbs[i] * b->limbs[j] + product->limbs[i + j];
+            product->limbs[i + j] = (uint32_t)carry;
+            carry >>= LIMB_BITS;
+        }
+        product->limbs[i + b->length] = (uint32_t)carry;
+    }
+    product->sign = 1;
+    big_trim(product);
+    return product;
+}
+
+// Divide the magnitude of `big` in place by a single limb; returns the remainder
+static uint32_t divide_limb_in_place(BigInt *big, uint32_t divisor) {
+    uint64_t remainder = 0;
+    for (size_t i = big->length; i-- > 0;) {
+        uint64_t current = (remainder << LIMB_BITS) | big->limbs[i];
+        big->limbs[i] = (uint32_t)(current / divisor);
+        remainder = current % divisor;
+    }
+    big_trim(big);
+    return (uint32_t)remainder;
+}
+
+// Truncating division of magnitudes (Knuth, TAOCP vol. 2, algorithm D).
+// Both results are non-negative.
+static void divmod_magnitude(const BigInt *u, const BigInt *v, BigInt **quotient, BigInt **remainder) {
+    if (compare_magnitude(u, v) < 0) {
+        *quotient = big_alloc(0);
+        *remainder = big_copy(u);
+        (*remainder)->sign = u->length ? 1 : 0;
+        return;
+    }
+    if (v->length == 1) {
+        *quotient = big_copy(u);
+        (*quotient)->sign = 1;
+        uint32_t rest = divide_limb_in_place(*quotient, v->limbs[0]);
+        *remainder = big_from_int64(rest);
+        return;
+    }
+
+    size_t n = v->length;
+    size_t m = u->length - n;
+    // Normalize so the divisor's top limb has its high bit set
+    int shift = __builtin_clz(v->limbs[n - 1]);
+    uint32_t *vn = safe_malloc(n * sizeof(uint32_t));
+    uint32_t *un = safe_malloc((u->length + 1) * sizeof(uint32_t));
+    for (size_t i = n - 1; i > 0; i--) {
+        vn[i] = (v->limbs[i] << shift) | (shift ? v->limbs[i - 1] >> (LIMB_BITS - shift) : 0);
+    }
+    vn[0] = v->limbs[0] << shift;
+    un[u->length] = shift ? u->limbs[u->length - 1] >> (LIMB_BITS - shift) : 0;
+    for (size_t i = u->length - 1; i > 0; i--) {
+        un[i] = (u->limbs[i] << shift) | (shift ? u->limbs[i - 1] >> (LIMB_BITS - shift) : 0);
+    }
+    un[0] = u->limbs[0] << shift;
+
+    BigInt *q = big_alloc(m + 1);
+    for (size_t j = m + 1; j-- > 0;) {
+        // Estimate the quotient limb from the top two limbs, then correct it
+        uint64_t numerator = ((uint64_t)un[j + n] << LIMB_BITS) | un[j + n - 1];
+        uint64_t qhat = numerator / vn[n - 1];
+        uint64_t rhat = numerator % vn[n - 1];
+        while (qhat >= LIMB_BASE || qhat * vn[n - 2] > ((rhat << LIMB_BITS) | un[j + n - 2])) {
+            qhat--;
+            rhat += vn[n - 1];
+            if (rhat >= LIMB_BASE) {
+                break;
+            }
+        }
+
+        // Multiply and subtract
+        int64_t borrow = 0;
+        uint64_t carry = 0;
+        for (size_t i = 0; i < n; i++) {
+            uint64_t product = qhat * vn[i] + carry;
+            carry = product >> LIMB_BITS;
+            int64_t t = (int64_t)un[i + j] - (int64_t)(product & 0xFFFFFFFFu) - borrow;
+            un[i + j] = (uint32_t)t;
+            borrow = t < 0;
+        }
+        int64_t t = (int64_t)un[j + n] - (int64_t)carry - borrow;
+        un[j + n] = (uint32_t)t;
+
+        // The estimate was one too large; add the divisor back
+        if (t < 0) {
+            qhat--;
+            uint64_t sum = 0;
+            for (size_t i = 0; i < n; i++) {
+                sum += (uint64_t)un[i + j] + vn[i];
+                un[i + j] = (uint32_t)sum;
+                sum >>= LIMB_BITS;
+            }
+            un[j + n] += (uint32_t)sum;
+        }
+        q->limbs[j] = (uint32_t)qhat;
+    }
+    q->sign = 1;
+    big_trim(q);
+
+    BigInt *r = big_alloc(n);
+    for (size_t i = 0; i < n; i++) {
+        r->limbs[i] = (un[i] >> shift) | (shift ? un[i + 1] << (LIMB_BITS - shift) : 0);
+    }
+    r->sign = 1;
+    big_trim(r);
+
+    free(vn);
+    free(un);
+    *quotient = q;
+    *remainder = r;
+}
+
+// Floor division and modulo of bignums, Python style
+static void floor_divmod(const BigInt *a, const BigInt *b, BigInt **quotient, BigInt **remainder) {
+    BigInt *q;
+    BigInt *r;
+    divmod_magnitude(a, b, &q, &r);
+    if (a->sign == b->sign || a->sign == 0) {
+        q->sign = q->length ? 1 : 0;
+        r->sign = r->length ? b->sign : 0;
+    } else if (r->length == 0) {
+        q->sign = q->length ? -1 : 0;
+    } else {
+        // Round the quotient down and take the remainder from the other side
+        BigInt *one = big_from_int64(1);
+        BigInt *rounded = add_magnitude(q, one);
+        rounded->sign = -1;
+        BigInt *complement = sub_magnitude(b, r);
+        complement->sign = complement->length ? b->sign : 0;
+        free(one);
+        free(q);
+        free(r);
+        q = rounded;
+        r = complement;
+    }
+    *quotient = q;
+    *remainder = r;
+}
+
+Integer integer_from_decimal(const char *digits, size_t length) {
+    // Each limb holds nine decimal digits' worth, with one spare
+    BigInt *big = big_alloc(length / DECIMAL_CHUNK_DIGITS + 2);
+    big->length = 0;
+    for (size_t i = 0; i < length;) {
+        uint32_t chunk = 0;
+        uint32_t scale = 1;
+        for (int k = 0; k < DECIMAL_CHUNK_DIGITS && i < length; k++, i++) {
+            chunk = chunk * 10 + (uint32_t)(digits[i] - '0');
+            scale *= 10;
+        }
+        // big = big * scale + chunk
+        uint64_t carry = chunk;
+        for (size_t j = 0; j < big->length; j++) {
+            carry += (uint64_t)big->limbs[j] * scale;
+            big->limbs[j] = (uint32_t)carry;
+            carry >>= LIMB_BITS;
+        }
+        if (carry) {
+            big->limbs[big->length++] = (uint32_t)carry;
+        }
+    }
+    big->sign = big->length ? 1 : 0;
+    return narrow(big);
+}
+
+Integer integer_copy(Integer value) {
+    if (value.big) {
+        value.big = big_copy(value.big);
+    }
+    return value;
+}
+
+void integer_free(Integer *value) {
+    free(value->big);
+    value->big = NULL;
+    value->small = 0;
+}
+
+// Every two-digit number, so digits are produced a pair at a time
+static const char ascii_pairs[200] =
+    "0001020304050607080910111213141516171819202122232425262728293031323334353637383940414243444546474849"
+    "5051525354555657585960616263646566676869707172737475767778798081828384858687888990919293949596979899";
+
+#define KANNADA_0 "\xE0\xB3\xA6"   // U+0CE6 to U+0CEF in UTF-8
+#define KANNADA_1 "\xE0\xB3\xA7"
+#define KANNADA_2 "\xE0\xB3\xA8"
+#define KANNADA_3 "\xE0\xB3\xA9"
+#define KANNADA_4 "\xE0\xB3\xAA"
+#define KANNADA_5 "\xE0\xB3\xAB"
+#define KANNADA_6 "\xE0\xB3\xAC"
+#define KANNADA_7 "\xE0\xB3\xAD"
+#define KANNADA_8 "\xE0\xB3\xAE"
+#define KANNADA_9 "\xE0\xB3\xAF"
+#define KANNADA_ROW(tens)                                               \
+    tens KANNADA_0, tens KANNADA_1, tens KANNADA_2, tens KANNADA_3,    \
+    tens KANNADA_4, tens KANNADA_5, tens KANNADA_6, tens KANNADA_7,    \
+    tens KANNADA_8, tens KANNADA_9
+
+static const char kannada_pairs[100][6] = {
+    KANNADA_ROW(KANNADA_0), KANNADA_ROW(KANNADA_1), KANNADA_ROW(KANNADA_2), KANNADA_ROW(KANNADA_3),
+    KANNADA_ROW(KANNADA_4), KANNADA_ROW(KANNADA_5), KANNADA_ROW(KANNADA_6), KANNADA_ROW(KANNADA_7),
+    KANNADA_ROW(KANNADA_8), KANNADA_ROW(KANNADA_9),
+};
+
+// Write the digits of `magnitude`, zero-padded to `min_digits`, so that
+// they end just before `end`. Returns where they start.
+static char *format_digits(char *end, uint64_t magnitude, size_t min_digits, DigitStyle style) {
+    size_t width = style == DIGITS_KANNADA ? 3 : 1;
+    const char *pairs = style == DIGITS_KANNADA ? (const char *)kannada_pairs : ascii_pairs;
+    char *p = end;
+    size_t digits = 0;
+    while (magnitude >= 100) {
+        p -= 2 * width;
+        memcpy(p, pairs + (magnitude % 100) * 2 * width, 2 * width);
+        magnitude /= 100;
+        digits += 2;
+    }
+    if (magnitude >= 10) {
+        p -= 2 * width;
+        memcpy(p, pairs + magnitude * 2 * width, 2 * width);
+        digits += 2;
+    } else {
+        // The second digit of the pair 0n
+        p -= width;
+        memcpy(p, pairs + (magnitude * 2 + 1) * width, width);
+        digits++;
+    }
+    for (; digits < min_digits; digits++) {
+        p -= width;
+        memcpy(p, pairs, width);
+    }
+    return p;
+}
+
+size_t integer_format_int64(char out[INTEGER_FORMAT_MAX], int64_t value, DigitStyle style) {
+    char digits[INTEGER_FORMAT_MAX];
+    char *end = digits + sizeof(digits);
+    uint64_t magnitude = value < 0 ? -(uint64_t)value : (uint64_t)value;
+    char *start = format_digits(end, magnitude, 1, style);
+    if (value < 0) {
+        *--start = '-';
+    }
+    size_t length = (size_t)(end - start);
+    memcpy(out, start, length);
+    return length;
+}
+
+void integer_append_digits(Buffer *buffer, Integer value, DigitStyle style) {
+    char digits[INTEGER_FORMAT_MAX];
+    if (value.big == NULL) {
+        buffer_append(buffer, digits, integer_format_int64(digits, value.small, style));
+        return;
+    }
+
+    // Peel off nine digits at a time, least significant first
+    BigInt *rest = big_copy(value.big);
+    size_t chunk_count = 0;
+    uint32_t *chunks = safe_malloc((rest->length * 2 + 1) * sizeof(uint32_t));
+    while (rest->length > 0) {
+        chunks[chunk_count++] = divide_limb_in_place(rest, DECIMAL_CHUNK);
+    }
+    if (value.big->sign < 0) {
+        buffer_append(buffer, "-", 1);
+    }
+    char *end = digits + sizeof(digits);
+    char *start = format_digits(end, chunks[chunk_count - 1], 1, style);
+    buffer_append(buffer, start, (size_t)(end - start));
+    for (size_t i = chunk_count - 1; i-- > 0;) {
+        start = format_digits(end, chunks[i], DECIMAL_CHUNK_DIGITS, style);
+        buffer_append(buffer, start, (size_t)(end - start));
+    }
+    free(chunks);
+    free(rest);
+}
+
+void integer_append(Buffer *buffer, Integer value) {
+    integer_append_digits(buffer, value, DIGITS_ASCII);
+}
+
+int integer_compare(Integer a, Integer b) {
+    if (a.big == NULL && b.big == NULL) {
+        return (a.small > b.small) - (a.small < b.small);
+    }
+    // A bignum is always outside the 64-bit range, so its sign decides
+    // against an inline value
+    if (a.big == NULL) {
+        return -b.big->sign;
+    }
+    if (b.big == NULL) {
+        return a.big->sign;
+    }
+    if (a.big->sign != b.big->sign) {
+        return a.big->sign < b.big->sign ? -1 : 1;
+    }
+    return a.big->sign * compare_magnitude(a.big, b.big);
+}
+
+Integer integer_add_slow(Integer a, Integer b) {
+    BigInt *owned_a;
+    BigInt *owned_b;
+    const BigInt *x = as_big(a, &owned_a);
+    const BigInt *y = as_big(b, &owned_b);
+    BigInt *sum = signed_add(x, y, y->sign);
+    free(owned_a);
+    free(owned_b);
+    return narrow(sum);
+}
+
+Integer integer_sub_slow(Integer a, Integer b) {
+    BigInt *owned_a;
+    BigInt *owned_b;
+    const BigInt *x = as_big(a, &owned_a);
+    const BigInt *y = as_big(b, &owned_b);
+    BigInt *difference = signed_add(x, y, -y->sign);
+    free(owned_a);
+    free(owned_b);
+    return narrow(difference);
+}
+
+Integer integer_mul_slow(Integer a, Integer b) {
+    BigInt *owned_a;
+    BigInt *owned_b;
+    const BigInt *x = as_big(a, &owned_a);
+    const BigInt *y = as_big(b, &owned_b);
+    BigInt *product = mul_magnitude(x, y);
+    product->sign = product->length ? x->sign * y->sign : 0;
+    free(owned_a);
+    free(owned_b);
+    return narrow(product);
+}
+
+Integer integer_neg_slow(Integer a) {
+    BigInt *owned;
+    const BigInt *x = as_big(a, &owned);
+    BigInt *negated = owned ? owned : big_copy(x);
+    negated->sign = -negated->sign;
+    return narrow(negated);
+}
+
+static bool is_zero(Integer value) {
+    return value.big == NULL && value.small == 0;
+}
+
+bool integer_divmod(Integer a, Integer b, Integer *quotient, Integer *remainder) {
+    if (is_zero(b)) {
+        return false;
+    }
+    // INT64_MIN / -1 is the one inline case that overflows
+    if (a.big == NULL && b.big == NULL && !(a.small == INT64_MIN && b.small == -1)) {
+        int64_t q = a.small / b.small;
+        int64_t r = a.small % b.small;
+        if (r != 0 && (r < 0) != (b.small < 0)) {
+            q--;
+            r += b.small;
+        }
+        *quotient = integer_from_int64(q);
+        *remainder = integer_from_int64(r);
+        return true;
+    }
+
+    BigInt *owned_a;
+    BigInt *owned_b;
+    const BigInt *x = as_big(a, &owned_a);
+    const BigInt *y = as_big(b, &owned_b);
+    BigInt *q;
+    BigInt *r;
+    floor_divmod(x, y, &q, &r);
+    free(owned_a);
+    free(owned_b);
+    *quotient = narrow(q);
+    *remainder = narrow(r);
+    return true;
+}
+
+bool integer_floordiv(Integer a, Integer b, Integer *result) {
+    Integer remainder;
+    if (!integer_divmod(a, b, result, &remainder)) {
+        return false;
+    }
+    integer_free(&remainder);
+    return true;
+}
+
+bool integer_mod(Integer a, Integer b, Integer *result) {
+    Integer quotient;
+    if (!integer_divmod(a, b, &quotient, result)) {
+        return false;
+    }
+    integer_free(&quotient);
+    return true;
+}
+
+size_t integer_bit_length(Integer value) {
+    if (value.big == NULL) {
+        uint64_t magnitude = value.small < 0 ? -(uint64_t)value.small : (uint64_t)value.small;
+        return magnitude ? 64 - (size_t)__builtin_clzll(magnitude) : 0;
+    }
+    const BigInt *big = value.big;
+    return big->length * LIMB_BITS - (size_t)__builtin_clz(big->limbs[big->length - 1]);
+}
+
+uint64_t integer_bits(Integer value, size_t start, bool *below) {
+    BigInt *owned;
+    const BigInt *x = as_big(value, &owned);
+    size_t limb = start / LIMB_BITS;
+    unsigned offset = start % LIMB_BITS;
+    *below = false;
+    for (size_t i = 0; i < limb && i < x->length && !*below; i++) {
+        *below = x->limbs[i] != 0;
+    }
+    if (limb < x->length && offset > 0 && (x->limbs[limb] & (((uint32_t)1 << offset) - 1))) {
+        *below = true;
+    }
+    // Three limbs from `limb` up cover the 64 bits past `offset`
+    uint64_t bits = 0;
+    for (int k = 2; k >= 0; k--) {
+        uint32_t next = limb + (size_t)k < x->length ? x->limbs[limb + (size_t)k] : 0;
+        if (k == 2) {
+            bits = offset ? (uint64_t)next << (2 * LIMB_BITS - offset) : 0;
+        } else {
+            bits |= ((uint64_t)next << (k * LIMB_BITS)) >> offset;
+        }
+    }
+    free(owned);
+    return bits;
+}
+
+Integer integer_shift_left(Integer value, size_t bits) {
+    BigInt *owned;
+    const BigInt *x = as_big(value, &owned);
+    if (x->sign == 0) {
+        free(owned);
+        return integer_from_int64(0);
+    }
+    size_t limbs = bits / LIMB_BITS;
+    unsigned offset = bits % LIMB_BITS;
+    BigInt *shifted = big_alloc(x->length + limbs + 1);
+    for (size_t i = 0; i < x->length; i++) {
+        uint64_t moved = (uint64_t)x->limbs[i] << offset;
+        shifted->limbs[i + limbs] |= (uint32_t)moved;
+        shifted->limbs[i + limbs + 1] = (uint32_t)(moved >> LIMB_BITS);
+    }
+    shifted->sign = x->sign;
+    big_trim(shifted);
+    free(owned);
+    return narrow(shifted);
+}
@@ -0,0 +1,106 @@
+// intern.c
+#include <stdlib.h>
+#include <string.h>
+#include "../include/intern.h"
+#include "../include/common.h"
+
+InternTable *create_intern_table(size_t size) {
+    InternTable *table = (InternTable *)safe_malloc(sizeof(InternTable));
+    table->buckets = (InternEntry **)safe_malloc(size * sizeof(InternEntry *));
+    for (size_t i = 0; i < size; i++) {
+        table->buckets[i] = NULL;
+    }
+    table->size = size;
+    table->count = 0;
+    pthread_mutex_init(&table->lock, NULL);
+    return table;
+}
+
+void free_intern_table(InternTable *table) {
+    for (size_t i = 0; i < table->size; i++) {
+        InternEntry *entry = table->buckets[i];
+        while (entry) {
+            InternEntry *next = entry->next;
+            free(entry);
+            entry = next;
+        }
+    }
+    pthread_mutex_destroy(&table->lock);
+    free(table->buckets);
+    free(table);
+}
+
+// Double the bucket count once the average chain gets longer than one
+// entry. Called with the lock held, so a failed allocation must not jump
+// out through safe_malloc; the table just keeps its longer chains.
+static void grow_intern_table(InternTable *table) {
+    size_t size = table->size * 2;
+    InternEntry **buckets = (InternEntry **)malloc(size * sizeof(InternEntry *));
+    if (buckets == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < size; i++) {
+        buckets[i] = NULL;
+    }
+    for (size_t i = 0; i < table->size; i++) {
+        InternEntry *entry = table->buckets[i];
+        while (entry) {
+            InternEntry *next = entry->next;
+            size_t index = entry->hash % size;
+            entry->next = buckets[index];
+            buckets[index] = entry;
+            entry = next;
+        }
+    }
+    free(table->buckets);
+    table->buckets = buckets;
+    table->size = size;
+}
+
+// Called with the lock held
+static InternEntry *find_interned(InternTable *table, const char *text, size_t length, uint64_t hash) {
+    for (InternEntry *entry = table->buckets[hash % table->size]; entry; entry = entry->next) {
+        if (entry->hash == hash && entry->length == length && memcmp(entry->text, text, length) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+const char *intern_string(InternTable *table, const char *text, size_t length) {
+    uint64_t hash = hash_bytes(text, length);
+
+    pthread_mutex_lock(&table->lock);
+    InternEntry *entry = find_interned(table, text, length, hash);
+    pthread_mutex_unlock(&table->lock);
+    if (entry) {
+        return entry->text;
+    }
+
+    // Allocated without the lock, as safe_malloc may longjmp out on
+    // failure; another thread may intern the same text meanwhile
+    InternEntry *fresh = (InternEntry *)safe_malloc(sizeof(InternEntry) + length + 1);
+    fresh->hash = hash;
+    fresh->length = length;
+    memcpy(fresh->text, text, length);
+    fresh->text[length] = '\0';
+
+    pthread_mutex_lock(&table->lock);
+    entry = find_interned(table, text, length, hash);
+    if (entry == NULL) {
+        if (table->count >= table->size) {
+            grow_intern_table(table);
+        }
+        entry = fresh;
+        size_t index = hash % table->size;
+        entry->next = table->buckets[index];
+        table->buckets[index] = entry;
+        table->count++;
+    }
+    pthread_mutex_unlock(&table->lock);
+
+    if (entry != fresh) {
+        free(fresh);
+    }
+    return entry->text;
+}
@@ -0,0 +1,189 @@
+// kannada.c - embeddable compiler API
+#include <stdlib.h>
+#include <string.h>
+#include "../include/kannada.h"
+#include "../include/compiler.h"
+#include "../include/incremental.h"
+#include "../include/common.h"
+
+static void copy_diagnostics(const ErrorList *errors, kpy_result *result) {
+    if (errors->count == 0) {
+        return;
+    }
+    result->diagnostics = safe_malloc(errors->count * sizeof(kpy_diagnostic));
+    for (int i = 0; i < errors->count; i++) {
+        kpy_diagnostic *diagnostic = &result->diagnostics[i];
+        diagnostic->kind = (kpy_diagnostic_kind)errors->errors[i].type;
+        diagnostic->line = errors->errors[i].line;
+        memcpy(diagnostic->message, errors->errors[i].message, KPY_MAX_MESSAGE_LENGTH);
+    }
+    result->diagnostic_count = errors->count;
+}
+
+static void init_output(const kpy_options *options, Buffer *output) {
+    if (options != NULL && options->buffer != NULL) {
+        buffer_init_fixed(output, options->buffer, options->buffer_size);
+    } else {
+        buffer_init(output);
+    }
+}
+
+static kpy_status finish_result(bool ok, Buffer *output, kpy_result *result) {
+    if (!ok) {
+        buffer_free(output);
+        return KPY_ERROR_COMPILE;
+    }
+    if (output->data == NULL) {
+        // Empty program with a growable buffer
+        buffer_append(output, "", 0);
+    }
+
+    result->output = output->data;
+    result->output_length = output->length;
+    result->owns_output = !output->fixed;
+    if (buffer_overflowed(output)) {
+        return KPY_ERROR_BUFFER_TOO_SMALL;
+    }
+    return KPY_OK;
+}
+
+kpy_status kpy_compile(const char *src, size_t len, const kpy_options *options, kpy_result *result) {
+    if (result == NULL) {
+        return KPY_ERROR_INVALID_ARGUMENT;
+    }
+    memset(result, 0, sizeof(*result));
+    if (src == NULL && len > 0) {
+        return KPY_ERROR_INVALID_ARGUMENT;
+    }
+
+    ErrorList errors;
+    init_error_list(&errors);
+    Buffer output;
+    init_output(options, &output);
+
+    // Allocation failures unwind to here. Memory already handed out by the
+    // failed compile is leaked, but the process keeps running.
+    jmp_buf recovery;
+    jmp_buf *previous = set_alloc_failure_jump(&recovery);
+    if (setjmp(recovery) != 0) {
+        set_alloc_failure_jump(previous);
+        memset(result, 0, sizeof(*result));
+        return KPY_ERROR_NO_MEMORY;
+    }
+
+    bool ok = compile_source(src ? src : "", len, &output, &errors, NULL);
+    copy_diagnostics(&errors, result);
+    free_error_list(&errors);
+    kpy_status status = finish_result(ok, &output, result);
+    set_alloc_failure_jump(previous);
+    return status;
+}
+
+struct kpy_document {
+    Document *document;
+    InternTable *names;
+};
+
+kpy_document *kpy_document_open(const char *src, size_t len) {
+    if (src == NULL && len > 0) {
+        return NULL;
+    }
+    jmp_buf recovery;
+    jmp_buf *previous = set_alloc_failure_jump(&recovery);
+    if (setjmp(recovery) != 0) {
+        set_alloc_failure_jump(previous);
+        return NULL;
+    }
+
+    kpy_document *document = safe_malloc(sizeof(kpy_document));
+    document->names = create_intern_table(256);
+    document->document = create_document(src ? src : "", len, document->names);
+    set_alloc_failure_jump(previous);
+    return document;
+}
+
+void kpy_document_close(kpy_document *document) {
+    if (document == NULL) {
+        return;
+    }
+    free_document(document->document);
+    free_intern_table(document->names);
+    free(document);
+}
+
+kpy_status kpy_document_edit(kpy_document *document, size_t start, size_t old_length,
+                             const char *text, size_t new_length) {
+    if (document == NULL || (text == NULL && new_length > 0) || start > document->document->length) {
+        return KPY_ERROR_INVALID_ARGUMENT;
+    }
+    // An allocation failure part way through an edit leaves the document
+    // inconsistent; callers must close it after KPY_ERROR_NO_MEMORY
+    jmp_buf recovery;
+    jmp_buf *previous = set_alloc_failure_jump(&recovery);
+    if (setjmp(recovery) != 0) {
+        set_alloc_failure_jump(previous);
+        return KPY_ERROR_NO_MEMORY;
+    }
+    document_edit(document->document, start, old_length, text ? text : "", new_length);
+    set_alloc_failure_jump(previous);
+    return KPY_OK;
+}
+
+kpy_status kpy_document_compile(kpy_document *document, const kpy_options *options, kpy_result *result) {
+    if (result == NULL) {
+        return KPY_ERROR_INVALID_ARGUMENT;
+    }
+    memset(result, 0, sizeof(*result));
+    if (document == NULL) {
+        return KPY_ERROR_INVALID_ARGUMENT;
+    }
+
+    ErrorList errors;
+    init_error_list(&errors);
+    Buffer output;
+    init_output(options, &output);
+
+    jmp_buf recovery;
+    jmp_buf *previous = set_alloc_failure_jump(&recovery);
+    if (setjmp(recovery) != 0) {
+        set_alloc_failure_jump(previous);
+        memset(result, 0, sizeof(*result));
+        return KPY_ERROR_NO_MEMORY;
+    }
+
+    document_errors(document->document, &errors);
+    ASTNode *program = document_program(document->document);
+    bool ok = false;
+    if (program != NULL && errors.count == 0) {
+        SymbolTable *symbol_table = create_symbol_table(128);
+        ok = compile_ast(program, symbol_table, &output, &errors);
+        free_symbol_table(symbol_table);
+    }
+    copy_diagnostics(&errors, result);
+    free_error_list(&errors);
+    kpy_status status = finish_result(ok, &output, result);
+    set_alloc_failure_jump(previous);
+    return status;
+}
+
+void kpy_result_free(kpy_result *result) {
+    if (result == NULL) {
+        return;
+    }
+    if (result->owns_output) {
+        free(result->output);
+    }
+    free(result->diagnostics);
+    memset(result, 0, sizeof(*result));
+}
+
+const char *kpy_status_string(kpy_status status) {
+    switch (status) {
+        case KPY_OK: return "ok";
+        case KPY_ERROR_COMPILE: return "compile error";
+        case KPY_ERROR_BUFFER_TOO_SMALL: return "output buffer too small";
+        case KPY_ERROR_NO_MEMORY: return "out of memory";
+        case KPY_ERROR_INVALID_ARGUMENT: return "invalid argument";
+        default: return "unknown status";
+    }
+}
@@ -1,199 +1,442 @@
-//lexer.c
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <ctype.h>
-#include "../include/lexer.h"
-#include "../include/common.h"
-
-#define MAX_IDENTIFIER_LENGTH 256
-#define MAX_NUMBER_LENGTH 100
-#define _POSIX_C_SOURCE 200809L  // This enables strdup in string.h
-
-static char *current_pos;
-static int line_number = 1;
-
-// Kannada keyword mappings
-static const struct {
-    const char *keyword;
-    TokenType type;
-} kannada_keywords[] = {
-    {"ಯದಿ", TOKEN_IF},
-    {"ಅನ್ಯಥಾ", TOKEN_ELSE},
-    {"ಆಗಿರುವ", TOKEN_WHILE},
-    {"ಮುದ್ರಿಸು", TOKEN_PRINT},
-    {"ನಿಜ", TOKEN_TRUE},
-    {"ಸುಳ್ಳು", TOKEN_FALSE},
-    {"ಶೂನ್ಯ", TOKEN_NONE},
-    {NULL, TOKEN_EOF}
-};
-
-const char *token_type_to_string(TokenType type) {
-    switch (type) {
-        case TOKEN_EOF: return "TOKEN_EOF";
-        case TOKEN_ERROR: return "TOKEN_ERROR";
-        case TOKEN_IDENTIFIER: return "TOKEN_IDENTIFIER";
-        case TOKEN_NUMBER: return "TOKEN_NUMBER";
-        case TOKEN_STRING: return "TOKEN_STRING";
-        case TOKEN_IF: return "TOKEN_IF";
-        case TOKEN_ELSE: return "TOKEN_ELSE";
-        case TOKEN_WHILE: return "TOKEN_WHILE";
-        case TOKEN_PRINT: return "TOKEN_PRINT";
-        case TOKEN_TRUE: return "TOKEN_TRUE";
-        case TOKEN_FALSE: return "TOKEN_FALSE";
-        case TOKEN_NONE: return "TOKEN_NONE";
-        case TOKEN_PLUS: return "TOKEN_PLUS";
-        case TOKEN_MINUS: return "TOKEN_MINUS";
-        case TOKEN_MULTIPLY: return "TOKEN_MULTIPLY";
-        case TOKEN_DIVIDE: return "TOKEN_DIVIDE";
-        case TOKEN_ASSIGN: return "TOKEN_ASSIGN";
-        case TOKEN_STAR: return "TOKEN_STAR";
-        case TOKEN_SLASH: return "TOKEN_SLASH";
-        case TOKEN_EQUAL: return "TOKEN_EQUAL";
-        case TOKEN_LPAREN: return "TOKEN_LPAREN";
-        case TOKEN_RPAREN: return "TOKEN_RPAREN";
-        case TOKEN_LBRACE: return "TOKEN_LBRACE";
-        case TOKEN_RBRACE: return "TOKEN_RBRACE";
-        case TOKEN_SEMICOLON: return "TOKEN_SEMICOLON";
-        default: return "UNKNOWN_TOKEN";
-    }
-}
-
-void init_lexer(const char *input) {
-    current_pos = (char *)input;
-    line_number = 1;
-}
-
-static bool is_kannada_digit(uint32_t c) {
-    // Kannada digits range from U+0CE6 to U+0CEF
-    return (c >= 0x0CE6 && c <= 0x0CEF);
-}
-
-static int kannada_digit_to_int(uint32_t c) {
-    return c - 0x0CE6;
-}
-
-static bool is_kannada_letter(uint32_t c) {
-    // Kannada letters range from U+0C80 to U+0CFF
-    return (c >= 0x0C80 && c <= 0x0CFF);
-}
-
-static void skip_whitespace() {
-    while (*current_pos == ' ' || *current_pos == '\t' || *current_pos == '\n' || *current_pos == '\r') {
-        if (*current_pos == '\n') {
-            line_number++;
-        }
-        current_pos++;
-    }
-}
-
-static Token *create_token(TokenType type) {
-    Token *token = (Token *)malloc(sizeof(Token));
-    token->type = type;
-    token->line = line_number;
-    return token;
-}
-
-static Token *tokenize_number() {
-    char number[MAX_NUMBER_LENGTH] = {0};
-    int i = 0;
-    while (is_kannada_digit(*current_pos) && i < MAX_NUMBER_LENGTH - 1) {
-        number[i++] = *current_pos++;
-    }
-    number[i] = '\0';
-
-    Token *token = create_token(TOKEN_NUMBER);
-    token->value.number = 0;
-    for (int j = 0; j < i; j++) {
-        token->value.number = token->value.number * 10 + kannada_digit_to_int(number[j]);
-    }
-    return token;
-}
-
-static Token *tokenize_identifier_or_keyword() {
-    char identifier[MAX_IDENTIFIER_LENGTH] = {0};
-    int i = 0;
-    const char *temp = current_pos;
-    while ((is_kannada_letter(utf8_nextchar(&temp)) || is_kannada_digit(utf8_nextchar(&temp))) && i < MAX_IDENTIFIER_LENGTH - 1) {
-        identifier[i++] = *current_pos++;
-    }
-    identifier[i] = '\0';
-
-    for (int j = 0; kannada_keywords[j].keyword != NULL; j++) {
-        if (strcmp(identifier, kannada_keywords[j].keyword) == 0) {
-            return create_token(kannada_keywords[j].type);
-        }
-    }
-
-    Token *token = create_token(TOKEN_IDENTIFIER);
-    token->value.string = safe_strdup(identifier);
-    return token;
-}
-
-static Token *tokenize_string() {
-    current_pos++; // Skip opening quote
-    const char *start = current_pos;
-    while (*current_pos != '"' && *current_pos != '\0') {
-        if (*current_pos == '\n') line_number++;
-        current_pos++;
-    }
-
-    if (*current_pos == '\0') {
-        fprintf(stderr, "Error: Unterminated string at line %d\n", line_number);
-        return create_token(TOKEN_ERROR);
-    }
-
-    int length = current_pos - start;
-    Token *token = create_token(TOKEN_STRING);
-    token->value.string = (char *)malloc(length + 1);
-    strncpy(token->value.string, start, length);
-    token->value.string[length] = '\0';
-
-    current_pos++; // Skip closing quote
-    return token;
-}
-
-Token *get_next_token() {
-    skip_whitespace();
-
-    if (*current_pos == '\0') {
-        return create_token(TOKEN_EOF);
-    }
-
-    if (is_kannada_digit(*current_pos)) {
-        return tokenize_number();
-    }
-
-    if (is_kannada_letter(*current_pos)) {
-        return tokenize_identifier_or_keyword();
-    }
-
-    if (*current_pos == '"') {
-        return tokenize_string();
-    }
-
-    // Single-character tokens
-    switch (*current_pos) {
-        case '+': current_pos++; return create_token(TOKEN_PLUS);
-        case '-': current_pos++; return create_token(TOKEN_MINUS);
-        case '*': current_pos++; return create_token(TOKEN_MULTIPLY);
-        case '/': current_pos++; return create_token(TOKEN_DIVIDE);
-        case '=': current_pos++; return create_token(TOKEN_ASSIGN);
-        case '(': current_pos++; return create_token(TOKEN_LPAREN);
-        case ')': current_pos++; return create_token(TOKEN_RPAREN);
-        case '{': current_pos++; return create_token(TOKEN_LBRACE);
-        case '}': current_pos++; return create_token(TOKEN_RBRACE);
-        case ';': current_pos++; return create_token(TOKEN_SEMICOLON);
-    }
-
-    fprintf(stderr, "Error: Unknown token at line %d: %c\n", line_number, *current_pos);
-    current_pos++;
-    return create_token(TOKEN_ERROR);
-}
-
-void free_token(Token *token) {
-    if (token->type == TOKEN_IDENTIFIER || token->type == TOKEN_STRING) {
-        free(token->value.string);
-    }
-    free(token);
-}
\ No newline at end of file
+//lexer.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdarg.h>
+#include "../include/lexer.h"
+#include "../include/common.h"
+#include "../include/floating.h"
+
+#define MAX_IDENTIFIER_LENGTH 256
+#define MAX_NUMBER_LENGTH 100
+#define _POSIX_C_SOURCE 200809L  // This enables strdup in string.h
+
+// Kannada keyword mappings
+static const struct {
+    const char *keyword;
+    TokenType type;
+} kannada_keywords[] = {
+    {"ಯದಿ", TOKEN_IF},
+    {"ಅನ್ಯಥಾ", TOKEN_ELSE},
+    {"ಆಗಿರುವ", TOKEN_WHILE},
+    {"ಪ್ರತಿ", TOKEN_FOR},
+    {"ಸಮಾನಾಂತರ", TOKEN_PARALLEL},
+    {"ಒಳಗೆ", TOKEN_IN},
+    {"ವ್ಯಾಪ್ತಿ", TOKEN_RANGE},
+    {"ಮುದ್ರಿಸು", TOKEN_PRINT},
+    {"ನಿಜ", TOKEN_TRUE},
+    {"ಸುಳ್ಳು", TOKEN_FALSE},
+    {"ಶೂನ್ಯ", TOKEN_NONE},
+    {"ಆಮದು", TOKEN_IMPORT},
+    {"ಉತ್ಪಾದಕ", TOKEN_GENERATOR},
+    {"ನೀಡು", TOKEN_YIELD},
+    {"ಕಾರ್ಯ", TOKEN_FUNCTION},
+    {"ಹಿಂತಿರುಗಿಸು", TOKEN_RETURN},
+    {"ಮತ್ತು", TOKEN_AND},
+    {"ಅಥವಾ", TOKEN_OR},
+    {"ಅಲ್ಲ", TOKEN_NOT},
+    {NULL, TOKEN_EOF}
+};
+
+const char *token_type_to_string(TokenType type) {
+    switch (type) {
+        case TOKEN_EOF: return "TOKEN_EOF";
+        case TOKEN_ERROR: return "TOKEN_ERROR";
+        case TOKEN_IDENTIFIER: return "TOKEN_IDENTIFIER";
+        case TOKEN_NUMBER: return "TOKEN_NUMBER";
+        case TOKEN_FLOAT: return "TOKEN_FLOAT";
+        case TOKEN_STRING: return "TOKEN_STRING";
+        case TOKEN_IF: return "TOKEN_IF";
+        case TOKEN_ELSE: return "TOKEN_ELSE";
+        case TOKEN_WHILE: return "TOKEN_WHILE";
+        case TOKEN_FOR: return "TOKEN_FOR";
+        case TOKEN_PARALLEL: return "TOKEN_PARALLEL";
+        case TOKEN_IN: return "TOKEN_IN";
+        case TOKEN_RANGE: return "TOKEN_RANGE";
+        case TOKEN_PRINT: return "TOKEN_PRINT";
+        case TOKEN_TRUE: return "TOKEN_TRUE";
+        case TOKEN_FALSE: return "TOKEN_FALSE";
+        case TOKEN_NONE: return "TOKEN_NONE";
+        case TOKEN_IMPORT: return "TOKEN_IMPORT";
+        case TOKEN_GENERATOR: return "TOKEN_GENERATOR";
+        case TOKEN_YIELD: return "TOKEN_YIELD";
+        case TOKEN_FUNCTION: return "TOKEN_FUNCTION";
+        case TOKEN_RETURN: return "TOKEN_RETURN";
+        case TOKEN_AND: return "TOKEN_AND";
+        case TOKEN_OR: return "TOKEN_OR";
+        case TOKEN_NOT: return "TOKEN_NOT";
+        case TOKEN_PLUS: return "TOKEN_PLUS";
+        case TOKEN_MINUS: return "TOKEN_MINUS";
+        case TOKEN_MULTIPLY: return "TOKEN_MULTIPLY";
+        case TOKEN_DIVIDE: return "TOKEN_DIVIDE";
+        case TOKEN_ASSIGN: return "TOKEN_ASSIGN";
+        case TOKEN_STAR: return "TOKEN_STAR";
+        case TOKEN_SLASH: return "TOKEN_SLASH";
+        case TOKEN_EQUAL: return "TOKEN_EQUAL";
+        case TOKEN_NOT_EQUAL: return "TOKEN_NOT_EQUAL";
+        case TOKEN_LESS: return "TOKEN_LESS";
+        case TOKEN_LESS_EQUAL: return "TOKEN_LESS_EQUAL";
+        case TOKEN_GREATER: return "TOKEN_GREATER";
+        case TOKEN_GREATER_EQUAL: return "TOKEN_GREATER_EQUAL";
+        case TOKEN_PERCENT: return "TOKEN_PERCENT";
+        case TOKEN_LPAREN: return "TOKEN_LPAREN";
+        case TOKEN_RPAREN: return "TOKEN_RPAREN";
+        case TOKEN_LBRACE: return "TOKEN_LBRACE";
+        case TOKEN_RBRACE: return "TOKEN_RBRACE";
+        case TOKEN_LBRACKET: return "TOKEN_LBRACKET";
+        case TOKEN_RBRACKET: return "TOKEN_RBRACKET";
+        case TOKEN_COMMA: return "TOKEN_COMMA";
+        case TOKEN_COLON: return "TOKEN_COLON";
+        case TOKEN_SEMICOLON: return "TOKEN_SEMICOLON";
+        default: return "UNKNOWN_TOKEN";
+    }
+}
+
+void init_lexer(Lexer *lexer, const char *input, size_t length, ErrorList *errors, InternTable *names) {
+    lexer->start = input;
+    lexer->current = input;
+    lexer->end = input + length;
+    lexer->line = 1;
+    lexer->errors = errors;
+    lexer->names = names;
+}
+
+void seek_lexer(Lexer *lexer, size_t offset, int line) {
+    lexer->current = lexer->start + offset;
+    lexer->line = line;
+}
+
+static bool is_kannada_digit(uint32_t c) {
+    // Kannada digits range from U+0CE6 to U+0CEF
+    return (c >= 0x0CE6 && c <= 0x0CEF);
+}
+
+static int kannada_digit_to_int(uint32_t c) {
+    return c - 0x0CE6;
+}
+
+static bool is_kannada_letter(uint32_t c) {
+    // Kannada letters range from U+0C80 to U+0CFF
+    return (c >= 0x0C80 && c <= 0x0CFF);
+}
+
+static bool at_end(Lexer *lexer) {
+    return lexer->current >= lexer->end;
+}
+
+// Decode the code point at the current position without consuming it.
+// Truncated sequences at the end of the input decode as their lead byte.
+static uint32_t peek_char(Lexer *lexer, int *width) {
+    const unsigned char *s = (const unsigned char *)lexer->current;
+    size_t available = (size_t)(lexer->end - lexer->current);
+    int bytes = *s < 0x80 ? 1 : *s < 0xE0 ? 2 : *s < 0xF0 ? 3 : 4;
+    if ((size_t)bytes > available) {
+        *width = 1;
+        return *s;
+    }
+    const char *next = lexer->current;
+    uint32_t c = utf8_nextchar(&next);
+    *width = bytes;
+    return c;
+}
+
+static void skip_whitespace(Lexer *lexer) {
+    while (!at_end(lexer) && (*lexer->current == ' ' || *lexer->current == '\t' ||
+                              *lexer->current == '\n' || *lexer->current == '\r')) {
+        if (*lexer->current == '\n') {
+            lexer->line++;
+        }
+        lexer->current++;
+    }
+}
+
+static Token *create_token(Lexer *lexer, TokenType type) {
+    Token *token = (Token *)safe_malloc(sizeof(Token));
+    token->type = type;
+    token->line = lexer->line;
+    return token;
+}
+
+// Error tokens carry their message so consumers that keep tokens around
+// (such as incremental documents) can report it again later
+static Token *error_token(Lexer *lexer, int line, const char *format, ...) {
+    Token *token = create_token(lexer, TOKEN_ERROR);
+    token->line = line;
+    token->value.string = safe_malloc(MAX_ERROR_MESSAGE_LENGTH);
+    va_list args;
+    va_start(args, format);
+    vsnprintf(token->value.string, MAX_ERROR_MESSAGE_LENGTH, format, args);
+    va_end(args);
+    report_error(lexer->errors, ERROR_LEXER, line, "%s", token->value.string);
+    return token;
+}
+
+// The value of a Kannada or ASCII digit, or -1
+static int digit_value(uint32_t c) {
+    if (is_kannada_digit(c)) {
+        return kannada_digit_to_int(c);
+    }
+    return c >= '0' && c <= '9' ? (int)(c - '0') : -1;
+}
+
+// The value of the digit at the current position, or -1, setting `width`
+// to its bytes. ASCII digits skip decoding.
+static int peek_digit(Lexer *lexer, int *width) {
+    if (at_end(lexer)) {
+        return -1;
+    }
+    unsigned char byte = (unsigned char)*lexer->current;
+    if (byte < 0x80) {
+        *width = 1;
+        return byte >= '0' && byte <= '9' ? byte - '0' : -1;
+    }
+    return digit_value(peek_char(lexer, width));
+}
+
+// The value of the digit `offset` bytes past the current position, or -1
+static int digit_at(Lexer *lexer, size_t offset) {
+    if ((size_t)(lexer->end - lexer->current) <= offset) {
+        return -1;
+    }
+    Lexer ahead = *lexer;
+    ahead.current += offset;
+    int width;
+    return peek_digit(&ahead, &width);
+}
+
+// Bytes of the `e`, `e+` or `e-` of an exponent at the current position,
+// or 0 if there is none; it must be followed by a digit
+static size_t exponent_mark(Lexer *lexer) {
+    if (at_end(lexer) || (*lexer->current != 'e' && *lexer->current != 'E')) {
+        return 0;
+    }
+    size_t length = 1;
+    if (lexer->current + 1 < lexer->end && (lexer->current[1] == '+' || lexer->current[1] == '-')) {
+        length++;
+    }
+    return digit_at(lexer, length) >= 0 ? length : 0;
+}
+
+// Consume a run of digits, appending them to `digits` in ASCII; returns
+// how many there were
+static size_t scan_digits(Lexer *lexer, Buffer *digits) {
+    size_t count = 0;
+    int width;
+    int digit;
+    while ((digit = peek_digit(lexer, &width)) >= 0) {
+        char ascii = (char)('0' + digit);
+        buffer_append(digits, &ascii, 1);
+        lexer->current += width;
+        count++;
+    }
+    return count;
+}
+
+// Past this, an exponent gives zero or infinity for any literal
+#define EXPONENT_LIMIT 1000000000
+
+// Consume an exponent, if there is one, and return its value
+static int64_t scan_exponent(Lexer *lexer) {
+    size_t mark = exponent_mark(lexer);
+    if (mark == 0) {
+        return 0;
+    }
+    bool negative = lexer->current[mark - 1] == '-';
+    lexer->current += mark;
+    int64_t magnitude = 0;
+    int width;
+    int digit;
+    while ((digit = peek_digit(lexer, &width)) >= 0) {
+        if (magnitude < EXPONENT_LIMIT) {
+            magnitude = magnitude * 10 + digit;
+        }
+        lexer->current += width;
+    }
+    return negative ? -magnitude : magnitude;
+}
+
+// An integer, or a float if a point and more digits or an exponent follow
+// the digits. Kannada and ASCII digits both count, even mixed.
+static Token *tokenize_number(Lexer *lexer) {
+    const char *start = lexer->current;
+    int64_t value = 0;
+    bool overflow = false;
+
+    int width;
+    int digit;
+    while ((digit = peek_digit(lexer, &width)) >= 0) {
+        if (!overflow) {
+            overflow = __builtin_mul_overflow(value, 10, &value) ||
+                       __builtin_add_overflow(value, digit, &value);
+        }
+        lexer->current += width;
+    }
+    bool point = !at_end(lexer) && *lexer->current == '.' && digit_at(lexer, 1) >= 0;
+    bool is_float = point || exponent_mark(lexer) > 0;
+    if (!overflow && !is_float) {
+        Token *token = create_token(lexer, TOKEN_NUMBER);
+        token->value.number = integer_from_int64(value);
+        return token;
+    }
+
+    // Go over the digits again in ASCII, for a bignum or a float
+    Buffer digits;
+    buffer_init(&digits);
+    lexer->current = start;
+    scan_digits(lexer, &digits);
+    Token *token;
+    if (!is_float) {
+        token = create_token(lexer, TOKEN_NUMBER);
+        token->value.number = integer_from_decimal(digits.data, digits.length);
+    } else {
+        int64_t exponent = 0;
+        if (point) {
+            lexer->current++;
+            exponent = -(int64_t)scan_digits(lexer, &digits);
+        }
+        exponent += scan_exponent(lexer);
+        token = create_token(lexer, TOKEN_FLOAT);
+        token->value.real = float_from_decimal(digits.data, digits.length, exponent);
+    }
+    buffer_free(&digits);
+    return token;
+}
+
+static Token *tokenize_identifier_or_keyword(Lexer *lexer) {
+    char identifier[MAX_IDENTIFIER_LENGTH] = {0};
+    size_t i = 0;
+    int width;
+    while (!at_end(lexer) && is_kannada_letter(peek_char(lexer, &width))) {
+        if (i + width < MAX_IDENTIFIER_LENGTH) {
+            memcpy(identifier + i, lexer->current, width);
+            i += width;
+        }
+        lexer->current += width;
+    }
+    identifier[i] = '\0';
+
+    for (int j = 0; kannada_keywords[j].keyword != NULL; j++) {
+        if (strcmp(identifier, kannada_keywords[j].keyword) == 0) {
+            return create_token(lexer, kannada_keywords[j].type);
+        }
+    }
+
+    Token *token = create_token(lexer, TOKEN_IDENTIFIER);
+    token->value.name = intern_string(lexer->names, identifier, i);
+    return token;
+}
+
+static Token *tokenize_string(Lexer *lexer) {
+    int start_line = lexer->line;
+    lexer->current++; // Skip opening quote
+    const char *start = lexer->current;
+    while (!at_end(lexer) && *lexer->current != '"') {
+        if (*lexer->current == '\n') lexer->line++;
+        lexer->current++;
+    }
+
+    if (at_end(lexer)) {
+        return error_token(lexer, start_line, "Unterminated string");
+    }
+
+    size_t length = lexer->current - start;
+    Token *token = create_token(lexer, TOKEN_STRING);
+    token->line = start_line;
+    token->value.string = (char *)safe_malloc(length + 1);
+    memcpy(token->value.string, start, length);
+    token->value.string[length] = '\0';
+
+    lexer->current++; // Skip closing quote
+    return token;
+}
+
+// Consume the next byte if it is `expected`
+static bool match(Lexer *lexer, char expected) {
+    if (at_end(lexer) || *lexer->current != expected) {
+        return false;
+    }
+    lexer->current++;
+    return true;
+}
+
+static Token *scan_token(Lexer *lexer) {
+    if (at_end(lexer)) {
+        return create_token(lexer, TOKEN_EOF);
+    }
+
+    int width;
+    uint32_t c = peek_char(lexer, &width);
+
+    if (digit_value(c) >= 0 || (c == '.' && digit_at(lexer, 1) >= 0)) {
+        return tokenize_number(lexer);
+    }
+
+    if (is_kannada_letter(c)) {
+        return tokenize_identifier_or_keyword(lexer);
+    }
+
+    if (c == '"') {
+        return tokenize_string(lexer);
+    }
+
+    // Single-character tokens
+    switch (c) {
+        case '+': lexer->current++; return create_token(lexer, TOKEN_PLUS);
+        case '-': lexer->current++; return create_token(lexer, TOKEN_MINUS);
+        case '*': lexer->current++; return create_token(lexer, TOKEN_MULTIPLY);
+        case '/': lexer->current++; return create_token(lexer, TOKEN_DIVIDE);
+        case '%': lexer->current++; return create_token(lexer, TOKEN_PERCENT);
+        case '(': lexer->current++; return create_token(lexer, TOKEN_LPAREN);
+        case ')': lexer->current++; return create_token(lexer, TOKEN_RPAREN);
+        case '{': lexer->current++; return create_token(lexer, TOKEN_LBRACE);
+        case '}': lexer->current++; return create_token(lexer, TOKEN_RBRACE);
+        case '[': lexer->current++; return create_token(lexer, TOKEN_LBRACKET);
+        case ']': lexer->current++; return create_token(lexer, TOKEN_RBRACKET);
+        case ',': lexer->current++; return create_token(lexer, TOKEN_COMMA);
+        case ':': lexer->current++; return create_token(lexer, TOKEN_COLON);
+        case ';': lexer->current++; return create_token(lexer, TOKEN_SEMICOLON);
+    }
+
+    // One- or two-character operators
+    switch (c) {
+        case '=':
+            lexer->current++;
+            return create_token(lexer, match(lexer, '=') ? TOKEN_EQUAL : TOKEN_ASSIGN);
+        case '<':
+            lexer->current++;
+            return create_token(lexer, match(lexer, '=') ? TOKEN_LESS_EQUAL : TOKEN_LESS);
+        case '>':
+            lexer->current++;
+            return create_token(lexer, match(lexer, '=') ? TOKEN_GREATER_EQUAL : TOKEN_GREATER);
+        case '!':
+            if (lexer->current + 1 < lexer->end && lexer->current[1] == '=') {
+                lexer->current += 2;
+                return create_token(lexer, TOKEN_NOT_EQUAL);
+            }
+            break;
+    }
+
+    Token *token = error_token(lexer, lexer->line, "Unknown token '%.*s'", width, lexer->current);
+    lexer->current += width;
+    return token;
+}
+
+Token *get_next_token(Lexer *lexer) {
+    skip_whitespace(lexer);
+
+    const char *start = lexer->current;
+    Token *token = scan_token(lexer);
+    token->offset = (size_t)(start - lexer->start);
+    token->length = (size_t)(lexer->current - start);
+    return token;
+}
+
+void free_token(Token *token) {
+    if (token->type == TOKEN_STRING || token->type == TOKEN_ERROR) {
+        free(token->value.string);
+    } else if (token->type == TOKEN_NUMBER) {
+        integer_free(&token->value.number);
+    }
+    free(token);
+}
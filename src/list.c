@@ -0,0 +1,464 @@
+//list.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/list.h"
+
+// Bulk operations on unboxed lists use GCC vector extensions, which
+// compile to SIMD instructions wherever the target has them. Two lanes fit
+// the 128-bit registers every x86-64 and AArch64 processor has.
+#define LANES 2
+typedef int64_t Int64Vector __attribute__((vector_size(LANES * sizeof(int64_t))));
+typedef uint64_t UInt64Vector __attribute__((vector_size(LANES * sizeof(uint64_t))));
+
+static inline Int64Vector load_vector(const int64_t *items) {
+    Int64Vector vector;
+    memcpy(&vector, items, sizeof(vector));
+    return vector;
+}
+
+static inline void store_vector(int64_t *items, Int64Vector vector) {
+    memcpy(items, &vector, sizeof(vector));
+}
+
+static inline Int64Vector splat(int64_t value) {
+    Int64Vector zero = {0};
+    return zero + value;
+}
+
+ListObject *list_create(Heap *heap, size_t capacity) {
+    ListObject *list = (ListObject *)allocate_object(heap, OBJECT_LIST, sizeof(ListObject));
+    list->count = 0;
+    list->capacity = capacity;
+    list->unboxed = true;
+    list->items.ints = NULL;
+    if (capacity > 0) {
+        list->items.ints = safe_malloc(capacity * sizeof(int64_t));
+        heap_note_external(heap, &list->object, capacity * sizeof(int64_t));
+    }
+    return list;
+}
+
+// Switch to tagged storage, tagging the integers in place
+static void box(ListObject *list) {
+    for (size_t i = 0; i < list->count; i++) {
+        list->items.values[i] = value_from_small_int(list->items.ints[i]);
+    }
+    list->unboxed = false;
+}
+
+static void reserve(Heap *heap, ListObject *list, size_t needed) {
+    if (needed <= list->capacity) {
+        return;
+    }
+    size_t capacity = list->capacity ? list->capacity : 8;
+    while (capacity < needed) {
+        capacity *= 2;
+    }
+    list->items.values = safe_realloc(list->items.values, capacity * sizeof(Value));
+    heap_note_external(heap, &list->object, (capacity - list->capacity) * sizeof(Value));
+    list->capacity = capacity;
+}
+
+void list_set(Heap *heap, ListObject *list, size_t index, Value value) {
+    if (list->unboxed) {
+        if (value_is_small_int(value)) {
+            list->items.ints[index] = value_as_small_int(value);
+            return;
+        }
+        box(list);
+    }
+    list->items.values[index] = value;
+    heap_write_barrier(heap, &list->object, value);
+}
+
+void list_append(Heap *heap, ListObject *list, Value value) {
+    reserve(heap, list, list->count + 1);
+    list->count++;
+    list_set(heap, list, list->count - 1, value);
+}
+
+Value list_from_values(Heap *heap, const Value *values, size_t count) {
+    ListObject *list = list_create(heap, count);
+    list->count = count;
+    for (size_t i = 0; i < count; i++) {
+        list_set(heap, list, i, values[i]);
+    }
+    return (Value)(uintptr_t)list;
+}
+
+bool sequence_index(Value index, size_t count, size_t *result) {
+    // A boxed integer is beyond any length
+    if (!value_is_small_int(index)) {
+        return false;
+    }
+    int64_t position = value_as_small_int(index);
+    if (position < 0) {
+        position += (int64_t)count;
+    }
+    if (position < 0 || (uint64_t)position >= count) {
+        return false;
+    }
+    *result = (size_t)position;
+    return true;
+}
+
+Value list_concat(Heap *heap, const ListObject *a, const ListObject *b) {
+    ListObject *list = list_create(heap, a->count + b->count);
+    list->count = a->count + b->count;
+    if (a->unboxed && b->unboxed) {
+        if (list->count > 0) {
+            memcpy(list->items.ints, a->items.ints, a->count * sizeof(int64_t));
+            memcpy(list->items.ints + a->count, b->items.ints, b->count * sizeof(int64_t));
+        }
+    } else {
+        for (size_t i = 0; i < a->count; i++) {
+            list_set(heap, list, i, list_get(a, i));
+        }
+        for (size_t i = 0; i < b->count; i++) {
+            list_set(heap, list, a->count + i, list_get(b, i));
+        }
+    }
+    return (Value)(uintptr_t)list;
+}
+
+// Sum small integers exactly. Each is split into a signed high and an
+// unsigned low 32-bit half, summed in separate lanes; within a block
+// neither total can overflow.
+#define SUM_BLOCK ((size_t)1 << 30)
+
+static Integer sum_ints(const int64_t *items, size_t count) {
+    Integer total = integer_from_int64(0);
+    for (size_t start = 0; start < count; start += SUM_BLOCK) {
+        size_t end = count - start > SUM_BLOCK ? start + SUM_BLOCK : count;
+        Int64Vector high = splat(0);
+        Int64Vector low = splat(0);
+        size_t i = start;
+        for (; i + LANES <= end; i += LANES) {
+            Int64Vector vector = load_vector(items + i);
+            high += vector >> 32;
+            low += vector & 0xFFFFFFFF;
+        }
+        int64_t high_sum = 0;
+        int64_t low_sum = 0;
+        for (int lane = 0; lane < LANES; lane++) {
+            high_sum += high[lane];
+            low_sum += low[lane];
+        }
+        for (; i < end; i++) {
+            high_sum += items[i] >> 32;
+            low_sum += items[i] & 0xFFFFFFFF;
+        }
+
+        Integer shifted = integer_mul(integer_from_int64(high_sum), integer_from_int64((int64_t)1 << 32));
+        Integer block = integer_add(shifted, integer_from_int64(low_sum));
+        Integer sum = integer_add(total, block);
+        integer_free(&shifted);
+        integer_free(&block);
+        integer_free(&total);
+        total = sum;
+    }
+    return total;
+}
+
+static void unsupported(char *error, const char *op, Value a, Value b) {
+    snprintf(error, MAX_ERROR_MESSAGE_LENGTH, "Unsupported operand types for %s: '%s' and '%s'", op,
+             value_type_name(a), value_type_name(b));
+}
+
+bool list_sum(Heap *heap, const ListObject *list, Value *result, char *error) {
+    if (list->unboxed) {
+        *result = value_from_integer(heap, sum_ints(list->items.ints, list->count));
+        return true;
+    }
+    Value total = value_from_small_int(0);
+    for (size_t i = 0; i < list->count; i++) {
+        Value sum;
+        if (!value_add(heap, total, list->items.values[i], &sum)) {
+            unsupported(error, "+", total, list->items.values[i]);
+            return false;
+        }
+        total = sum;
+    }
+    *result = total;
+    return true;
+}
+
+// The smallest of `count` integers, or with `flip` set to -1 the largest:
+// complementing every bit reverses the order
+static int64_t extreme_int(const int64_t *items, size_t count, int64_t flip) {
+    Int64Vector best = splat(items[0] ^ flip);
+    size_t i = 0;
+    for (; i + LANES <= count; i += LANES) {
+        Int64Vector vector = load_vector(items + i) ^ flip;
+        Int64Vector smaller = vector < best;
+        best = (vector & smaller) | (best & ~smaller);
+    }
+    int64_t result = best[0];
+    for (int lane = 1; lane < LANES; lane++) {
+        result = best[lane] < result ? best[lane] : result;
+    }
+    for (; i < count; i++) {
+        int64_t item = items[i] ^ flip;
+        result = item < result ? item : result;
+    }
+    return result ^ flip;
+}
+
+bool list_extreme(const ListObject *list, bool want_max, Value *result, char *error) {
+    if (list->unboxed) {
+        *result = value_from_small_int(extreme_int(list->items.ints, list->count, want_max ? -1 : 0));
+        return true;
+    }
+    Value best = list->items.values[0];
+    for (size_t i = 1; i < list->count; i++) {
+        Value item = list->items.values[i];
+        bool better;
+        if (!value_less(want_max ? best : item, want_max ? item : best, &better)) {
+            unsupported(error, "<", item, best);
+            return false;
+        }
+        if (better) {
+            best = item;
+        }
+    }
+    *result = best;
+    return true;
+}
+
+// out[i] = a[i] + b[i * b_step]; a step of 0 repeats one value. The
+// operands are 63-bit, so their sum fits in 64; returns false if any sum
+// needs more than 63.
+static bool add_ints(int64_t *out, const int64_t *a, const int64_t *b, size_t b_step, size_t count) {
+    UInt64Vector outside = {0};
+    size_t i = 0;
+    for (; i + LANES <= count; i += LANES) {
+        UInt64Vector x = (UInt64Vector)load_vector(a + i);
+        UInt64Vector y = (UInt64Vector)(b_step ? load_vector(b + i) : splat(b[0]));
+        UInt64Vector sum = x + y;
+        // The top two bits differ when the sum leaves 63 bits
+        outside |= sum ^ (sum << 1);
+        store_vector(out + i, (Int64Vector)sum);
+    }
+    uint64_t tail = 0;
+    for (int lane = 0; lane < LANES; lane++) {
+        tail |= outside[lane];
+    }
+    for (; i < count; i++) {
+        uint64_t sum = (uint64_t)a[i] + (uint64_t)b[i * b_step];
+        tail |= sum ^ (sum << 1);
+        out[i] = (int64_t)sum;
+    }
+    return (tail >> 63) == 0;
+}
+
+// Bits needed for the magnitude of each of `count` integers. x ^ (x >> 63)
+// is |x| for x >= 0 and |x| - 1 otherwise, so no element exceeds 2^bits.
+static int magnitude_bits(const int64_t *items, size_t count) {
+    Int64Vector bits = splat(0);
+    size_t i = 0;
+    for (; i + LANES <= count; i += LANES) {
+        Int64Vector vector = load_vector(items + i);
+        bits |= vector ^ (vector >> 63);
+    }
+    int64_t all = 0;
+    for (int lane = 0; lane < LANES; lane++) {
+        all |= bits[lane];
+    }
+    for (; i < count; i++) {
+        all |= items[i] ^ (items[i] >> 63);
+    }
+    return all == 0 ? 0 : 64 - __builtin_clzll((uint64_t)all);
+}
+
+// out[i] = a[i] * b[i * b_step]. When the operands' magnitudes show that
+// no product can leave 63 bits, the products are taken a vector at a time
+// without checks. Returns false if some product does.
+static bool multiply_ints(int64_t *out, const int64_t *a, const int64_t *b, size_t b_step, size_t count) {
+    if (magnitude_bits(a, count) + magnitude_bits(b, b_step ? count : 1) <= 61) {
+        size_t i = 0;
+        for (; i + LANES <= count; i += LANES) {
+            UInt64Vector x = (UInt64Vector)load_vector(a + i);
+            UInt64Vector y = (UInt64Vector)(b_step ? load_vector(b + i) : splat(b[0]));
+            store_vector(out + i, (Int64Vector)(x * y));
+        }
+        for (; i < count; i++) {
+            out[i] = a[i] * b[i * b_step];
+        }
+        return true;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (__builtin_mul_overflow(a[i], b[i * b_step], &out[i]) || out[i] < SMALL_INT_MIN ||
+            out[i] > SMALL_INT_MAX) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool list_elementwise(Heap *heap, Value a, Value b, bool multiply, Value *result, char *error) {
+    ListObject *left = value_is_list(a) ? value_as_list(a) : NULL;
+    ListObject *right = value_is_list(b) ? value_as_list(b) : NULL;
+    if (left == NULL && right == NULL) {
+        snprintf(error, MAX_ERROR_MESSAGE_LENGTH, "Expected a list, got '%s' and '%s'",
+                 value_type_name(a), value_type_name(b));
+        return false;
+    }
+    if (left != NULL && right != NULL && left->count != right->count) {
+        snprintf(error, MAX_ERROR_MESSAGE_LENGTH, "Lists have different lengths: %zu and %zu",
+                 left->count, right->count);
+        return false;
+    }
+    size_t count = left ? left->count : right->count;
+    ListObject *list = list_create(heap, count);
+    list->count = count;
+    *result = (Value)(uintptr_t)list;
+
+    // Both operands as unboxed integers, a scalar with a step of 0
+    const int64_t *left_ints = NULL;
+    const int64_t *right_ints = NULL;
+    int64_t left_scalar = value_is_small_int(a) ? value_as_small_int(a) : 0;
+    int64_t right_scalar = value_is_small_int(b) ? value_as_small_int(b) : 0;
+    size_t left_step = 1;
+    size_t right_step = 1;
+    if (left ? left->unboxed : value_is_small_int(a)) {
+        left_ints = left ? left->items.ints : &left_scalar;
+        left_step = left ? 1 : 0;
+    }
+    if (right ? right->unboxed : value_is_small_int(b)) {
+        right_ints = right ? right->items.ints : &right_scalar;
+        right_step = right ? 1 : 0;
+    }
+    if (left_ints != NULL && right_ints != NULL) {
+        // Put the list first; both operations commute on integers
+        if (left_step == 0) {
+            const int64_t *swap = left_ints;
+            left_ints = right_ints;
+            right_ints = swap;
+            right_step = 0;
+        }
+        bool fits = multiply ? multiply_ints(list->items.ints, left_ints, right_ints, right_step, count)
+                             : add_ints(list->items.ints, left_ints, right_ints, right_step, count);
+        if (fits) {
+            return true;
+        }
+    }
+
+    // Element by element, in operand order since + on strings does not commute
+    for (size_t i = 0; i < count; i++) {
+        Value x = left ? list_get(left, i) : a;
+        Value y = right ? list_get(right, i) : b;
+        Value item;
+        bool ok = multiply ? value_mul(heap, x, y, &item) : value_add(heap, x, y, &item);
+        if (!ok) {
+            unsupported(error, multiply ? "*" : "+", x, y);
+            return false;
+        }
+        list_set(heap, list, i, item);
+    }
+    return true;
+}
+
+#define SIGN_BIT ((uint64_t)1 << 63)
+
+// Least significant digit radix sort, a byte per pass, on the integers
+// with their sign bit flipped so they order as unsigned. A pass in which
+// every element has the same byte is skipped.
+static void radix_sort(int64_t *items, size_t count) {
+    size_t counts[8][256];
+    memset(counts, 0, sizeof(counts));
+    for (size_t i = 0; i < count; i++) {
+        uint64_t key = (uint64_t)items[i] ^ SIGN_BIT;
+        for (int byte = 0; byte < 8; byte++) {
+            counts[byte][(key >> (8 * byte)) & 0xFF]++;
+        }
+    }
+
+    int64_t *scratch = safe_malloc(count * sizeof(int64_t));
+    int64_t *from = items;
+    int64_t *to = scratch;
+    for (int byte = 0; byte < 8; byte++) {
+        int shift = 8 * byte;
+        if (counts[byte][(((uint64_t)from[0] ^ SIGN_BIT) >> shift) & 0xFF] == count) {
+            continue;
+        }
+        size_t offsets[256];
+        size_t offset = 0;
+        for (int digit = 0; digit < 256; digit++) {
+            offsets[digit] = offset;
+            offset += counts[byte][digit];
+        }
+        for (size_t i = 0; i < count; i++) {
+            to[offsets[(((uint64_t)from[i] ^ SIGN_BIT) >> shift) & 0xFF]++] = from[i];
+        }
+        int64_t *swap = from;
+        from = to;
+        to = swap;
+    }
+    if (from != items) {
+        memcpy(items, from, count * sizeof(int64_t));
+    }
+    free(scratch);
+}
+
+// Bottom-up merge sort, stable. Returns false if two elements cannot be
+// compared.
+static bool merge_sort(Value *items, size_t count, char *error) {
+    Value *scratch = safe_malloc(count * sizeof(Value));
+    Value *from = items;
+    Value *to = scratch;
+    bool ok = true;
+    for (size_t width = 1; width < count && ok; width *= 2) {
+        for (size_t start = 0; start < count; start += 2 * width) {
+            size_t middle = start + width < count ? start + width : count;
+            size_t end = start + 2 * width < count ? start + 2 * width : count;
+            size_t i = start;
+            size_t j = middle;
+            size_t k = start;
+            while (i < middle && j < end) {
+                // Take from the right only if strictly smaller
+                bool less;
+                if (!value_less(from[j], from[i], &less)) {
+                    unsupported(error, "<", from[j], from[i]);
+                    ok = false;
+                    less = false;
+                }
+                to[k++] = less ? from[j++] : from[i++];
+            }
+            while (i < middle) {
+                to[k++] = from[i++];
+            }
+            while (j < end) {
+                to[k++] = from[j++];
+            }
+        }
+        Value *swap = from;
+        from = to;
+        to = swap;
+    }
+    if (from != items) {
+        memcpy(items, from, count * sizeof(Value));
+    }
+    free(scratch);
+    return ok;
+}
+
+bool list_sorted(Heap *heap, const ListObject *list, Value *result, char *error) {
+    ListObject *sorted = list_create(heap, list->count);
+    sorted->count = list->count;
+    sorted->unboxed = list->unboxed;
+    *result = (Value)(uintptr_t)sorted;
+    if (list->count == 0) {
+        return true;
+    }
+    memcpy(sorted->items.values, list->items.values, list->count * sizeof(Value));
+    if (list->unboxed) {
+        radix_sort(sorted->items.ints, sorted->count);
+        return true;
+    }
+    return merge_sort(sorted->items.values, sorted->count, error);
+}
+
+void release_list(ListObject *list) {
+    free(list->items.values);
+}
@@ -0,0 +1,208 @@
+//loop.c
+#include <stdlib.h>
+#include "../include/loop.h"
+#include "../include/visitor.h"
+
+// Most body nodes all the unrolled copies of a loop may have between them.
+// A test and a jump back cost about as much as a short statement, so
+// unrolling stops paying once bodies get longer than a few statements.
+#define UNROLL_BUDGET 96
+
+typedef struct {
+    const char *variable;
+    const char *bound;          // NULL for a number
+    int nodes;
+    int variable_assignments;
+    int bound_assignments;
+    bool has_loop;
+    LoopPlan *plan;
+    int product_capacity;
+    int multiplier_capacity;
+} LoopScan;
+
+static int integer_sign(Integer value) {
+    if (value.big != NULL) {
+        return value.big->sign;
+    }
+    return (value.small > 0) - (value.small < 0);
+}
+
+static bool is_variable(const ASTNode *node, const char *name) {
+    return node->type == AST_VARIABLE && node->data.variable.name == name;
+}
+
+// The k of `i * k` or `k * i`, or NULL
+static const Integer *product_multiplier(const ASTNode *node, const char *variable) {
+    if (node->type != AST_BINARY_OP || node->data.binary_op.op != TOKEN_MULTIPLY) {
+        return NULL;
+    }
+    const ASTNode *left = node->data.binary_op.left;
+    const ASTNode *right = node->data.binary_op.right;
+    if (is_variable(left, variable) && right->type == AST_NUMBER) {
+        return &right->data.number;
+    }
+    if (is_variable(right, variable) && left->type == AST_NUMBER) {
+        return &left->data.number;
+    }
+    return NULL;
+}
+
+static void add_product(LoopScan *scan, const ASTNode *node, const Integer *multiplier) {
+    LoopPlan *plan = scan->plan;
+    int index = 0;
+    while (index < plan->multiplier_count && integer_compare(*plan->multipliers[index], *multiplier) != 0) {
+        index++;
+    }
+    if (index == plan->multiplier_count) {
+        if (plan->multiplier_count == scan->multiplier_capacity) {
+            scan->multiplier_capacity = scan->multiplier_capacity ? scan->multiplier_capacity * 2 : 4;
+            plan->multipliers = safe_realloc(plan->multipliers, scan->multiplier_capacity * sizeof(Integer *));
+        }
+        plan->multipliers[plan->multiplier_count++] = multiplier;
+    }
+
+    if (plan->product_count == scan->product_capacity) {
+        scan->product_capacity = scan->product_capacity ? scan->product_capacity * 2 : 4;
+        plan->products = safe_realloc(plan->products, scan->product_capacity * sizeof(ASTNode *));
+        plan->product_multipliers = safe_realloc(plan->product_multipliers, scan->product_capacity * sizeof(int));
+    }
+    plan->products[plan->product_count] = node;
+    plan->product_multipliers[plan->product_count] = index;
+    plan->product_count++;
+}
+
+static void scan_node(ASTNode *node, void *context) {
+    LoopScan *scan = context;
+    scan->nodes++;
+
+    switch (node->type) {
+        case AST_WHILE:
+        case AST_FOR:
+            scan->has_loop = true;
+            break;
+        case AST_ASSIGN:
+            if (node->data.assign.name == scan->variable) {
+                scan->variable_assignments++;
+            } else if (node->data.assign.name == scan->bound) {
+                scan->bound_assignments++;
+            }
+            break;
+        case AST_BINARY_OP:
+            {
+                const Integer *multiplier = product_multiplier(node, scan->variable);
+                if (multiplier) {
+                    add_product(scan, node, multiplier);
+                }
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+// The body's `i = i + c;` or `i = i - c;` statement, if it has one
+static const ASTNode *find_update(const ASTNode *body, const char *variable) {
+    if (body->type != AST_BLOCK) {
+        return NULL;
+    }
+    for (int i = 0; i < body->data.block.count; i++) {
+        const ASTNode *statement = body->data.block.statements[i];
+        if (statement->type != AST_ASSIGN || statement->data.assign.name != variable) {
+            continue;
+        }
+        const ASTNode *value = statement->data.assign.value;
+        if (value->type == AST_BINARY_OP &&
+            (value->data.binary_op.op == TOKEN_PLUS || value->data.binary_op.op == TOKEN_MINUS) &&
+            is_variable(value->data.binary_op.left, variable) && value->data.binary_op.right->type == AST_NUMBER &&
+            integer_sign(value->data.binary_op.right->data.number) != 0) {
+            return statement;
+        }
+    }
+    return NULL;
+}
+
+static bool plan_for_variable(const ASTNode *loop, const ASTNode *variable, const ASTNode *bound,
+                              bool variable_first, int max_factor, LoopPlan *plan) {
+    const ASTNode *body = loop->data.while_loop.body;
+    const char *name = variable->data.variable.name;
+    const ASTNode *update = find_update(body, name);
+    if (update == NULL) {
+        return false;
+    }
+
+    *plan = (LoopPlan){0};
+    LoopScan scan = {name, bound->type == AST_VARIABLE ? bound->data.variable.name : NULL,
+                     0, 0, 0, false, plan, 0, 0};
+    ASTVisitor visitor = {scan_node, NULL, NULL, &scan};
+    walk_ast((ASTNode *)body, &visitor, 1);
+
+    // i must only step at the update and n must not move at all; and the
+    // step must head towards the bound, or the loop would never end anyway
+    const ASTNode *step = update->data.assign.value->data.binary_op.right;
+    int direction = integer_sign(step->data.number);
+    if (update->data.assign.value->data.binary_op.op == TOKEN_MINUS) {
+        direction = -direction;
+    }
+    TokenType op = loop->data.while_loop.condition->data.binary_op.op;
+    bool below = op == TOKEN_LESS || op == TOKEN_LESS_EQUAL;
+    bool increasing = below == variable_first;
+
+    int factor = max_factor;
+    while (factor > 1 && scan.nodes * factor > UNROLL_BUDGET) {
+        factor--;
+    }
+    if (scan.variable_assignments != 1 || scan.bound_assignments != 0 || scan.has_loop ||
+        direction != (increasing ? 1 : -1) || scan.nodes > UNROLL_BUDGET ||
+        (factor < 2 && plan->product_count == 0)) {
+        free_loop_plan(plan);
+        return false;
+    }
+
+    plan->variable = name;
+    plan->update = update;
+    plan->step = update->data.assign.value->data.binary_op.op == TOKEN_MINUS ? integer_neg(step->data.number)
+                                                                            : integer_copy(step->data.number);
+    plan->bound = bound;
+    plan->factor = factor;
+    return true;
+}
+
+bool plan_loop(const ASTNode *loop, int max_factor, LoopPlan *plan) {
+    const ASTNode *condition = loop->data.while_loop.condition;
+    if (condition->type != AST_BINARY_OP) {
+        return false;
+    }
+    TokenType op = condition->data.binary_op.op;
+    if (op != TOKEN_LESS && op != TOKEN_LESS_EQUAL && op != TOKEN_GREATER && op != TOKEN_GREATER_EQUAL) {
+        return false;
+    }
+
+    // Either side may be the counter, so long as the other is a bound
+    const ASTNode *left = condition->data.binary_op.left;
+    const ASTNode *right = condition->data.binary_op.right;
+    bool left_bound = left->type == AST_NUMBER || left->type == AST_VARIABLE;
+    bool right_bound = right->type == AST_NUMBER || right->type == AST_VARIABLE;
+    if (left->type == AST_VARIABLE && right_bound && !is_variable(right, left->data.variable.name) &&
+        plan_for_variable(loop, left, right, true, max_factor, plan)) {
+        return true;
+    }
+    return right->type == AST_VARIABLE && left_bound && !is_variable(left, right->data.variable.name) &&
+           plan_for_variable(loop, right, left, false, max_factor, plan);
+}
+
+void free_loop_plan(LoopPlan *plan) {
+    integer_free(&plan->step);
+    free(plan->products);
+    free(plan->product_multipliers);
+    free(plan->multipliers);
+    *plan = (LoopPlan){0};
+}
+
+int find_product(const LoopPlan *plan, const ASTNode *node) {
+    for (int i = 0; i < plan->product_count; i++) {
+        if (plan->products[i] == node) {
+            return i;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,214 @@
+// main.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/compiler.h"
+#include "../include/module.h"
+#include "../include/repl.h"
+#include "../include/server.h"
+#include "../include/stream.h"
+#include "../include/common.h"
+
+static void print_usage(const char *program) {
+    fprintf(stderr, "Usage: %s <source file> <output file>\n", program);
+    fprintf(stderr, "       %s --serve <socket>\n", program);
+    fprintf(stderr, "       %s --client <socket> <source file> <output file>\n", program);
+    fprintf(stderr, "       %s --stream <source file or -> <output file or ->\n", program);
+    fprintf(stderr, "       %s --run <source file> [--gc-stats] [--heap-limit <MB>] [--unroll <factor>] [--cse]\n"
+            "             [--profile <stacks file>] [--threads <count>]\n", program);
+    fprintf(stderr, "       %s --repl [--gc-stats] [--heap-limit <MB>] [--unroll <factor>] [--cse] [--threads <count>]\n",
+            program);
+    fprintf(stderr, "       %s --build <entry file> <output dir> [-I <dir>]... [-j <jobs>]\n", program);
+}
+
+// Read a whole file into a NUL-terminated buffer; returns NULL on error
+static char *read_source_file(const char *source_file, size_t *length) {
+    FILE *input = fopen(source_file, "r");
+    if (!input) {
+        perror("Error opening source file");
+        return NULL;
+    }
+    fseek(input, 0, SEEK_END);
+    *length = ftell(input);
+    fseek(input, 0, SEEK_SET);
+
+    char *source_code = (char *)safe_malloc(*length + 1);
+    *length = fread(source_code, 1, *length, input);
+    fclose(input);
+    source_code[*length] = '\0';
+    return source_code;
+}
+
+// Read the options of --run or --repl from argv[first] on; returns false
+// on one it does not know
+static bool parse_run_options(int argc, char *argv[], int first, RunOptions *options) {
+    *options = (RunOptions){0};
+    for (int i = first; i < argc; i++) {
+        if (strcmp(argv[i], "--gc-stats") == 0) {
+            options->gc_stats = true;
+        } else if (strcmp(argv[i], "--heap-limit") == 0 && i + 1 < argc) {
+            options->heap_limit = (size_t)atol(argv[++i]) * 1024 * 1024;
+        } else if (strcmp(argv[i], "--unroll") == 0 && i + 1 < argc && atoi(argv[i + 1]) >= 1) {
+            options->unroll_factor = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--cse") == 0) {
+            options->eliminate_common = true;
+        } else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+            options->profile_path = argv[++i];
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc && atoi(argv[i + 1]) >= 1) {
+            options->threads = atoi(argv[++i]);
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+static int run_main(int argc, char *argv[]) {
+    RunOptions options;
+    if (!parse_run_options(argc, argv, 3, &options)) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    size_t length;
+    char *source_code = read_source_file(argv[2], &length);
+    if (!source_code) {
+        return EXIT_FAILURE;
+    }
+
+    ErrorList errors;
+    init_error_list(&errors);
+    bool ok = run_source(source_code, length, stdout, &errors, &options);
+    print_errors(&errors, stderr);
+
+    free_error_list(&errors);
+    free(source_code);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// A session profiles nothing, having no whole program to attribute time to
+static int repl_main(int argc, char *argv[]) {
+    RunOptions options;
+    if (!parse_run_options(argc, argv, 2, &options) || options.profile_path != NULL) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    return run_repl(stdin, stdout, &options) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Modules are searched for next to the entry file, then in each -I directory
+static int build_main(int argc, char *argv[]) {
+    const char *entry_file = argv[2];
+    const char **search_paths = safe_malloc(argc * sizeof(const char *));
+    int search_path_count = 0;
+
+    char *entry_dir = safe_strdup(entry_file);
+    char *slash = strrchr(entry_dir, '/');
+    if (slash) {
+        *slash = '\0';
+    } else {
+        strcpy(entry_dir, ".");
+    }
+    search_paths[search_path_count++] = entry_dir;
+
+    BuildOptions options = {0};
+    options.output_dir = argv[3];
+    for (int i = 4; i < argc; i++) {
+        if (strcmp(argv[i], "-I") == 0 && i + 1 < argc) {
+            search_paths[search_path_count++] = argv[++i];
+        } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            options.jobs = atoi(argv[++i]);
+        } else {
+            print_usage(argv[0]);
+            free(search_paths);
+            free(entry_dir);
+            return EXIT_FAILURE;
+        }
+    }
+    options.search_paths = search_paths;
+    options.search_path_count = search_path_count;
+
+    bool ok = build_modules(entry_file, &options);
+    free(search_paths);
+    free(entry_dir);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// "-" reads from stdin or writes to stdout
+static int stream_main(const char *source_file, const char *output_file) {
+    FILE *input = strcmp(source_file, "-") == 0 ? stdin : fopen(source_file, "r");
+    if (!input) {
+        perror("Error opening source file");
+        return EXIT_FAILURE;
+    }
+    FILE *output = strcmp(output_file, "-") == 0 ? stdout : fopen(output_file, "w");
+    if (!output) {
+        perror("Error opening output file");
+        if (input != stdin) {
+            fclose(input);
+        }
+        return EXIT_FAILURE;
+    }
+
+    bool ok = compile_stream(input, output);
+
+    if (input != stdin) {
+        fclose(input);
+    }
+    if (output != stdout) {
+        fclose(output);
+    }
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc == 3 && strcmp(argv[1], "--serve") == 0) {
+        return run_compile_server(argv[2]);
+    }
+    if (argc == 5 && strcmp(argv[1], "--client") == 0) {
+        return run_compile_client(argv[2], argv[3], argv[4]);
+    }
+    if (argc == 4 && strcmp(argv[1], "--stream") == 0) {
+        return stream_main(argv[2], argv[3]);
+    }
+    if (argc >= 3 && strcmp(argv[1], "--run") == 0) {
+        return run_main(argc, argv);
+    }
+    if (argc >= 2 && strcmp(argv[1], "--repl") == 0) {
+        return repl_main(argc, argv);
+    }
+    if (argc >= 4 && strcmp(argv[1], "--build") == 0) {
+        return build_main(argc, argv);
+    }
+    if (argc != 3) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    const char *source_file = argv[1];
+    const char *output_file = argv[2];
+
+    // Read the source file
+    size_t length;
+    char *source_code = read_source_file(source_file, &length);
+    if (!source_code) {
+        return EXIT_FAILURE;
+    }
+
+    // Open the output file
+    FILE *output = fopen(output_file, "w");
+    if (!output) {
+        perror("Error opening output file");
+        free(source_code);
+        return EXIT_FAILURE;
+    }
+
+    // Compile the source code
+    bool ok = compile(source_code, output);
+
+    // Clean up
+    fclose(output);
+    free(source_code);
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,599 @@
+// module.c - multi-module builds
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "../include/module.h"
+#include "../include/compiler.h"
+#include "../include/common.h"
+
+typedef struct {
+    Module **modules;            // In discovery order
+    int count;
+    InternTable *names;
+    const BuildOptions *options;
+
+    // Modules whose imports are all finished, oldest first
+    Module **ready;
+    int ready_head;
+    int ready_tail;
+    int remaining;               // Modules not processed yet
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+} Build;
+
+static char *read_file(const char *path, size_t *length) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        return NULL;
+    }
+    Buffer buffer;
+    buffer_init(&buffer);
+    char chunk[65536];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        buffer_append(&buffer, chunk, n);
+    }
+    fclose(file);
+    buffer_append(&buffer, "", 0);
+    *length = buffer.length;
+    return buffer.data;
+}
+
+static char *join_path(const char *directory, const char *name, const char *extension) {
+    size_t length = strlen(directory) + strlen(name) + strlen(extension) + 2;
+    char *path = safe_malloc(length);
+    snprintf(path, length, "%s/%s%s", directory, name, extension);
+    return path;
+}
+
+static char *resolve_module(const BuildOptions *options, const char *name) {
+    for (int i = 0; i < options->search_path_count; i++) {
+        char *path = join_path(options->search_paths[i], name, ".kpy");
+        if (access(path, R_OK) == 0) {
+            return path;
+        }
+        free(path);
+    }
+    return NULL;
+}
+
+static int compare_names(const void *a, const void *b) {
+    return strcmp(*(const char *const *)a, *(const char *const *)b);
+}
+
+// Sorted, so the interface hash does not depend on statement order
+static uint64_t hash_interface(const char **exports, int count) {
+    Buffer text;
+    buffer_init(&text);
+    for (int i = 0; i < count; i++) {
+        buffer_append_str(&text, exports[i]);
+        buffer_append(&text, "\n", 1);
+    }
+    uint64_t hash = hash_bytes(text.data ? text.data : "", text.length);
+    buffer_free(&text);
+    return hash;
+}
+
+static void add_name(const char ***names, int *count, const char *name) {
+    *names = safe_realloc(*names, (*count + 1) * sizeof(const char *));
+    (*names)[(*count)++] = name;
+}
+
+// Variables assigned anywhere in a module are its exports
+static void collect_exports(ASTNode *node, const char ***exports, int *count) {
+    if (node == NULL) return;
+
+    switch (node->type) {
+        case AST_PROGRAM:
+        case AST_BLOCK:
+            for (int i = 0; i < node->data.block.count; i++) {
+                collect_exports(node->data.block.statements[i], exports, count);
+            }
+            break;
+        case AST_IF:
+            collect_exports(node->data.if_stmt.if_body, exports, count);
+            collect_exports(node->data.if_stmt.else_body, exports, count);
+            break;
+        case AST_WHILE:
+            collect_exports(node->data.while_loop.body, exports, count);
+            break;
+        case AST_FOR:
+            add_name(exports, count, node->data.for_loop.variable);
+            collect_exports(node->data.for_loop.body, exports, count);
+            break;
+        case AST_ASSIGN:
+            add_name(exports, count, node->data.assign.name);
+            break;
+        default:
+            break;
+    }
+}
+
+static void collect_imports(ASTNode *node, const char ***imports, int **lines, int *count) {
+    if (node == NULL) return;
+
+    switch (node->type) {
+        case AST_PROGRAM:
+        case AST_BLOCK:
+            for (int i = 0; i < node->data.block.count; i++) {
+                collect_imports(node->data.block.statements[i], imports, lines, count);
+            }
+            break;
+        case AST_IF:
+            collect_imports(node->data.if_stmt.if_body, imports, lines, count);
+            collect_imports(node->data.if_stmt.else_body, imports, lines, count);
+            break;
+        case AST_WHILE:
+            collect_imports(node->data.while_loop.body, imports, lines, count);
+            break;
+        case AST_FOR:
+            collect_imports(node->data.for_loop.body, imports, lines, count);
+            break;
+        case AST_IMPORT:
+            *lines = safe_realloc(*lines, (*count + 1) * sizeof(int));
+            (*lines)[*count] = node->line;
+            add_name(imports, count, node->data.import_stmt.module);
+            break;
+        default:
+            break;
+    }
+}
+
+// Interface files
+
+static void write_interface(Build *build, Module *module) {
+    char *path = join_path(build->options->output_dir, module->name, ".kpyi");
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        report_error(&module->errors, ERROR_CODEGEN, 0, "Cannot write interface file %s", path);
+        free(path);
+        return;
+    }
+    fprintf(file, "source %016llx\n", (unsigned long long)module->source_hash);
+    fprintf(file, "interface %016llx\n", (unsigned long long)module->interface_hash);
+    for (int i = 0; i < module->import_count; i++) {
+        fprintf(file, "import %s %016llx %d\n", module->imports[i]->name,
+                (unsigned long long)module->imports[i]->interface_hash, module->import_lines[i]);
+    }
+    for (int i = 0; i < module->export_count; i++) {
+        fprintf(file, "export %s\n", module->exports[i]);
+    }
+    fclose(file);
+    free(path);
+}
+
+// Load the previous build's interface if it was built from the same source
+static void load_interface(Build *build, Module *module) {
+    char *path = join_path(build->options->output_dir, module->name, ".kpyi");
+    FILE *file = fopen(path, "r");
+    free(path);
+    if (!file) {
+        return;
+    }
+
+    char line[MAX_IDENTIFIER_LENGTH + 64];
+    char name[MAX_IDENTIFIER_LENGTH];
+    unsigned long long hash;
+    int import_line;
+    bool source_matches = false;
+    while (fgets(line, sizeof(line), file)) {
+        if (sscanf(line, "source %llx", &hash) == 1) {
+            source_matches = hash == module->source_hash;
+        } else if (sscanf(line, "interface %llx", &hash) == 1) {
+            module->cached_interface_hash = hash;
+        } else if (sscanf(line, "import %255s %llx %d", name, &hash, &import_line) == 3) {
+            module->cached_import_hashes = safe_realloc(module->cached_import_hashes,
+                                                        (module->cached_import_count + 1) * sizeof(uint64_t));
+            module->cached_import_lines = safe_realloc(module->cached_import_lines,
+                                                       (module->cached_import_count + 1) * sizeof(int));
+            module->cached_import_hashes[module->cached_import_count] = hash;
+            module->cached_import_lines[module->cached_import_count] = import_line;
+            add_name(&module->cached_import_names, &module->cached_import_count,
+                     intern_string(build->names, name, strlen(name)));
+        } else if (sscanf(line, "export %255s", name) == 1) {
+            add_name(&module->cached_exports, &module->cached_export_count,
+                     intern_string(build->names, name, strlen(name)));
+        }
+    }
+    fclose(file);
+    module->cache_valid = source_matches;
+}
+
+// Dependency graph
+
+static Module *find_module(Build *build, const char *name) {
+    for (int i = 0; i < build->count; i++) {
+        if (build->modules[i]->name == name) {
+            return build->modules[i];
+        }
+    }
+    return NULL;
+}
+
+static Module *add_module(Build *build, const char *name, char *path) {
+    Module *module = safe_malloc(sizeof(Module));
+    memset(module, 0, sizeof(Module));
+    module->name = name;
+    module->path = path;
+    module->state = MODULE_PENDING;
+    init_error_list(&module->errors);
+
+    build->modules = safe_realloc(build->modules, (build->count + 1) * sizeof(Module *));
+    build->modules[build->count++] = module;
+    return module;
+}
+
+static void link_import(Module *module, Module *import, int line) {
+    module->imports = safe_realloc(module->imports, (module->import_count + 1) * sizeof(Module *));
+    module->import_lines = safe_realloc(module->import_lines, (module->import_count + 1) * sizeof(int));
+    module->imports[module->import_count] = import;
+    module->import_lines[module->import_count] = line;
+    module->import_count++;
+
+    import->dependents = safe_realloc(import->dependents, (import->dependent_count + 1) * sizeof(Module *));
+    import->dependents[import->dependent_count++] = module;
+}
+
+// Read a module and find what it imports. Unchanged modules take their
+// imports from the previous build; others are parsed now.
+static void load_module(Build *build, Module *module) {
+    module->source = read_file(module->path, &module->source_length);
+    if (module->source == NULL) {
+        report_error(&module->errors, ERROR_PARSER, 0, "Cannot read %s", module->path);
+        module->state = MODULE_FAILED;
+        return;
+    }
+    module->source_hash = hash_bytes(module->source, module->source_length);
+    load_interface(build, module);
+
+    const char **imports = NULL;
+    int *lines = NULL;
+    int count = 0;
+    if (module->cache_valid) {
+        for (int i = 0; i < module->cached_import_count; i++) {
+            lines = safe_realloc(lines, (count + 1) * sizeof(int));
+            lines[count] = module->cached_import_lines[i];
+            add_name(&imports, &count, module->cached_import_names[i]);
+        }
+    } else {
+        module->ast = parse_source(module->source, module->source_length, &module->errors, build->names, false);
+        if (module->ast == NULL) {
+            module->state = MODULE_FAILED;
+            return;
+        }
+        collect_imports(module->ast, &imports, &lines, &count);
+    }
+
+    for (int i = 0; i < count; i++) {
+        Module *import = find_module(build, imports[i]);
+        if (import == NULL) {
+            char *path = resolve_module(build->options, imports[i]);
+            if (path == NULL) {
+                report_error(&module->errors, ERROR_SEMANTIC, lines[i], "Cannot find module '%s'", imports[i]);
+                module->state = MODULE_FAILED;
+                continue;
+            }
+            import = add_module(build, imports[i], path);
+        }
+        link_import(module, import, lines[i]);
+    }
+    free(imports);
+    free(lines);
+}
+
+// Depth-first search for import cycles; modules on a cycle fail
+static bool find_cycle(Module *module, int *marks, Build *build, Module **stack, int depth) {
+    int index = 0;
+    while (build->modules[index] != module) {
+        index++;
+    }
+    if (marks[index] == 2) {
+        return false;
+    }
+    if (marks[index] == 1) {
+        // `module` is on the stack: report the loop back to it
+        Buffer path;
+        buffer_init(&path);
+        int start = 0;
+        while (stack[start] != module) {
+            start++;
+        }
+        for (int i = start; i < depth; i++) {
+            buffer_appendf(&path, "%s -> ", stack[i]->name);
+            stack[i]->state = MODULE_FAILED;
+        }
+        buffer_append_str(&path, module->name);
+        report_error(&module->errors, ERROR_SEMANTIC, 0, "Import cycle: %s", path.data);
+        buffer_free(&path);
+        return true;
+    }
+
+    marks[index] = 1;
+    stack[depth] = module;
+    bool found = false;
+    for (int i = 0; i < module->import_count; i++) {
+        found |= find_cycle(module->imports[i], marks, build, stack, depth + 1);
+    }
+    marks[index] = 2;
+    return found;
+}
+
+// Compilation
+
+static bool write_output(Build *build, Module *module, const Buffer *output) {
+    char *path = join_path(build->options->output_dir, module->name, ".kpyc");
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        report_error(&module->errors, ERROR_CODEGEN, 0, "Cannot write output file %s", path);
+        free(path);
+        return false;
+    }
+    fwrite(output->data ? output->data : "", 1, output->length, file);
+    fclose(file);
+    free(path);
+    return true;
+}
+
+static bool is_up_to_date(Build *build, Module *module) {
+    if (!module->cache_valid || module->cached_import_count != module->import_count) {
+        return false;
+    }
+    for (int i = 0; i < module->import_count; i++) {
+        if (module->cached_import_names[i] != module->imports[i]->name ||
+            module->cached_import_hashes[i] != module->imports[i]->interface_hash) {
+            return false;
+        }
+    }
+    char *path = join_path(build->options->output_dir, module->name, ".kpyc");
+    bool exists = access(path, R_OK) == 0;
+    free(path);
+    return exists;
+}
+
+static void compile_module(Build *build, Module *module) {
+    if (module->state == MODULE_FAILED) {
+        return;
+    }
+    for (int i = 0; i < module->import_count; i++) {
+        Module *import = module->imports[i];
+        if (import->state == MODULE_FAILED || import->state == MODULE_SKIPPED) {
+            report_error(&module->errors, ERROR_SEMANTIC, module->import_lines[i],
+                         "Not compiled because module '%s' failed", import->name);
+            module->state = MODULE_SKIPPED;
+            return;
+        }
+    }
+
+    if (is_up_to_date(build, module)) {
+        module->exports = module->cached_exports;
+        module->export_count = module->cached_export_count;
+        module->cached_exports = NULL;
+        module->interface_hash = module->cached_interface_hash;
+        module->state = MODULE_UP_TO_DATE;
+        return;
+    }
+
+    if (module->ast == NULL) {
+        module->ast = parse_source(module->source, module->source_length, &module->errors, build->names, false);
+        if (module->ast == NULL) {
+            module->state = MODULE_FAILED;
+            return;
+        }
+    }
+
+    // Imports are registered as module symbols for the semantic analyzer
+    SymbolTable *symbol_table = create_symbol_table(128);
+    for (int i = 0; i < module->import_count; i++) {
+        Symbol *symbol = insert_symbol(symbol_table, module->imports[i]->name, SYMBOL_MODULE);
+        symbol->info.module.exports = module->imports[i]->exports;
+        symbol->info.module.export_count = module->imports[i]->export_count;
+    }
+
+    Buffer output;
+    buffer_init(&output);
+    bool ok = compile_ast(module->ast, symbol_table, &output, &module->errors) &&
+              write_output(build, module, &output);
+    buffer_free(&output);
+    free_symbol_table(symbol_table);
+    if (!ok) {
+        module->state = MODULE_FAILED;
+        return;
+    }
+
+    collect_exports(module->ast, &module->exports, &module->export_count);
+    if (module->export_count > 0) {
+        qsort(module->exports, module->export_count, sizeof(const char *), compare_names);
+    }
+    int unique = 0;
+    for (int i = 0; i < module->export_count; i++) {
+        if (unique == 0 || module->exports[unique - 1] != module->exports[i]) {
+            module->exports[unique++] = module->exports[i];
+        }
+    }
+    module->export_count = unique;
+    module->interface_hash = hash_interface(module->exports, module->export_count);
+    write_interface(build, module);
+    module->state = MODULE_COMPILED;
+}
+
+static void push_ready(Build *build, Module *module) {
+    build->ready[build->ready_tail++] = module;
+}
+
+static void *build_worker(void *arg) {
+    Build *build = arg;
+    pthread_mutex_lock(&build->lock);
+    for (;;) {
+        while (build->ready_head == build->ready_tail && build->remaining > 0) {
+            pthread_cond_wait(&build->changed, &build->lock);
+        }
+        if (build->remaining == 0) {
+            break;
+        }
+        Module *module = build->ready[build->ready_head++];
+        pthread_mutex_unlock(&build->lock);
+
+        compile_module(build, module);
+
+        pthread_mutex_lock(&build->lock);
+        build->remaining--;
+        for (int i = 0; i < module->dependent_count; i++) {
+            Module *dependent = module->dependents[i];
+            if (--dependent->pending_imports == 0 && dependent->state == MODULE_PENDING) {
+                push_ready(build, dependent);
+            }
+        }
+        pthread_cond_broadcast(&build->changed);
+    }
+    pthread_mutex_unlock(&build->lock);
+    return NULL;
+}
+
+static void free_module(Module *module) {
+    free_ast(module->ast);
+    free(module->path);
+    free(module->source);
+    free(module->imports);
+    free(module->import_lines);
+    free(module->dependents);
+    free(module->cached_import_names);
+    free(module->cached_import_hashes);
+    free(module->cached_import_lines);
+    free(module->cached_exports);
+    free(module->exports);
+    free_error_list(&module->errors);
+    free(module);
+}
+
+static char *module_name_from_path(const char *path) {
+    const char *base = strrchr(path, '/');
+    base = base ? base + 1 : path;
+    size_t length = strlen(base);
+    if (length > 4 && strcmp(base + length - 4, ".kpy") == 0) {
+        length -= 4;
+    }
+    char *name = safe_malloc(length + 1);
+    memcpy(name, base, length);
+    name[length] = '\0';
+    return name;
+}
+
+// Create `path` and any missing directories above it, as `mkdir -p` does.
+// Returns false with errno set if one cannot be created.
+static bool make_directories(const char *path) {
+    char *partial = safe_strdup(path);
+    bool ok = true;
+    // Each prefix that ends before a '/', then the whole path
+    for (char *slash = strchr(partial + (partial[0] == '/'), '/'); ok; slash = strchr(slash + 1, '/')) {
+        if (slash != NULL) {
+            *slash = '\0';
+        }
+        ok = mkdir(partial, 0777) == 0 || errno == EEXIST;
+        if (slash == NULL) {
+            break;
+        }
+        *slash = '/';
+    }
+    struct stat info;
+    if (ok && (stat(path, &info) != 0 || !S_ISDIR(info.st_mode))) {
+        errno = ENOTDIR;
+        ok = false;
+    }
+    free(partial);
+    return ok;
+}
+
+bool build_modules(const char *entry_file, const BuildOptions *options) {
+    if (!make_directories(options->output_dir)) {
+        fprintf(stderr, "Cannot create output directory %s: %s\n", options->output_dir, strerror(errno));
+        return false;
+    }
+
+    Build build;
+    memset(&build, 0, sizeof(build));
+    build.options = options;
+    build.names = create_intern_table(1024);
+    pthread_mutex_init(&build.lock, NULL);
+    pthread_cond_init(&build.changed, NULL);
+
+    // Discover the graph breadth-first from the entry module
+    char *entry_name = module_name_from_path(entry_file);
+    add_module(&build, intern_string(build.names, entry_name, strlen(entry_name)), safe_strdup(entry_file));
+    free(entry_name);
+    for (int i = 0; i < build.count; i++) {
+        load_module(&build, build.modules[i]);
+    }
+
+    int *marks = safe_malloc(build.count * sizeof(int));
+    Module **stack = safe_malloc(build.count * sizeof(Module *));
+    memset(marks, 0, build.count * sizeof(int));
+    for (int i = 0; i < build.count; i++) {
+        find_cycle(build.modules[i], marks, &build, stack, 0);
+    }
+    free(marks);
+    free(stack);
+
+    // Failed modules are queued straight away so their dependents get skipped
+    build.ready = safe_malloc(build.count * sizeof(Module *));
+    build.remaining = build.count;
+    for (int i = 0; i < build.count; i++) {
+        Module *module = build.modules[i];
+        module->pending_imports = module->import_count;
+        if (module->import_count == 0 || module->state == MODULE_FAILED) {
+            push_ready(&build, module);
+        }
+    }
+
+    int jobs = options->jobs > 0 ? options->jobs : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (jobs < 1) {
+        jobs = 1;
+    }
+    if (jobs > build.count) {
+        jobs = build.count;
+    }
+    pthread_t *workers = safe_malloc(jobs * sizeof(pthread_t));
+    int started = 0;
+    while (started < jobs && pthread_create(&workers[started], NULL, build_worker, &build) == 0) {
+        started++;
+    }
+    // Workers take modules until none remain, so any number of them will do;
+    // with none at all, build on this thread
+    if (started == 0) {
+        build_worker(&build);
+    }
+    for (int i = 0; i < started; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    free(workers);
+
+    // Report in discovery order so output does not depend on scheduling
+    bool ok = true;
+    int compiled = 0;
+    int up_to_date = 0;
+    for (int i = 0; i < build.count; i++) {
+        Module *module = build.modules[i];
+        for (int j = 0; j < module->errors.count; j++) {
+            const Error *error = &module->errors.errors[j];
+            fprintf(stderr, "%s: %s error at line %d: %s\n", module->path,
+                    error_type_to_string(error->type), error->line, error->message);
+        }
+        compiled += module->state == MODULE_COMPILED;
+        up_to_date += module->state == MODULE_UP_TO_DATE;
+        ok &= module->state == MODULE_COMPILED || module->state == MODULE_UP_TO_DATE;
+    }
+    printf("Compiled %d module(s), %d up to date\n", compiled, up_to_date);
+
+    for (int i = 0; i < build.count; i++) {
+        free_module(build.modules[i]);
+    }
+    free(build.modules);
+    free(build.ready);
+    pthread_mutex_destroy(&build.lock);
+    pthread_cond_destroy(&build.changed);
+    free_intern_table(build.names);
+    return ok;
+}
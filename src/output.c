@@ -0,0 +1,56 @@
+// output.c
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "../include/output.h"
+
+void output_init(Output *output, FILE *stream) {
+    output->stream = stream;
+    output->capture = NULL;
+    output->data = safe_malloc(OUTPUT_BUFFER_SIZE);
+    output->length = 0;
+    output->line_buffered = stream != NULL && isatty(fileno(stream));
+}
+
+void output_free(Output *output) {
+    output_flush(output);
+    free(output->data);
+    output->data = NULL;
+}
+
+void output_flush(Output *output) {
+    if (output->stream == NULL) {
+        buffer_append(output->capture, output->data, output->length);
+        output->length = 0;
+        return;
+    }
+    if (output->length > 0) {
+        fwrite(output->data, 1, output->length, output->stream);
+        output->length = 0;
+    }
+    fflush(output->stream);
+}
+
+void output_write(Output *output, const char *data, size_t length) {
+    if (OUTPUT_BUFFER_SIZE - output->length < length) {
+        output_flush(output);
+        // Too big to be worth copying
+        if (length >= OUTPUT_BUFFER_SIZE) {
+            if (output->stream == NULL) {
+                buffer_append(output->capture, data, length);
+            } else {
+                fwrite(data, 1, length, output->stream);
+            }
+            return;
+        }
+    }
+    memcpy(output->data + output->length, data, length);
+    output->length += length;
+}
+
+void output_end_line(Output *output) {
+    output_write(output, "\n", 1);
+    if (output->line_buffered) {
+        output_flush(output);
+    }
+}
@@ -0,0 +1,369 @@
+//parallel.c
+#include <stdlib.h>
+#include "../include/parallel.h"
+#include "../include/builtins.h"
+#include "../include/visitor.h"
+
+// How a variable's first occurrence in the body uses it
+typedef enum {
+    FIRST_NONE,
+    FIRST_READ,
+    FIRST_ASSIGN,       // At the top level of the body
+    FIRST_NESTED_ASSIGN
+} FirstUse;
+
+typedef struct {
+    const char *name;
+    int line;               // Of its first occurrence
+    FirstUse first;
+    int reads;              // Besides the `x` of its reductions
+    int assignments;        // Other than reductions
+    int reductions;
+    ReductionKind kind;     // Of its first reduction
+    bool mixed;             // Reduced in more than one way
+} NameUse;
+
+// A list or dictionary changed in place, by the variable it is reached from
+typedef struct {
+    const char *name;
+    int line;
+} Mutation;
+
+typedef struct {
+    NameUse *names;
+    int name_count;
+    int name_capacity;
+    Mutation *mutations;
+    int mutation_count;
+    int mutation_capacity;
+    int depth;                      // Compound statements entered within the body
+    const ASTNode *reduced;         // The `x` of the reduction being walked
+    int yield_line;                 // Of a ನೀಡು in the body, or 0
+    int return_line;                // Of a ಹಿಂತಿರುಗಿಸು in the body, or 0
+    SymbolTable *symbol_table;      // Where the functions it calls are found
+} BodyScan;
+
+static bool is_variable(const ASTNode *node, const char *name) {
+    return node->type == AST_VARIABLE && node->data.variable.name == name;
+}
+
+typedef struct {
+    const char *name;
+    bool found;
+} NameSearch;
+
+static void find_name(ASTNode *node, void *context) {
+    NameSearch *search = context;
+    if (node->type == AST_VARIABLE && node->data.variable.name == search->name) {
+        search->found = true;
+    }
+}
+
+// Whether the variable `name` occurs in `node`
+static bool mentions(const ASTNode *node, const char *name) {
+    NameSearch search = {name, false};
+    ASTVisitor visitor = {find_name, NULL, NULL, &search};
+    walk_ast((ASTNode *)node, &visitor, 1);
+    return search.found;
+}
+
+const ASTNode *reduction_operand(const ASTNode *assign, ReductionKind *kind) {
+    const char *name = assign->data.assign.name;
+    const ASTNode *value = assign->data.assign.value;
+    const ASTNode *operand = NULL;
+    if (value->type == AST_BINARY_OP && value->data.binary_op.op == TOKEN_PLUS &&
+        is_variable(value->data.binary_op.left, name)) {
+        *kind = REDUCE_SUM;
+        operand = value->data.binary_op.right;
+    } else if (value->type == AST_CALL && value->data.call.count == 1 &&
+               value->data.call.arguments[0]->type == AST_LIST &&
+               value->data.call.arguments[0]->data.list.count == 2) {
+        int builtin = find_builtin(value->data.call.name);
+        ASTNode **pair = value->data.call.arguments[0]->data.list.elements;
+        if (builtin != BUILTIN_MIN && builtin != BUILTIN_MAX) {
+            return NULL;
+        }
+        *kind = builtin == BUILTIN_MIN ? REDUCE_MIN : REDUCE_MAX;
+        if (is_variable(pair[0], name)) {
+            operand = pair[1];
+        } else if (is_variable(pair[1], name)) {
+            operand = pair[0];
+        }
+    }
+    return operand != NULL && !mentions(operand, name) ? operand : NULL;
+}
+
+// The `x` that the reduction `assign` reads
+static const ASTNode *reduced_variable(const ASTNode *assign) {
+    const ASTNode *value = assign->data.assign.value;
+    if (value->type == AST_BINARY_OP) {
+        return value->data.binary_op.left;
+    }
+    ASTNode **pair = value->data.call.arguments[0]->data.list.elements;
+    return is_variable(pair[0], assign->data.assign.name) ? pair[0] : pair[1];
+}
+
+static NameUse *find_use(BodyScan *scan, const char *name, int line) {
+    for (int i = 0; i < scan->name_count; i++) {
+        if (scan->names[i].name == name) {
+            return &scan->names[i];
+        }
+    }
+    if (scan->name_count == scan->name_capacity) {
+        scan->name_capacity = scan->name_capacity ? scan->name_capacity * 2 : 16;
+        scan->names = safe_realloc(scan->names, scan->name_capacity * sizeof(NameUse));
+    }
+    NameUse *use = &scan->names[scan->name_count++];
+    *use = (NameUse){name, line, FIRST_NONE, 0, 0, 0, REDUCE_SUM, false};
+    return use;
+}
+
+static void note_first(NameUse *use, FirstUse first, int line) {
+    if (use->first == FIRST_NONE) {
+        use->first = first;
+        use->line = line;
+    }
+}
+
+// The variable a list or dictionary expression is reached from, or NULL
+static const char *root_variable(const ASTNode *node) {
+    while (node->type == AST_INDEX) {
+        node = node->data.index.object;
+    }
+    return node->type == AST_VARIABLE ? node->data.variable.name : NULL;
+}
+
+static void add_mutation(BodyScan *scan, const ASTNode *target, int line) {
+    const char *name = root_variable(target);
+    if (name == NULL) {
+        return;
+    }
+    if (scan->mutation_count == scan->mutation_capacity) {
+        scan->mutation_capacity = scan->mutation_capacity ? scan->mutation_capacity * 2 : 8;
+        scan->mutations = safe_realloc(scan->mutations, scan->mutation_capacity * sizeof(Mutation));
+    }
+    scan->mutations[scan->mutation_count++] = (Mutation){name, line};
+}
+
+// A call of a ಕಾರ್ಯ reads, when it runs, the globals its body reads and
+// those of every function it calls in turn
+static void note_call(BodyScan *scan, const ASTNode *call) {
+    if (scan->symbol_table == NULL) {
+        return;
+    }
+    const char **pending = safe_malloc(sizeof(const char *));
+    int pending_count = 0;
+    const char **seen = NULL;
+    int seen_count = 0;
+    pending[pending_count++] = call->data.call.name;
+    while (pending_count > 0) {
+        const char *name = pending[--pending_count];
+        bool visited = false;
+        for (int i = 0; i < seen_count && !visited; i++) {
+            visited = seen[i] == name;
+        }
+        if (visited) {
+            continue;
+        }
+        seen = safe_realloc(seen, (seen_count + 1) * sizeof(const char *));
+        seen[seen_count++] = name;
+
+        Symbol *symbol = lookup_symbol(scan->symbol_table, name);
+        if (symbol == NULL || symbol->type != SYMBOL_FUNCTION) {
+            if (name != call->data.call.name) {
+                NameUse *use = find_use(scan, name, call->line);
+                note_first(use, FIRST_READ, call->line);
+                use->reads++;
+            }
+            continue;
+        }
+        const char **uses = symbol->info.function.uses;
+        int use_count = symbol->info.function.use_count;
+        pending = safe_realloc(pending, (pending_count + use_count + 1) * sizeof(const char *));
+        for (int i = 0; i < use_count; i++) {
+            pending[pending_count++] = uses[i];
+        }
+    }
+    free(pending);
+    free(seen);
+}
+
+static void enter_node(ASTNode *node, void *context) {
+    BodyScan *scan = context;
+    switch (node->type) {
+        case AST_IF:
+        case AST_WHILE:
+        case AST_FOR:
+            scan->depth++;
+            break;
+        case AST_ASSIGN:
+            {
+                ReductionKind kind;
+                if (reduction_operand(node, &kind)) {
+                    // A reduction reads its variable first
+                    note_first(find_use(scan, node->data.assign.name, node->line), FIRST_READ, node->line);
+                    scan->reduced = reduced_variable(node);
+                }
+            }
+            break;
+        case AST_STORE_INDEX:
+            add_mutation(scan, node->data.store_index.object, node->line);
+            break;
+        case AST_YIELD:
+            if (scan->yield_line == 0) {
+                scan->yield_line = node->line;
+            }
+            break;
+        case AST_RETURN:
+            if (scan->return_line == 0) {
+                scan->return_line = node->line;
+            }
+            break;
+        case AST_CALL:
+            {
+                int builtin = find_builtin(node->data.call.name);
+                if ((builtin == BUILTIN_APPEND || builtin == BUILTIN_REMOVE) && node->data.call.count > 0) {
+                    add_mutation(scan, node->data.call.arguments[0], node->line);
+                } else if (builtin < 0) {
+                    note_call(scan, node);
+                }
+            }
+            break;
+        case AST_VARIABLE:
+            if (node != scan->reduced) {
+                NameUse *use = find_use(scan, node->data.variable.name, node->line);
+                note_first(use, FIRST_READ, node->line);
+                use->reads++;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+static void separate_node(ASTNode *node, int index, void *context) {
+    BodyScan *scan = context;
+    // A nested loop's variable is assigned before each of its iterations
+    if (node->type == AST_FOR && index == for_body_index(node)) {
+        NameUse *use = find_use(scan, node->data.for_loop.variable, node->line);
+        note_first(use, FIRST_ASSIGN, node->line);
+        use->assignments++;
+    }
+}
+
+static void leave_node(ASTNode *node, void *context) {
+    BodyScan *scan = context;
+    switch (node->type) {
+        case AST_IF:
+        case AST_WHILE:
+        case AST_FOR:
+            scan->depth--;
+            break;
+        case AST_ASSIGN:
+            {
+                NameUse *use = find_use(scan, node->data.assign.name, node->line);
+                ReductionKind kind;
+                if (reduction_operand(node, &kind)) {
+                    if (use->reductions > 0 && use->kind != kind) {
+                        use->mixed = true;
+                    }
+                    use->kind = kind;
+                    use->reductions++;
+                    scan->reduced = NULL;
+                } else {
+                    note_first(use, scan->depth == 0 ? FIRST_ASSIGN : FIRST_NESTED_ASSIGN, node->line);
+                    use->assignments++;
+                }
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+static bool is_reduction(const NameUse *use) {
+    return use->reductions > 0 && use->assignments == 0 && use->reads == 0 && !use->mixed;
+}
+
+bool plan_parallel_loop(const ASTNode *loop, ParallelPlan *plan, SymbolTable *symbol_table, ErrorList *errors) {
+    BodyScan scan = {0};
+    scan.symbol_table = symbol_table;
+    NameUse *variable = find_use(&scan, loop->data.for_loop.variable, loop->line);
+    variable->first = FIRST_ASSIGN;
+    variable->assignments = 1;
+    ASTVisitor visitor = {enter_node, separate_node, leave_node, &scan};
+    walk_ast(loop->data.for_loop.body, &visitor, 1);
+
+    plan->reductions = NULL;
+    plan->reduction_count = 0;
+    plan->privates = NULL;
+    plan->private_count = 0;
+    bool ok = true;
+    for (int i = 0; i < scan.name_count; i++) {
+        NameUse *use = &scan.names[i];
+        if (is_reduction(use)) {
+            plan->reductions = safe_realloc(plan->reductions, (plan->reduction_count + 1) * sizeof(Reduction));
+            plan->reductions[plan->reduction_count++] = (Reduction){use->name, use->kind};
+            continue;
+        }
+        if (use->assignments > 0) {
+            plan->privates = safe_realloc(plan->privates, (plan->private_count + 1) * sizeof(const char *));
+            plan->privates[plan->private_count++] = use->name;
+        }
+        if (use->first != FIRST_ASSIGN && (use->reductions > 0 || (use->assignments > 0 && use->reads > 0))) {
+            // Read before the iteration assigns it, so possibly another's value
+            ok = false;
+            if (errors) {
+                report_error(errors, ERROR_SEMANTIC, use->line,
+                             "'%s' may carry a value from one iteration of a parallel loop to the next; "
+                             "assign it at the start of the body, or only update it as a reduction",
+                             use->name);
+            }
+        }
+    }
+
+    // Iterations run apart from the generator's loop, with nowhere to give it values
+    if (scan.yield_line > 0) {
+        ok = false;
+        if (errors) {
+            report_error(errors, ERROR_SEMANTIC, scan.yield_line, "A parallel loop cannot yield values");
+        }
+    }
+
+    // The function would go on from wherever the iteration was run
+    if (scan.return_line > 0) {
+        ok = false;
+        if (errors) {
+            report_error(errors, ERROR_SEMANTIC, scan.return_line, "A parallel loop cannot return from its function");
+        }
+    }
+
+    // Changing a private list is fine, since each iteration made its own
+    for (int i = 0; i < scan.mutation_count; i++) {
+        NameUse *use = find_use(&scan, scan.mutations[i].name, scan.mutations[i].line);
+        if (use->assignments == 0) {
+            ok = false;
+            if (errors) {
+                report_error(errors, ERROR_SEMANTIC, scan.mutations[i].line,
+                             "A parallel loop cannot change '%s', which its iterations share",
+                             scan.mutations[i].name);
+            }
+        }
+    }
+
+    free(scan.names);
+    free(scan.mutations);
+    if (!ok) {
+        free_parallel_plan(plan);
+    }
+    return ok;
+}
+
+void free_parallel_plan(ParallelPlan *plan) {
+    free(plan->reductions);
+    free(plan->privates);
+    plan->reductions = NULL;
+    plan->reduction_count = 0;
+    plan->privates = NULL;
+    plan->private_count = 0;
+}
@@ -1,186 +1,776 @@
-//parser.c
-#include <stdio.h>
-#include <stdlib.h>
-#include "../include/parser.h"
-#include "../include/common.h"
-
-Parser *create_parser(Token **tokens, int length) {
-    Parser *parser = (Parser *)safe_malloc(sizeof(Parser));
-    parser->tokens = tokens;
-    parser->current = 0;
-    parser->length = length;
-    return parser;
-}
-
-void free_parser(Parser *parser) {
-    free(parser);
-}
-
-Token *advance(Parser *parser) {
-    if (parser->current < parser->length) {
-        return parser->tokens[parser->current++];
-    }
-    return NULL;
-}
-
-Token *peek(Parser *parser) {
-    if (parser->current < parser->length) {
-        return parser->tokens[parser->current];
-    }
-    return NULL;
-}
-
-Token *consume(Parser *parser, TokenType type, const char *message) {
-    if (peek(parser)->type == type) {
-        return advance(parser);
-    }
-    fprintf(stderr, "Parser error: %s\n", message);
-    exit(EXIT_FAILURE);
-}
-
-ASTNode *parse_program(Parser *parser) {
-    ASTNode **statements = NULL;
-    int count = 0;
-
-    while (peek(parser)->type != TOKEN_EOF) {
-        statements = (ASTNode **)safe_realloc(statements, sizeof(ASTNode *) * (count + 1));
-        statements[count++] = parse_statement(parser);
-    }
-
-    return create_program_node(statements, count);
-}
-
-ASTNode *parse_block(Parser *parser) {
-    ASTNode **statements = NULL;
-    int count = 0;
-
-    consume(parser, TOKEN_LBRACE, "Expected '{' at the beginning of a block");
-
-    while (peek(parser)->type != TOKEN_RBRACE) {
-        statements = (ASTNode **)safe_realloc(statements, sizeof(ASTNode *) * (count + 1));
-        statements[count++] = parse_statement(parser);
-    }
-
-    consume(parser, TOKEN_RBRACE, "Expected '}' at the end of a block");
-
-    return create_block_node(statements, count);
-}
-
-ASTNode *parse_statement(Parser *parser) {
-    switch (peek(parser)->type) {
-        case TOKEN_IF:
-            return parse_if_statement(parser);
-        case TOKEN_WHILE:
-            return parse_while_statement(parser);
-        case TOKEN_PRINT:
-            return parse_print_statement(parser);
-        case TOKEN_IDENTIFIER:
-            return parse_assign_statement(parser);
-        default:
-            fprintf(stderr, "Unexpected token: %s\n", token_type_to_string(peek(parser)->type));
-            exit(EXIT_FAILURE);
-    }
-}
-
-ASTNode *parse_if_statement(Parser *parser) {
-    consume(parser, TOKEN_IF, "Expected 'if'");
-
-    ASTNode *condition = parse_expression(parser);
-    ASTNode *if_body = parse_block(parser);
-    ASTNode *else_body = NULL;
-
-    if (peek(parser)->type == TOKEN_ELSE) {
-        advance(parser);  // consume 'else'
-        else_body = parse_block(parser);
-    }
-
-    return create_if_node(condition, if_body, else_body);
-}
-
-ASTNode *parse_while_statement(Parser *parser) {
-    consume(parser, TOKEN_WHILE, "Expected 'while'");
-
-    ASTNode *condition = parse_expression(parser);
-    ASTNode *body = parse_block(parser);
-
-    return create_while_node(condition, body);
-}
-
-ASTNode *parse_print_statement(Parser *parser) {
-    consume(parser, TOKEN_PRINT, "Expected 'print'");
-
-    ASTNode *expression = parse_expression(parser);
-    consume(parser, TOKEN_SEMICOLON, "Expected ';' after print statement");
-
-    return create_print_node(expression);
-}
-
-ASTNode *parse_assign_statement(Parser *parser) {
-    Token *identifier = consume(parser, TOKEN_IDENTIFIER, "Expected identifier");
-
-    consume(parser, TOKEN_EQUAL, "Expected '=' after identifier");
-    ASTNode *value = parse_expression(parser);
-    consume(parser, TOKEN_SEMICOLON, "Expected ';' after assignment");
-
-    return create_assign_node(identifier->value.string, value);
-}
-
-ASTNode *parse_expression(Parser *parser) {
-    ASTNode *left = parse_term(parser);
-
-    while (peek(parser)->type == TOKEN_PLUS || peek(parser)->type == TOKEN_MINUS) {
-        Token *op = advance(parser);
-        ASTNode *right = parse_term(parser);
-        left = create_binary_op_node(op->type, left, right);
-    }
-
-    return left;
-}
-
-ASTNode *parse_term(Parser *parser) {
-    ASTNode *left = parse_factor(parser);
-
-    while (peek(parser)->type == TOKEN_STAR || peek(parser)->type == TOKEN_SLASH) {
-        Token *op = advance(parser);
-        ASTNode *right = parse_factor(parser);
-        left = create_binary_op_node(op->type, left, right);
-    }
-
-    return left;
-}
-
-ASTNode *parse_factor(Parser *parser) {
-    if (peek(parser)->type == TOKEN_MINUS) {
-        Token *op = advance(parser);
-        ASTNode *operand = parse_primary(parser);
-        return create_unary_op_node(op->type, operand);
-    }
-
-    return parse_primary(parser);
-}
-
-ASTNode *parse_primary(Parser *parser) {
-    Token *token = advance(parser);
-
-    switch (token->type) {
-        case TOKEN_NUMBER:
-            return create_number_node(token->value.number);
-        case TOKEN_STRING:
-            return create_string_node(token->value.string);
-        case TOKEN_TRUE:
-            return create_boolean_node(true);
-        case TOKEN_FALSE:
-            return create_boolean_node(false);
-        case TOKEN_IDENTIFIER:
-            return create_variable_node(token->value.string);
-        case TOKEN_LPAREN:
-            {
-                ASTNode *expression = parse_expression(parser);
-                consume(parser, TOKEN_RPAREN, "Expected ')' after expression");
-                return expression;
-            }
-        default:
-            fprintf(stderr, "Unexpected token: %s\n", token_type_to_string(token->type));
-            exit(EXIT_FAILURE);
-    }
-}
+//parser.c
+#include <stdio.h>
+#include <stdlib.h>
+#include "../include/parser.h"
+#include "../include/common.h"
+
+Parser *create_parser(Token **tokens, int length, ErrorList *errors) {
+    Parser *parser = (Parser *)safe_malloc(sizeof(Parser));
+    parser->tokens = tokens;
+    parser->current = 0;
+    parser->length = length;
+    parser->errors = errors;
+    parser->expressions = NULL;
+    parser->depth = 0;
+    parser->too_deep = false;
+    parser->listener = NULL;
+    return parser;
+}
+
+void free_parser(Parser *parser) {
+    free(parser);
+}
+
+Token *advance(Parser *parser) {
+    // Never move past the trailing TOKEN_EOF
+    if (parser->current < parser->length - 1) {
+        return parser->tokens[parser->current++];
+    }
+    return parser->tokens[parser->length - 1];
+}
+
+Token *peek(Parser *parser) {
+    if (parser->current < parser->length) {
+        return parser->tokens[parser->current];
+    }
+    return parser->tokens[parser->length - 1];
+}
+
+Token *consume(Parser *parser, TokenType type, const char *message) {
+    if (peek(parser)->type == type) {
+        return advance(parser);
+    }
+    if (parser->too_deep) {
+        return NULL;    // Out of tokens on purpose; the cause is reported
+    }
+    report_error(parser->errors, ERROR_PARSER, peek(parser)->line, "%s", message);
+    return NULL;
+}
+
+// Skip tokens after an error until something that can start a new statement
+static void synchronize(Parser *parser) {
+    while (peek(parser)->type != TOKEN_EOF) {
+        switch (peek(parser)->type) {
+            case TOKEN_SEMICOLON:
+                advance(parser);
+                return;
+            case TOKEN_IF:
+            case TOKEN_WHILE:
+            case TOKEN_FOR:
+            case TOKEN_PARALLEL:
+            case TOKEN_PRINT:
+            case TOKEN_IMPORT:
+            case TOKEN_GENERATOR:
+            case TOKEN_YIELD:
+            case TOKEN_FUNCTION:
+            case TOKEN_RETURN:
+            case TOKEN_RBRACE:
+                return;
+            default:
+                advance(parser);
+        }
+    }
+}
+
+static ASTNode *with_line(ASTNode *node, int line) {
+    if (node) {
+        node->line = line;
+    }
+    return node;
+}
+
+static ASTNode *share(Parser *parser, ASTNode *node) {
+    return parser->expressions ? share_expression(parser->expressions, node) : node;
+}
+
+// A loop, generator or function starts or ends; see expression_barrier
+static void loop_boundary(Parser *parser) {
+    if (parser->expressions) {
+        expression_barrier(parser->expressions);
+    }
+}
+
+static void free_statements(ASTNode **statements, int count) {
+    for (int i = 0; i < count; i++) {
+        free_ast(statements[i]);
+    }
+    free(statements);
+}
+
+static bool parse_expression_list(Parser *parser, TokenType close, const char *message,
+                                  ASTNode ***expressions, int *count);
+
+// Enter an expression or block. Past MAX_NESTING_DEPTH, reports an error,
+// skips to the end of the tokens and returns false.
+static bool descend(Parser *parser) {
+    if (parser->depth < MAX_NESTING_DEPTH) {
+        parser->depth++;
+        return true;
+    }
+    report_error(parser->errors, ERROR_PARSER, peek(parser)->line, "Nested more than %d levels deep",
+                 MAX_NESTING_DEPTH);
+    parser->current = parser->length - 1;
+    parser->too_deep = true;
+    return false;
+}
+
+ASTNode *parse_top_level_statement(Parser *parser) {
+    ASTNode *statement;
+    parser->depth = 0;
+    parser->too_deep = false;
+    if (peek(parser)->type == TOKEN_GENERATOR) {
+        statement = parse_generator_definition(parser);
+    } else if (peek(parser)->type == TOKEN_FUNCTION) {
+        statement = parse_function_definition(parser);
+    } else {
+        statement = parse_statement(parser);
+    }
+    if (statement == NULL) {
+        synchronize(parser);
+        // A stray '}' cannot start anything at the top level
+        if (peek(parser)->type == TOKEN_RBRACE) {
+            advance(parser);
+        }
+    }
+    return statement;
+}
+
+ASTNode *parse_program(Parser *parser) {
+    ASTNode **statements = NULL;
+    int count = 0;
+    int error_count = parser->errors->count;
+
+    while (peek(parser)->type != TOKEN_EOF) {
+        ASTNode *statement = parse_top_level_statement(parser);
+        if (statement == NULL) {
+            continue;
+        }
+        statements = (ASTNode **)safe_realloc(statements, sizeof(ASTNode *) * (count + 1));
+        statements[count++] = statement;
+    }
+
+    if (parser->errors->count > error_count) {
+        free_statements(statements, count);
+        return NULL;
+    }
+    return with_line(create_program_node(statements, count), 1);
+}
+
+static ASTNode *parse_block_inside(Parser *parser, Token *brace, int open) {
+    ASTNode **statements = NULL;
+    int *starts = NULL;
+    int count = 0;
+    int error_count = parser->errors->count;
+
+    while (peek(parser)->type != TOKEN_RBRACE && peek(parser)->type != TOKEN_EOF) {
+        int start = parser->current;
+        ASTNode *statement = parse_statement(parser);
+        if (statement == NULL) {
+            synchronize(parser);
+            continue;
+        }
+        statements = (ASTNode **)safe_realloc(statements, sizeof(ASTNode *) * (count + 1));
+        if (parser->listener) {
+            starts = (int *)safe_realloc(starts, sizeof(int) * (count + 1));
+            starts[count] = start;
+        }
+        statements[count++] = statement;
+    }
+
+    if (!consume(parser, TOKEN_RBRACE, "Expected '}' at the end of a block") ||
+        parser->errors->count > error_count) {
+        free_statements(statements, count);
+        free(starts);
+        return NULL;
+    }
+
+    ASTNode *block = with_line(create_block_node(statements, count), brace->line);
+    if (parser->listener) {
+        parser->listener->block(block, open, parser->current - 1, starts, parser->depth, parser->listener->context);
+    }
+    return block;
+}
+
+ASTNode *parse_block(Parser *parser) {
+    int open = parser->current;
+    Token *brace = consume(parser, TOKEN_LBRACE, "Expected '{' at the beginning of a block");
+    if (brace == NULL || !descend(parser)) {
+        return NULL;
+    }
+    ASTNode *block = parse_block_inside(parser, brace, open);
+    parser->depth--;
+    return block;
+}
+
+ASTNode *parse_statement(Parser *parser) {
+    switch (peek(parser)->type) {
+        case TOKEN_IF:
+            return parse_if_statement(parser);
+        case TOKEN_WHILE:
+            return parse_while_statement(parser);
+        case TOKEN_FOR:
+        case TOKEN_PARALLEL:
+            return parse_for_statement(parser);
+        case TOKEN_PRINT:
+            return parse_print_statement(parser);
+        case TOKEN_IDENTIFIER:
+            return parse_assign_statement(parser);
+        case TOKEN_IMPORT:
+            return parse_import_statement(parser);
+        case TOKEN_YIELD:
+            return parse_yield_statement(parser);
+        case TOKEN_RETURN:
+            return parse_return_statement(parser);
+        case TOKEN_GENERATOR:
+            {
+                // Parsed whole so the error does not spill into what follows
+                int line = peek(parser)->line;
+                free_ast(parse_generator_definition(parser));
+                report_error(parser->errors, ERROR_PARSER, line, "Generators can only be defined at the top level");
+                return NULL;
+            }
+        case TOKEN_FUNCTION:
+            {
+                int line = peek(parser)->line;
+                free_ast(parse_function_definition(parser));
+                report_error(parser->errors, ERROR_PARSER, line, "Functions can only be defined at the top level");
+                return NULL;
+            }
+        case TOKEN_ERROR:
+            // The lexer has already reported this token
+            advance(parser);
+            return NULL;
+        default:
+            report_error(parser->errors, ERROR_PARSER, peek(parser)->line,
+                         "Unexpected token: %s", token_type_to_string(peek(parser)->type));
+            advance(parser);
+            return NULL;
+    }
+}
+
+ASTNode *parse_if_statement(Parser *parser) {
+    Token *keyword = consume(parser, TOKEN_IF, "Expected 'if'");
+
+    ASTNode *condition = parse_expression(parser);
+    if (condition == NULL) {
+        return NULL;
+    }
+    ASTNode *if_body = parse_block(parser);
+    if (if_body == NULL) {
+        free_ast(condition);
+        return NULL;
+    }
+    ASTNode *else_body = NULL;
+
+    if (peek(parser)->type == TOKEN_ELSE) {
+        advance(parser);  // consume 'else'
+        else_body = parse_block(parser);
+        if (else_body == NULL) {
+            free_ast(condition);
+            free_ast(if_body);
+            return NULL;
+        }
+    }
+
+    return with_line(create_if_node(condition, if_body, else_body), keyword->line);
+}
+
+ASTNode *parse_while_statement(Parser *parser) {
+    Token *keyword = consume(parser, TOKEN_WHILE, "Expected 'while'");
+
+    // The condition runs again after the body, so it is inside the loop
+    loop_boundary(parser);
+    ASTNode *condition = parse_expression(parser);
+    if (condition == NULL) {
+        return NULL;
+    }
+    ASTNode *body = parse_block(parser);
+    loop_boundary(parser);
+    if (body == NULL) {
+        free_ast(condition);
+        return NULL;
+    }
+
+    return with_line(create_while_node(condition, body), keyword->line);
+}
+
+// The rest of `ಪ್ರತಿ variable ಒಳಗೆ iterable { ... }` after ಒಳಗೆ. The
+// iterable is evaluated once, before the loop starts.
+static ASTNode *parse_for_in(Parser *parser, Token *keyword, const char *variable) {
+    ASTNode *iterable = parse_expression(parser);
+    if (iterable == NULL) {
+        return NULL;
+    }
+    loop_boundary(parser);
+    ASTNode *body = parse_block(parser);
+    loop_boundary(parser);
+    if (body == NULL) {
+        free_ast(iterable);
+        return NULL;
+    }
+    return with_line(create_for_in_node(variable, iterable, body), keyword->line);
+}
+
+ASTNode *parse_for_statement(Parser *parser) {
+    bool parallel = peek(parser)->type == TOKEN_PARALLEL;
+    Token *keyword = parallel ? advance(parser) : consume(parser, TOKEN_FOR, "Expected 'for'");
+
+    Token *variable = consume(parser, TOKEN_IDENTIFIER, "Expected a variable after 'for'");
+    if (variable == NULL || !consume(parser, TOKEN_IN, "Expected 'in' after the loop variable")) {
+        return NULL;
+    }
+    // Only ranges can be split between threads
+    if (peek(parser)->type != TOKEN_RANGE && !parallel) {
+        return parse_for_in(parser, keyword, variable->value.name);
+    }
+    if (!consume(parser, TOKEN_RANGE, "Expected 'range' after 'in'") ||
+        !consume(parser, TOKEN_LPAREN, "Expected '(' after 'range'")) {
+        return NULL;
+    }
+    ASTNode **bounds;
+    int count;
+    if (!parse_expression_list(parser, TOKEN_RPAREN, "Expected ')' after range arguments", &bounds, &count)) {
+        return NULL;
+    }
+    if (count < 1 || count > 3) {
+        report_error(parser->errors, ERROR_PARSER, keyword->line,
+                     "range() takes 1 to 3 arguments but %d %s given", count, count == 1 ? "was" : "were");
+        free_statements(bounds, count);
+        return NULL;
+    }
+    loop_boundary(parser);
+    ASTNode *body = parse_block(parser);
+    loop_boundary(parser);
+    if (body == NULL) {
+        free_statements(bounds, count);
+        return NULL;
+    }
+
+    ASTNode *start = count > 1 ? bounds[0] : NULL;
+    ASTNode *stop = count > 1 ? bounds[1] : bounds[0];
+    ASTNode *step = count > 2 ? bounds[2] : NULL;
+    free(bounds);
+    ASTNode *loop = create_for_node(variable->value.name, start, stop, step, body);
+    loop->data.for_loop.parallel = parallel;
+    return with_line(loop, keyword->line);
+}
+
+ASTNode *parse_print_statement(Parser *parser) {
+    Token *keyword = consume(parser, TOKEN_PRINT, "Expected 'print'");
+
+    ASTNode *expression = parse_expression(parser);
+    if (expression == NULL) {
+        return NULL;
+    }
+    if (!consume(parser, TOKEN_SEMICOLON, "Expected ';' after print statement")) {
+        free_ast(expression);
+        return NULL;
+    }
+
+    return with_line(create_print_node(expression), keyword->line);
+}
+
+ASTNode *parse_assign_statement(Parser *parser) {
+    int line = peek(parser)->line;
+    ASTNode *target = parse_expression(parser);
+    if (target == NULL) {
+        return NULL;
+    }
+
+    if (peek(parser)->type != TOKEN_ASSIGN) {
+        // A bare name does nothing, so it is most likely a broken assignment
+        if (target->type == AST_VARIABLE) {
+            consume(parser, TOKEN_ASSIGN, "Expected '=' after identifier");
+            free_ast(target);
+            return NULL;
+        }
+        if (!consume(parser, TOKEN_SEMICOLON, "Expected ';' after expression")) {
+            free_ast(target);
+            return NULL;
+        }
+        return with_line(create_expression_node(target), line);
+    }
+
+    if (target->type != AST_VARIABLE && target->type != AST_INDEX) {
+        report_error(parser->errors, ERROR_PARSER, peek(parser)->line,
+                     "Can only assign to a variable or a list element");
+        free_ast(target);
+        return NULL;
+    }
+    advance(parser);  // consume '='
+    ASTNode *value = parse_expression(parser);
+    if (value == NULL) {
+        free_ast(target);
+        return NULL;
+    }
+    if (!consume(parser, TOKEN_SEMICOLON, "Expected ';' after assignment")) {
+        free_ast(target);
+        free_ast(value);
+        return NULL;
+    }
+
+    ASTNode *statement;
+    if (target->type == AST_VARIABLE) {
+        statement = create_assign_node(target->data.variable.name, value);
+        if (parser->expressions) {
+            expression_assigned(parser->expressions, target->data.variable.name);
+        }
+        free_ast(target);
+    } else {
+        // The index node's children move to the store
+        statement = create_store_index_node(target->data.index.object, target->data.index.index, value);
+        free(target);
+    }
+    return with_line(statement, line);
+}
+
+// `(a, b, ...)` after a definition's name, up to and including the ')'.
+// Returns false, with nothing to free, on error.
+static bool parse_parameters(Parser *parser, const char ***parameters, int *count) {
+    *parameters = NULL;
+    *count = 0;
+    while (peek(parser)->type != TOKEN_RPAREN) {
+        Token *parameter = consume(parser, TOKEN_IDENTIFIER, "Expected a parameter name");
+        if (parameter == NULL) {
+            free(*parameters);
+            return false;
+        }
+        *parameters = safe_realloc(*parameters, (*count + 1) * sizeof(const char *));
+        (*parameters)[(*count)++] = parameter->value.name;
+        if (peek(parser)->type != TOKEN_COMMA) {
+            break;
+        }
+        advance(parser);
+    }
+    if (!consume(parser, TOKEN_RPAREN, "Expected ')' after parameters")) {
+        free(*parameters);
+        return false;
+    }
+    return true;
+}
+
+ASTNode *parse_generator_definition(Parser *parser) {
+    Token *keyword = consume(parser, TOKEN_GENERATOR, "Expected 'generator'");
+
+    Token *name = consume(parser, TOKEN_IDENTIFIER, "Expected a name after 'generator'");
+    if (name == NULL || !consume(parser, TOKEN_LPAREN, "Expected '(' after the generator's name")) {
+        return NULL;
+    }
+    const char **parameters;
+    int count;
+    if (!parse_parameters(parser, &parameters, &count)) {
+        return NULL;
+    }
+
+    // The body runs whenever the generator is resumed, with its own variables
+    loop_boundary(parser);
+    ASTNode *body = parse_block(parser);
+    loop_boundary(parser);
+    if (body == NULL) {
+        free(parameters);
+        return NULL;
+    }
+    return with_line(create_generator_node(name->value.name, parameters, count, body), keyword->line);
+}
+
+ASTNode *parse_function_definition(Parser *parser) {
+    Token *keyword = consume(parser, TOKEN_FUNCTION, "Expected 'function'");
+
+    Token *name = consume(parser, TOKEN_IDENTIFIER, "Expected a name after 'function'");
+    if (name == NULL || !consume(parser, TOKEN_LPAREN, "Expected '(' after the function's name")) {
+        return NULL;
+    }
+    const char **parameters;
+    int count;
+    if (!parse_parameters(parser, &parameters, &count)) {
+        return NULL;
+    }
+
+    // The body runs on every call, with its own variables
+    loop_boundary(parser);
+    ASTNode *body = parse_block(parser);
+    loop_boundary(parser);
+    if (body == NULL) {
+        free(parameters);
+        return NULL;
+    }
+    return with_line(create_function_node(name->value.name, parameters, count, body), keyword->line);
+}
+
+ASTNode *parse_return_statement(Parser *parser) {
+    Token *keyword = consume(parser, TOKEN_RETURN, "Expected 'return'");
+
+    ASTNode *value = NULL;
+    if (peek(parser)->type != TOKEN_SEMICOLON) {
+        value = parse_expression(parser);
+        if (value == NULL) {
+            return NULL;
+        }
+    }
+    if (!consume(parser, TOKEN_SEMICOLON, "Expected ';' after return statement")) {
+        free_ast(value);
+        return NULL;
+    }
+    return with_line(create_return_node(value), keyword->line);
+}
+
+ASTNode *parse_yield_statement(Parser *parser) {
+    Token *keyword = consume(parser, TOKEN_YIELD, "Expected 'yield'");
+
+    ASTNode *value = parse_expression(parser);
+    if (value == NULL) {
+        return NULL;
+    }
+    if (!consume(parser, TOKEN_SEMICOLON, "Expected ';' after yield statement")) {
+        free_ast(value);
+        return NULL;
+    }
+    // Whoever resumes the generator next may have changed any variable
+    loop_boundary(parser);
+    return with_line(create_yield_node(value), keyword->line);
+}
+
+ASTNode *parse_import_statement(Parser *parser) {
+    Token *keyword = consume(parser, TOKEN_IMPORT, "Expected 'import'");
+
+    Token *module = consume(parser, TOKEN_IDENTIFIER, "Expected module name after import");
+    if (module == NULL) {
+        return NULL;
+    }
+    if (!consume(parser, TOKEN_SEMICOLON, "Expected ';' after import statement")) {
+        return NULL;
+    }
+
+    return with_line(create_import_node(module->value.name), keyword->line);
+}
+
+// Binding strength of operators, weakest first
+typedef enum {
+    PREC_NONE,
+    PREC_OR,          // ಅಥವಾ
+    PREC_AND,         // ಮತ್ತು
+    PREC_NOT,         // ಅಲ್ಲ
+    PREC_COMPARISON,  // == != < <= > >=
+    PREC_TERM,        // + -
+    PREC_FACTOR,      // * / %
+    PREC_UNARY        // -
+} Precedence;
+
+// Precedence of each token used as a binary operator; PREC_NONE ends the
+// expression. All binary operators are left-associative.
+static const Precedence infix_precedence[TOKEN_TYPE_COUNT] = {
+    [TOKEN_OR] = PREC_OR,
+    [TOKEN_AND] = PREC_AND,
+    [TOKEN_EQUAL] = PREC_COMPARISON,
+    [TOKEN_NOT_EQUAL] = PREC_COMPARISON,
+    [TOKEN_LESS] = PREC_COMPARISON,
+    [TOKEN_LESS_EQUAL] = PREC_COMPARISON,
+    [TOKEN_GREATER] = PREC_COMPARISON,
+    [TOKEN_GREATER_EQUAL] = PREC_COMPARISON,
+    [TOKEN_PLUS] = PREC_TERM,
+    [TOKEN_MINUS] = PREC_TERM,
+    [TOKEN_MULTIPLY] = PREC_FACTOR,
+    [TOKEN_DIVIDE] = PREC_FACTOR,
+    [TOKEN_PERCENT] = PREC_FACTOR,
+};
+
+// Precedence of the operand of each prefix operator
+static const Precedence prefix_precedence[TOKEN_TYPE_COUNT] = {
+    [TOKEN_NOT] = PREC_NOT,
+    [TOKEN_MINUS] = PREC_UNARY,
+};
+
+// Parse expressions separated by commas up to the `close` token, which is
+// consumed. A trailing comma is allowed. Returns false on error.
+static bool parse_expression_list(Parser *parser, TokenType close, const char *message,
+                                  ASTNode ***expressions, int *count) {
+    *expressions = NULL;
+    *count = 0;
+    while (peek(parser)->type != close) {
+        ASTNode *expression = parse_expression(parser);
+        if (expression == NULL) {
+            free_statements(*expressions, *count);
+            return false;
+        }
+        *expressions = (ASTNode **)safe_realloc(*expressions, sizeof(ASTNode *) * (*count + 1));
+        (*expressions)[(*count)++] = expression;
+        if (peek(parser)->type != TOKEN_COMMA) {
+            break;
+        }
+        advance(parser);
+    }
+    if (!consume(parser, close, message)) {
+        free_statements(*expressions, *count);
+        return false;
+    }
+    return true;
+}
+
+// Parse `key: value` pairs separated by commas up to the closing '}',
+// which is consumed. A trailing comma is allowed.
+static ASTNode *parse_dict(Parser *parser) {
+    ASTNode **entries = NULL;
+    int count = 0;
+    while (peek(parser)->type != TOKEN_RBRACE) {
+        ASTNode *key = parse_expression(parser);
+        ASTNode *value = NULL;
+        if (key == NULL || !consume(parser, TOKEN_COLON, "Expected ':' after dictionary key") ||
+            (value = parse_expression(parser)) == NULL) {
+            free_ast(key);
+            free_statements(entries, count * 2);
+            return NULL;
+        }
+        entries = (ASTNode **)safe_realloc(entries, sizeof(ASTNode *) * (count + 1) * 2);
+        entries[count * 2] = key;
+        entries[count * 2 + 1] = value;
+        count++;
+        if (peek(parser)->type != TOKEN_COMMA) {
+            break;
+        }
+        advance(parser);
+    }
+    if (!consume(parser, TOKEN_RBRACE, "Expected '}' after dictionary entries")) {
+        free_statements(entries, count * 2);
+        return NULL;
+    }
+    return create_dict_node(entries, count);
+}
+
+// Parse a literal, variable, call or parenthesized expression starting at `token`
+static ASTNode *parse_primary(Parser *parser, Token *token) {
+    switch (token->type) {
+        case TOKEN_NUMBER:
+            return share(parser, with_line(create_number_node(token->value.number), token->line));
+        case TOKEN_FLOAT:
+            return share(parser, with_line(create_float_node(token->value.real), token->line));
+        case TOKEN_STRING:
+            return share(parser, with_line(create_string_node(token->value.string), token->line));
+        case TOKEN_TRUE:
+            return share(parser, with_line(create_boolean_node(true), token->line));
+        case TOKEN_FALSE:
+            return share(parser, with_line(create_boolean_node(false), token->line));
+        case TOKEN_NONE:
+            return share(parser, with_line(create_none_node(), token->line));
+        case TOKEN_IDENTIFIER:
+            if (peek(parser)->type == TOKEN_LPAREN) {
+                advance(parser);
+                ASTNode **arguments;
+                int count;
+                if (!parse_expression_list(parser, TOKEN_RPAREN, "Expected ')' after arguments",
+                                           &arguments, &count)) {
+                    return NULL;
+                }
+                return with_line(create_call_node(token->value.name, arguments, count), token->line);
+            }
+            return share(parser, with_line(create_variable_node(token->value.name), token->line));
+        case TOKEN_LBRACKET:
+            {
+                ASTNode **elements;
+                int count;
+                if (!parse_expression_list(parser, TOKEN_RBRACKET, "Expected ']' after list elements",
+                                           &elements, &count)) {
+                    return NULL;
+                }
+                return with_line(create_list_node(elements, count), token->line);
+            }
+        case TOKEN_LBRACE:
+            return with_line(parse_dict(parser), token->line);
+        case TOKEN_LPAREN:
+            {
+                ASTNode *expression = parse_expression(parser);
+                if (expression == NULL) {
+                    return NULL;
+                }
+                if (!consume(parser, TOKEN_RPAREN, "Expected ')' after expression")) {
+                    free_ast(expression);
+                    return NULL;
+                }
+                return expression;
+            }
+        case TOKEN_ERROR:
+            // The lexer has already reported this token
+            return NULL;
+        default:
+            report_error(parser->errors, ERROR_PARSER, token->line,
+                         "Unexpected token: %s", token_type_to_string(token->type));
+            return NULL;
+    }
+}
+
+// Parse a primary expression and any indexes that follow it. Indexing
+// binds tighter than any operator.
+static ASTNode *parse_postfix(Parser *parser, Token *token) {
+    ASTNode *expression = parse_primary(parser, token);
+    while (expression != NULL && peek(parser)->type == TOKEN_LBRACKET) {
+        Token *bracket = advance(parser);
+        ASTNode *index = parse_expression(parser);
+        if (index == NULL || !consume(parser, TOKEN_RBRACKET, "Expected ']' after index")) {
+            free_ast(index);
+            free_ast(expression);
+            return NULL;
+        }
+        expression = with_line(create_index_node(expression, index), bracket->line);
+    }
+    return expression;
+}
+
+static ASTNode *parse_precedence(Parser *parser, Precedence min_precedence);
+
+static ASTNode *parse_operators(Parser *parser, Precedence min_precedence) {
+    Token *token = advance(parser);
+    ASTNode *left;
+
+    Precedence operand_precedence = prefix_precedence[token->type];
+    if (operand_precedence != PREC_NONE) {
+        ASTNode *operand = parse_precedence(parser, operand_precedence);
+        if (operand == NULL) {
+            return NULL;
+        }
+        left = share(parser, with_line(create_unary_op_node(token->type, operand), token->line));
+    } else {
+        left = parse_postfix(parser, token);
+        if (left == NULL) {
+            return NULL;
+        }
+    }
+
+    bool compared = false;
+    for (;;) {
+        Precedence precedence = infix_precedence[peek(parser)->type];
+        if (precedence == PREC_NONE || precedence < min_precedence) {
+            return left;
+        }
+        Token *op = advance(parser);
+        // Python reads `a < b < c` as `a < b and b < c`; rather than mean
+        // something else by it, it is refused
+        if (precedence == PREC_COMPARISON && compared) {
+            report_error(parser->errors, ERROR_PARSER, op->line,
+                         "Comparisons cannot be chained; join them with ಮತ್ತು");
+            free_ast(left);
+            return NULL;
+        }
+        compared = precedence == PREC_COMPARISON;
+        ASTNode *right = parse_precedence(parser, precedence + 1);
+        if (right == NULL) {
+            free_ast(left);
+            return NULL;
+        }
+        left = share(parser, with_line(create_binary_op_node(op->type, left, right), op->line));
+    }
+}
+
+// Parse an expression whose binary operators all bind at least as tightly
+// as `min_precedence`. Runs of operators at one level are handled by the
+// loop, so recursion only deepens where precedence rises.
+static ASTNode *parse_precedence(Parser *parser, Precedence min_precedence) {
+    if (!descend(parser)) {
+        return NULL;
+    }
+    ASTNode *expression = parse_operators(parser, min_precedence);
+    parser->depth--;
+    return expression;
+}
+
+ASTNode *parse_expression(Parser *parser) {
+    return parse_precedence(parser, PREC_OR);
+}
@@ -0,0 +1,362 @@
+//profile.c
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../include/profile.h"
+#include "../include/visitor.h"
+#include "../include/common.h"
+
+// Longest line text shown, in bytes
+#define PROFILE_TEXT_LENGTH 96
+
+static uint64_t now_ns(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64_t)time.tv_sec * 1000000000u + (uint64_t)time.tv_nsec;
+}
+
+static bool is_statement(const ASTNode *node) {
+    switch (node->type) {
+        case AST_ASSIGN:
+        case AST_PRINT:
+        case AST_EXPRESSION:
+        case AST_STORE_INDEX:
+        case AST_IF:
+        case AST_WHILE:
+        case AST_FOR:
+        case AST_IMPORT:
+        case AST_GENERATOR:
+        case AST_YIELD:
+        case AST_FUNCTION:
+        case AST_RETURN:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static bool is_compound(const ASTNode *node) {
+    return node->type == AST_IF || node->type == AST_WHILE || node->type == AST_FOR ||
+           node->type == AST_GENERATOR || node->type == AST_FUNCTION;
+}
+
+typedef struct {
+    Profile *profile;       // NULL while only finding the last line
+    int line_count;         // One past the last line
+    int *enclosing;         // Lines of the compound statements being walked
+    int depth;
+    int capacity;
+    int nesting;            // Most compound statements around a statement
+} NestingWalk;
+
+static void enter_statement(ASTNode *node, void *context) {
+    NestingWalk *walk = context;
+    if (walk->profile == NULL) {
+        if (node->line + 1 > walk->line_count) {
+            walk->line_count = node->line + 1;
+        }
+        return;
+    }
+    if (!is_statement(node)) {
+        return;
+    }
+    // A statement on the same line as its parent is shown as part of it
+    int parent = walk->depth > 0 ? walk->enclosing[walk->depth - 1] : 0;
+    if (walk->profile->parents[node->line] == 0 && parent != node->line) {
+        walk->profile->parents[node->line] = parent;
+    }
+    if (node->type == AST_FUNCTION || node->type == AST_GENERATOR) {
+        walk->profile->definitions[node->line] = true;
+    }
+    if (is_compound(node)) {
+        if (walk->depth == walk->capacity) {
+            walk->capacity = walk->capacity ? walk->capacity * 2 : 16;
+            walk->enclosing = safe_realloc(walk->enclosing, walk->capacity * sizeof(int));
+        }
+        walk->enclosing[walk->depth++] = node->line;
+    }
+    if (walk->depth + 1 > walk->nesting) {
+        walk->nesting = walk->depth + 1;
+    }
+}
+
+static void leave_statement(ASTNode *node, void *context) {
+    NestingWalk *walk = context;
+    if (walk->profile != NULL && is_compound(node)) {
+        walk->depth--;
+    }
+}
+
+Profile *create_profile(ASTNode *program) {
+    // The first walk finds the last line, the second how statements nest
+    NestingWalk walk = {NULL, 0, NULL, 0, 0, 1};
+    ASTVisitor visitor = {enter_statement, NULL, leave_statement, &walk};
+    walk_ast(program, &visitor, 1);
+
+    Profile *profile = safe_malloc(sizeof(Profile));
+    profile->line_count = walk.line_count;
+    profile->lines = safe_malloc(profile->line_count * sizeof(LineProfile));
+    memset(profile->lines, 0, profile->line_count * sizeof(LineProfile));
+    profile->parents = safe_malloc(profile->line_count * sizeof(int));
+    memset(profile->parents, 0, profile->line_count * sizeof(int));
+    profile->definitions = safe_malloc(profile->line_count * sizeof(bool));
+    memset(profile->definitions, 0, profile->line_count * sizeof(bool));
+    profile->calls = safe_malloc(PROFILE_CALL_DEPTH * sizeof(atomic_int));
+    for (int i = 0; i < PROFILE_CALL_DEPTH; i++) {
+        atomic_init(&profile->calls[i], 0);
+    }
+    atomic_init(&profile->call_depth, 0);
+    atomic_init(&profile->running, false);
+    profile->start_ns = 0;
+    profile->stop_ns = 0;
+    profile->elapsed_ns = 0;
+    profile->nodes = safe_malloc(sizeof(StackNode));
+    profile->nodes[0] = (StackNode){0, -1, -1, -1, 0};
+    profile->node_count = 1;
+    profile->node_capacity = 1;
+    profile->seen = safe_malloc(profile->line_count * sizeof(uint64_t));
+    memset(profile->seen, 0, profile->line_count * sizeof(uint64_t));
+
+    walk.profile = profile;
+    walk_ast(program, &visitor, 1);
+    free(walk.enclosing);
+    profile->nesting = walk.nesting;
+    profile->chain = safe_malloc(profile->nesting * sizeof(int));
+    return profile;
+}
+
+void free_profile(Profile *profile) {
+    free(profile->lines);
+    free(profile->parents);
+    free(profile->definitions);
+    free(profile->calls);
+    free(profile->nodes);
+    free(profile->seen);
+    free(profile->chain);
+    free(profile);
+}
+
+// The child of stack node `parent` for `line`, added if it is new
+static int stack_child(Profile *profile, int parent, int line) {
+    int child = profile->nodes[parent].first_child;
+    while (child >= 0 && profile->nodes[child].line != line) {
+        child = profile->nodes[child].next_sibling;
+    }
+    if (child >= 0) {
+        return child;
+    }
+    if (profile->node_count == profile->node_capacity) {
+        profile->node_capacity *= 2;
+        profile->nodes = safe_realloc(profile->nodes, profile->node_capacity * sizeof(StackNode));
+    }
+    child = profile->node_count++;
+    profile->nodes[child] = (StackNode){line, parent, -1, profile->nodes[parent].first_child, 0};
+    profile->nodes[parent].first_child = child;
+    return child;
+}
+
+// Charge `nanoseconds` to the stack running at tick `tick`
+static void charge_stack(Profile *profile, uint64_t tick, uint64_t nanoseconds) {
+    int depth = atomic_load_explicit(&profile->call_depth, memory_order_relaxed);
+    if (depth >= PROFILE_CALL_DEPTH) {
+        depth = PROFILE_CALL_DEPTH - 1;
+    }
+    int node = 0;
+    int innermost = 0;
+    for (int call = 0; call <= depth; call++) {
+        // The call's line and the statements around it, up to its function
+        int count = 0;
+        int line = atomic_load_explicit(&profile->calls[call], memory_order_relaxed);
+        innermost = line;
+        while (line > 0 && count < profile->nesting) {
+            profile->chain[count++] = line;
+            if (profile->definitions[line]) {
+                break;
+            }
+            line = profile->parents[line];
+        }
+        for (int i = count - 1; i >= 0; i--) {
+            line = profile->chain[i];
+            node = stack_child(profile, node, line);
+            // A line on the stack more than once, in recursion, spent the
+            // time only once
+            if (profile->seen[line] != tick) {
+                profile->seen[line] = tick;
+                profile->lines[line].total_nanoseconds += nanoseconds;
+            }
+        }
+    }
+    profile->nodes[node].nanoseconds += nanoseconds;
+    profile->lines[innermost].samples++;
+    profile->lines[innermost].nanoseconds += nanoseconds;
+}
+
+static void *sample(void *context) {
+    Profile *profile = context;
+    struct timespec interval = {0, PROFILE_INTERVAL_NS};
+    uint64_t last = profile->start_ns;
+    uint64_t tick = 0;
+    bool running;
+    do {
+        nanosleep(&interval, NULL);
+        running = atomic_load(&profile->running);
+        // Once stopped, the run ended at stop_ns rather than now
+        uint64_t now = running ? now_ns() : profile->stop_ns;
+        charge_stack(profile, ++tick, now > last ? now - last : 0);
+        last = now;
+    } while (running);
+    return NULL;
+}
+
+bool start_profile(Profile *profile) {
+    profile->start_ns = now_ns();
+    atomic_store(&profile->running, true);
+    if (pthread_create(&profile->sampler, NULL, sample, profile) != 0) {
+        atomic_store(&profile->running, false);
+        return false;
+    }
+    return true;
+}
+
+void stop_profile(Profile *profile) {
+    profile->stop_ns = now_ns();
+    atomic_store(&profile->running, false);
+    pthread_join(profile->sampler, NULL);
+    profile->elapsed_ns = profile->stop_ns - profile->start_ns;
+}
+
+// Where each line of `source` starts; line n is at starts[n - 1]
+static size_t *find_line_starts(const char *source, size_t length, int *count) {
+    int capacity = 64;
+    size_t *starts = safe_malloc(capacity * sizeof(size_t));
+    *count = 0;
+    starts[(*count)++] = 0;
+    for (size_t i = 0; i < length; i++) {
+        if (source[i] == '\n') {
+            if (*count == capacity) {
+                capacity *= 2;
+                starts = safe_realloc(starts, capacity * sizeof(size_t));
+            }
+            starts[(*count)++] = i + 1;
+        }
+    }
+    return starts;
+}
+
+// The text of `line` without its indentation, cut to PROFILE_TEXT_LENGTH
+// bytes on a character boundary. As a collapsed-stack `frame` it also loses
+// its final semicolon, and those inside, which would split the frame,
+// become commas.
+static void line_text(const char *source, size_t length, const size_t *starts, int start_count, int line,
+                      bool frame, char *text) {
+    text[0] = '\0';
+    if (line < 1 || line > start_count) {
+        return;
+    }
+    size_t begin = starts[line - 1];
+    size_t end = line < start_count ? starts[line] : length;
+    while (begin < end && (source[begin] == ' ' || source[begin] == '\t')) {
+        begin++;
+    }
+    while (end > begin && (source[end - 1] == '\n' || source[end - 1] == '\r' || source[end - 1] == ' ' ||
+                           source[end - 1] == '\t' || (frame && source[end - 1] == ';'))) {
+        end--;
+    }
+    if (end - begin > PROFILE_TEXT_LENGTH) {
+        end = begin + PROFILE_TEXT_LENGTH;
+        while (end > begin && ((unsigned char)source[end] & 0xC0) == 0x80) {
+            end--;
+        }
+    }
+    size_t n = end - begin;
+    memcpy(text, source + begin, n);
+    text[n] = '\0';
+    for (size_t i = 0; frame && i < n; i++) {
+        if (text[i] == ';') {
+            text[i] = ',';
+        }
+    }
+}
+
+typedef struct {
+    int line;
+    LineProfile profile;
+} ReportLine;
+
+// Most total time first, then most time of its own, then most hits, then
+// in source order
+static int compare_lines(const void *a, const void *b) {
+    const ReportLine *x = a;
+    const ReportLine *y = b;
+    if (x->profile.total_nanoseconds != y->profile.total_nanoseconds) {
+        return x->profile.total_nanoseconds < y->profile.total_nanoseconds ? 1 : -1;
+    }
+    if (x->profile.nanoseconds != y->profile.nanoseconds) {
+        return x->profile.nanoseconds < y->profile.nanoseconds ? 1 : -1;
+    }
+    if (x->profile.hits != y->profile.hits) {
+        return x->profile.hits < y->profile.hits ? 1 : -1;
+    }
+    return x->line - y->line;
+}
+
+void print_profile_report(const Profile *profile, const char *source, size_t length, FILE *stream) {
+    ReportLine *order = safe_malloc(profile->line_count * sizeof(ReportLine));
+    int count = 0;
+    uint64_t samples = 0;
+    for (int line = 0; line < profile->line_count; line++) {
+        samples += profile->lines[line].samples;
+        if (line > 0 && (profile->lines[line].hits > 0 || profile->lines[line].total_nanoseconds > 0)) {
+            order[count++] = (ReportLine){line, profile->lines[line]};
+        }
+    }
+    qsort(order, count, sizeof(ReportLine), compare_lines);
+
+    int start_count;
+    size_t *starts = find_line_starts(source, length, &start_count);
+    char text[PROFILE_TEXT_LENGTH + 1];
+    double total_ms = (double)profile->elapsed_ns / 1e6;
+    fprintf(stream, "Profile: %.3f ms in %llu samples\n", total_ms, (unsigned long long)samples);
+    fprintf(stream, "%6s %14s %12s %6s %12s  %s\n", "Line", "Hits", "Total (ms)", "%", "Self (ms)", "Source");
+    for (int i = 0; i < count && i < PROFILE_REPORT_LINES; i++) {
+        const LineProfile *line = &order[i].profile;
+        double ms = (double)line->total_nanoseconds / 1e6;
+        line_text(source, length, starts, start_count, order[i].line, false, text);
+        fprintf(stream, "%6d %14llu %12.3f %6.1f %12.3f  %s\n", order[i].line, (unsigned long long)line->hits, ms,
+                total_ms > 0 ? 100.0 * ms / total_ms : 0.0, (double)line->nanoseconds / 1e6, text);
+    }
+    if (count > PROFILE_REPORT_LINES) {
+        fprintf(stream, "(%d more lines)\n", count - PROFILE_REPORT_LINES);
+    }
+    free(starts);
+    free(order);
+}
+
+void write_collapsed_stacks(const Profile *profile, const char *source, size_t length, FILE *stream) {
+    int start_count;
+    size_t *starts = find_line_starts(source, length, &start_count);
+    int *frames = NULL;
+    int frame_capacity = 0;
+    char text[PROFILE_TEXT_LENGTH + 1];
+    for (int node = 1; node < profile->node_count; node++) {
+        uint64_t microseconds = profile->nodes[node].nanoseconds / 1000;
+        if (microseconds == 0) {
+            continue;
+        }
+        int depth = 0;
+        for (int frame = node; frame > 0; frame = profile->nodes[frame].parent) {
+            if (depth == frame_capacity) {
+                frame_capacity = frame_capacity ? frame_capacity * 2 : 64;
+                frames = safe_realloc(frames, frame_capacity * sizeof(int));
+            }
+            frames[depth++] = profile->nodes[frame].line;
+        }
+        for (int i = depth - 1; i >= 0; i--) {
+            line_text(source, length, starts, start_count, frames[i], true, text);
+            fprintf(stream, "%d: %s%s", frames[i], text, i > 0 ? ";" : "");
+        }
+        fprintf(stream, " %llu\n", (unsigned long long)microseconds);
+    }
+    free(frames);
+    free(starts);
+}
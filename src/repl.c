@@ -0,0 +1,133 @@
+//repl.c
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "../include/repl.h"
+
+typedef struct {
+    InternTable *names;
+    SymbolTable *symbol_table;
+    Chunk chunk;
+    VM vm;
+    int unroll_factor;
+    bool eliminate_common;
+} Session;
+
+// Whether `text` leaves a bracket or a string open, so the input goes on
+// at the next line
+static bool is_open(const char *text, size_t length) {
+    int depth = 0;
+    bool in_string = false;
+    for (size_t i = 0; i < length; i++) {
+        char c = text[i];
+        if (in_string) {
+            in_string = c != '"';
+        } else if (c == '"') {
+            in_string = true;
+        } else if (c == '{' || c == '(' || c == '[') {
+            depth++;
+        } else if (c == '}' || c == ')' || c == ']') {
+            depth--;
+        }
+    }
+    return in_string || depth > 0;
+}
+
+static bool is_blank(const char *text, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        if (text[i] != ' ' && text[i] != '\t' && text[i] != '\r' && text[i] != '\n') {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Compile one input onto the end of the session's chunk and run it
+static bool run_input(Session *session, const char *text, size_t length) {
+    ErrorList errors;
+    init_error_list(&errors);
+    bool ok = false;
+    ASTNode *program = parse_source(text, length, &errors, session->names, session->eliminate_common);
+    if (program != NULL) {
+        size_t start = session->chunk.count;
+        int symbol_count = session->symbol_table->symbol_count;
+        if (compile_bytecode(program, session->symbol_table, &session->chunk, &session->vm.heap, &errors,
+                             session->unroll_factor, false)) {
+            ok = run_code(&session->vm, &session->chunk, start, &errors);
+        } else {
+            truncate_chunk(&session->chunk, start);
+            forget_symbols(session->symbol_table, symbol_count);
+        }
+        free_ast(program);
+    }
+    // What a failed input or its compilation allocated is left for here,
+    // with the session's variables as the roots
+    if (!collect_if_due(&session->vm, &session->chunk)) {
+        report_error(&errors, ERROR_RUNTIME, 0, "Out of memory: live data exceeds the heap limit of %zu MB",
+                     session->vm.heap.limit / (1024 * 1024));
+        ok = false;
+    }
+    output_flush(&session->vm.output);
+    print_errors(&errors, stderr);
+    free_error_list(&errors);
+    return ok;
+}
+
+bool run_repl(FILE *input, FILE *output, const RunOptions *options) {
+    Session session;
+    session.names = create_intern_table(256);
+    session.symbol_table = create_symbol_table(128);
+    init_chunk(&session.chunk);
+    init_vm(&session.vm, output);
+    session.unroll_factor = 0;
+    session.eliminate_common = false;
+    if (options != NULL) {
+        session.vm.heap.limit = options->heap_limit;
+        session.vm.threads = options->threads;
+        session.unroll_factor = options->unroll_factor;
+        session.eliminate_common = options->eliminate_common;
+    }
+    bool interactive = isatty(fileno(input));
+
+    Buffer pending;
+    buffer_init(&pending);
+    char *line = NULL;
+    size_t capacity = 0;
+    bool ok = true;
+    for (;;) {
+        if (interactive) {
+            fputs(pending.length == 0 ? ">>> " : "... ", output);
+            fflush(output);
+        }
+        ssize_t length = getline(&line, &capacity, input);
+        if (length < 0) {
+            break;
+        }
+        buffer_append(&pending, line, (size_t)length);
+        if (is_open(pending.data, pending.length)) {
+            continue;
+        }
+        if (!is_blank(pending.data, pending.length)) {
+            ok &= run_input(&session, pending.data, pending.length);
+        }
+        pending.length = 0;
+    }
+    // Input that ends part way through a statement is still reported
+    if (!is_blank(pending.data, pending.length)) {
+        ok &= run_input(&session, pending.data, pending.length);
+    }
+    if (interactive) {
+        fputc('\n', output);
+    }
+    if (options != NULL && options->gc_stats) {
+        print_gc_stats(&session.vm.heap, stderr);
+    }
+
+    free(line);
+    buffer_free(&pending);
+    free_vm(&session.vm);
+    free_chunk(&session.chunk);
+    free_symbol_table(session.symbol_table);
+    free_intern_table(session.names);
+    return ok;
+}
@@ -0,0 +1,465 @@
+//runtime_string.c
+#include <stdlib.h>
+#include <string.h>
+#include "../include/runtime_string.h"
+#include "../include/list.h"
+
+static Value make_short_string(const char *chars, size_t length) {
+    Value value = 4 | (Value)length << 3;
+    for (size_t i = 0; i < length; i++) {
+        value |= (Value)(unsigned char)chars[i] << (8 * (i + 1));
+    }
+    return value;
+}
+
+static size_t short_string_length(Value value) {
+    return (value >> 3) & 31;
+}
+
+static void copy_short_string(Value value, char *destination) {
+    size_t length = short_string_length(value);
+    for (size_t i = 0; i < length; i++) {
+        destination[i] = (char)(value >> (8 * (i + 1)));
+    }
+}
+
+static const char *short_string_chars(Value value, char *scratch) {
+    copy_short_string(value, scratch);
+    scratch[short_string_length(value)] = '\0';
+    return scratch;
+}
+
+// A rope has no storage of its own; a flat string keeps its bytes inline.
+// Strings expected to live as long as the program are allocated `old`.
+static StringObject *allocate_string(Heap *heap, size_t length, bool flat, bool old) {
+    size_t size = sizeof(StringObject) + (flat ? length + 1 : 0);
+    StringObject *string = (StringObject *)(old ? allocate_old_object : allocate_object)(heap, OBJECT_STRING, size);
+    string->length = length;
+    string->codepoints = SIZE_MAX;
+    string->hash = 0;
+    string->interned = false;
+    string->chars = flat ? string->storage : NULL;
+    string->left = VALUE_NONE;
+    string->right = VALUE_NONE;
+    string->breadcrumbs = NULL;
+    if (flat) {
+        string->chars[length] = '\0';
+    }
+    return string;
+}
+
+void release_string_object(StringObject *string) {
+    if (string->chars != string->storage && !string_is_slice(string)) {
+        free(string->chars);
+    }
+    free(string->breadcrumbs);
+}
+
+Value string_from_chars(Heap *heap, const char *chars, size_t length) {
+    if (length <= SHORT_STRING_MAX) {
+        return make_short_string(chars, length);
+    }
+    StringObject *string = allocate_string(heap, length, true, false);
+    memcpy(string->chars, chars, length);
+    return (Value)(uintptr_t)string;
+}
+
+Value string_slice(Heap *heap, Value owner, const char *chars, size_t length) {
+    if (length <= SHORT_STRING_MAX) {
+        return make_short_string(chars, length);
+    }
+    StringObject *string = allocate_string(heap, length, false, false);
+    string->chars = (char *)chars;
+    string->left = owner;
+    return (Value)(uintptr_t)string;
+}
+
+Value string_split(Heap *heap, Value string, Value delimiter) {
+    char scratch[SHORT_STRING_MAX + 1];
+    char delimiter_scratch[SHORT_STRING_MAX + 1];
+    const char *chars = string_chars(string, scratch);
+    const char *end = chars + string_byte_length(string);
+    const char *separator = string_chars(delimiter, delimiter_scratch);
+    size_t separator_length = string_byte_length(delimiter);
+
+    // Slices point into whatever holds the bytes. Those of a young flat
+    // string move with it, so its parts are copied instead.
+    Value owner = VALUE_NONE;
+    if (!value_is_short_string(string)) {
+        StringObject *object = value_as_string(string);
+        if (string_is_slice(object)) {
+            owner = object->left;
+        } else if (object->chars != object->storage || !heap_in_nursery(heap, object)) {
+            owner = string;
+        }
+    }
+
+    ListObject *list = list_create(heap, 0);
+    const char *start = chars;
+    for (;;) {
+        const char *found = start;
+        while ((found = memchr(found, separator[0], (size_t)(end - found))) != NULL &&
+               ((size_t)(end - found) < separator_length || memcmp(found, separator, separator_length) != 0)) {
+            found++;
+        }
+        const char *stop = found ? found : end;
+        size_t length = (size_t)(stop - start);
+        list_append(heap, list, owner != VALUE_NONE ? string_slice(heap, owner, start, length)
+                                                    : string_from_chars(heap, start, length));
+        if (found == NULL) {
+            break;
+        }
+        start = found + separator_length;
+    }
+    return (Value)(uintptr_t)list;
+}
+
+size_t string_byte_length(Value string) {
+    if (value_is_short_string(string)) {
+        return short_string_length(string);
+    }
+    return value_as_string(string)->length;
+}
+
+// Copy a rope's leaves into one buffer, right to left. The pending halves
+// are kept on an explicit stack, so a rope built by a long loop of
+// appends does not recurse once per append.
+static void flatten(StringObject *rope) {
+    char *chars = safe_malloc(rope->length + 1);
+    chars[rope->length] = '\0';
+    size_t end = rope->length;
+
+    Value *stack = NULL;
+    size_t count = 0;
+    size_t capacity = 0;
+    Value pending[2] = {rope->left, rope->right};
+    for (int i = 0; i < 2; i++) {
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 16;
+            stack = safe_realloc(stack, capacity * sizeof(Value));
+        }
+        stack[count++] = pending[i];
+    }
+
+    while (count > 0) {
+        Value piece = stack[--count];
+        if (value_is_short_string(piece)) {
+            size_t length = short_string_length(piece);
+            end -= length;
+            copy_short_string(piece, chars + end);
+            continue;
+        }
+        StringObject *string = value_as_string(piece);
+        if (string->chars) {
+            end -= string->length;
+            memcpy(chars + end, string->chars, string->length);
+            continue;
+        }
+        // The right half is copied first, so it goes on top
+        if (count + 2 > capacity) {
+            capacity = capacity * 2;
+            stack = safe_realloc(stack, capacity * sizeof(Value));
+        }
+        stack[count++] = string->left;
+        stack[count++] = string->right;
+    }
+    free(stack);
+
+    rope->chars = chars;
+    rope->left = VALUE_NONE;
+    rope->right = VALUE_NONE;
+}
+
+const char *string_chars(Value string, char scratch[SHORT_STRING_MAX + 1]) {
+    if (value_is_short_string(string)) {
+        return short_string_chars(string, scratch);
+    }
+    StringObject *object = value_as_string(string);
+    if (object->chars == NULL) {
+        flatten(object);
+    }
+    return object->chars;
+}
+
+// Codepoints if already known, without flattening; SIZE_MAX otherwise, or
+// STRING_INVALID_UTF8
+static size_t known_length(Value string) {
+    if (value_is_short_string(string)) {
+        char scratch[SHORT_STRING_MAX + 1];
+        size_t codepoints;
+        bool valid = utf8_validate(short_string_chars(string, scratch), short_string_length(string), &codepoints);
+        return valid ? codepoints : STRING_INVALID_UTF8;
+    }
+    return value_as_string(string)->codepoints;
+}
+
+Value string_concat(Heap *heap, Value a, Value b) {
+    size_t left_length = string_byte_length(a);
+    size_t right_length = string_byte_length(b);
+    if (left_length == 0) {
+        return b;
+    }
+    if (right_length == 0) {
+        return a;
+    }
+    size_t length = left_length + right_length;
+    size_t left_codepoints = known_length(a);
+    size_t right_codepoints = known_length(b);
+    // Halves of a sequence split between invalid ones may make a valid one
+    size_t codepoints = left_codepoints >= STRING_INVALID_UTF8 || right_codepoints >= STRING_INVALID_UTF8
+                            ? SIZE_MAX
+                            : left_codepoints + right_codepoints;
+
+    if (length < ROPE_MIN_LENGTH) {
+        // Both halves are short or flat here, since ropes are longer
+        char left_scratch[SHORT_STRING_MAX + 1];
+        char right_scratch[SHORT_STRING_MAX + 1];
+        const char *left = string_chars(a, left_scratch);
+        const char *right = string_chars(b, right_scratch);
+        if (length <= SHORT_STRING_MAX) {
+            char chars[SHORT_STRING_MAX];
+            memcpy(chars, left, left_length);
+            memcpy(chars + left_length, right, right_length);
+            return make_short_string(chars, length);
+        }
+        StringObject *string = allocate_string(heap, length, true, false);
+        memcpy(string->chars, left, left_length);
+        memcpy(string->chars + left_length, right, right_length);
+        string->codepoints = codepoints;
+        return (Value)(uintptr_t)string;
+    }
+
+    StringObject *rope = allocate_string(heap, length, false, false);
+    rope->left = a;
+    rope->right = b;
+    rope->codepoints = codepoints;
+    return (Value)(uintptr_t)rope;
+}
+
+bool string_length(Value string, size_t *length) {
+    size_t codepoints = known_length(string);
+    if (codepoints == SIZE_MAX) {
+        StringObject *object = value_as_string(string);
+        if (!utf8_validate(string_chars(string, NULL), object->length, &codepoints)) {
+            codepoints = STRING_INVALID_UTF8;
+        }
+        object->codepoints = codepoints;
+    }
+    *length = codepoints;
+    return codepoints != STRING_INVALID_UTF8;
+}
+
+static void build_breadcrumbs(StringObject *string) {
+    size_t count = (string->codepoints + STRING_BREADCRUMB_STRIDE - 1) / STRING_BREADCRUMB_STRIDE;
+    string->breadcrumbs = safe_malloc((count ? count : 1) * sizeof(size_t));
+    const char *p = string->chars;
+    for (size_t i = 0; i < string->codepoints; i++) {
+        if (i % STRING_BREADCRUMB_STRIDE == 0) {
+            string->breadcrumbs[i / STRING_BREADCRUMB_STRIDE] = (size_t)(p - string->chars);
+        }
+        utf8_nextchar(&p);
+    }
+}
+
+bool string_index(Value string, size_t index, Value *result) {
+    size_t length;
+    if (!string_length(string, &length) || index >= length) {
+        return false;
+    }
+    char scratch[SHORT_STRING_MAX + 1];
+    const char *chars = string_chars(string, scratch);
+    const char *p = chars;
+
+    if (value_is_short_string(string)) {
+        for (size_t i = 0; i < index; i++) {
+            utf8_nextchar(&p);
+        }
+    } else {
+        StringObject *object = value_as_string(string);
+        if (object->codepoints == object->length) {
+            // All ASCII: one byte per codepoint
+            p = chars + index;
+        } else {
+            if (object->breadcrumbs == NULL) {
+                build_breadcrumbs(object);
+            }
+            p = chars + object->breadcrumbs[index / STRING_BREADCRUMB_STRIDE];
+            for (size_t i = 0; i < index % STRING_BREADCRUMB_STRIDE; i++) {
+                utf8_nextchar(&p);
+            }
+        }
+    }
+
+    // A codepoint is at most 4 bytes, so the result is always short
+    const char *start = p;
+    utf8_nextchar(&p);
+    *result = make_short_string(start, (size_t)(p - start));
+    return true;
+}
+
+// Never 0, so 0 can mean "not computed"
+static uint64_t content_hash(const char *chars, size_t length) {
+    uint64_t hash = hash_bytes(chars, length);
+    return hash ? hash : 1;
+}
+
+uint64_t string_hash(Value string) {
+    if (value_is_short_string(string)) {
+        // Short strings never equal heap strings, so they may hash differently
+        uint64_t hash = string * 0x9E3779B97F4A7C15ULL;
+        return hash ^ (hash >> 32);
+    }
+    StringObject *object = value_as_string(string);
+    if (object->hash == 0) {
+        object->hash = content_hash(string_chars(string, NULL), object->length);
+    }
+    return object->hash;
+}
+
+bool string_equal(Value a, Value b) {
+    if (a == b) {
+        return true;
+    }
+    if (value_is_short_string(a) || value_is_short_string(b)) {
+        return false;
+    }
+    StringObject *x = value_as_string(a);
+    StringObject *y = value_as_string(b);
+    if (x->length != y->length || (x->interned && y->interned)) {
+        return false;
+    }
+    if (x->hash != 0 && y->hash != 0 && x->hash != y->hash) {
+        return false;
+    }
+    return memcmp(string_chars(a, NULL), string_chars(b, NULL), x->length) == 0;
+}
+
+int string_compare(Value a, Value b) {
+    char left_scratch[SHORT_STRING_MAX + 1];
+    char right_scratch[SHORT_STRING_MAX + 1];
+    size_t left_length = string_byte_length(a);
+    size_t right_length = string_byte_length(b);
+    size_t length = left_length < right_length ? left_length : right_length;
+    int order = memcmp(string_chars(a, left_scratch), string_chars(b, right_scratch), length);
+    if (order != 0) {
+        return order;
+    }
+    return left_length < right_length ? -1 : left_length > right_length;
+}
+
+void string_settle(Value string) {
+    if (value_is_short_string(string)) {
+        return;
+    }
+    StringObject *object = value_as_string(string);
+    size_t length;
+    string_hash(string);
+    if (string_length(string, &length) && length != object->length && object->breadcrumbs == NULL) {
+        build_breadcrumbs(object);
+    }
+}
+
+StringBuilder *builder_create(Heap *heap, Value string) {
+    StringBuilder *builder = (StringBuilder *)allocate_object(heap, OBJECT_BUILDER, sizeof(StringBuilder));
+    size_t length = string_byte_length(string);
+    builder->capacity = length < 64 ? 128 : length * 2;
+    builder->chars = safe_malloc(builder->capacity);
+    builder->length = 0;
+    builder_append(builder, string);
+    return builder;
+}
+
+void builder_append(StringBuilder *builder, Value string) {
+    size_t length = string_byte_length(string);
+    if (builder->length + length > builder->capacity) {
+        while (builder->length + length > builder->capacity) {
+            builder->capacity = builder->capacity ? builder->capacity * 2 : 128;
+        }
+        builder->chars = safe_realloc(builder->chars, builder->capacity);
+    }
+    if (value_is_short_string(string)) {
+        copy_short_string(string, builder->chars + builder->length);
+    } else {
+        memcpy(builder->chars + builder->length, string_chars(string, NULL), length);
+    }
+    builder->length += length;
+}
+
+Value builder_finish(Heap *heap, StringBuilder *builder) {
+    Value result;
+    if (builder->length <= SHORT_STRING_MAX) {
+        result = make_short_string(builder->chars, builder->length);
+        free(builder->chars);
+    } else {
+        // The buffer becomes the string's storage
+        StringObject *string = allocate_string(heap, builder->length, false, false);
+        string->chars = safe_realloc(builder->chars, builder->length + 1);
+        string->chars[builder->length] = '\0';
+        result = (Value)(uintptr_t)string;
+    }
+    builder->chars = NULL;
+    builder->length = 0;
+    builder->capacity = 0;
+    return result;
+}
+
+void release_builder(StringBuilder *builder) {
+    free(builder->chars);
+}
+
+static void insert_interned(Heap *heap, StringObject *string) {
+    size_t mask = heap->string_capacity - 1;
+    size_t index = string->hash & mask;
+    while (heap->strings[index] != NULL) {
+        index = (index + 1) & mask;
+    }
+    heap->strings[index] = string;
+}
+
+Value string_intern(Heap *heap, const char *chars, size_t length) {
+    if (length <= SHORT_STRING_MAX) {
+        return make_short_string(chars, length);
+    }
+    uint64_t hash = content_hash(chars, length);
+    if (heap->string_capacity > 0) {
+        size_t mask = heap->string_capacity - 1;
+        for (size_t index = hash & mask; heap->strings[index] != NULL; index = (index + 1) & mask) {
+            StringObject *string = heap->strings[index];
+            if (string->hash == hash && string->length == length &&
+                memcmp(string->chars, chars, length) == 0) {
+                return (Value)(uintptr_t)string;
+            }
+        }
+    }
+
+    // Keep the table at most half full
+    if ((heap->string_count + 1) * 2 > heap->string_capacity) {
+        StringObject **old = heap->strings;
+        size_t old_capacity = heap->string_capacity;
+        heap->string_capacity = old_capacity ? old_capacity * 2 : 64;
+        heap->strings = safe_malloc(heap->string_capacity * sizeof(StringObject *));
+        memset(heap->strings, 0, heap->string_capacity * sizeof(StringObject *));
+        for (size_t i = 0; i < old_capacity; i++) {
+            if (old[i] != NULL) {
+                insert_interned(heap, old[i]);
+            }
+        }
+        free(old);
+    }
+
+    StringObject *string = allocate_string(heap, length, true, true);
+    memcpy(string->chars, chars, length);
+    Value value = (Value)(uintptr_t)string;
+    string->hash = hash;
+    string->interned = true;
+    insert_interned(heap, string);
+    heap->string_count++;
+    return value;
+}
+
+void free_string_table(Heap *heap) {
+    free(heap->strings);
+    heap->strings = NULL;
+    heap->string_count = 0;
+    heap->string_capacity = 0;
+}
@@ -0,0 +1,655 @@
+//scheduler.c
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "../include/scheduler.h"
+#include "../include/runtime_string.h"
+#include "../include/list.h"
+#include "../include/dict.h"
+
+static uint64_t now_ns(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64_t)time.tv_sec * 1000000000u + (uint64_t)time.tv_nsec;
+}
+
+bool reduce_values(Heap *heap, ReductionKind kind, Value *total, Value value, char *error) {
+    if (kind == REDUCE_SUM) {
+        // Strings are summed in a builder, as an accumulator's appends are
+        if (value_is_object_type(*total, OBJECT_BUILDER) && value_is_string(value)) {
+            builder_append((StringBuilder *)value_as_object(*total), value);
+            return true;
+        }
+        if (value_is_string(*total) && value_is_string(value)) {
+            StringBuilder *builder = builder_create(heap, *total);
+            builder_append(builder, value);
+            *total = (Value)(uintptr_t)builder;
+            return true;
+        }
+        if (value_is_object_type(*total, OBJECT_BUILDER)) {
+            *total = builder_finish(heap, (StringBuilder *)value_as_object(*total));
+        }
+        if (!value_add(heap, *total, value, total)) {
+            snprintf(error, MAX_ERROR_MESSAGE_LENGTH, "Unsupported operand types for +: '%s' and '%s'",
+                     value_type_name(*total), value_type_name(value));
+            return false;
+        }
+        return true;
+    }
+    // The first of equal values is kept, as ಕನಿಷ್ಠ and ಗರಿಷ್ಠ keep it
+    bool better;
+    if (!value_less(kind == REDUCE_MAX ? *total : value, kind == REDUCE_MAX ? value : *total, &better)) {
+        snprintf(error, MAX_ERROR_MESSAGE_LENGTH, "Unsupported operand types for <: '%s' and '%s'",
+                 value_type_name(value), value_type_name(*total));
+        return false;
+    }
+    if (better) {
+        *total = value;
+    }
+    return true;
+}
+
+// Iterations [begin, end) of one worker, run back to back
+typedef struct {
+    uint64_t begin;
+    uint64_t end;           // Past the last that ran
+    Buffer output;          // What they printed
+    // Where their partial reductions start in the worker's partials,
+    // followed by the private variables as they left them
+    size_t partials;
+} Batch;
+
+struct Scheduler;
+struct ThreadPool;
+
+typedef struct {
+    struct ThreadPool *pool;
+    struct Scheduler *scheduler;    // The loop it is working on
+    int index;
+    VM vm;
+    pthread_t thread;
+
+    // Iterations not yet taken, [next, end). The worker takes batches
+    // from the front; others take half from the back.
+    pthread_mutex_t lock;
+    uint64_t next;
+    uint64_t end;
+    uint64_t batch_size;
+
+    Batch *batches;
+    int batch_count;
+    int batch_capacity;
+    // Each batch's value of every reduction, or VALUE_UNDEFINED if it
+    // reduced none, then of every private variable, or VALUE_UNDEFINED if
+    // it assigned none. The worker's collections treat them as roots.
+    Value *partials;
+    size_t partial_count;
+    size_t partial_capacity;
+    Buffer text;            // What the running batch prints
+
+    ErrorList errors;       // The error of its first failed iteration
+    uint64_t failed_at;     // That iteration, or UINT64_MAX
+} Worker;
+
+typedef struct Scheduler {
+    Chunk *chunk;
+    const ParallelLoop *loop;
+    Value start;
+    Value step;
+    Worker *workers;
+    int worker_count;
+    // The first iteration known to fail. Iterations after it need not run.
+    atomic_uint_fast64_t first_failure;
+} Scheduler;
+
+// The workers of one VM, kept from one loop to the next. The first runs
+// on the thread that runs the loop; the others wait on threads of their
+// own for a loop to be handed out.
+struct ThreadPool {
+    Worker workers[PARALLEL_MAX_THREADS];
+    int ready;              // Workers whose VM is set up
+    int threads;            // Workers after the first with a thread running
+    pthread_mutex_t lock;
+    pthread_cond_t wake;    // A loop was handed out, or the pool is stopping
+    pthread_cond_t done;    // The last busy worker finished
+    Scheduler *scheduler;   // The loop handed out last
+    uint64_t generation;    // How many loops were handed out
+    int busy;               // Threads still working on it
+    bool stopping;
+};
+
+// The value of the loop variable in iteration `i`
+static Value iteration_value(Heap *heap, Value start, Value step, uint64_t i) {
+    int64_t offset;
+    int64_t value;
+    if ((start & step & 1) && !__builtin_mul_overflow(value_as_small_int(step), (int64_t)i, &offset) &&
+        !__builtin_add_overflow(value_as_small_int(start), offset, &value) && value >= SMALL_INT_MIN &&
+        value <= SMALL_INT_MAX) {
+        return value_from_small_int(value);
+    }
+    Integer index = integer_from_int64((int64_t)i);
+    Integer distance = integer_mul(value_to_integer(step), index);
+    Value result = value_from_integer(heap, integer_add(value_to_integer(start), distance));
+    integer_free(&index);
+    integer_free(&distance);
+    return result;
+}
+
+static void note_failure(Worker *worker, uint64_t iteration) {
+    // Only the earliest failure is reported, so only its error is kept
+    ErrorList *errors = &worker->errors;
+    if (iteration < worker->failed_at) {
+        errors->errors[0] = errors->errors[errors->count - 1];
+        errors->count = 1;
+        worker->failed_at = iteration;
+    } else {
+        errors->count--;
+    }
+    atomic_uint_fast64_t *first = &worker->scheduler->first_failure;
+    uint_fast64_t current = atomic_load(first);
+    while (iteration < current && !atomic_compare_exchange_weak(first, &current, iteration)) {
+    }
+}
+
+static void run_batch(Worker *worker, uint64_t begin, uint64_t end) {
+    Scheduler *scheduler = worker->scheduler;
+    const ParallelLoop *loop = scheduler->loop;
+    VM *vm = &worker->vm;
+    for (int i = 0; i < loop->reduction_count; i++) {
+        vm->globals[loop->reduction_slots[i]] = VALUE_UNDEFINED;
+    }
+    // No iteration reads a private variable before assigning it, so this
+    // only notes which the batch assigns
+    for (int i = 0; i < loop->private_count; i++) {
+        vm->globals[loop->private_slots[i]] = VALUE_UNDEFINED;
+    }
+
+    uint64_t i = begin;
+    while (i < end && i <= atomic_load_explicit(&scheduler->first_failure, memory_order_relaxed)) {
+        vm->globals[loop->slot] = iteration_value(&vm->heap, scheduler->start, scheduler->step, i);
+        if (!run_code(vm, scheduler->chunk, loop->body, &worker->errors)) {
+            // What the failed iteration printed before failing is kept
+            note_failure(worker, i++);
+            break;
+        }
+        i++;
+    }
+
+    if (worker->batch_count == worker->batch_capacity) {
+        worker->batch_capacity = worker->batch_capacity ? worker->batch_capacity * 2 : 64;
+        worker->batches = safe_realloc(worker->batches, worker->batch_capacity * sizeof(Batch));
+    }
+    Batch *batch = &worker->batches[worker->batch_count++];
+    batch->begin = begin;
+    batch->end = i;
+    output_flush(&vm->output);
+    batch->output = worker->text;
+    buffer_init(&worker->text);
+
+    batch->partials = worker->partial_count;
+    size_t needed = worker->partial_count + (size_t)(loop->reduction_count + loop->private_count);
+    if (needed > worker->partial_capacity) {
+        worker->partial_capacity = worker->partial_capacity ? worker->partial_capacity * 2 : 64;
+        while (worker->partial_capacity < needed) {
+            worker->partial_capacity *= 2;
+        }
+        worker->partials = safe_realloc(worker->partials, worker->partial_capacity * sizeof(Value));
+    }
+    for (int r = 0; r < loop->reduction_count + loop->private_count; r++) {
+        Value *slot = &vm->globals[r < loop->reduction_count ? loop->reduction_slots[r]
+                                                              : loop->private_slots[r - loop->reduction_count]];
+        if (value_is_object_type(*slot, OBJECT_BUILDER)) {
+            *slot = builder_finish(&vm->heap, (StringBuilder *)value_as_object(*slot));
+        }
+        worker->partials[worker->partial_count++] = *slot;
+    }
+    vm->roots = (RootRange){worker->partials, worker->partial_count};
+}
+
+// Take the next batch from the worker's own iterations
+static bool take_batch(Worker *worker, uint64_t *begin, uint64_t *end) {
+    pthread_mutex_lock(&worker->lock);
+    bool found = worker->next < worker->end;
+    if (found) {
+        uint64_t left = worker->end - worker->next;
+        *begin = worker->next;
+        *end = *begin + (left < worker->batch_size ? left : worker->batch_size);
+        worker->next = *end;
+    }
+    pthread_mutex_unlock(&worker->lock);
+    return found;
+}
+
+// Move the back half of another worker's iterations to `thief`, whose
+// own have run out. Returns false if there are none left anywhere.
+static bool steal(Worker *thief) {
+    Scheduler *scheduler = thief->scheduler;
+    for (int k = 1; k < scheduler->worker_count; k++) {
+        Worker *victim = &scheduler->workers[(thief->index + k) % scheduler->worker_count];
+        uint64_t begin = 0;
+        uint64_t end = 0;
+        pthread_mutex_lock(&victim->lock);
+        if (victim->next < victim->end) {
+            end = victim->end;
+            begin = end - (end - victim->next + 1) / 2;
+            victim->end = begin;
+        }
+        pthread_mutex_unlock(&victim->lock);
+        if (begin < end) {
+            pthread_mutex_lock(&thief->lock);
+            thief->next = begin;
+            thief->end = end;
+            pthread_mutex_unlock(&thief->lock);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Run batches until no iterations are left anywhere or, if `deadline` is
+// not 0, one ends after it
+static void run_batches(Worker *worker, uint64_t deadline) {
+    Scheduler *scheduler = worker->scheduler;
+    for (;;) {
+        uint64_t begin;
+        uint64_t end;
+        if (!take_batch(worker, &begin, &end)) {
+            if (!steal(worker)) {
+                return;
+            }
+            continue;
+        }
+        if (begin > atomic_load(&scheduler->first_failure)) {
+            continue;
+        }
+        uint64_t started = now_ns();
+        run_batch(worker, begin, end);
+        uint64_t finished = now_ns();
+        if (finished - started < PARALLEL_BATCH_MIN_NS && end - begin == worker->batch_size) {
+            worker->batch_size *= 2;
+        } else if (finished - started > PARALLEL_BATCH_MAX_NS && worker->batch_size > 1) {
+            worker->batch_size /= 2;
+        }
+        if (deadline != 0 && finished > deadline) {
+            return;
+        }
+    }
+}
+
+// The thread of a worker after the first: it works on every loop handed
+// out that has a part for it
+static void *serve(void *context) {
+    Worker *worker = context;
+    ThreadPool *pool = worker->pool;
+    uint64_t seen = 0;
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (pool->generation == seen && !pool->stopping) {
+            pthread_cond_wait(&pool->wake, &pool->lock);
+        }
+        if (pool->stopping) {
+            break;
+        }
+        seen = pool->generation;
+        if (worker->index < pool->scheduler->worker_count) {
+            pthread_mutex_unlock(&pool->lock);
+            run_batches(worker, 0);
+            pthread_mutex_lock(&pool->lock);
+            if (--pool->busy == 0) {
+                pthread_cond_signal(&pool->done);
+            }
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+// Objects that settling has reached, and those it has still to look into
+typedef struct {
+    Object **objects;
+    size_t count;
+    size_t capacity;
+} ObjectList;
+
+static void reach(ObjectList *list, Value value) {
+    if (!value_is_object(value) || value_as_object(value)->marked) {
+        return;
+    }
+    if (list->count == list->capacity) {
+        list->capacity = list->capacity ? list->capacity * 2 : 256;
+        list->objects = safe_realloc(list->objects, list->capacity * sizeof(Object *));
+    }
+    value_as_object(value)->marked = true;
+    list->objects[list->count++] = value_as_object(value);
+}
+
+// Settle every string the workers can reach through `roots`, so that
+// reading it from several threads at once writes nothing. Collections
+// leave every mark clear, so marks note what has been reached.
+static void settle_reachable(const RootRange *roots, int root_count) {
+    ObjectList reached = {NULL, 0, 0};
+    for (int i = 0; i < root_count; i++) {
+        for (size_t j = 0; j < roots[i].count; j++) {
+            reach(&reached, roots[i].values[j]);
+        }
+    }
+    for (size_t i = 0; i < reached.count; i++) {
+        Object *object = reached.objects[i];
+        if (object->type == OBJECT_STRING) {
+            string_settle((Value)(uintptr_t)object);
+        } else if (object->type == OBJECT_LIST && !((ListObject *)object)->unboxed) {
+            ListObject *list = (ListObject *)object;
+            for (size_t j = 0; j < list->count; j++) {
+                reach(&reached, list->items.values[j]);
+            }
+        } else if (object->type == OBJECT_DICT) {
+            DictObject *dict = (DictObject *)object;
+            for (size_t j = 0; j < dict->entry_count; j++) {
+                reach(&reached, dict->entries[j].key);
+                reach(&reached, dict->entries[j].value);
+            }
+        }
+    }
+    for (size_t i = 0; i < reached.count; i++) {
+        reached.objects[i]->marked = false;
+    }
+    free(reached.objects);
+}
+
+static int thread_count(const VM *vm, uint64_t count) {
+    long threads = vm->threads > 0 ? vm->threads : sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads < 1) {
+        threads = 1;
+    }
+    if (threads > PARALLEL_MAX_THREADS) {
+        threads = PARALLEL_MAX_THREADS;
+    }
+    return (uint64_t)threads > count ? (int)count : (int)threads;
+}
+
+static void init_worker(Worker *worker, ThreadPool *pool, int index) {
+    worker->pool = pool;
+    worker->index = index;
+    init_vm(&worker->vm, NULL);
+    worker->vm.output.capture = &worker->text;
+    worker->vm.heap.tag = (uint8_t)(index + 1);
+    // A loop nested in an iteration runs on the iteration's thread
+    worker->vm.threads = 1;
+    pthread_mutex_init(&worker->lock, NULL);
+    worker->batches = NULL;
+    worker->batch_count = 0;
+    worker->batch_capacity = 0;
+    worker->partials = NULL;
+    worker->partial_count = 0;
+    worker->partial_capacity = 0;
+    buffer_init(&worker->text);
+    init_error_list(&worker->errors);
+}
+
+// Ready the worker for the loop, with the VM's globals as they are before
+// it and the iterations [begin, end)
+static void start_worker(Worker *worker, Scheduler *scheduler, const VM *vm, uint64_t begin, uint64_t end) {
+    VM *own = &worker->vm;
+    if (own->global_count < vm->global_count) {
+        own->globals = safe_realloc(own->globals, vm->global_count * sizeof(Value));
+    }
+    memcpy(own->globals, vm->globals, vm->global_count * sizeof(Value));
+    own->global_count = vm->global_count;
+    own->roots = (RootRange){NULL, 0};
+    own->heap.limit = vm->heap.limit;
+    // Only the first worker runs on the calling thread, so only it may profile
+    own->profile = worker->index == 0 ? vm->profile : NULL;
+    worker->scheduler = scheduler;
+    worker->next = begin;
+    worker->end = end;
+    worker->batch_size = 1;
+    worker->failed_at = UINT64_MAX;
+}
+
+// Let go of what the worker kept of the loop, once its heap is adopted
+static void end_worker(Worker *worker) {
+    for (int i = 0; i < worker->batch_count; i++) {
+        buffer_free(&worker->batches[i].output);
+    }
+    worker->batch_count = 0;
+    worker->partial_count = 0;
+    free_error_list(&worker->errors);
+    init_error_list(&worker->errors);
+}
+
+static void free_worker(Worker *worker) {
+    free_vm(&worker->vm);
+    buffer_free(&worker->text);
+    free(worker->batches);
+    free(worker->partials);
+    free_error_list(&worker->errors);
+    pthread_mutex_destroy(&worker->lock);
+}
+
+static ThreadPool *create_pool(void) {
+    ThreadPool *pool = safe_malloc(sizeof(ThreadPool));
+    pool->ready = 0;
+    pool->threads = 0;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    pool->scheduler = NULL;
+    pool->generation = 0;
+    pool->busy = 0;
+    pool->stopping = false;
+    return pool;
+}
+
+// Set up the first `count` workers, starting threads for those after the
+// first. Returns how many can work, fewer if a thread would not start.
+static int prepare_workers(ThreadPool *pool, int count) {
+    while (pool->ready < count) {
+        init_worker(&pool->workers[pool->ready], pool, pool->ready);
+        pool->ready++;
+    }
+    while (pool->threads + 1 < count) {
+        Worker *worker = &pool->workers[pool->threads + 1];
+        if (pthread_create(&worker->thread, NULL, serve, worker) != 0) {
+            break;
+        }
+        pool->threads++;
+    }
+    return pool->threads + 1 < count ? pool->threads + 1 : count;
+}
+
+void free_thread_pool(ThreadPool *pool) {
+    if (pool == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+    for (int w = 1; w <= pool->threads; w++) {
+        pthread_join(pool->workers[w].thread, NULL);
+    }
+    for (int w = 0; w < pool->ready; w++) {
+        free_worker(&pool->workers[w]);
+    }
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->wake);
+    pthread_cond_destroy(&pool->done);
+    free(pool);
+}
+
+typedef struct {
+    Worker *worker;
+    Batch *batch;
+} BatchRef;
+
+static int compare_batches(const void *a, const void *b) {
+    uint64_t x = ((const BatchRef *)a)->batch->begin;
+    uint64_t y = ((const BatchRef *)b)->batch->begin;
+    return x < y ? -1 : x > y;
+}
+
+// Write what the batches printed, combine their reductions into the VM's
+// variables and give its private variables their last values, all in
+// iteration order. If an iteration failed, the VM is left as a sequential
+// loop would leave it when that iteration failed.
+static bool finish_loop(VM *vm, Scheduler *scheduler, ErrorList *errors) {
+    const ParallelLoop *loop = scheduler->loop;
+    int count = 0;
+    for (int w = 0; w < scheduler->worker_count; w++) {
+        count += scheduler->workers[w].batch_count;
+    }
+    BatchRef *order = safe_malloc((count + 1) * sizeof(BatchRef));
+    count = 0;
+    for (int w = 0; w < scheduler->worker_count; w++) {
+        Worker *worker = &scheduler->workers[w];
+        for (int i = 0; i < worker->batch_count; i++) {
+            order[count++] = (BatchRef){worker, &worker->batches[i]};
+        }
+    }
+    qsort(order, count, sizeof(BatchRef), compare_batches);
+
+    // Batches partition the range, so those starting after the first
+    // failure all come after it
+    uint64_t failure = atomic_load(&scheduler->first_failure);
+    while (count > 0 && order[count - 1].batch->begin > failure) {
+        count--;
+    }
+    for (int i = 0; i < count; i++) {
+        output_write(&vm->output, order[i].batch->output.data, order[i].batch->output.length);
+    }
+
+    // The partial results become the VM's before they are combined
+    for (int w = 0; w < scheduler->worker_count; w++) {
+        Worker *worker = &scheduler->workers[w];
+        RootRange partials = {worker->partials, worker->partial_count};
+        heap_adopt(&vm->heap, &worker->vm.heap, &partials, 1);
+    }
+    bool ok = true;
+    for (int r = 0; r < loop->reduction_count; r++) {
+        Value *total = &vm->globals[loop->reduction_slots[r]];
+        char message[MAX_ERROR_MESSAGE_LENGTH];
+        for (int i = 0; i < count; i++) {
+            Value partial = order[i].worker->partials[order[i].batch->partials + r];
+            if (partial != VALUE_UNDEFINED && !reduce_values(&vm->heap, loop->reduction_kinds[r], total, partial,
+                                                             message)) {
+                // A failed iteration came first and is what is reported
+                if (ok && failure == UINT64_MAX) {
+                    report_error(errors, ERROR_RUNTIME, loop->line, "%s", message);
+                }
+                ok = false;
+                break;
+            }
+        }
+        if (value_is_object_type(*total, OBJECT_BUILDER)) {
+            *total = builder_finish(&vm->heap, (StringBuilder *)value_as_object(*total));
+        }
+    }
+    for (int p = 0; p < loop->private_count; p++) {
+        for (int i = count - 1; i >= 0; i--) {
+            Value value = order[i].worker->partials[order[i].batch->partials + loop->reduction_count + p];
+            if (value != VALUE_UNDEFINED) {
+                vm->globals[loop->private_slots[p]] = value;
+                break;
+            }
+        }
+    }
+    free(order);
+
+    if (failure != UINT64_MAX) {
+        for (int w = 0; w < scheduler->worker_count; w++) {
+            Worker *worker = &scheduler->workers[w];
+            if (worker->failed_at == failure) {
+                Error *error = &worker->errors.errors[0];
+                report_error(errors, error->type, error->line, "%s", error->message);
+            }
+        }
+        return false;
+    }
+    return ok;
+}
+
+bool run_parallel_loop(VM *vm, Chunk *chunk, const ParallelLoop *loop, Value start, Value step,
+                       uint64_t count, ErrorList *errors) {
+    for (int r = 0; r < loop->reduction_count; r++) {
+        uint32_t slot = loop->reduction_slots[r];
+        if (vm->globals[slot] == VALUE_UNDEFINED) {
+            report_error(errors, ERROR_RUNTIME, loop->line, "Variable '%s' used before it was assigned",
+                         chunk->global_names[slot]);
+            return false;
+        }
+    }
+    // Builders are changed in place, so none may be shared
+    for (int i = 0; i < vm->global_count; i++) {
+        if (value_is_object_type(vm->globals[i], OBJECT_BUILDER)) {
+            vm->globals[i] = builder_finish(&vm->heap, (StringBuilder *)value_as_object(vm->globals[i]));
+        }
+    }
+    if (vm->pool == NULL) {
+        vm->pool = create_pool();
+    }
+    ThreadPool *pool = vm->pool;
+    prepare_workers(pool, 1);
+
+    Scheduler scheduler;
+    scheduler.chunk = chunk;
+    scheduler.loop = loop;
+    scheduler.start = start;
+    scheduler.step = step;
+    scheduler.workers = pool->workers;
+    scheduler.worker_count = 1;
+    atomic_init(&scheduler.first_failure, UINT64_MAX);
+    Worker *first = &pool->workers[0];
+    start_worker(first, &scheduler, vm, 0, count);
+
+    // The calling thread makes a start alone, so a loop that is soon done
+    // costs no more than a sequential one
+    int wanted = thread_count(vm, count);
+    run_batches(first, wanted > 1 ? now_ns() + PARALLEL_INLINE_NS : 0);
+
+    if (first->next < first->end) {
+        RootRange shared[] = {
+            {vm->globals, (size_t)vm->global_count},
+            {chunk->constants, (size_t)chunk->constant_count},
+        };
+        settle_reachable(shared, 2);
+
+        // What is left is split evenly between the workers
+        int workers = prepare_workers(pool, wanted);
+        uint64_t begin = first->next;
+        uint64_t left = first->end - begin;
+        uint64_t share = left / workers;
+        uint64_t extra = left % workers;
+        for (int w = 0; w < workers; w++) {
+            uint64_t end = begin + share + ((uint64_t)w < extra);
+            if (w == 0) {
+                first->end = end;
+            } else {
+                start_worker(&pool->workers[w], &scheduler, vm, begin, end);
+            }
+            begin = end;
+        }
+        scheduler.worker_count = workers;
+
+        pthread_mutex_lock(&pool->lock);
+        pool->scheduler = &scheduler;
+        pool->busy = workers - 1;
+        pool->generation++;
+        pthread_cond_broadcast(&pool->wake);
+        pthread_mutex_unlock(&pool->lock);
+        run_batches(first, 0);
+        pthread_mutex_lock(&pool->lock);
+        while (pool->busy > 0) {
+            pthread_cond_wait(&pool->done, &pool->lock);
+        }
+        pthread_mutex_unlock(&pool->lock);
+    }
+
+    bool ok = finish_loop(vm, &scheduler, errors);
+    for (int w = 0; w < scheduler.worker_count; w++) {
+        end_worker(&pool->workers[w]);
+    }
+    return ok;
+}
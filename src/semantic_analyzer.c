@@ -1,64 +1,316 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include "../include/semantic_analyzer.h"
-#include "../include/common.h"
-
-// Function to perform semantic analysis on the AST
-void semantic_analysis(ASTNode *ast, SymbolTable *symbol_table) {
-    // Perform semantic analysis based on the node type
-    switch (ast->type) {
-        case AST_PROGRAM:
-            for (int i = 0; i < ast->data.program.count; i++) {
-                semantic_analysis(ast->data.program.statements[i], symbol_table);
-            }
-            break;
-        case AST_BLOCK:
-            for (int i = 0; i < ast->data.block.count; i++) {
-                semantic_analysis(ast->data.block.statements[i], symbol_table);
-            }
-            break;
-        case AST_IF:
-            semantic_analysis(ast->data.if_stmt.condition, symbol_table);
-            semantic_analysis(ast->data.if_stmt.if_body, symbol_table);
-            if (ast->data.if_stmt.else_body) {
-                semantic_analysis(ast->data.if_stmt.else_body, symbol_table);
-            }
-            break;
-        case AST_WHILE:
-            semantic_analysis(ast->data.while_loop.condition, symbol_table);
-            semantic_analysis(ast->data.while_loop.body, symbol_table);
-            break;
-        case AST_PRINT:
-            semantic_analysis(ast->data.print_stmt.expression, symbol_table);
-            break;
-        case AST_ASSIGN:
-            if (!lookup_symbol(symbol_table, ast->data.assign.name)) {
-                fprintf(stderr, "Error: Undeclared variable '%s' at line %d\n", ast->data.assign.name, ast->line);
-                exit(EXIT_FAILURE);
-            }
-            semantic_analysis(ast->data.assign.value, symbol_table);
-            break;
-        case AST_BINARY_OP:
-            semantic_analysis(ast->data.binary_op.left, symbol_table);
-            semantic_analysis(ast->data.binary_op.right, symbol_table);
-            break;
-        case AST_UNARY_OP:
-            semantic_analysis(ast->data.unary_op.operand, symbol_table);
-            break;
-        case AST_VARIABLE:
-            if (!lookup_symbol(symbol_table, ast->data.variable.name)) {
-                fprintf(stderr, "Error: Undeclared variable '%s' at line %d\n", ast->data.variable.name, ast->line);
-                exit(EXIT_FAILURE);
-            }
-            break;
-        case AST_NUMBER:
-        case AST_STRING:
-        case AST_BOOLEAN:
-            // No semantic checks needed for literals
-            break;
-        default:
-            fprintf(stderr, "Error: Unknown AST node type at line %d\n", ast->line);
-            exit(EXIT_FAILURE);
-    }
-}
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/semantic_analyzer.h"
+#include "../include/builtins.h"
+#include "../include/parallel.h"
+#include "../include/common.h"
+
+// Report a call whose argument count is not `arity`
+static void check_arity(SemanticContext *semantic, const ASTNode *call, int arity) {
+    if (arity != call->data.call.count) {
+        report_error(semantic->errors, ERROR_SEMANTIC, call->line,
+                     "'%s' takes %d argument%s but %d %s given", call->data.call.name,
+                     arity, arity == 1 ? "" : "s",
+                     call->data.call.count, call->data.call.count == 1 ? "was" : "were");
+    }
+}
+
+// Declare `name` as a variable of the current scope, unless it already is
+static void declare_local(SemanticContext *semantic, const char *name) {
+    Symbol *symbol = lookup_symbol(semantic->symbol_table, name);
+    if (symbol == NULL || symbol->scope < semantic->symbol_table->scope) {
+        insert_symbol(semantic->symbol_table, name, SYMBOL_VARIABLE);
+    }
+}
+
+// As in Python, every name a generator or function assigns is its own
+// throughout its body, and hides any global of that name
+static void declare_assigned(ASTNode *node, void *context) {
+    if (node->type == AST_ASSIGN) {
+        declare_local(context, node->data.assign.name);
+    } else if (node->type == AST_FOR) {
+        declare_local(context, node->data.for_loop.variable);
+    }
+}
+
+// Declare a ಉತ್ಪಾದಕ or ಕಾರ್ಯ named `name`, unless the name is taken
+static Symbol *declare_definition(SymbolTable *symbol_table, ErrorList *errors, const char *name,
+                                  int parameter_count, int line) {
+    if (find_builtin(name) >= 0 || lookup_symbol(symbol_table, name) != NULL) {
+        report_error(errors, ERROR_SEMANTIC, line, "'%s' is already defined", name);
+        return NULL;
+    }
+    Symbol *symbol = insert_symbol(symbol_table, name, SYMBOL_FUNCTION);
+    symbol->info.function.parameter_count = parameter_count;
+    return symbol;
+}
+
+// The names a function's body assigns and the names it uses otherwise
+typedef struct {
+    const char **assigned;
+    int assigned_count;
+    const char **used;
+    int used_count;
+} BodyNames;
+
+static void add_body_name(const char ***names, int *count, const char *name) {
+    for (int i = 0; i < *count; i++) {
+        if ((*names)[i] == name) {
+            return;
+        }
+    }
+    *names = safe_realloc(*names, (*count + 1) * sizeof(const char *));
+    (*names)[(*count)++] = name;
+}
+
+static void collect_body_name(ASTNode *node, void *context) {
+    BodyNames *names = context;
+    if (node->type == AST_ASSIGN) {
+        add_body_name(&names->assigned, &names->assigned_count, node->data.assign.name);
+    } else if (node->type == AST_FOR) {
+        add_body_name(&names->assigned, &names->assigned_count, node->data.for_loop.variable);
+    } else if (node->type == AST_VARIABLE) {
+        add_body_name(&names->used, &names->used_count, node->data.variable.name);
+    } else if (node->type == AST_CALL && find_builtin(node->data.call.name) < 0) {
+        add_body_name(&names->used, &names->used_count, node->data.call.name);
+    }
+}
+
+// Declare the ಕಾರ್ಯ `function`, noting the names its body uses that are
+// not its own for plan_parallel_loop
+static void declare_function(SymbolTable *symbol_table, ErrorList *errors, ASTNode *function) {
+    Symbol *symbol = declare_definition(symbol_table, errors, function->data.function.name,
+                                        function->data.function.parameter_count, function->line);
+    if (symbol == NULL) {
+        return;
+    }
+    BodyNames names = {NULL, 0, NULL, 0};
+    for (int i = 0; i < function->data.function.parameter_count; i++) {
+        add_body_name(&names.assigned, &names.assigned_count, function->data.function.parameters[i]);
+    }
+    ASTVisitor visitor = {collect_body_name, NULL, NULL, &names};
+    walk_ast(function->data.function.body, &visitor, 1);
+
+    int count = 0;
+    for (int i = 0; i < names.used_count; i++) {
+        bool own = false;
+        for (int j = 0; j < names.assigned_count && !own; j++) {
+            own = names.assigned[j] == names.used[i];
+        }
+        if (!own) {
+            names.used[count++] = names.used[i];
+        }
+    }
+    free(names.assigned);
+    symbol->info.function.uses = names.used;
+    symbol->info.function.use_count = count;
+}
+
+void declare_functions(ASTNode *program, SymbolTable *symbol_table, ErrorList *errors) {
+    for (int i = 0; i < program->data.program.count; i++) {
+        if (program->data.program.statements[i]->type == AST_FUNCTION) {
+            declare_function(symbol_table, errors, program->data.program.statements[i]);
+        }
+    }
+}
+
+// Open the scope of a definition's body and declare its variables
+static void open_body(SemanticContext *semantic, const char **parameters, int parameter_count, ASTNode *body,
+                      int line) {
+    open_scope(semantic->symbol_table);
+    for (int i = 0; i < parameter_count; i++) {
+        const char *parameter = parameters[i];
+        Symbol *symbol = lookup_symbol(semantic->symbol_table, parameter);
+        if (symbol != NULL && symbol->scope == semantic->symbol_table->scope) {
+            report_error(semantic->errors, ERROR_SEMANTIC, line, "Duplicate parameter '%s'", parameter);
+        } else {
+            insert_symbol(semantic->symbol_table, parameter, SYMBOL_VARIABLE);
+        }
+    }
+    ASTVisitor visitor = {declare_assigned, NULL, NULL, semantic};
+    walk_ast(body, &visitor, 1);
+}
+
+static void open_generator(SemanticContext *semantic, ASTNode *ast) {
+    // Declared before the body, which may call it
+    Symbol *symbol = declare_definition(semantic->symbol_table, semantic->errors, ast->data.generator.name,
+                                        ast->data.generator.parameter_count, ast->line);
+    if (symbol != NULL) {
+        symbol->info.function.generator = true;
+    }
+    semantic->generator = ast;
+    open_body(semantic, ast->data.generator.parameters, ast->data.generator.parameter_count,
+              ast->data.generator.body, ast->line);
+}
+
+static void open_function(SemanticContext *semantic, ASTNode *ast) {
+    if (!semantic->functions_declared) {
+        declare_function(semantic->symbol_table, semantic->errors, ast);
+    }
+    semantic->function = ast;
+    open_body(semantic, ast->data.function.parameters, ast->data.function.parameter_count,
+              ast->data.function.body, ast->line);
+}
+
+static const char *definition_kind(const Symbol *symbol) {
+    return symbol->info.function.generator ? "generator" : "function";
+}
+
+// Give `name` a value from here on. A generator's or function's name stays its own.
+static void assign_name(SemanticContext *semantic, const char *name, int line) {
+    Symbol *symbol = lookup_symbol(semantic->symbol_table, name);
+    if (symbol == NULL) {
+        insert_symbol(semantic->symbol_table, name, SYMBOL_VARIABLE);
+    } else if (symbol->type == SYMBOL_FUNCTION) {
+        report_error(semantic->errors, ERROR_SEMANTIC, line, "Cannot assign to the %s '%s'",
+                     definition_kind(symbol), name);
+    }
+}
+
+static void check_node(ASTNode *ast, void *context) {
+    SemanticContext *semantic = context;
+
+    // A shared node stands for each of its occurrences, so it is reported
+    // at the statement currently being checked
+    int line = ast->references > 1 ? semantic->statement_line : ast->line;
+    if (ast->type == AST_ASSIGN || ast->type == AST_PRINT || ast->type == AST_EXPRESSION ||
+        ast->type == AST_STORE_INDEX || ast->type == AST_IF || ast->type == AST_WHILE ||
+        ast->type == AST_FOR || ast->type == AST_IMPORT || ast->type == AST_GENERATOR ||
+        ast->type == AST_YIELD || ast->type == AST_FUNCTION || ast->type == AST_RETURN) {
+        semantic->statement_line = ast->line;
+    }
+
+    switch (ast->type) {
+        case AST_IMPORT:
+            {
+                // The driver registers each resolved module before analysis
+                Symbol *module = lookup_symbol(semantic->symbol_table, ast->data.import_stmt.module);
+                if (!module || module->type != SYMBOL_MODULE) {
+                    report_error(semantic->errors, ERROR_SEMANTIC, ast->line,
+                                 "Unknown module '%s'", ast->data.import_stmt.module);
+                    break;
+                }
+                for (int i = 0; i < module->info.module.export_count; i++) {
+                    if (!lookup_symbol(semantic->symbol_table, module->info.module.exports[i])) {
+                        insert_symbol(semantic->symbol_table, module->info.module.exports[i], SYMBOL_VARIABLE);
+                    }
+                }
+            }
+            break;
+        case AST_VARIABLE:
+            {
+                Symbol *symbol = lookup_symbol(semantic->symbol_table, ast->data.variable.name);
+                if (!symbol) {
+                    report_error(semantic->errors, ERROR_SEMANTIC, line,
+                                 "Undeclared variable '%s'", ast->data.variable.name);
+                } else if (symbol->type == SYMBOL_FUNCTION && symbol->info.function.generator) {
+                    report_error(semantic->errors, ERROR_SEMANTIC, line,
+                                 "'%s' is a generator; call it to get its values", ast->data.variable.name);
+                } else if (symbol->type == SYMBOL_FUNCTION) {
+                    report_error(semantic->errors, ERROR_SEMANTIC, line,
+                                 "'%s' is a function; call it to get its value", ast->data.variable.name);
+                }
+            }
+            break;
+        case AST_CALL:
+            {
+                int builtin = find_builtin(ast->data.call.name);
+                Symbol *symbol = builtin < 0 ? lookup_symbol(semantic->symbol_table, ast->data.call.name) : NULL;
+                if (builtin >= 0) {
+                    check_arity(semantic, ast, builtin_arity(builtin));
+                } else if (symbol != NULL && symbol->type == SYMBOL_FUNCTION) {
+                    check_arity(semantic, ast, symbol->info.function.parameter_count);
+                } else {
+                    report_error(semantic->errors, ERROR_SEMANTIC, ast->line,
+                                 "Unknown function '%s'", ast->data.call.name);
+                }
+            }
+            break;
+        case AST_GENERATOR:
+            open_generator(semantic, ast);
+            break;
+        case AST_YIELD:
+            if (semantic->generator == NULL) {
+                report_error(semantic->errors, ERROR_SEMANTIC, ast->line, "Yield outside a generator");
+            }
+            break;
+        case AST_FUNCTION:
+            open_function(semantic, ast);
+            break;
+        case AST_RETURN:
+            if (semantic->function == NULL) {
+                report_error(semantic->errors, ERROR_SEMANTIC, ast->line, "Return outside a function");
+            }
+            break;
+        case AST_FOR:
+            // Iterations that may depend on each other cannot run at once
+            if (ast->data.for_loop.parallel) {
+                ParallelPlan plan;
+                if (plan_parallel_loop(ast, &plan, semantic->symbol_table, semantic->errors)) {
+                    free_parallel_plan(&plan);
+                }
+            }
+            break;
+        case AST_PROGRAM:
+        case AST_BLOCK:
+        case AST_IF:
+        case AST_WHILE:
+        case AST_PRINT:
+        case AST_ASSIGN:
+        case AST_STORE_INDEX:
+        case AST_EXPRESSION:
+        case AST_LIST:
+        case AST_DICT:
+        case AST_INDEX:
+        case AST_BINARY_OP:
+        case AST_UNARY_OP:
+        case AST_NUMBER:
+        case AST_FLOAT:
+        case AST_STRING:
+        case AST_BOOLEAN:
+        case AST_NONE:
+            // Nothing to check on entry; children are visited by the walker
+            break;
+        default:
+            report_error(semantic->errors, ERROR_SEMANTIC, ast->line, "Unknown AST node type");
+            break;
+    }
+}
+
+static void finish_node(ASTNode *ast, void *context) {
+    SemanticContext *semantic = context;
+
+    // The value has been checked by now, so `x = x;` still reports an undeclared x
+    if (ast->type == AST_ASSIGN) {
+        assign_name(semantic, ast->data.assign.name, ast->line);
+    } else if (ast->type == AST_GENERATOR) {
+        close_scope(semantic->symbol_table);
+        semantic->generator = NULL;
+    } else if (ast->type == AST_FUNCTION) {
+        close_scope(semantic->symbol_table);
+        semantic->function = NULL;
+    }
+}
+
+// A loop variable exists from the body on, so its bounds cannot use it
+static void check_child(ASTNode *ast, int index, void *context) {
+    SemanticContext *semantic = context;
+
+    if (ast->type == AST_FOR && index == for_body_index(ast)) {
+        assign_name(semantic, ast->data.for_loop.variable, ast->line);
+    }
+}
+
+ASTVisitor semantic_visitor(SemanticContext *context) {
+    return (ASTVisitor){check_node, check_child, finish_node, context};
+}
+
+// Function to perform semantic analysis on the AST
+bool semantic_analysis(ASTNode *ast, SymbolTable *symbol_table, ErrorList *errors) {
+    int error_count = errors->count;
+    SemanticContext context = {symbol_table, errors, 0, NULL, NULL, false};
+    ASTVisitor visitor = semantic_visitor(&context);
+    walk_ast(ast, &visitor, 1);
+    return errors->count == error_count;
+}
@@ -0,0 +1,396 @@
+// server.c - resident compile server and thin client
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "../include/server.h"
+#include "../include/compiler.h"
+#include "../include/intern.h"
+#include "../include/common.h"
+
+#define CACHE_BUCKETS 1024
+#define CACHE_MAX_ENTRIES 4096
+
+// Compiled results keyed by the hash of their source
+typedef struct CacheEntry {
+    uint64_t hash;
+    char *source;
+    size_t source_length;
+    uint8_t status;
+    char *payload;
+    size_t payload_length;
+    struct CacheEntry *next;  // For chaining in case of hash collisions
+} CacheEntry;
+
+typedef struct {
+    CacheEntry *buckets[CACHE_BUCKETS];
+    CacheEntry *order[CACHE_MAX_ENTRIES];  // Insertion order, for eviction
+    size_t oldest;
+    size_t count;
+    pthread_mutex_t lock;
+} ResultCache;
+
+typedef struct {
+    ResultCache cache;
+    InternTable *names;
+} Server;
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void handle_stop_signal(int signal_number) {
+    (void)signal_number;
+    stop_requested = 1;
+}
+
+// Socket I/O
+
+static bool read_exact(int fd, void *data, size_t length) {
+    char *bytes = data;
+    while (length > 0) {
+        ssize_t n = read(fd, bytes, length);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        bytes += n;
+        length -= (size_t)n;
+    }
+    return true;
+}
+
+static bool write_exact(int fd, const void *data, size_t length) {
+    const char *bytes = data;
+    while (length > 0) {
+        ssize_t n = write(fd, bytes, length);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        bytes += n;
+        length -= (size_t)n;
+    }
+    return true;
+}
+
+static bool write_message(int fd, uint8_t code, const char *payload, size_t length) {
+    unsigned char header[5] = {
+        code,
+        (unsigned char)(length >> 24), (unsigned char)(length >> 16),
+        (unsigned char)(length >> 8), (unsigned char)length
+    };
+    return write_exact(fd, header, sizeof(header)) && write_exact(fd, payload, length);
+}
+
+// Reads one framed message. Returns false on EOF, I/O error or an
+// oversized payload; on success *payload must be freed by the caller.
+static bool read_message(int fd, uint8_t *code, char **payload, size_t *length) {
+    unsigned char header[5];
+    if (!read_exact(fd, header, sizeof(header))) {
+        return false;
+    }
+    *code = header[0];
+    *length = ((size_t)header[1] << 24) | ((size_t)header[2] << 16) |
+              ((size_t)header[3] << 8) | (size_t)header[4];
+    if (*length > SERVER_MAX_MESSAGE_LENGTH) {
+        return false;
+    }
+    *payload = safe_malloc(*length + 1);
+    if (!read_exact(fd, *payload, *length)) {
+        free(*payload);
+        return false;
+    }
+    (*payload)[*length] = '\0';
+    return true;
+}
+
+// Result cache
+
+static void init_result_cache(ResultCache *cache) {
+    memset(cache->buckets, 0, sizeof(cache->buckets));
+    cache->oldest = 0;
+    cache->count = 0;
+    pthread_mutex_init(&cache->lock, NULL);
+}
+
+static void free_cache_entry(CacheEntry *entry) {
+    free(entry->source);
+    free(entry->payload);
+    free(entry);
+}
+
+// Copies a cached result for `source` into *payload. Returns false on a miss.
+static bool cache_lookup(ResultCache *cache, uint64_t hash, const char *source, size_t length,
+                         uint8_t *status, char **payload, size_t *payload_length) {
+    bool found = false;
+    pthread_mutex_lock(&cache->lock);
+    for (CacheEntry *entry = cache->buckets[hash % CACHE_BUCKETS]; entry; entry = entry->next) {
+        if (entry->hash == hash && entry->source_length == length &&
+            memcmp(entry->source, source, length) == 0) {
+            *status = entry->status;
+            *payload_length = entry->payload_length;
+            *payload = safe_malloc(entry->payload_length + 1);
+            memcpy(*payload, entry->payload, entry->payload_length);
+            found = true;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&cache->lock);
+    return found;
+}
+
+static void cache_evict_oldest(ResultCache *cache) {
+    CacheEntry *victim = cache->order[cache->oldest];
+    CacheEntry **link = &cache->buckets[victim->hash % CACHE_BUCKETS];
+    while (*link != victim) {
+        link = &(*link)->next;
+    }
+    *link = victim->next;
+    free_cache_entry(victim);
+    cache->oldest = (cache->oldest + 1) % CACHE_MAX_ENTRIES;
+    cache->count--;
+}
+
+static void cache_insert(ResultCache *cache, uint64_t hash, const char *source, size_t length,
+                         uint8_t status, const char *payload, size_t payload_length) {
+    CacheEntry *entry = safe_malloc(sizeof(CacheEntry));
+    entry->hash = hash;
+    entry->source = safe_malloc(length + 1);
+    memcpy(entry->source, source, length);
+    entry->source_length = length;
+    entry->status = status;
+    entry->payload = safe_malloc(payload_length + 1);
+    memcpy(entry->payload, payload, payload_length);
+    entry->payload_length = payload_length;
+
+    pthread_mutex_lock(&cache->lock);
+    // Another connection may have compiled the same source meanwhile
+    for (CacheEntry *existing = cache->buckets[hash % CACHE_BUCKETS]; existing; existing = existing->next) {
+        if (existing->hash == hash && existing->source_length == length &&
+            memcmp(existing->source, source, length) == 0) {
+            pthread_mutex_unlock(&cache->lock);
+            free_cache_entry(entry);
+            return;
+        }
+    }
+    if (cache->count == CACHE_MAX_ENTRIES) {
+        cache_evict_oldest(cache);
+    }
+    entry->next = cache->buckets[hash % CACHE_BUCKETS];
+    cache->buckets[hash % CACHE_BUCKETS] = entry;
+    cache->order[(cache->oldest + cache->count) % CACHE_MAX_ENTRIES] = entry;
+    cache->count++;
+    pthread_mutex_unlock(&cache->lock);
+}
+
+// Request handling
+
+static void format_errors(const ErrorList *errors, Buffer *output) {
+    for (int i = 0; i < errors->count; i++) {
+        const Error *error = &errors->errors[i];
+        buffer_appendf(output, "%s error at line %d: %s\n",
+                       error_type_to_string(error->type), error->line, error->message);
+    }
+}
+
+static bool handle_compile(Server *server, int fd, const char *source, size_t length) {
+    uint64_t hash = hash_bytes(source, length);
+    uint8_t status;
+    char *payload;
+    size_t payload_length;
+
+    if (cache_lookup(&server->cache, hash, source, length, &status, &payload, &payload_length)) {
+        bool sent = write_message(fd, status, payload, payload_length);
+        free(payload);
+        return sent;
+    }
+
+    ErrorList errors;
+    init_error_list(&errors);
+    Buffer output;
+    buffer_init(&output);
+
+    if (compile_source(source, length, &output, &errors, server->names)) {
+        status = SERVER_RESPONSE_OK;
+    } else {
+        status = SERVER_RESPONSE_ERROR;
+        output.length = 0;
+        format_errors(&errors, &output);
+    }
+
+    cache_insert(&server->cache, hash, source, length, status, output.data ? output.data : "", output.length);
+    bool sent = write_message(fd, status, output.data ? output.data : "", output.length);
+    buffer_free(&output);
+    free_error_list(&errors);
+    return sent;
+}
+
+typedef struct {
+    Server *server;
+    int fd;
+} Connection;
+
+static void *serve_connection(void *arg) {
+    Connection *connection = arg;
+    uint8_t code;
+    char *payload;
+    size_t length;
+
+    while (read_message(connection->fd, &code, &payload, &length)) {
+        bool ok;
+        if (code == SERVER_REQUEST_COMPILE) {
+            ok = handle_compile(connection->server, connection->fd, payload, length);
+        } else {
+            const char *reason = "Unknown request";
+            ok = write_message(connection->fd, SERVER_RESPONSE_BAD_REQUEST, reason, strlen(reason));
+        }
+        free(payload);
+        if (!ok) {
+            break;
+        }
+    }
+
+    close(connection->fd);
+    free(connection);
+    return NULL;
+}
+
+static int open_socket(const char *socket_path, struct sockaddr_un *address) {
+    if (strlen(socket_path) >= sizeof(address->sun_path)) {
+        fprintf(stderr, "Error: Socket path too long: %s\n", socket_path);
+        return -1;
+    }
+    memset(address, 0, sizeof(*address));
+    address->sun_family = AF_UNIX;
+    strcpy(address->sun_path, socket_path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("Error creating socket");
+    }
+    return fd;
+}
+
+int run_compile_server(const char *socket_path) {
+    struct sockaddr_un address;
+    int listen_fd = open_socket(socket_path, &address);
+    if (listen_fd < 0) {
+        return EXIT_FAILURE;
+    }
+
+    unlink(socket_path);
+    if (bind(listen_fd, (struct sockaddr *)&address, sizeof(address)) < 0 ||
+        listen(listen_fd, SOMAXCONN) < 0) {
+        perror("Error listening on socket");
+        close(listen_fd);
+        return EXIT_FAILURE;
+    }
+
+    // No SA_RESTART, so a stop signal interrupts accept()
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = handle_stop_signal;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    Server server;
+    init_result_cache(&server.cache);
+    server.names = create_intern_table(4096);
+
+    pthread_attr_t attributes;
+    pthread_attr_init(&attributes);
+    pthread_attr_setdetachstate(&attributes, PTHREAD_CREATE_DETACHED);
+
+    while (!stop_requested) {
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) {
+            if (errno != EINTR) {
+                perror("Error accepting connection");
+            }
+            continue;
+        }
+        Connection *connection = safe_malloc(sizeof(Connection));
+        connection->server = &server;
+        connection->fd = fd;
+        pthread_t thread;
+        if (pthread_create(&thread, &attributes, serve_connection, connection) != 0) {
+            close(fd);
+            free(connection);
+        }
+    }
+
+    // Connection threads may still reference the server; the process is
+    // about to exit, so its state is left for the OS to reclaim.
+    pthread_attr_destroy(&attributes);
+    close(listen_fd);
+    unlink(socket_path);
+    return EXIT_SUCCESS;
+}
+
+int run_compile_client(const char *socket_path, const char *source_file, const char *output_file) {
+    FILE *input = fopen(source_file, "rb");
+    if (!input) {
+        perror("Error opening source file");
+        return EXIT_FAILURE;
+    }
+    Buffer source;
+    buffer_init(&source);
+    char chunk[65536];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), input)) > 0) {
+        buffer_append(&source, chunk, n);
+    }
+    fclose(input);
+
+    struct sockaddr_un address;
+    int fd = open_socket(socket_path, &address);
+    if (fd < 0) {
+        buffer_free(&source);
+        return EXIT_FAILURE;
+    }
+    if (connect(fd, (struct sockaddr *)&address, sizeof(address)) < 0) {
+        perror("Error connecting to compile server");
+        close(fd);
+        buffer_free(&source);
+        return EXIT_FAILURE;
+    }
+
+    uint8_t status;
+    char *payload;
+    size_t length;
+    bool ok = write_message(fd, SERVER_REQUEST_COMPILE, source.data ? source.data : "", source.length) &&
+              read_message(fd, &status, &payload, &length);
+    close(fd);
+    buffer_free(&source);
+    if (!ok) {
+        fprintf(stderr, "Error: Lost connection to compile server\n");
+        return EXIT_FAILURE;
+    }
+
+    int exit_status = EXIT_FAILURE;
+    if (status == SERVER_RESPONSE_OK) {
+        FILE *output = fopen(output_file, "w");
+        if (!output) {
+            perror("Error opening output file");
+        } else {
+            fwrite(payload, 1, length, output);
+            fclose(output);
+            exit_status = EXIT_SUCCESS;
+        }
+    } else {
+        fwrite(payload, 1, length, stderr);
+    }
+    free(payload);
+    return exit_status;
+}
@@ -0,0 +1,238 @@
+//stream.c
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "../include/stream.h"
+#include "../include/codegen.h"
+#include "../include/intern.h"
+#include "../include/lexer.h"
+#include "../include/parser.h"
+#include "../include/semantic_analyzer.h"
+#include "../include/symbol_table.h"
+
+#define STREAM_CHUNK_SIZE 65536
+
+// The unparsed tail of the input. Text before `lexed` has been turned into
+// tokens and is dropped on the next read; tokens own their values, so the
+// text they came from is no longer needed.
+typedef struct {
+    int fd;
+    bool finished;        // End of input reached and fully lexed
+
+    char *text;
+    size_t length;
+    size_t capacity;
+    size_t lexed;         // Offset up to which tokens are complete
+    int lexed_line;       // Line number at `lexed`
+    size_t base;          // Stream offset of text[0]
+
+    // Tokens not yet consumed by a statement. Until the input is finished
+    // the parser sees them followed by `window_end`, which stands in for
+    // whatever has not been read yet.
+    Token **tokens;
+    int token_count;
+    int token_capacity;
+    Token window_end;
+
+    InternTable *names;
+} SourceStream;
+
+static void init_stream(SourceStream *stream, FILE *input) {
+    memset(stream, 0, sizeof(*stream));
+    stream->fd = fileno(input);
+    stream->lexed_line = 1;
+    stream->window_end.type = TOKEN_EOF;
+    stream->names = create_intern_table(256);
+}
+
+static void free_stream(SourceStream *stream) {
+    for (int i = 0; i < stream->token_count; i++) {
+        free_token(stream->tokens[i]);
+    }
+    free(stream->tokens);
+    free(stream->text);
+    free_intern_table(stream->names);
+}
+
+static void push_token(SourceStream *stream, Token *token) {
+    // One spare slot is kept for `window_end`
+    if (stream->token_count + 1 >= stream->token_capacity) {
+        stream->token_capacity = stream->token_capacity ? stream->token_capacity * 2 : 256;
+        stream->tokens = safe_realloc(stream->tokens, stream->token_capacity * sizeof(Token *));
+    }
+    stream->tokens[stream->token_count++] = token;
+}
+
+// Drop the first `count` tokens, which the parser has consumed
+static void consume_tokens(SourceStream *stream, int count) {
+    for (int i = 0; i < count; i++) {
+        free_token(stream->tokens[i]);
+    }
+    stream->token_count -= count;
+    if (stream->token_count > 0) {
+        memmove(stream->tokens, stream->tokens + count, stream->token_count * sizeof(Token *));
+    }
+}
+
+// Length of the text that ends on a character boundary, so a multibyte
+// character split between reads is not lexed as two pieces
+static size_t complete_length(const SourceStream *stream) {
+    size_t length = stream->length;
+    for (int back = 1; back <= 3 && back <= (int)length; back++) {
+        unsigned char c = (unsigned char)stream->text[length - back];
+        if ((c & 0xC0) != 0x80) {
+            int width = c < 0x80 ? 1 : c < 0xE0 ? 2 : c < 0xF0 ? 3 : 4;
+            return width > back ? length - back : length;
+        }
+    }
+    return length;
+}
+
+// Lex whatever complete tokens the text now holds. Until the input is
+// finished, a token that runs into the end of the text may continue in the
+// next read, so it is left for later. Lexer errors are reported again from
+// the tokens when their statement is compiled.
+static void lex_available(SourceStream *stream) {
+    size_t end = stream->finished ? stream->length : complete_length(stream);
+    ErrorList scratch;
+    init_error_list(&scratch);
+    Lexer lexer;
+    init_lexer(&lexer, stream->text, end, &scratch, stream->names);
+    seek_lexer(&lexer, stream->lexed, stream->lexed_line);
+
+    for (;;) {
+        Token *token = get_next_token(&lexer);
+        if (!stream->finished &&
+            (token->type == TOKEN_EOF || token->offset + token->length >= end)) {
+            free_token(token);
+            break;
+        }
+        stream->lexed = token->offset + token->length;
+        stream->lexed_line = lexer.line;
+        token->offset += stream->base;
+        push_token(stream, token);
+        if (token->type == TOKEN_EOF) {
+            break;
+        }
+    }
+    free_error_list(&scratch);
+}
+
+// Read the next chunk of input and lex it
+static void fill_stream(SourceStream *stream) {
+    // Drop text that has already been lexed
+    if (stream->lexed > 0) {
+        stream->length -= stream->lexed;
+        memmove(stream->text, stream->text + stream->lexed, stream->length);
+        stream->base += stream->lexed;
+        stream->lexed = 0;
+    }
+
+    if (stream->capacity - stream->length < STREAM_CHUNK_SIZE) {
+        stream->capacity = stream->length + STREAM_CHUNK_SIZE;
+        stream->text = safe_realloc(stream->text, stream->capacity);
+    }
+
+    // read() rather than fread() so a pipe's data is used as soon as it arrives
+    ssize_t n;
+    do {
+        n = read(stream->fd, stream->text + stream->length, STREAM_CHUNK_SIZE);
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0) {
+        if (n < 0) {
+            perror("Error reading source");
+        }
+        stream->finished = true;
+    } else {
+        stream->length += (size_t)n;
+    }
+
+    lex_available(stream);
+}
+
+bool compile_stream(FILE *input, FILE *output) {
+    SourceStream stream;
+    init_stream(&stream, input);
+    SymbolTable *symbol_table = create_symbol_table(128);
+    Buffer code;
+    buffer_init(&code);
+    bool ok = true;
+    // Tokens to wait for before parsing again after a statement ran past
+    // the end of the window. Large windows wait to double, so a huge
+    // statement is not re-parsed for every read.
+    int parse_after = 0;
+
+    for (;;) {
+        if (stream.finished && stream.tokens[0]->type == TOKEN_EOF) {
+            break;
+        }
+        if (!stream.finished && (stream.token_count == 0 || stream.token_count < parse_after)) {
+            fflush(output);
+            fill_stream(&stream);
+            continue;
+        }
+
+        ErrorList parse_errors;
+        init_error_list(&parse_errors);
+        int window = stream.token_count;
+        if (!stream.finished) {
+            stream.tokens[window++] = &stream.window_end;
+            stream.window_end.line = stream.lexed_line;
+        }
+        Parser parser = {stream.tokens, 0, window, &parse_errors, NULL, 0, false, NULL};
+        ASTNode *statement = parse_top_level_statement(&parser);
+
+        // The parser may have looked at the token at `current`. If that is
+        // the end of the window, the statement may go on: a failed parse
+        // could have ended differently, and an `if` may yet get an `else`.
+        // Other statements stop at their closing token.
+        bool open_ended = statement == NULL ||
+                          (statement->type == AST_IF && statement->data.if_stmt.else_body == NULL);
+        if (!stream.finished && parser.current >= stream.token_count && open_ended) {
+            free_ast(statement);
+            free_error_list(&parse_errors);
+            parse_after = stream.token_count < 1024 ? stream.token_count + 1 : stream.token_count * 2;
+            continue;
+        }
+        parse_after = 0;
+
+        ErrorList errors;
+        init_error_list(&errors);
+        for (int i = 0; i < parser.current; i++) {
+            Token *token = stream.tokens[i];
+            if (token->type == TOKEN_ERROR) {
+                report_error(&errors, ERROR_LEXER, token->line, "%s", token->value.string);
+            }
+        }
+        for (int i = 0; i < parse_errors.count; i++) {
+            report_error(&errors, parse_errors.errors[i].type, parse_errors.errors[i].line,
+                         "%s", parse_errors.errors[i].message);
+        }
+        free_error_list(&parse_errors);
+
+        if (statement != NULL && errors.count == 0) {
+            SemanticContext semantic = {symbol_table, &errors, 0, NULL, NULL, false};
+            ASTVisitor passes[] = {semantic_visitor(&semantic), codegen_visitor(&code)};
+            walk_ast(statement, passes, 2);
+        }
+
+        if (errors.count > 0) {
+            print_errors(&errors, stderr);
+            ok = false;
+        } else if (ok) {
+            fwrite(code.data, 1, code.length, output);
+        }
+        code.length = 0;
+
+        free_error_list(&errors);
+        free_ast(statement);
+        consume_tokens(&stream, parser.current);
+    }
+
+    fflush(output);
+    buffer_free(&code);
+    free_symbol_table(symbol_table);
+    free_stream(&stream);
+    return ok;
+}
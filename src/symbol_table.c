@@ -1,83 +1,201 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include "../include/symbol_table.h"
-#include "../include/common.h"
-
-// Hash function to map names to table indices
-static size_t hash(const char *name, size_t table_size) {
-    size_t hash_value = 0;
-    while (*name) {
-        hash_value = (hash_value << 5) + *name++;
-    }
-    return hash_value % table_size;
-}
-
-// Create a new symbol table
-SymbolTable *create_symbol_table(size_t size) {
-    SymbolTable *symbol_table = (SymbolTable *)safe_malloc(sizeof(SymbolTable));
-    symbol_table->table = (Symbol **)safe_malloc(size * sizeof(Symbol *));
-    for (size_t i = 0; i < size; i++) {
-        symbol_table->table[i] = NULL;
-    }
-    symbol_table->size = size;
-    return symbol_table;
-}
-
-// Free a symbol
-static void free_symbol(Symbol *symbol) {
-    free(symbol->name);
-    free(symbol);
-}
-
-// Free the symbol table
-void free_symbol_table(SymbolTable *symbol_table) {
-    for (size_t i = 0; i < symbol_table->size; i++) {
-        Symbol *symbol = symbol_table->table[i];
-        while (symbol) {
-            Symbol *next = symbol->next;
-            free_symbol(symbol);
-            symbol = next;
-        }
-    }
-    free(symbol_table->table);
-    free(symbol_table);
-}
-
-// Insert a symbol into the table
-Symbol *insert_symbol(SymbolTable *symbol_table, const char *name, SymbolType type) {
-    size_t index = hash(name, symbol_table->size);
-    Symbol *new_symbol = (Symbol *)safe_malloc(sizeof(Symbol));
-    new_symbol->name = safe_strdup(name);
-    new_symbol->type = type;
-    new_symbol->next = symbol_table->table[index];
-    symbol_table->table[index] = new_symbol;
-    return new_symbol;
-}
-
-// Lookup a symbol in the table
-Symbol *lookup_symbol(SymbolTable *symbol_table, const char *name) {
-    size_t index = hash(name, symbol_table->size);
-    Symbol *symbol = symbol_table->table[index];
-    while (symbol) {
-        if (strcmp(symbol->name, name) == 0) {
-            return symbol;
-        }
-        symbol = symbol->next;
-    }
-    return NULL;
-}
-
-// Print the symbol table (for debugging)
-void print_symbol_table(SymbolTable *symbol_table) {
-    for (size_t i = 0; i < symbol_table->size; i++) {
-        Symbol *symbol = symbol_table->table[i];
-        if (symbol) {
-            printf("Bucket %zu:\n", i);
-            while (symbol) {
-                printf("  Name: %s, Type: %d\n", symbol->name, symbol->type);
-                symbol = symbol->next;
-            }
-        }
-    }
-}
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/symbol_table.h"
+#include "../include/common.h"
+
+// Hash function to map names to table indices. Every byte counts, since
+// Kannada names often share their last few.
+static size_t hash(const char *name, size_t table_size) {
+    return (size_t)(hash_bytes(name, strlen(name)) % table_size);
+}
+
+// Double the buckets. The symbols are put back in the order they were
+// inserted, so each chain still starts with the newest and a scope's
+// symbols lead their chains.
+static void grow(SymbolTable *symbol_table) {
+    size_t size = symbol_table->size * 2;
+    Symbol **table = (Symbol **)safe_malloc(size * sizeof(Symbol *));
+    for (size_t i = 0; i < size; i++) {
+        table[i] = NULL;
+    }
+    // Orders are distinct and below symbol_count
+    Symbol **by_order = (Symbol **)safe_malloc(symbol_table->symbol_count * sizeof(Symbol *));
+    for (int i = 0; i < symbol_table->symbol_count; i++) {
+        by_order[i] = NULL;
+    }
+    for (size_t i = 0; i < symbol_table->size; i++) {
+        for (Symbol *symbol = symbol_table->table[i]; symbol; symbol = symbol->next) {
+            by_order[symbol->order] = symbol;
+        }
+    }
+    for (int i = 0; i < symbol_table->symbol_count; i++) {
+        Symbol *symbol = by_order[i];
+        if (symbol != NULL) {
+            size_t index = hash(symbol->name, size);
+            symbol->next = table[index];
+            table[index] = symbol;
+        }
+    }
+    free(by_order);
+    free(symbol_table->table);
+    symbol_table->table = table;
+    symbol_table->size = size;
+}
+
+// Create a new symbol table
+SymbolTable *create_symbol_table(size_t size) {
+    SymbolTable *symbol_table = (SymbolTable *)safe_malloc(sizeof(SymbolTable));
+    symbol_table->table = (Symbol **)safe_malloc(size * sizeof(Symbol *));
+    for (size_t i = 0; i < size; i++) {
+        symbol_table->table[i] = NULL;
+    }
+    symbol_table->size = size;
+    symbol_table->variable_count = 0;
+    symbol_table->symbol_count = 0;
+    symbol_table->scope = 0;
+    symbol_table->closed = NULL;
+    symbol_table->inserted = NULL;
+    symbol_table->inserted_capacity = 0;
+    symbol_table->scope_starts = NULL;
+    symbol_table->scope_capacity = 0;
+    symbol_table->outer = NULL;
+    symbol_table->visible = 0;
+    return symbol_table;
+}
+
+// Free a symbol
+static void free_symbol(Symbol *symbol) {
+    if (symbol->type == SYMBOL_FUNCTION) {
+        free(symbol->info.function.uses);
+    }
+    free(symbol->name);
+    free(symbol);
+}
+
+// Free the symbol table
+void free_symbol_table(SymbolTable *symbol_table) {
+    for (size_t i = 0; i < symbol_table->size; i++) {
+        Symbol *symbol = symbol_table->table[i];
+        while (symbol) {
+            Symbol *next = symbol->next;
+            free_symbol(symbol);
+            symbol = next;
+        }
+    }
+    while (symbol_table->closed) {
+        Symbol *next = symbol_table->closed->next;
+        free_symbol(symbol_table->closed);
+        symbol_table->closed = next;
+    }
+    free(symbol_table->inserted);
+    free(symbol_table->scope_starts);
+    free(symbol_table->table);
+    free(symbol_table);
+}
+
+// Insert a symbol into the table
+Symbol *insert_symbol(SymbolTable *symbol_table, const char *name, SymbolType type) {
+    if ((size_t)symbol_table->symbol_count >= symbol_table->size * 2) {
+        grow(symbol_table);
+    }
+    size_t index = hash(name, symbol_table->size);
+    Symbol *new_symbol = (Symbol *)safe_malloc(sizeof(Symbol));
+    new_symbol->name = safe_strdup(name);
+    new_symbol->type = type;
+    if (type == SYMBOL_VARIABLE) {
+        new_symbol->info.variable.slot = symbol_table->variable_count++;
+    } else if (type == SYMBOL_FUNCTION) {
+        new_symbol->info.function.index = -1;
+        new_symbol->info.function.parameter_count = 0;
+        new_symbol->info.function.generator = false;
+        new_symbol->info.function.uses = NULL;
+        new_symbol->info.function.use_count = 0;
+    }
+    new_symbol->scope = symbol_table->scope;
+    new_symbol->order = symbol_table->symbol_count++;
+    if (symbol_table->symbol_count > symbol_table->inserted_capacity) {
+        symbol_table->inserted_capacity = symbol_table->inserted_capacity == 0 ? 64 : symbol_table->inserted_capacity * 2;
+        symbol_table->inserted = (Symbol **)safe_realloc(symbol_table->inserted,
+                                                         symbol_table->inserted_capacity * sizeof(Symbol *));
+    }
+    symbol_table->inserted[new_symbol->order] = new_symbol;
+    new_symbol->next = symbol_table->table[index];
+    symbol_table->table[index] = new_symbol;
+    return new_symbol;
+}
+
+// Lookup a symbol in the table
+Symbol *lookup_symbol(SymbolTable *symbol_table, const char *name) {
+    size_t index = hash(name, symbol_table->size);
+    Symbol *symbol = symbol_table->table[index];
+    while (symbol) {
+        if (strcmp(symbol->name, name) == 0) {
+            return symbol;
+        }
+        symbol = symbol->next;
+    }
+    SymbolTable *outer = symbol_table->outer;
+    if (outer == NULL) {
+        return NULL;
+    }
+    for (symbol = outer->table[hash(name, outer->size)]; symbol; symbol = symbol->next) {
+        if (symbol->order < symbol_table->visible && strcmp(symbol->name, name) == 0) {
+            return symbol;
+        }
+    }
+    return NULL;
+}
+
+// Print the symbol table (for debugging)
+void print_symbol_table(SymbolTable *symbol_table) {
+    for (size_t i = 0; i < symbol_table->size; i++) {
+        Symbol *symbol = symbol_table->table[i];
+        if (symbol) {
+            printf("Bucket %zu:\n", i);
+            while (symbol) {
+                printf("  Name: %s, Type: %d\n", symbol->name, symbol->type);
+                symbol = symbol->next;
+            }
+        }
+    }
+}
+
+void open_scope(SymbolTable *symbol_table) {
+    if (symbol_table->scope == symbol_table->scope_capacity) {
+        symbol_table->scope_capacity = symbol_table->scope_capacity == 0 ? 8 : symbol_table->scope_capacity * 2;
+        symbol_table->scope_starts = (int *)safe_realloc(symbol_table->scope_starts,
+                                                         symbol_table->scope_capacity * sizeof(int));
+    }
+    symbol_table->scope_starts[symbol_table->scope++] = symbol_table->symbol_count;
+}
+
+// Move `symbol` from the head of its chain to the closed symbols. Any
+// symbol inserted after it into the same chain must be gone already.
+static void close_symbol(SymbolTable *symbol_table, Symbol *symbol) {
+    size_t index = hash(symbol->name, symbol_table->size);
+    symbol_table->table[index] = symbol->next;
+    symbol->next = symbol_table->closed;
+    symbol_table->closed = symbol;
+}
+
+void close_scope(SymbolTable *symbol_table) {
+    // Everything inserted since the scope opened belongs to it or to a
+    // scope inside it, closed already. Newest first, each leads its chain.
+    int start = symbol_table->scope_starts[symbol_table->scope - 1];
+    for (int i = symbol_table->symbol_count - 1; i >= start; i--) {
+        if (symbol_table->inserted[i]->scope == symbol_table->scope) {
+            close_symbol(symbol_table, symbol_table->inserted[i]);
+        }
+    }
+    symbol_table->scope--;
+}
+
+void forget_symbols(SymbolTable *symbol_table, int count) {
+    // Those of scopes that closed meanwhile are gone already
+    for (int i = symbol_table->symbol_count - 1; i >= count; i--) {
+        if (symbol_table->inserted[i]->scope == 0) {
+            close_symbol(symbol_table, symbol_table->inserted[i]);
+        }
+    }
+}
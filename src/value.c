@@ -0,0 +1,589 @@
+//value.c
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/value.h"
+#include "../include/floating.h"
+#include "../include/runtime_string.h"
+#include "../include/list.h"
+#include "../include/dict.h"
+#include "../include/generator.h"
+#include "../include/file.h"
+
+Value value_from_integer(Heap *heap, Integer value) {
+    if (integer_is_small(value) && value.small >= SMALL_INT_MIN && value.small <= SMALL_INT_MAX) {
+        return value_from_small_int(value.small);
+    }
+    IntegerObject *object = (IntegerObject *)allocate_object(heap, OBJECT_INTEGER, sizeof(IntegerObject));
+    object->value = value;
+    return (Value)(uintptr_t)object;
+}
+
+Integer value_to_integer(Value value) {
+    if (value_is_small_int(value)) {
+        return integer_from_int64(value_as_small_int(value));
+    }
+    return ((IntegerObject *)value_as_object(value))->value;
+}
+
+Value value_from_double(Heap *heap, double value) {
+    FloatObject *object = (FloatObject *)allocate_object(heap, OBJECT_FLOAT, sizeof(FloatObject));
+    object->value = value;
+    return (Value)(uintptr_t)object;
+}
+
+static double number_as_double(Value value) {
+    if (value_is_float(value)) {
+        return value_as_double(value);
+    }
+    if (value_is_small_int(value)) {
+        return (double)value_as_small_int(value);
+    }
+    return float_from_integer(value_to_integer(value));
+}
+
+// If either operand is a float and the other a number, both as doubles
+static bool float_operands(Value a, Value b, double *x, double *y) {
+    if ((!value_is_float(a) && !value_is_float(b)) || !value_is_number(a) || !value_is_number(b)) {
+        return false;
+    }
+    *x = number_as_double(a);
+    *y = number_as_double(b);
+    return true;
+}
+
+// The order of two numbers, at least one a float: -1, 0 or 1, or 2 if
+// either is NaN. An int is compared exactly, not rounded to a double.
+static int compare_numbers(Value a, Value b) {
+    if (value_is_float(a) && value_is_float(b)) {
+        double x = value_as_double(a);
+        double y = value_as_double(b);
+        return x < y ? -1 : x > y ? 1 : x == y ? 0 : 2;
+    }
+    if (value_is_nan(a) || value_is_nan(b)) {
+        return 2;
+    }
+    if (value_is_float(a)) {
+        return float_compare_integer(value_as_double(a), value_to_integer(b));
+    }
+    return -float_compare_integer(value_as_double(b), value_to_integer(a));
+}
+
+const char *value_type_name(Value value) {
+    if (value_is_int(value)) {
+        return "int";
+    }
+    if (value_is_float(value)) {
+        return "float";
+    }
+    if (value_is_string(value)) {
+        return "str";
+    }
+    if (value_is_list(value)) {
+        return "list";
+    }
+    if (value_is_dict(value)) {
+        return "dict";
+    }
+    if (value_is_generator(value)) {
+        return "generator";
+    }
+    if (value_is_line_reader(value)) {
+        return "lines";
+    }
+    if (value == VALUE_TRUE || value == VALUE_FALSE) {
+        return "bool";
+    }
+    return "None";
+}
+
+// Lists and dictionaries can hold themselves, directly or further down,
+// and can nest deeper than the C stack goes, so printing and comparing
+// them walks an explicit stack of the containers it is inside. A Path is that stack. Its
+// frames are also chained into a hash table, by position, so that finding
+// whether a container, or for a comparison a pair of them, is already on
+// the path takes one probe; a frame is always the newest in its bucket when
+// it is popped, so popping just restores the bucket's previous head.
+typedef struct {
+    Value a;
+    Value b;            // The other side of a comparison, else 0
+    size_t next;        // Position of the next element, or dictionary entry
+    size_t chain;       // 1 + the frame below it in its bucket, or 0
+    bool printed;       // Whether an element has been printed yet
+} PathFrame;
+
+#define PATH_INLINE 16
+
+typedef struct {
+    PathFrame *frames;
+    size_t *buckets;    // 1 + the newest frame in each, or 0
+    size_t count;
+    size_t capacity;    // Of both frames and buckets; a power of two
+    PathFrame inline_frames[PATH_INLINE];
+    size_t inline_buckets[PATH_INLINE];
+} Path;
+
+static void path_init(Path *path) {
+    path->frames = path->inline_frames;
+    path->buckets = path->inline_buckets;
+    path->count = 0;
+    path->capacity = PATH_INLINE;
+    memset(path->buckets, 0, sizeof(path->inline_buckets));
+}
+
+static void path_free(Path *path) {
+    if (path->frames != path->inline_frames) {
+        free(path->frames);
+        free(path->buckets);
+    }
+}
+
+static size_t path_bucket(const Path *path, Value a, Value b) {
+    uint64_t hash = (a ^ b * 0x9E3779B97F4A7C15ULL) * 0xBF58476D1CE4E5B9ULL;
+    return (size_t)(hash >> 32) & (path->capacity - 1);
+}
+
+static bool path_contains(const Path *path, Value a, Value b) {
+    for (size_t i = path->buckets[path_bucket(path, a, b)]; i != 0; i = path->frames[i - 1].chain) {
+        if (path->frames[i - 1].a == a && path->frames[i - 1].b == b) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Frame pointers do not survive a push, which may move the frames
+static void path_push(Path *path, Value a, Value b) {
+    if (path->count == path->capacity) {
+        path->capacity *= 2;
+        if (path->frames == path->inline_frames) {
+            path->frames = safe_malloc(path->capacity * sizeof(PathFrame));
+            memcpy(path->frames, path->inline_frames, sizeof(path->inline_frames));
+            path->buckets = safe_malloc(path->capacity * sizeof(size_t));
+        } else {
+            path->frames = safe_realloc(path->frames, path->capacity * sizeof(PathFrame));
+            path->buckets = safe_realloc(path->buckets, path->capacity * sizeof(size_t));
+        }
+        memset(path->buckets, 0, path->capacity * sizeof(size_t));
+        for (size_t i = 0; i < path->count; i++) {
+            size_t bucket = path_bucket(path, path->frames[i].a, path->frames[i].b);
+            path->frames[i].chain = path->buckets[bucket];
+            path->buckets[bucket] = i + 1;
+        }
+    }
+    size_t bucket = path_bucket(path, a, b);
+    path->frames[path->count] = (PathFrame){a, b, 0, path->buckets[bucket], false};
+    path->buckets[bucket] = ++path->count;
+}
+
+static void path_pop(Path *path) {
+    PathFrame *frame = &path->frames[--path->count];
+    path->buckets[path_bucket(path, frame->a, frame->b)] = frame->chain;
+}
+
+static bool value_is_container(Value value) {
+    return value_is_list(value) || value_is_dict(value);
+}
+
+// Print an element, opening it if it is a container not already being
+// printed; one that is shows as [...] or {...}, as in Python
+static void append_element(Buffer *buffer, Path *path, Value value) {
+    if (!value_is_container(value)) {
+        value_append_quoted(buffer, value);
+    } else if (path_contains(path, value, 0)) {
+        buffer_append_str(buffer, value_is_list(value) ? "[...]" : "{...}");
+    } else {
+        buffer_append(buffer, value_is_list(value) ? "[" : "{", 1);
+        path_push(path, value, 0);
+    }
+}
+
+static void append_container(Buffer *buffer, Value value) {
+    Path path;
+    path_init(&path);
+    append_element(buffer, &path, value);
+    while (path.count > 0) {
+        PathFrame *frame = &path.frames[path.count - 1];
+        if (value_is_list(frame->a)) {
+            ListObject *list = value_as_list(frame->a);
+            if (frame->next == list->count) {
+                buffer_append(buffer, "]", 1);
+                path_pop(&path);
+                continue;
+            }
+            if (frame->printed) {
+                buffer_append(buffer, ", ", 2);
+            }
+            frame->printed = true;
+            append_element(buffer, &path, list_get(list, frame->next++));
+        } else {
+            DictObject *dict = value_as_dict(frame->a);
+            while (frame->next < dict->entry_count && dict->entries[frame->next].key == VALUE_UNDEFINED) {
+                frame->next++;
+            }
+            if (frame->next == dict->entry_count) {
+                buffer_append(buffer, "}", 1);
+                path_pop(&path);
+                continue;
+            }
+            if (frame->printed) {
+                buffer_append(buffer, ", ", 2);
+            }
+            frame->printed = true;
+            const DictEntry *entry = &dict->entries[frame->next++];
+            value_append_quoted(buffer, entry->key);
+            buffer_append(buffer, ": ", 2);
+            append_element(buffer, &path, entry->value);
+        }
+    }
+    path_free(&path);
+}
+
+void value_append_quoted(Buffer *buffer, Value value) {
+    if (value_is_string(value)) {
+        buffer_append(buffer, "\"", 1);
+        value_append(buffer, value);
+        buffer_append(buffer, "\"", 1);
+    } else {
+        value_append(buffer, value);
+    }
+}
+
+void value_append(Buffer *buffer, Value value) {
+    if (value_is_container(value)) {
+        append_container(buffer, value);
+    } else if (value_is_int(value)) {
+        integer_append_digits(buffer, value_to_integer(value), DIGITS_KANNADA);
+    } else if (value_is_float(value)) {
+        float_append(buffer, value_as_double(value), DIGITS_KANNADA);
+    } else if (value_is_string(value)) {
+        char scratch[SHORT_STRING_MAX + 1];
+        buffer_append(buffer, string_chars(value, scratch), string_byte_length(value));
+    } else if (value_is_generator(value)) {
+        buffer_append_str(buffer, "<ಉತ್ಪಾದಕ>");
+    } else if (value_is_line_reader(value)) {
+        buffer_append_str(buffer, "<ಸಾಲುಗಳು>");
+    } else if (value == VALUE_TRUE) {
+        buffer_append_str(buffer, "ನಿಜ");
+    } else if (value == VALUE_FALSE) {
+        buffer_append_str(buffer, "ಸುಳ್ಳು");
+    } else {
+        buffer_append_str(buffer, "ಶೂನ್ಯ");
+    }
+}
+
+bool value_add_slow(Heap *heap, Value a, Value b, Value *result) {
+    double x;
+    double y;
+    if (float_operands(a, b, &x, &y)) {
+        *result = value_from_double(heap, x + y);
+        return true;
+    }
+    if (value_is_int(a) && value_is_int(b)) {
+        *result = value_from_integer(heap, integer_add(value_to_integer(a), value_to_integer(b)));
+        return true;
+    }
+    if (value_is_string(a) && value_is_string(b)) {
+        *result = string_concat(heap, a, b);
+        return true;
+    }
+    if (value_is_list(a) && value_is_list(b)) {
+        *result = list_concat(heap, value_as_list(a), value_as_list(b));
+        return true;
+    }
+    return false;
+}
+
+bool value_sub_slow(Heap *heap, Value a, Value b, Value *result) {
+    double x;
+    double y;
+    if (float_operands(a, b, &x, &y)) {
+        *result = value_from_double(heap, x - y);
+        return true;
+    }
+    if (!value_is_int(a) || !value_is_int(b)) {
+        return false;
+    }
+    *result = value_from_integer(heap, integer_sub(value_to_integer(a), value_to_integer(b)));
+    return true;
+}
+
+bool value_mul_slow(Heap *heap, Value a, Value b, Value *result) {
+    double x;
+    double y;
+    if (float_operands(a, b, &x, &y)) {
+        *result = value_from_double(heap, x * y);
+        return true;
+    }
+    if (!value_is_int(a) || !value_is_int(b)) {
+        return false;
+    }
+    *result = value_from_integer(heap, integer_mul(value_to_integer(a), value_to_integer(b)));
+    return true;
+}
+
+bool value_neg_slow(Heap *heap, Value a, Value *result) {
+    if (value_is_float(a)) {
+        *result = value_from_double(heap, -value_as_double(a));
+        return true;
+    }
+    if (!value_is_int(a)) {
+        return false;
+    }
+    *result = value_from_integer(heap, integer_neg(value_to_integer(a)));
+    return true;
+}
+
+bool value_floordiv(Heap *heap, Value a, Value b, Value *result) {
+    if (!value_is_int(a) || !value_is_int(b)) {
+        return false;
+    }
+    if (a & b & 1) {
+        int64_t x = value_as_small_int(a);
+        int64_t y = value_as_small_int(b);
+        if (y == 0) {
+            return false;
+        }
+        int64_t quotient = x / y;
+        if (x % y != 0 && (x < 0) != (y < 0)) {
+            quotient--;
+        }
+        // Only SMALL_INT_MIN / -1 leaves the small range
+        *result = value_from_integer(heap, integer_from_int64(quotient));
+        return true;
+    }
+    Integer quotient;
+    if (!integer_floordiv(value_to_integer(a), value_to_integer(b), &quotient)) {
+        return false;
+    }
+    *result = value_from_integer(heap, quotient);
+    return true;
+}
+
+bool value_divide(Heap *heap, Value a, Value b, Value *result) {
+    double x;
+    double y;
+    if (!float_operands(a, b, &x, &y)) {
+        return value_floordiv(heap, a, b, result);
+    }
+    if (y == 0) {
+        return false;
+    }
+    *result = value_from_double(heap, x / y);
+    return true;
+}
+
+bool value_mod(Heap *heap, Value a, Value b, Value *result) {
+    double x;
+    double y;
+    if (float_operands(a, b, &x, &y)) {
+        if (y == 0) {
+            return false;
+        }
+        // Python's: the remainder takes the divisor's sign
+        double remainder = fmod(x, y);
+        if (remainder == 0) {
+            remainder = copysign(0.0, y);
+        } else if ((remainder < 0) != (y < 0)) {
+            remainder += y;
+        }
+        *result = value_from_double(heap, remainder);
+        return true;
+    }
+    if (!value_is_int(a) || !value_is_int(b)) {
+        return false;
+    }
+    if (a & b & 1) {
+        int64_t x = value_as_small_int(a);
+        int64_t y = value_as_small_int(b);
+        if (y == 0) {
+            return false;
+        }
+        int64_t remainder = x % y;
+        if (remainder != 0 && (remainder < 0) != (y < 0)) {
+            remainder += y;
+        }
+        *result = value_from_small_int(remainder);
+        return true;
+    }
+    Integer remainder;
+    if (!integer_mod(value_to_integer(a), value_to_integer(b), &remainder)) {
+        return false;
+    }
+    *result = value_from_integer(heap, remainder);
+    return true;
+}
+
+// Compare two containers of the same kind as far as can be done without
+// looking into their elements. Returns false if they differ, and pushes
+// them onto `path` if their elements are still to be compared.
+static bool containers_equal_shallow(Path *path, Value a, Value b) {
+    if (value_is_dict(a)) {
+        if (value_as_dict(a)->count != value_as_dict(b)->count) {
+            return false;
+        }
+        path_push(path, a, b);
+        return true;
+    }
+    ListObject *x = value_as_list(a);
+    ListObject *y = value_as_list(b);
+    if (x->count != y->count) {
+        return false;
+    }
+    if (x->unboxed && y->unboxed) {
+        return x->count == 0 || memcmp(x->items.ints, y->items.ints, x->count * sizeof(int64_t)) == 0;
+    }
+    path_push(path, a, b);
+    return true;
+}
+
+// Dictionaries are equal if they hold the same pairs, in any order. A
+// pair of containers met again inside themselves is taken to be equal, as
+// any difference is found where the pair was first compared.
+static bool containers_equal(Value a, Value b) {
+    Path path;
+    path_init(&path);
+    bool equal = containers_equal_shallow(&path, a, b);
+    while (equal && path.count > 0) {
+        PathFrame *frame = &path.frames[path.count - 1];
+        Value p;
+        Value q;
+        if (value_is_list(frame->a)) {
+            ListObject *x = value_as_list(frame->a);
+            ListObject *y = value_as_list(frame->b);
+            if (frame->next == x->count) {
+                path_pop(&path);
+                continue;
+            }
+            p = list_get(x, frame->next);
+            q = list_get(y, frame->next);
+            frame->next++;
+        } else {
+            DictObject *x = value_as_dict(frame->a);
+            while (frame->next < x->entry_count && x->entries[frame->next].key == VALUE_UNDEFINED) {
+                frame->next++;
+            }
+            if (frame->next == x->entry_count) {
+                path_pop(&path);
+                continue;
+            }
+            const DictEntry *entry = &x->entries[frame->next++];
+            bool found;
+            char error[MAX_ERROR_MESSAGE_LENGTH];
+            p = entry->value;
+            if (!dict_get(value_as_dict(frame->b), entry->key, &q, &found, error) || !found) {
+                equal = false;
+                break;
+            }
+        }
+        if (p == q) {
+            continue;
+        }
+        if (value_is_container(p) && value_is_object(q) && value_as_object(p)->type == value_as_object(q)->type) {
+            if (!path_contains(&path, p, q)) {
+                equal = containers_equal_shallow(&path, p, q);
+            }
+        } else {
+            equal = value_equal(p, q);
+        }
+    }
+    path_free(&path);
+    return equal;
+}
+
+// Lexicographic order, as Python compares lists. Returns false if two
+// elements that decide it cannot be compared.
+static bool lists_less(Value a, Value b, bool *result) {
+    Path path;
+    path_init(&path);
+    path_push(&path, a, b);
+    bool ok = true;
+    *result = false;
+    while (path.count > 0) {
+        PathFrame *frame = &path.frames[path.count - 1];
+        ListObject *x = value_as_list(frame->a);
+        ListObject *y = value_as_list(frame->b);
+        size_t count = x->count < y->count ? x->count : y->count;
+        if (frame->next == count) {
+            if (x->count != y->count) {
+                *result = x->count < y->count;
+                break;
+            }
+            path_pop(&path);
+            continue;
+        }
+        Value p = list_get(x, frame->next);
+        Value q = list_get(y, frame->next);
+        frame->next++;
+        if (p == q) {
+            continue;
+        }
+        if (value_is_list(p) && value_is_list(q)) {
+            if (!path_contains(&path, p, q)) {
+                path_push(&path, p, q);
+            }
+        } else if (!value_equal(p, q)) {
+            ok = value_less(p, q, result);
+            break;
+        }
+    }
+    path_free(&path);
+    return ok;
+}
+
+bool value_equal_slow(Value a, Value b) {
+    if (value_is_float(a) || value_is_float(b)) {
+        return value_is_number(a) && value_is_number(b) && compare_numbers(a, b) == 0;
+    }
+    if (!value_is_object(a) || !value_is_object(b)) {
+        return false;
+    }
+    Object *left = value_as_object(a);
+    Object *right = value_as_object(b);
+    if (left->type != right->type) {
+        return false;
+    }
+    if (left->type == OBJECT_INTEGER) {
+        return integer_compare(value_to_integer(a), value_to_integer(b)) == 0;
+    }
+    if (left->type == OBJECT_LIST || left->type == OBJECT_DICT) {
+        return containers_equal(a, b);
+    }
+    if (left->type == OBJECT_GENERATOR || left->type == OBJECT_LINE_READER) {
+        return false;   // Only the same one, which value_equal has ruled out
+    }
+    return string_equal(a, b);
+}
+
+bool value_less_slow(Value a, Value b, bool *result) {
+    if (value_is_int(a) && value_is_int(b)) {
+        *result = integer_compare(value_to_integer(a), value_to_integer(b)) < 0;
+        return true;
+    }
+    if (value_is_number(a) && value_is_number(b)) {
+        *result = compare_numbers(a, b) == -1;
+        return true;
+    }
+    if (value_is_string(a) && value_is_string(b)) {
+        *result = string_compare(a, b) < 0;
+        return true;
+    }
+    if (value_is_list(a) && value_is_list(b)) {
+        return lists_less(a, b, result);
+    }
+    return false;
+}
+
+bool value_is_truthy_slow(Value value) {
+    // Boxed integers are never zero, and heap strings never empty
+    if (value_is_float(value)) {
+        return value_as_double(value) != 0;
+    }
+    if (value_is_list(value)) {
+        return value_as_list(value)->count > 0;
+    }
+    if (value_is_dict(value)) {
+        return value_as_dict(value)->count > 0;
+    }
+    return true;
+}
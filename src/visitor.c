@@ -0,0 +1,183 @@
+//visitor.c
+#include <stdlib.h>
+#include "../include/visitor.h"
+#include "../include/common.h"
+
+#define INLINE_FRAMES 64
+
+// Children are looked up once, when the frame is pushed. Programs, blocks,
+// lists, dicts and calls point at their child array; other nodes copy
+// theirs into slots.
+typedef struct {
+    ASTNode *node;
+    ASTNode **children;
+    ASTNode *slots[4];
+    int next_child;
+    int child_count;
+} WalkFrame;
+
+static void push_frame(WalkFrame *frame, ASTNode *node) {
+    frame->node = node;
+    frame->children = NULL;  // Not &frame->slots: the stack may move when it grows
+    frame->next_child = 0;
+    switch (node->type) {
+        case AST_PROGRAM:
+        case AST_BLOCK:
+            frame->children = node->data.block.statements;
+            frame->child_count = node->data.block.count;
+            break;
+        case AST_LIST:
+            frame->children = node->data.list.elements;
+            frame->child_count = node->data.list.count;
+            break;
+        case AST_DICT:
+            frame->children = node->data.dict.entries;
+            frame->child_count = node->data.dict.count * 2;
+            break;
+        case AST_CALL:
+            frame->children = node->data.call.arguments;
+            frame->child_count = node->data.call.count;
+            break;
+        case AST_IF:
+            frame->slots[0] = node->data.if_stmt.condition;
+            frame->slots[1] = node->data.if_stmt.if_body;
+            frame->slots[2] = node->data.if_stmt.else_body;
+            frame->child_count = node->data.if_stmt.else_body ? 3 : 2;
+            break;
+        case AST_WHILE:
+            frame->slots[0] = node->data.while_loop.condition;
+            frame->slots[1] = node->data.while_loop.body;
+            frame->child_count = 2;
+            break;
+        case AST_FOR:
+            // The bounds that were given or the iterable, then the body
+            frame->child_count = 0;
+            if (node->data.for_loop.iterable) {
+                frame->slots[frame->child_count++] = node->data.for_loop.iterable;
+                frame->slots[frame->child_count++] = node->data.for_loop.body;
+                break;
+            }
+            if (node->data.for_loop.start) {
+                frame->slots[frame->child_count++] = node->data.for_loop.start;
+            }
+            frame->slots[frame->child_count++] = node->data.for_loop.stop;
+            if (node->data.for_loop.step) {
+                frame->slots[frame->child_count++] = node->data.for_loop.step;
+            }
+            frame->slots[frame->child_count++] = node->data.for_loop.body;
+            break;
+        case AST_BINARY_OP:
+            frame->slots[0] = node->data.binary_op.left;
+            frame->slots[1] = node->data.binary_op.right;
+            frame->child_count = 2;
+            break;
+        case AST_PRINT:
+            frame->slots[0] = node->data.print_stmt.expression;
+            frame->child_count = 1;
+            break;
+        case AST_ASSIGN:
+            frame->slots[0] = node->data.assign.value;
+            frame->child_count = 1;
+            break;
+        case AST_GENERATOR:
+            frame->slots[0] = node->data.generator.body;
+            frame->child_count = 1;
+            break;
+        case AST_YIELD:
+            frame->slots[0] = node->data.yield_stmt.value;
+            frame->child_count = 1;
+            break;
+        case AST_FUNCTION:
+            frame->slots[0] = node->data.function.body;
+            frame->child_count = 1;
+            break;
+        case AST_RETURN:
+            frame->slots[0] = node->data.return_stmt.value;
+            frame->child_count = node->data.return_stmt.value ? 1 : 0;
+            break;
+        case AST_STORE_INDEX:
+            frame->slots[0] = node->data.store_index.object;
+            frame->slots[1] = node->data.store_index.index;
+            frame->slots[2] = node->data.store_index.value;
+            frame->child_count = 3;
+            break;
+        case AST_EXPRESSION:
+            frame->slots[0] = node->data.expression_stmt.expression;
+            frame->child_count = 1;
+            break;
+        case AST_INDEX:
+            frame->slots[0] = node->data.index.object;
+            frame->slots[1] = node->data.index.index;
+            frame->child_count = 2;
+            break;
+        case AST_UNARY_OP:
+            frame->slots[0] = node->data.unary_op.operand;
+            frame->child_count = 1;
+            break;
+        default:
+            frame->child_count = 0;
+            break;
+    }
+}
+
+static void enter(ASTNode *node, const ASTVisitor *visitors, int count) {
+    for (int i = 0; i < count; i++) {
+        if (visitors[i].pre) {
+            visitors[i].pre(node, visitors[i].context);
+        }
+    }
+}
+
+void walk_ast(ASTNode *root, const ASTVisitor *visitors, int count) {
+    if (root == NULL) return;
+
+    // Most trees are shallow; only deep ones touch the heap
+    WalkFrame inline_frames[INLINE_FRAMES];
+    WalkFrame *frames = inline_frames;
+    int capacity = INLINE_FRAMES;
+    int depth = 0;
+
+    enter(root, visitors, count);
+    push_frame(&frames[depth++], root);
+
+    while (depth > 0) {
+        WalkFrame *frame = &frames[depth - 1];
+
+        if (frame->next_child == frame->child_count) {
+            ASTNode *node = frame->node;
+            depth--;
+            for (int i = count - 1; i >= 0; i--) {
+                if (visitors[i].post) {
+                    visitors[i].post(node, visitors[i].context);
+                }
+            }
+            continue;
+        }
+
+        int index = frame->next_child++;
+        ASTNode *child = frame->children ? frame->children[index] : frame->slots[index];
+        for (int i = 0; i < count; i++) {
+            if (visitors[i].child) {
+                visitors[i].child(frame->node, index, visitors[i].context);
+            }
+        }
+        enter(child, visitors, count);
+
+        if (depth == capacity) {
+            capacity *= 2;
+            if (frames == inline_frames) {
+                frames = safe_malloc(capacity * sizeof(WalkFrame));
+                for (int i = 0; i < depth; i++) {
+                    frames[i] = inline_frames[i];
+                }
+            } else {
+                frames = safe_realloc(frames, capacity * sizeof(WalkFrame));
+            }
+        }
+        push_frame(&frames[depth++], child);
+    }
+
+    if (frames != inline_frames) {
+        free(frames);
+    }
+}
@@ -0,0 +1,935 @@
+//vm.c
+#include <stdlib.h>
+#include <string.h>
+#include "../include/vm.h"
+#include "../include/runtime_string.h"
+#include "../include/list.h"
+#include "../include/dict.h"
+#include "../include/builtins.h"
+#include "../include/generator.h"
+#include "../include/file.h"
+#include "../include/scheduler.h"
+
+void init_vm(VM *vm, FILE *output) {
+    init_heap(&vm->heap);
+    vm->globals = NULL;
+    vm->global_count = 0;
+    vm->stack = NULL;
+    vm->stack_capacity = 0;
+    output_init(&vm->output, output);
+    vm->profile = NULL;
+    vm->threads = 0;
+    vm->pool = NULL;
+    vm->roots = (RootRange){NULL, 0};
+    vm->resumes = NULL;
+    vm->resume_count = 0;
+    vm->resume_capacity = 0;
+    vm->occupants = NULL;
+    vm->occupant_count = 0;
+    vm->call_depth = 0;
+}
+
+void free_vm(VM *vm) {
+    free_thread_pool(vm->pool);
+    vm->pool = NULL;
+    output_free(&vm->output);
+    free_heap(&vm->heap);
+    free(vm->globals);
+    free(vm->stack);
+    free(vm->resumes);
+    free(vm->occupants);
+    vm->resumes = NULL;
+    vm->resume_count = 0;
+    vm->resume_capacity = 0;
+    vm->occupants = NULL;
+    vm->occupant_count = 0;
+    vm->globals = NULL;
+    vm->global_count = 0;
+    vm->stack = NULL;
+    vm->stack_capacity = 0;
+}
+
+// Make room for everything `chunk` uses, so the loop itself never checks
+static void prepare(VM *vm, const Chunk *chunk) {
+    if (chunk->global_count > vm->global_count) {
+        vm->globals = safe_realloc(vm->globals, chunk->global_count * sizeof(Value));
+        for (int i = vm->global_count; i < chunk->global_count; i++) {
+            vm->globals[i] = VALUE_UNDEFINED;
+        }
+        vm->global_count = chunk->global_count;
+    }
+    if (chunk->max_stack > vm->stack_capacity) {
+        vm->stack_capacity = chunk->max_stack;
+        vm->stack = safe_realloc(vm->stack, vm->stack_capacity * sizeof(Value));
+    }
+    if (chunk->generator_count > vm->occupant_count) {
+        vm->occupants = safe_realloc(vm->occupants, chunk->generator_count * sizeof(Value));
+        for (int i = vm->occupant_count; i < chunk->generator_count; i++) {
+            vm->occupants[i] = VALUE_NONE;
+        }
+        vm->occupant_count = chunk->generator_count;
+    }
+}
+
+// Make room for `count` values on the stack. Generators resumed inside
+// one another take it deeper than any one chunk's code does.
+static void reserve_stack(VM *vm, size_t count) {
+    if (count > (size_t)vm->stack_capacity) {
+        size_t capacity = (size_t)vm->stack_capacity * 2;
+        vm->stack_capacity = (int)(capacity > count ? capacity : count);
+        vm->stack = safe_realloc(vm->stack, vm->stack_capacity * sizeof(Value));
+    }
+}
+
+static const char *operator_name(OpCode op) {
+    switch (op) {
+        case OP_ADD: return "+";
+        case OP_SUBTRACT: return "-";
+        case OP_MULTIPLY: return "*";
+        case OP_DIVIDE: return "/";
+        case OP_MODULO: return "%";
+        case OP_LESS: return "<";
+        case OP_LESS_EQUAL: return "<=";
+        case OP_GREATER: return ">";
+        default: return ">=";
+    }
+}
+
+static void print_value(VM *vm, Value value) {
+    Output *output = &vm->output;
+    if (value_is_small_int(value)) {
+        char *digits = output_reserve(output, INTEGER_FORMAT_MAX);
+        output_commit(output, integer_format_int64(digits, value_as_small_int(value), DIGITS_KANNADA));
+    } else if (value_is_string(value)) {
+        char scratch[SHORT_STRING_MAX + 1];
+        output_write(output, string_chars(value, scratch), string_byte_length(value));
+    } else {
+        char storage[256];
+        Buffer text;
+        buffer_init_fixed(&text, storage, sizeof(storage));
+        value_append(&text, value);
+        if (buffer_overflowed(&text)) {
+            buffer_init(&text);
+            value_append(&text, value);
+            output_write(output, text.data, text.length);
+            buffer_free(&text);
+        } else {
+            output_write(output, text.data, text.length);
+        }
+    }
+    output_end_line(output);
+}
+
+// Replace a string builder in `slot` with the string it built
+static Value finish_accumulator(VM *vm, Value *slot) {
+    if (value_is_object_type(*slot, OBJECT_BUILDER)) {
+        *slot = builder_finish(&vm->heap, (StringBuilder *)value_as_object(*slot));
+    }
+    return *slot;
+}
+
+// Collect garbage at a point where every live reference is on the stack,
+// in a global, among the chunk's constants or in the VM's extra roots
+static bool collect(VM *vm, Chunk *chunk, Value *sp) {
+    RootRange roots[] = {
+        {vm->stack, (size_t)(sp - vm->stack)},
+        {vm->globals, (size_t)vm->global_count},
+        {chunk->constants, (size_t)chunk->constant_count},
+        vm->roots,
+        {vm->resumes, (size_t)vm->resume_count},
+        {vm->occupants, (size_t)vm->occupant_count},
+    };
+    return collect_garbage(&vm->heap, roots, 6);
+}
+
+static uint32_t read_operand(const uint8_t *ip) {
+    return (uint32_t)ip[0] | (uint32_t)ip[1] << 8 | (uint32_t)ip[2] << 16 | (uint32_t)ip[3] << 24;
+}
+
+// A counted loop keeps the iterations it has left on the stack, between
+// its current value and its step. The count is tagged like a small integer,
+// so the collector passes over it, but uses all 63 bits unsigned.
+static inline Value loop_count(uint64_t count) {
+    return (Value)(count << 1) | 1;
+}
+
+// How many values range(start, stop, step) takes, as Python counts them.
+// `step` is not zero. Returns false if the count does not fit in 63 bits.
+static bool range_length(Value start, Value stop, Value step, uint64_t *length) {
+    if (start & stop & step & 1) {
+        int64_t from = value_as_small_int(start);
+        int64_t to = value_as_small_int(stop);
+        int64_t by = value_as_small_int(step);
+        if (by > 0 ? to <= from : to >= from) {
+            *length = 0;
+            return true;
+        }
+        // Both ends fit in 63 bits, so the distance fits in 64 unsigned
+        uint64_t distance = by > 0 ? (uint64_t)to - (uint64_t)from : (uint64_t)from - (uint64_t)to;
+        uint64_t stride = by > 0 ? (uint64_t)by : -(uint64_t)by;
+        *length = distance / stride + (distance % stride != 0);
+        return true;
+    }
+
+    Integer zero = integer_from_int64(0);
+    Integer by = value_to_integer(step);
+    bool up = integer_compare(by, zero) > 0;
+    Integer distance = up ? integer_sub(value_to_integer(stop), value_to_integer(start))
+                          : integer_sub(value_to_integer(start), value_to_integer(stop));
+    Integer stride = up ? integer_copy(by) : integer_neg(by);
+    bool fits = true;
+    *length = 0;
+    if (integer_compare(distance, zero) > 0) {
+        // ceil(distance / stride) is floor((distance - 1) / stride) + 1
+        Integer last = integer_sub(distance, integer_from_int64(1));
+        Integer steps;
+        integer_floordiv(last, stride, &steps);
+        fits = integer_is_small(steps) && steps.small < INT64_MAX;
+        if (fits) {
+            *length = (uint64_t)steps.small + 1;
+        }
+        integer_free(&last);
+        integer_free(&steps);
+    }
+    integer_free(&distance);
+    integer_free(&stride);
+    return fits;
+}
+
+// Check the arguments of range(start, stop, step) at `range` and count its
+// values. Returns false and sets `error` if they are not a valid range.
+static bool check_range(const Value *range, uint64_t *length, char *error) {
+    for (int i = 0; i < 3; i++) {
+        if (!value_is_int(range[i])) {
+            snprintf(error, MAX_ERROR_MESSAGE_LENGTH, "range() arguments must be integers, not '%s'",
+                     value_type_name(range[i]));
+            return false;
+        }
+    }
+    if (range[2] == value_from_small_int(0)) {
+        snprintf(error, MAX_ERROR_MESSAGE_LENGTH, "range() step must not be zero");
+        return false;
+    }
+    if (!range_length(range[0], range[1], range[2], length)) {
+        snprintf(error, MAX_ERROR_MESSAGE_LENGTH, "range() has too many elements");
+        return false;
+    }
+    return true;
+}
+
+// Whether `value` is a list or dictionary another heap owns, which a
+// parallel loop's iterations share and must not change
+static inline bool is_shared_object(const Heap *heap, Value value) {
+    return value_is_object(value) && value_as_object(value)->owner != heap->tag;
+}
+
+// A loop over a call that keeps its frame on the stack holds this in place
+// of a generator: the frame's position, tagged like a special constant
+static inline Value frame_handle(size_t position) {
+    return (Value)(position << 8) | 0x2A;
+}
+
+static inline bool is_frame_handle(Value value) {
+    return (value & 0xFF) == 0x2A;
+}
+
+static inline size_t frame_position(Value handle) {
+    return (size_t)(handle >> 8);
+}
+
+// The frame of the generator `handle` stands for. One on the stack moves
+// when the stack grows.
+static inline Value *frame_of(VM *vm, Value handle) {
+    return is_frame_handle(handle) ? vm->stack + frame_position(handle) : value_as_generator(handle)->frame;
+}
+
+static inline int frame_definition(const Value *frame) {
+    return (int)value_as_small_int(frame[FRAME_DEFINITION]);
+}
+
+// The frame's values have been replaced wholesale; a frame on the heap may
+// now refer to younger objects
+static void touch_frame(VM *vm, Value handle) {
+    if (!is_frame_handle(handle)) {
+        Object *object = value_as_object(handle);
+        if (!object->remembered && !heap_in_nursery(&vm->heap, object)) {
+            heap_remember(&vm->heap, object);
+        }
+    }
+}
+
+// Give the slots of generator `index` to the call `handle` stands for,
+// keeping the values of the call that had them in its frame
+static void occupy(VM *vm, const Chunk *chunk, int index, Value handle) {
+    Value occupant = vm->occupants[index];
+    if (occupant == handle) {
+        return;
+    }
+    const GeneratorDefinition *definition = &chunk->generators[index];
+    Value *slots = vm->globals + definition->first_slot;
+    size_t bytes = (size_t)definition->slot_count * sizeof(Value);
+    if (occupant != VALUE_NONE) {
+        memcpy(frame_of(vm, occupant) + FRAME_HEADER, slots, bytes);
+        touch_frame(vm, occupant);
+    }
+    if (handle != VALUE_NONE) {
+        memcpy(slots, frame_of(vm, handle) + FRAME_HEADER, bytes);
+    }
+    vm->occupants[index] = handle;
+}
+
+// A generator has stopped; give the slots back to the one that resumed
+// it, if it was resumed by a generator rather than the program
+static void occupy_caller(VM *vm, const Chunk *chunk) {
+    if (vm->resume_count > 0) {
+        Value caller = vm->resumes[vm->resume_count - 1];
+        occupy(vm, chunk, frame_definition(frame_of(vm, caller)), caller);
+    }
+}
+
+static void push_resume(VM *vm, size_t offset, size_t base, Value handle) {
+    if (vm->resume_count + 3 > vm->resume_capacity) {
+        vm->resume_capacity = vm->resume_capacity ? vm->resume_capacity * 2 : 48;
+        vm->resumes = safe_realloc(vm->resumes, vm->resume_capacity * sizeof(Value));
+    }
+    vm->resumes[vm->resume_count++] = value_from_small_int((int64_t)offset);
+    vm->resumes[vm->resume_count++] = value_from_small_int((int64_t)base);
+    vm->resumes[vm->resume_count++] = handle;
+}
+
+// After a runtime error, the generators that were running cannot go on
+// from where they stopped, and frames on the stack are gone
+static void abandon_generators(VM *vm) {
+    for (int i = 0; i < vm->resume_count; i += 3) {
+        Value *frame = frame_of(vm, vm->resumes[i + 2]);
+        frame[FRAME_RESUME] = FRAME_DONE;
+        vm->occupants[frame_definition(frame)] = VALUE_NONE;
+    }
+    vm->resume_count = 0;
+    for (int i = 0; i < vm->occupant_count; i++) {
+        if (is_frame_handle(vm->occupants[i])) {
+            vm->occupants[i] = VALUE_NONE;
+        }
+    }
+}
+
+static void missing_key(ErrorList *errors, int line, Value key) {
+    Buffer text;
+    buffer_init(&text);
+    value_append_quoted(&text, key);
+    report_error(errors, ERROR_RUNTIME, line, "Key not found: %.*s", (int)text.length, text.data);
+    buffer_free(&text);
+}
+
+bool run_chunk(VM *vm, Chunk *chunk, ErrorList *errors) {
+    return run_code(vm, chunk, 0, errors);
+}
+
+static bool execute(VM *vm, Chunk *chunk, size_t offset, ErrorList *errors);
+
+// A loop stopped by an error may leave a string builder in a variable,
+// which code run later must see as the string it holds
+static void finish_accumulators(VM *vm) {
+    for (int i = 0; i < vm->global_count; i++) {
+        finish_accumulator(vm, &vm->globals[i]);
+    }
+}
+
+bool run_code(VM *vm, Chunk *chunk, size_t offset, ErrorList *errors) {
+    prepare(vm, chunk);
+    if (execute(vm, chunk, offset, errors)) {
+        return true;
+    }
+    abandon_generators(vm);
+    finish_accumulators(vm);
+    vm->call_depth = 0;
+    return false;
+}
+
+bool collect_if_due(VM *vm, Chunk *chunk) {
+    return !vm->heap.collect_requested || collect(vm, chunk, vm->stack);
+}
+
+static bool execute(VM *vm, Chunk *chunk, size_t offset, ErrorList *errors) {
+    const uint8_t *code = chunk->code;
+    const uint8_t *ip = code + offset;
+    Value *sp = vm->stack;
+    Heap *heap = &vm->heap;
+
+// The line of the instruction being executed; its opcode is at ip - 1
+#define LINE() (chunk->lines[ip - code - 1])
+#define RUNTIME_ERROR(...)                                          \
+    do {                                                            \
+        report_error(errors, ERROR_RUNTIME, LINE(), __VA_ARGS__);   \
+        return false;                                               \
+    } while (0)
+
+    for (;;) {
+        OpCode op = (OpCode)*ip++;
+        switch (op) {
+            case OP_CONSTANT:
+                *sp++ = chunk->constants[read_operand(ip)];
+                ip += 4;
+                break;
+            case OP_NONE:
+                *sp++ = VALUE_NONE;
+                break;
+            case OP_TRUE:
+                *sp++ = VALUE_TRUE;
+                break;
+            case OP_FALSE:
+                *sp++ = VALUE_FALSE;
+                break;
+            case OP_POP:
+                sp--;
+                break;
+            case OP_GET_GLOBAL:
+                {
+                    uint32_t slot = read_operand(ip);
+                    Value value = vm->globals[slot];
+                    if (value == VALUE_UNDEFINED) {
+                        RUNTIME_ERROR("Variable '%s' used before it was assigned", chunk->global_names[slot]);
+                    }
+                    *sp++ = value;
+                    ip += 4;
+                }
+                break;
+            case OP_SET_GLOBAL:
+                vm->globals[read_operand(ip)] = *--sp;
+                ip += 4;
+                break;
+            case OP_APPEND_GLOBAL:
+                {
+                    uint32_t index = read_operand(ip);
+                    Value *slot = &vm->globals[index];
+                    Value value = *--sp;
+                    if (value_is_object_type(*slot, OBJECT_BUILDER) && value_is_string(value)) {
+                        builder_append((StringBuilder *)value_as_object(*slot), value);
+                    } else if (value_is_string(*slot) && value_is_string(value)) {
+                        StringBuilder *builder = builder_create(heap, *slot);
+                        builder_append(builder, value);
+                        *slot = (Value)(uintptr_t)builder;
+                    } else {
+                        if (*slot == VALUE_UNDEFINED) {
+                            RUNTIME_ERROR("Variable '%s' used before it was assigned", chunk->global_names[index]);
+                        }
+                        Value current = finish_accumulator(vm, slot);
+                        if (!value_add(heap, current, value, slot)) {
+                            RUNTIME_ERROR("Unsupported operand types for +: '%s' and '%s'",
+                                          value_type_name(current), value_type_name(value));
+                        }
+                    }
+                    ip += 4;
+                }
+                break;
+            case OP_INCREMENT_GLOBAL:
+                {
+                    // The compiler has checked the variable holds an
+                    // integer, so the addition cannot fail
+                    Value *slot = &vm->globals[read_operand(ip)];
+                    value_add(heap, *slot, chunk->constants[read_operand(ip + 4)], slot);
+                    ip += 8;
+                }
+                break;
+            case OP_GET_ACCUMULATOR:
+                {
+                    uint32_t slot = read_operand(ip);
+                    Value value = finish_accumulator(vm, &vm->globals[slot]);
+                    if (value == VALUE_UNDEFINED) {
+                        RUNTIME_ERROR("Variable '%s' used before it was assigned", chunk->global_names[slot]);
+                    }
+                    *sp++ = value;
+                    ip += 4;
+                }
+                break;
+            case OP_FINISH_ACCUMULATOR:
+                finish_accumulator(vm, &vm->globals[read_operand(ip)]);
+                ip += 4;
+                break;
+            case OP_REDUCE:
+                {
+                    // The first value a batch of iterations reduces starts it
+                    Value *slot = &vm->globals[read_operand(ip)];
+                    Value value = *--sp;
+                    char message[MAX_ERROR_MESSAGE_LENGTH];
+                    if (*slot == VALUE_UNDEFINED) {
+                        *slot = value;
+                    } else if (!reduce_values(heap, (ReductionKind)read_operand(ip + 4), slot, value, message)) {
+                        RUNTIME_ERROR("%s", message);
+                    }
+                    ip += 8;
+                }
+                break;
+            case OP_ADD:
+            case OP_SUBTRACT:
+            case OP_MULTIPLY:
+            case OP_DIVIDE:
+            case OP_MODULO:
+                {
+                    Value b = sp[-1];
+                    Value a = sp[-2];
+                    bool ok;
+                    switch (op) {
+                        case OP_ADD: ok = value_add(heap, a, b, &sp[-2]); break;
+                        case OP_SUBTRACT: ok = value_sub(heap, a, b, &sp[-2]); break;
+                        case OP_MULTIPLY: ok = value_mul(heap, a, b, &sp[-2]); break;
+                        case OP_DIVIDE: ok = value_divide(heap, a, b, &sp[-2]); break;
+                        default: ok = value_mod(heap, a, b, &sp[-2]); break;
+                    }
+                    if (!ok) {
+                        if (value_is_number(a) && value_is_number(b)) {
+                            RUNTIME_ERROR("Division by zero");
+                        }
+                        RUNTIME_ERROR("Unsupported operand types for %s: '%s' and '%s'",
+                                      operator_name(op), value_type_name(a), value_type_name(b));
+                    }
+                    sp--;
+                }
+                break;
+            case OP_NEGATE:
+                if (!value_neg(heap, sp[-1], &sp[-1])) {
+                    RUNTIME_ERROR("Unsupported operand type for -: '%s'", value_type_name(sp[-1]));
+                }
+                break;
+            case OP_NOT:
+                sp[-1] = value_from_bool(!value_is_truthy(sp[-1]));
+                break;
+            case OP_EQUAL:
+            case OP_NOT_EQUAL:
+                {
+                    // NaN is unequal even to itself
+                    bool equal = value_equal(sp[-2], sp[-1]) && !(sp[-2] == sp[-1] && value_is_nan(sp[-1]));
+                    sp[-2] = value_from_bool(op == OP_EQUAL ? equal : !equal);
+                    sp--;
+                }
+                break;
+            case OP_LESS:
+            case OP_LESS_EQUAL:
+            case OP_GREATER:
+            case OP_GREATER_EQUAL:
+                {
+                    Value a = sp[-2];
+                    Value b = sp[-1];
+                    // a <= b is !(b < a), and a > b is b < a
+                    bool swap = op == OP_LESS_EQUAL || op == OP_GREATER;
+                    bool less;
+                    if (!value_less(swap ? b : a, swap ? a : b, &less)) {
+                        RUNTIME_ERROR("Unsupported operand types for %s: '%s' and '%s'",
+                                      operator_name(op), value_type_name(a), value_type_name(b));
+                    }
+                    bool result = op == OP_LESS_EQUAL || op == OP_GREATER_EQUAL ? !less : less;
+                    // NaN is unordered, so b < a failing does not make a <= b
+                    if (result && !(a & b & 1) && (value_is_nan(a) || value_is_nan(b))) {
+                        result = false;
+                    }
+                    sp[-2] = value_from_bool(result);
+                    sp--;
+                }
+                break;
+            case OP_BUILD_LIST:
+                {
+                    uint32_t count = read_operand(ip);
+                    sp -= count;
+                    *sp = list_from_values(heap, sp, count);
+                    sp++;
+                    ip += 4;
+                }
+                break;
+            case OP_BUILD_DICT:
+                {
+                    uint32_t count = read_operand(ip);
+                    char message[MAX_ERROR_MESSAGE_LENGTH];
+                    sp -= count * 2;
+                    if (!dict_from_entries(heap, sp, count, sp, message)) {
+                        RUNTIME_ERROR("%s", message);
+                    }
+                    sp++;
+                    ip += 4;
+                }
+                break;
+            case OP_INDEX:
+                {
+                    Value sequence = sp[-2];
+                    Value index = sp[-1];
+                    if (value_is_dict(sequence)) {
+                        char message[MAX_ERROR_MESSAGE_LENGTH];
+                        bool found;
+                        if (!dict_get(value_as_dict(sequence), index, &sp[-2], &found, message)) {
+                            RUNTIME_ERROR("%s", message);
+                        }
+                        if (!found) {
+                            missing_key(errors, LINE(), index);
+                            return false;
+                        }
+                        sp--;
+                        break;
+                    }
+                    size_t length;
+                    if (value_is_list(sequence)) {
+                        length = value_as_list(sequence)->count;
+                    } else if (value_is_string(sequence)) {
+                        if (!string_length(sequence, &length)) {
+                            RUNTIME_ERROR("Cannot index a string that is not valid UTF-8");
+                        }
+                    } else {
+                        RUNTIME_ERROR("'%s' cannot be indexed", value_type_name(sequence));
+                    }
+                    if (!value_is_int(index)) {
+                        RUNTIME_ERROR("Indices must be integers, not '%s'", value_type_name(index));
+                    }
+                    size_t position;
+                    if (!sequence_index(index, length, &position)) {
+                        RUNTIME_ERROR("Index out of range");
+                    }
+                    if (value_is_list(sequence)) {
+                        sp[-2] = list_get(value_as_list(sequence), position);
+                    } else {
+                        string_index(sequence, position, &sp[-2]);
+                    }
+                    sp--;
+                }
+                break;
+            case OP_STORE_INDEX:
+                {
+                    Value target = sp[-3];
+                    Value index = sp[-2];
+                    if (is_shared_object(heap, target)) {
+                        RUNTIME_ERROR("A parallel loop cannot change a %s that its iterations share",
+                                      value_type_name(target));
+                    }
+                    if (value_is_dict(target)) {
+                        char message[MAX_ERROR_MESSAGE_LENGTH];
+                        if (!dict_set(heap, value_as_dict(target), index, sp[-1], message)) {
+                            RUNTIME_ERROR("%s", message);
+                        }
+                        sp -= 3;
+                        break;
+                    }
+                    if (!value_is_list(target)) {
+                        RUNTIME_ERROR("'%s' does not support item assignment", value_type_name(target));
+                    }
+                    if (!value_is_int(index)) {
+                        RUNTIME_ERROR("Indices must be integers, not '%s'", value_type_name(index));
+                    }
+                    size_t position;
+                    if (!sequence_index(index, value_as_list(target)->count, &position)) {
+                        RUNTIME_ERROR("Index out of range");
+                    }
+                    list_set(heap, value_as_list(target), position, sp[-1]);
+                    sp -= 3;
+                }
+                break;
+            case OP_CALL_BUILTIN:
+                {
+                    Builtin builtin = (Builtin)read_operand(ip);
+                    char message[MAX_ERROR_MESSAGE_LENGTH];
+                    Value result;
+                    sp -= builtin_arity(builtin);
+                    if ((builtin == BUILTIN_APPEND || builtin == BUILTIN_REMOVE) && is_shared_object(heap, sp[0])) {
+                        RUNTIME_ERROR("A parallel loop cannot change a %s that its iterations share",
+                                      value_type_name(sp[0]));
+                    }
+                    if (!call_builtin(heap, builtin, sp, &result, message)) {
+                        RUNTIME_ERROR("%s", message);
+                    }
+                    *sp++ = result;
+                    ip += 4;
+                }
+                break;
+            case OP_FOR_PREPARE:
+                {
+                    char message[MAX_ERROR_MESSAGE_LENGTH];
+                    uint64_t length;
+                    if (!check_range(sp - 3, &length, message)) {
+                        RUNTIME_ERROR("%s", message);
+                    }
+                    if (length == 0) {
+                        sp -= 3;
+                        ip = code + read_operand(ip + 4);
+                        break;
+                    }
+                    vm->globals[read_operand(ip)] = sp[-3];
+                    sp[-2] = loop_count(length - 1);
+                    ip += 8;
+                }
+                break;
+            case OP_FOR_LOOP:
+                {
+                    if (sp[-2] == loop_count(0)) {
+                        sp -= 3;
+                        ip += 8;
+                        break;
+                    }
+                    sp[-2] -= 2;
+                    value_add(heap, sp[-3], sp[-1], &sp[-3]);
+                    vm->globals[read_operand(ip)] = sp[-3];
+                    // A jump back, like OP_JUMP
+                    if (heap->collect_requested && !collect(vm, chunk, sp)) {
+                        RUNTIME_ERROR("Out of memory: live data exceeds the heap limit of %zu MB",
+                                      heap->limit / (1024 * 1024));
+                    }
+                    ip = code + read_operand(ip + 4);
+                }
+                break;
+            case OP_PARALLEL:
+                {
+                    const ParallelLoop *loop = &chunk->parallel_loops[read_operand(ip)];
+                    char message[MAX_ERROR_MESSAGE_LENGTH];
+                    uint64_t length;
+                    if (!check_range(sp - 3, &length, message)) {
+                        RUNTIME_ERROR("%s", message);
+                    }
+                    sp -= 3;
+                    if (length > 0 && !run_parallel_loop(vm, chunk, loop, sp[0], sp[2], length, errors)) {
+                        return false;
+                    }
+                    ip = code + loop->exit;
+                }
+                break;
+            case OP_END_ITERATION:
+                // An iteration of a parallel loop ends, as a loop's does
+                // with a jump back
+                if (heap->collect_requested && !collect(vm, chunk, sp)) {
+                    RUNTIME_ERROR("Out of memory: live data exceeds the heap limit of %zu MB",
+                                  heap->limit / (1024 * 1024));
+                }
+                return true;
+            case OP_MAKE_GENERATOR:
+                {
+                    int index = (int)read_operand(ip);
+                    const GeneratorDefinition *definition = &chunk->generators[index];
+                    uint32_t size = generator_frame_size(definition->slot_count, definition->max_stack);
+                    GeneratorObject *generator = generator_create(heap, size);
+                    sp -= definition->parameter_count;
+                    memcpy(generator->frame + FRAME_HEADER, sp, definition->parameter_count * sizeof(Value));
+                    generator_frame_init(generator->frame, size, index, definition->entry,
+                                         definition->parameter_count, definition->slot_count);
+                    *sp++ = (Value)(uintptr_t)generator;
+                    ip += 4;
+                }
+                break;
+            case OP_GENERATOR_FRAME:
+                {
+                    // The frame starts where the arguments are, under the loop's handle
+                    int index = (int)read_operand(ip);
+                    const GeneratorDefinition *definition = &chunk->generators[index];
+                    uint32_t size = generator_frame_size(definition->slot_count, definition->max_stack);
+                    Value *frame = sp - definition->parameter_count;
+                    memmove(frame + FRAME_HEADER, frame, definition->parameter_count * sizeof(Value));
+                    generator_frame_init(frame, size, index, definition->entry,
+                                         definition->parameter_count, definition->slot_count);
+                    sp = frame + size;
+                    *sp++ = frame_handle((size_t)(frame - vm->stack));
+                    ip += 4;
+                }
+                break;
+            case OP_FOR_GENERATOR:
+                {
+                    Value handle = sp[-1];
+                    if (value_is_line_reader(handle)) {
+                        if (is_shared_object(heap, handle)) {
+                            RUNTIME_ERROR("A parallel loop cannot read lines that its iterations share");
+                        }
+                        char message[MAX_ERROR_MESSAGE_LENGTH];
+                        Value line;
+                        if (!line_reader_next(heap, value_as_line_reader(handle), &line, message)) {
+                            RUNTIME_ERROR("%s", message);
+                        }
+                        if (line == VALUE_NONE) {
+                            sp--;
+                            ip = code + read_operand(ip + 4);
+                        } else {
+                            vm->globals[read_operand(ip)] = line;
+                            ip += 8;
+                        }
+                        break;
+                    }
+                    if (!is_frame_handle(handle) && !value_is_generator(handle)) {
+                        RUNTIME_ERROR("Cannot loop over '%s'; only over a range, a generator or a file's lines",
+                                      value_type_name(handle));
+                    }
+                    if (is_shared_object(heap, handle)) {
+                        RUNTIME_ERROR("A parallel loop cannot resume a generator that its iterations share");
+                    }
+                    Value *frame = frame_of(vm, handle);
+                    if (frame[FRAME_RESUME] == FRAME_DONE) {
+                        sp = is_frame_handle(handle) ? vm->stack + frame_position(handle) : sp - 1;
+                        ip = code + read_operand(ip + 4);
+                        break;
+                    }
+                    if (frame[FRAME_RESUME] == FRAME_RUNNING) {
+                        RUNTIME_ERROR("Cannot loop over a generator inside its own body");
+                    }
+
+                    // Its stack goes on top of the loop's, and its
+                    // variables into their slots
+                    int index = frame_definition(frame);
+                    const GeneratorDefinition *definition = &chunk->generators[index];
+                    size_t base = (size_t)(sp - vm->stack);
+                    push_resume(vm, (size_t)(ip - 1 - code), base, handle);
+                    if (vm->profile != NULL) {
+                        profile_call(vm->profile);
+                    }
+                    reserve_stack(vm, base + (size_t)definition->max_stack);
+                    sp = vm->stack + base;
+                    frame = frame_of(vm, handle);
+                    occupy(vm, chunk, index, handle);
+                    size_t depth = (size_t)value_as_small_int(frame[FRAME_DEPTH]);
+                    memcpy(sp, frame + FRAME_HEADER + definition->slot_count, depth * sizeof(Value));
+                    sp += depth;
+                    ip = code + value_as_small_int(frame[FRAME_RESUME]);
+                    frame[FRAME_RESUME] = FRAME_RUNNING;
+                }
+                break;
+            case OP_YIELD:
+                {
+                    // Save the generator's stack and where it goes on
+                    Value value = *--sp;
+                    vm->resume_count -= 3;
+                    if (vm->profile != NULL) {
+                        profile_return(vm->profile);
+                    }
+                    const Value *resume = vm->resumes + vm->resume_count;
+                    size_t loop = (size_t)value_as_small_int(resume[0]);
+                    Value *base = vm->stack + value_as_small_int(resume[1]);
+                    Value handle = resume[2];
+                    Value *frame = frame_of(vm, handle);
+                    const GeneratorDefinition *definition = &chunk->generators[frame_definition(frame)];
+                    memcpy(frame + FRAME_HEADER + definition->slot_count, base, (size_t)(sp - base) * sizeof(Value));
+                    frame[FRAME_DEPTH] = value_from_small_int(sp - base);
+                    frame[FRAME_RESUME] = value_from_small_int(ip - code);
+                    touch_frame(vm, handle);
+                    sp = base;
+
+                    // The loop that resumed it runs its body with the value
+                    occupy_caller(vm, chunk);
+                    vm->globals[read_operand(code + loop + 1)] = value;
+                    ip = code + loop + 9;
+                }
+                break;
+            case OP_END_GENERATOR:
+                {
+                    vm->resume_count -= 3;
+                    if (vm->profile != NULL) {
+                        profile_return(vm->profile);
+                    }
+                    const Value *resume = vm->resumes + vm->resume_count;
+                    Value *frame = frame_of(vm, resume[2]);
+                    vm->occupants[frame_definition(frame)] = VALUE_NONE;
+                    frame[FRAME_RESUME] = FRAME_DONE;
+                    sp = vm->stack + value_as_small_int(resume[1]);
+                    occupy_caller(vm, chunk);
+                    // The loop finds it done and ends
+                    ip = code + value_as_small_int(resume[0]);
+                }
+                break;
+            case OP_CALL:
+                // Recursion may allocate without ever looping, so calls
+                // and returns let the collector run too
+                if (heap->collect_requested && !collect(vm, chunk, sp)) {
+                    RUNTIME_ERROR("Out of memory: live data exceeds the heap limit of %zu MB",
+                                  heap->limit / (1024 * 1024));
+                }
+                {
+                    const FunctionDefinition *definition = &chunk->functions[read_operand(ip)];
+                    if (vm->call_depth == CALL_DEPTH_MAX) {
+                        RUNTIME_ERROR("Calls nest more than %d deep", CALL_DEPTH_MAX);
+                    }
+                    size_t base = (size_t)(sp - vm->stack) - (size_t)definition->parameter_count;
+                    reserve_stack(vm, base + (size_t)definition->slot_count + 1 + (size_t)definition->max_stack);
+                    sp = vm->stack + base;
+                    // The arguments trade places with the values in the
+                    // parameters' slots; the other variables start unassigned
+                    Value *slots = vm->globals + definition->first_slot;
+                    for (int i = 0; i < definition->parameter_count; i++) {
+                        Value argument = sp[i];
+                        sp[i] = slots[i];
+                        slots[i] = argument;
+                    }
+                    for (int i = definition->parameter_count; i < definition->slot_count; i++) {
+                        sp[i] = slots[i];
+                        slots[i] = VALUE_UNDEFINED;
+                    }
+                    sp += definition->slot_count;
+                    *sp++ = value_from_small_int(ip + 4 - code);
+                    vm->call_depth++;
+                    if (vm->profile != NULL) {
+                        profile_call(vm->profile);
+                    }
+                    ip = code + definition->entry;
+                }
+                break;
+            case OP_RETURN:
+                if (heap->collect_requested && !collect(vm, chunk, sp)) {
+                    RUNTIME_ERROR("Out of memory: live data exceeds the heap limit of %zu MB",
+                                  heap->limit / (1024 * 1024));
+                }
+                {
+                    uint32_t depth = read_operand(ip);
+                    const FunctionDefinition *definition = &chunk->functions[read_operand(ip + 4)];
+                    Value result = sp[-1];
+                    Value *frame = sp - depth - 1 - definition->slot_count;
+                    memcpy(vm->globals + definition->first_slot, frame, definition->slot_count * sizeof(Value));
+                    ip = code + value_as_small_int(frame[definition->slot_count]);
+                    sp = frame;
+                    *sp++ = result;
+                    vm->call_depth--;
+                    if (vm->profile != NULL) {
+                        profile_return(vm->profile);
+                    }
+                }
+                break;
+            case OP_JUMP:
+                // Every loop ends in a jump back, so this is where the
+                // collector gets to run
+                if (heap->collect_requested && !collect(vm, chunk, sp)) {
+                    RUNTIME_ERROR("Out of memory: live data exceeds the heap limit of %zu MB",
+                                  heap->limit / (1024 * 1024));
+                }
+                ip = code + read_operand(ip);
+                break;
+            case OP_JUMP_IF_FALSE:
+                ip = value_is_truthy(*--sp) ? ip + 4 : code + read_operand(ip);
+                break;
+            case OP_JUMP_IF_FALSE_OR_POP:
+                if (value_is_truthy(sp[-1])) {
+                    sp--;
+                    ip += 4;
+                } else {
+                    ip = code + read_operand(ip);
+                }
+                break;
+            case OP_JUMP_IF_TRUE_OR_POP:
+                if (value_is_truthy(sp[-1])) {
+                    ip = code + read_operand(ip);
+                } else {
+                    sp--;
+                    ip += 4;
+                }
+                break;
+            case OP_JUMP_IF_NOT_INTEGER:
+                ip = value_is_int(*--sp) ? ip + 4 : code + read_operand(ip);
+                break;
+            case OP_PRINT:
+                print_value(vm, *--sp);
+                break;
+            case OP_LINE:
+                // Only the thread that started a parallel loop profiles its iterations
+                if (vm->profile != NULL) {
+                    profile_enter(vm->profile, (int)read_operand(ip));
+                }
+                ip += 4;
+                break;
+            case OP_HALT:
+                // Code that neither loops nor calls stops within the limit too
+                if (heap->collect_requested && !collect(vm, chunk, sp)) {
+                    RUNTIME_ERROR("Out of memory: live data exceeds the heap limit of %zu MB",
+                                  heap->limit / (1024 * 1024));
+                }
+                return true;
+        }
+    }
+
+#undef RUNTIME_ERROR
+#undef LINE
+}
@@ -0,0 +1,46 @@
+#!/bin/sh
+# Run each tests/programs/*.kpy with `--run` and compare what it prints,
+# stdout then stderr, and its exit status with the .out file next to it.
+# A .args file next to a program holds extra options for it, one line per
+# run: a program whose output must not change with an option, such as
+# `--unroll` or `--cse`, is run once with each line and every run is held
+# to the same .out file. Programs run in tests/programs, so the files they
+# read are named from there.
+#
+# Usage: tests/run_programs.sh <compiler>
+
+compiler=$(cd "$(dirname "$1")" && pwd)/$(basename "$1")
+dir=$(dirname "$0")/programs
+failed=0
+count=0
+actual=$(mktemp)
+trap 'rm -f "$actual"' EXIT
+
+for program in "$dir"/*.kpy; do
+    name=${program%.kpy}
+    runs=
+    if [ -f "$name.args" ]; then
+        runs=$(cat "$name.args")
+    fi
+    while IFS= read -r args; do
+        # shellcheck disable=SC2086
+        (cd "$dir" && "$compiler" --run "${program##*/}" $args) >"$actual" 2>"$actual.err"
+        status=$?
+        cat "$actual.err" >>"$actual"
+        rm -f "$actual.err"
+        echo "exit $status" >>"$actual"
+        count=$((count + 1))
+        if ! diff -u "$name.out" "$actual"; then
+            echo "FAILED: $program $args"
+            failed=$((failed + 1))
+        fi
+    done <<RUNS
+$runs
+RUNS
+done
+
+if [ "$failed" -ne 0 ]; then
+    echo "programs         $failed of $count FAILED"
+    exit 1
+fi
+echo "programs         ok ($count)"
@@ -0,0 +1,48 @@
+#ifndef TEST_H
+#define TEST_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Shared by the unit tests in tests/. Each test is a program of its own
+// that exits with status 0 if every check passed. Random inputs come from
+// a fixed seed, so a failure shows up again on the next run.
+
+static int test_failures = 0;
+
+// Report a failed check with a printf-style message, giving up after a
+// few so one broken invariant does not flood the log
+#define CHECK(condition, ...)                                                        \
+    do {                                                                             \
+        if (!(condition)) {                                                          \
+            fprintf(stderr, "%s:%d: check failed: %s: ", __FILE__, __LINE__, #condition); \
+            fprintf(stderr, __VA_ARGS__);                                            \
+            fputc('\n', stderr);                                                     \
+            if (++test_failures >= 10) {                                             \
+                exit(EXIT_FAILURE);                                                  \
+            }                                                                        \
+        }                                                                            \
+    } while (0)
+
+static uint64_t test_random_state = 0x9E3779B97F4A7C15u;
+
+// xorshift64*
+static inline uint64_t test_random(void) {
+    test_random_state ^= test_random_state >> 12;
+    test_random_state ^= test_random_state << 25;
+    test_random_state ^= test_random_state >> 27;
+    return test_random_state * 0x2545F4914F6CDD1Du;
+}
+
+// A number in [0, bound)
+static inline size_t test_random_below(size_t bound) {
+    return (size_t)(test_random() % bound);
+}
+
+static inline int test_finish(const char *name) {
+    printf("%-16s %s\n", name, test_failures == 0 ? "ok" : "FAILED");
+    return test_failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+#endif // TEST_H
@@ -0,0 +1,122 @@
+//test_dict.c
+#include <string.h>
+#include "../include/dict.h"
+#include "../include/list.h"
+#include "../include/runtime_string.h"
+#include "test.h"
+
+#define KEY_COUNT 3000
+
+// Odd keys are integers, even ones strings long enough to live on the heap
+static Value make_key(Heap *heap, int key) {
+    if (key % 2 != 0) {
+        return value_from_small_int(key);
+    }
+    char text[32];
+    int length = snprintf(text, sizeof(text), "ಕೀಲಿ-%d", key);
+    return string_from_chars(heap, text, (size_t)length);
+}
+
+// The dictionary against a plain model of it: which keys are present, their
+// values, and the order they were first inserted in since last deleted
+typedef struct {
+    bool present[KEY_COUNT];
+    int64_t values[KEY_COUNT];
+    int order[KEY_COUNT];
+    int count;
+} Model;
+
+static void model_set(Model *model, int key, int64_t value) {
+    if (!model->present[key]) {
+        model->present[key] = true;
+        model->order[model->count++] = key;
+    }
+    model->values[key] = value;
+}
+
+static void model_delete(Model *model, int key) {
+    if (!model->present[key]) {
+        return;
+    }
+    model->present[key] = false;
+    for (int i = 0; i < model->count; i++) {
+        if (model->order[i] == key) {
+            memmove(&model->order[i], &model->order[i + 1], (model->count - i - 1) * sizeof(int));
+            break;
+        }
+    }
+    model->count--;
+}
+
+static void check_against_model(Heap *heap, DictObject *dict, const Model *model, int round) {
+    char error[MAX_ERROR_MESSAGE_LENGTH];
+    CHECK(dict->count == (size_t)model->count, "round %d: %zu entries, expected %d", round, dict->count,
+          model->count);
+    for (int key = 0; key < KEY_COUNT; key++) {
+        Value value;
+        bool found;
+        // A fresh copy of a string key must find the same entry
+        CHECK(dict_get(dict, make_key(heap, key), &value, &found, error), "round %d: get failed: %s", round, error);
+        CHECK(found == model->present[key], "round %d: key %d %s", round, key,
+              found ? "found after deletion" : "missing");
+        if (found && model->present[key]) {
+            CHECK(value == value_from_small_int(model->values[key]), "round %d: key %d has the wrong value",
+                  round, key);
+        }
+    }
+    ListObject *keys = value_as_list(dict_keys(heap, dict));
+    CHECK(keys->count == (size_t)model->count, "round %d: dict_keys gave %zu keys", round, keys->count);
+    for (size_t i = 0; i < keys->count && i < (size_t)model->count; i++) {
+        CHECK(value_equal(list_get(keys, i), make_key(heap, model->order[i])),
+              "round %d: key %zu is out of insertion order", round, i);
+    }
+}
+
+int main(void) {
+    Heap heap;
+    init_heap(&heap);
+    char error[MAX_ERROR_MESSAGE_LENGTH];
+    DictObject *dict = dict_create(&heap);
+    static Model model;
+
+    Value keys[KEY_COUNT];
+    for (int key = 0; key < KEY_COUNT; key++) {
+        keys[key] = make_key(&heap, key);
+    }
+
+    // Inserting and deleting at random, with deletions rarer early on so
+    // the index has to grow, then commoner so it fills with tombstones
+    for (int round = 0; round < 60000; round++) {
+        int key = (int)test_random_below(KEY_COUNT);
+        bool remove = test_random_below(10) < (round < 30000 ? 2u : 5u);
+        if (remove) {
+            bool found;
+            CHECK(dict_delete(dict, keys[key], &found, error), "delete failed: %s", error);
+            CHECK(found == model.present[key], "round %d: delete of key %d found %d", round, key, found);
+            model_delete(&model, key);
+        } else {
+            int64_t value = (int64_t)test_random_below(1000000);
+            CHECK(dict_set(&heap, dict, keys[key], value_from_small_int(value), error), "set failed: %s", error);
+            model_set(&model, key, value);
+        }
+        if (round % 5000 == 0) {
+            check_against_model(&heap, dict, &model, round);
+        }
+    }
+    check_against_model(&heap, dict, &model, -1);
+
+    // Equal numbers are the same key, as in Python
+    CHECK(dict_set(&heap, dict, value_from_small_int(1), value_from_small_int(7), error), "set failed: %s", error);
+    Value value;
+    bool found;
+    CHECK(dict_get(dict, value_from_double(&heap, 1.0), &value, &found, error) && found &&
+              value == value_from_small_int(7),
+          "1.0 does not find the entry for 1");
+
+    // Mutable values cannot be keys
+    Value list = list_from_values(&heap, keys, 2);
+    CHECK(!dict_set(&heap, dict, list, VALUE_NONE, error), "a list was accepted as a key");
+
+    free_heap(&heap);
+    return test_finish("dict");
+}
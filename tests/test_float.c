@@ -0,0 +1,139 @@
+//test_float.c
+#include <math.h>
+#include <string.h>
+#include "../include/floating.h"
+#include "test.h"
+
+static uint64_t bits_of(double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static double from_bits(uint64_t bits) {
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// Read decimal text such as "-1.5e-07" with float_from_decimal
+static double parse(const char *text) {
+    bool negative = *text == '-';
+    text += negative;
+    char digits[1024];
+    size_t length = 0;
+    int64_t exponent = 0;
+    bool fraction = false;
+    for (; *text != '\0' && *text != 'e'; text++) {
+        if (*text == '.') {
+            fraction = true;
+        } else {
+            digits[length++] = *text;
+            exponent -= fraction;
+        }
+    }
+    if (*text == 'e') {
+        exponent += strtol(text + 1, NULL, 10);
+    }
+    double value = float_from_decimal(digits, length, exponent);
+    return negative ? -value : value;
+}
+
+static char *print(double value) {
+    Buffer buffer;
+    buffer_init(&buffer);
+    float_append(&buffer, value, DIGITS_ASCII);
+    buffer_append(&buffer, "", 0);
+    return buffer.data;
+}
+
+static void check_known(void) {
+    // Printed as Python's repr() prints them
+    struct {
+        uint64_t bits;
+        const char *text;
+    } printed[] = {
+        {0x3FB999999999999Au, "0.1"},
+        {0x3FF0000000000000u, "1.0"},
+        {0x4341C37937E08000u, "1e+16"},
+        {0x3EE4F8B588E368F1u, "1e-05"},
+        {0x3FD3333333333334u, "0.30000000000000004"},
+        {0x0000000000000001u, "5e-324"},
+        {0x7FEFFFFFFFFFFFFFu, "1.7976931348623157e+308"},
+        {0xC00C000000000000u, "-3.5"},
+        {0x4450BB448EC2F608u, "1.2345678901234568e+21"},
+        {0x0000000000000000u, "0.0"},
+        {0x8000000000000000u, "-0.0"},
+    };
+    for (size_t i = 0; i < sizeof(printed) / sizeof(printed[0]); i++) {
+        char *text = print(from_bits(printed[i].bits));
+        CHECK(strcmp(text, printed[i].text) == 0, "printed %s as %s", printed[i].text, text);
+        free(text);
+    }
+
+    // Read with one rounding, ties to even, including inputs only the
+    // exact big-integer fallback settles
+    struct {
+        const char *text;
+        uint64_t bits;
+    } read[] = {
+        {"9007199254740993", 0x4340000000000000u},
+        {"9007199254740995", 0x4340000000000002u},
+        {"2.2250738585072011e-308", 0x000FFFFFFFFFFFFFu},
+        {"1.00000000000000011102230246251565404236316680908203125", 0x3FF0000000000000u},
+        {"1.00000000000000011102230246251565404236316680908203126", 0x3FF0000000000001u},
+        {"2.4703282292062327e-324", 0x0000000000000000u},
+        {"2.4703282292062328e-324", 0x0000000000000001u},
+        {"1.7976931348623159e+308", 0x7FF0000000000000u},
+        {"0.1", 0x3FB999999999999Au},
+    };
+    for (size_t i = 0; i < sizeof(read) / sizeof(read[0]); i++) {
+        uint64_t bits = bits_of(parse(read[i].text));
+        CHECK(bits == read[i].bits, "read %s as %016llx, expected %016llx", read[i].text,
+              (unsigned long long)bits, (unsigned long long)read[i].bits);
+    }
+}
+
+// Whatever is printed reads back as the same double, and no shorter
+// prefix rounded the same way would have
+static void check_round_trip(int rounds) {
+    for (int round = 0; round < rounds; round++) {
+        uint64_t bits = test_random();
+        // Half of them in the range programs usually see
+        if (round % 2 == 0) {
+            bits = (bits & 0x800FFFFFFFFFFFFFu) | ((uint64_t)(1023 - 40 + test_random_below(80)) << 52);
+        }
+        double value = from_bits(bits);
+        if (!isfinite(value)) {
+            continue;
+        }
+        char *text = print(value);
+        uint64_t back = bits_of(parse(text));
+        CHECK(back == bits, "%016llx printed as %s reads back as %016llx", (unsigned long long)bits, text,
+              (unsigned long long)back);
+
+        // If fewer digits read back as the value, the nearest number with
+        // that many digits does too
+        size_t start = strspn(text, "-0.");
+        size_t end = strcspn(text, "e");
+        int significant = 0;
+        for (size_t i = start; i < end; i++) {
+            significant += text[i] != '.';
+        }
+        while (end > start && (text[end - 1] == '0' || text[end - 1] == '.')) {
+            significant -= text[--end] != '.';
+        }
+        if (significant > 1) {
+            char shorter[64];
+            snprintf(shorter, sizeof(shorter), "%.*e", significant - 2, value);
+            CHECK(bits_of(parse(shorter)) != bits, "%s also reads back, so %s is not the shortest", shorter, text);
+        }
+        free(text);
+    }
+}
+
+int main(void) {
+    check_known();
+    check_round_trip(200000);
+    return test_finish("float");
+}
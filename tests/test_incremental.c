@@ -0,0 +1,255 @@
+//test_incremental.c
+#include <string.h>
+#include "../include/kannada.h"
+#include "../include/incremental.h"
+#include "../include/visitor.h"
+#include "test.h"
+
+// Pieces of text that edits insert: whole statements, halves of them,
+// brackets and quotes that open or close blocks and strings, and
+// characters the lexer rejects
+static const char *const snippets[] = {
+    "ಅ = 1;\n", "ಬ = ಅ + 2;\n", "ಮುದ್ರಿಸು(ಅ * ಬ);\n", "ಯದಿ ಅ < ಬ {\n", "}\n", "} ಅನ್ಯಥಾ {\n",
+    "ಆಗಿರುವ ಅ < 10 { ಅ = ಅ + 1; }\n", "ಪ್ರತಿ ಕ ಒಳಗೆ ವ್ಯಾಪ್ತಿ(3) { ಮುದ್ರಿಸು(ಕ); }\n",
+    "\"ಪದ\"", "\"", "(", ")", "{", "}", ";", "\n", " ", "+", "=", "ಅ", "ಬ", "ಮ", "12", "3.5",
+    "@", "$", "[1, 2]", "ಸತ್ಯ", "ಕಾರ್ಯ ಫ(ಅ) { ಹಿಂತಿರುಗಿಸು ಅ + 1; }\n", "ಮುದ್ರಿಸು(ಫ(2));\n",
+};
+
+static const char initial[] =
+    "ಅ = 1;\n"
+    "ಬ = 2;\n"
+    "ಯದಿ ಅ < ಬ {\n"
+    "    ಮುದ್ರಿಸು(\"ಚಿಕ್ಕದು\");\n"
+    "} ಅನ್ಯಥಾ {\n"
+    "    ಮುದ್ರಿಸು(ಬ);\n"
+    "}\n"
+    "ಮುದ್ರಿಸು(ಅ + ಬ);\n";
+
+// Byte offsets on UTF-8 character boundaries only, as an editor sends
+static size_t random_boundary(const char *text, size_t length) {
+    size_t offset = test_random_below(length + 1);
+    while (offset < length && (text[offset] & 0xC0) == 0x80) {
+        offset++;
+    }
+    return offset;
+}
+
+static void compare(kpy_document *document, const char *text, size_t length, int edit) {
+    kpy_result full;
+    kpy_result incremental;
+    kpy_status full_status = kpy_compile(text, length, NULL, &full);
+    kpy_status incremental_status = kpy_document_compile(document, NULL, &incremental);
+    CHECK(full_status == incremental_status, "edit %d: status %d, full compile %d", edit, incremental_status,
+          full_status);
+    CHECK(full.output_length == incremental.output_length &&
+              (full.output_length == 0 || memcmp(full.output, incremental.output, full.output_length) == 0),
+          "edit %d: output differs from a full compile", edit);
+    CHECK(full.diagnostic_count == incremental.diagnostic_count, "edit %d: %zu diagnostics, full compile %zu",
+          edit, incremental.diagnostic_count, full.diagnostic_count);
+    for (size_t i = 0; i < full.diagnostic_count && i < incremental.diagnostic_count; i++) {
+        const kpy_diagnostic *a = &incremental.diagnostics[i];
+        const kpy_diagnostic *b = &full.diagnostics[i];
+        CHECK(a->kind == b->kind && a->line == b->line && strcmp(a->message, b->message) == 0,
+              "edit %d: diagnostic %zu is %d:%d %s, full compile has %d:%d %s", edit, i, a->kind, a->line,
+              a->message, b->kind, b->line, b->message);
+    }
+    kpy_result_free(&full);
+    kpy_result_free(&incremental);
+}
+
+typedef struct {
+    int *lines;
+    size_t count;
+    size_t capacity;
+} Lines;
+
+static void record_line(ASTNode *node, void *context) {
+    Lines *lines = context;
+    if (lines->count == lines->capacity) {
+        lines->capacity = lines->capacity ? lines->capacity * 2 : 1024;
+        lines->lines = realloc(lines->lines, lines->capacity * sizeof(int));
+    }
+    lines->lines[lines->count++] = node->line;
+}
+
+static Lines program_lines(Document *document) {
+    Lines lines = {NULL, 0, 0};
+    ASTNode *program = document_program(document);
+    if (program) {
+        ASTVisitor visitor = {record_line, NULL, NULL, &lines};
+        walk_ast(program, &visitor, 1);
+    }
+    return lines;
+}
+
+// The lines of every node must be those of the same text parsed afresh,
+// as the compiled code does not show them
+static void compare_lines(Document *shadow, const char *text, size_t length, int edit) {
+    Document *fresh = create_document(text, length, shadow->names);
+    Lines expected = program_lines(fresh);
+    Lines actual = program_lines(shadow);
+    CHECK(actual.count == expected.count, "edit %d: %zu nodes, not %zu", edit, actual.count, expected.count);
+    for (size_t i = 0; i < actual.count && i < expected.count; i++) {
+        if (actual.lines[i] != expected.lines[i]) {
+            CHECK(false, "edit %d: node %zu is on line %d, not %d", edit, i, actual.lines[i], expected.lines[i]);
+            break;
+        }
+    }
+    free(expected.lines);
+    free(actual.lines);
+    free_document(fresh);
+}
+
+// Apply the same edit to the document, its shadow and the text
+static void edit_both(kpy_document *document, Document *shadow, char *text, size_t *length, size_t start,
+                      size_t old_length, const char *insert) {
+    size_t insert_length = strlen(insert);
+    CHECK(kpy_document_edit(document, start, old_length, insert, insert_length) == KPY_OK, "edit failed");
+    document_edit(shadow, start, old_length, insert, insert_length);
+    memmove(text + start + insert_length, text + start + old_length, *length - start - old_length);
+    memcpy(text + start, insert, insert_length);
+    *length = *length - old_length + insert_length;
+}
+
+// A function with a body of thousands of lines, some in blocks of their
+// own. Edits between its braces must re-parse only the statements around
+// them, not the whole function.
+static void edit_function_body(void) {
+    enum { STATEMENTS = 3000, LOCAL = 100 };
+    size_t capacity = 1 << 20;
+    char *text = malloc(capacity);
+    size_t length = (size_t)sprintf(text, "ಕಾರ್ಯ ಫ(ಅ) {\n    ಬ = ಅ;\n");
+    size_t body = length;
+    for (int i = 0; i < STATEMENTS; i++) {
+        if (i % 10 == 0) {
+            length += (size_t)sprintf(text + length,
+                                      "    ಯದಿ ಬ > %d {\n        ಬ = ಬ - %d;\n    } ಅನ್ಯಥಾ {\n        ಬ = ಬ + 1;\n    }\n",
+                                      i, i % 7);
+        } else {
+            length += (size_t)sprintf(text + length, "    ಬ = ಬ + %d;\n", i % 13);
+        }
+    }
+    size_t body_end = length;
+    length += (size_t)sprintf(text + length, "    ಹಿಂತಿರುಗಿಸು ಬ;\n}\nಮುದ್ರಿಸು(ಫ(3));\n");
+
+    kpy_document *document = kpy_document_open(text, length);
+    InternTable *names = create_intern_table(256);
+    Document *shadow = create_document(text, length, names);
+    compare(document, text, length, 0);
+
+    const char *const statements[] = {
+        "    ಬ = ಬ * 2;\n", "    ಮುದ್ರಿಸು(ಬ);\n", "    ಆಗಿರುವ ಬ > 100 { ಬ = ಬ - 100; }\n",
+        "    ಯದಿ ಬ < 0 {\n        ಬ = 0;\n    }\n",
+    };
+    for (int edit = 1; edit <= 40; edit++) {
+        // The start of a random line of the body, and a statement there
+        size_t start = body + test_random_below(body_end - body);
+        while (text[start - 1] != '\n') {
+            start--;
+        }
+        const char *insert = statements[test_random_below(sizeof(statements) / sizeof(statements[0]))];
+        edit_both(document, shadow, text, &length, start, 0, insert);
+        body_end += strlen(insert);
+        CHECK(shadow->reparsed_tokens < LOCAL, "inserting at %zu re-parsed %d tokens", start,
+              shadow->reparsed_tokens);
+        compare(document, text, length, edit);
+        compare_lines(shadow, text, length, edit);
+
+        // A keystroke in a number on some line of the body, typing another
+        // digit or over one
+        size_t digit = body + test_random_below(body_end - body);
+        while (text[digit] < '0' || text[digit] > '9') {
+            digit++;
+        }
+        edit_both(document, shadow, text, &length, digit, edit % 2, "5");
+        body_end += edit % 2 ? 0 : 1;
+        CHECK(shadow->reparsed_tokens < LOCAL, "typing at %zu re-parsed %d tokens", digit,
+              shadow->reparsed_tokens);
+        compare(document, text, length, edit);
+        compare_lines(shadow, text, length, edit);
+
+        // A statement typed a character at a time, through states that do
+        // not parse, each of which is still local
+        if (edit % 5 == 0) {
+            const char *typed = "ಮುದ್ರಿಸು(ಬ + 1);\n    ";
+            size_t at = start;
+            for (const char *c = typed; *c != '\0';) {
+                size_t size = 1;
+                while ((c[size] & 0xC0) == 0x80) {
+                    size++;
+                }
+                char character[8] = {0};
+                memcpy(character, c, size);
+                edit_both(document, shadow, text, &length, at, 0, character);
+                CHECK(shadow->reparsed_tokens < LOCAL, "typing %s at %zu re-parsed %d tokens", character, at,
+                      shadow->reparsed_tokens);
+                compare(document, text, length, edit);
+                at += size;
+                c += size;
+            }
+            body_end += strlen(typed);
+            compare_lines(shadow, text, length, edit);
+        }
+
+        // A brace that leaves the function open, and then taken out again;
+        // both re-parse the function, after which edits are local again
+        if (edit % 10 == 0) {
+            edit_both(document, shadow, text, &length, start, 0, "{");
+            compare(document, text, length, edit);
+            edit_both(document, shadow, text, &length, start, 1, "");
+            compare(document, text, length, edit);
+            edit_both(document, shadow, text, &length, start, 0, " ");
+            CHECK(shadow->reparsed_tokens < LOCAL, "re-parsed %d tokens after an unbalanced edit",
+                  shadow->reparsed_tokens);
+            compare(document, text, length, edit);
+            compare_lines(shadow, text, length, edit);
+            edit_both(document, shadow, text, &length, start, 1, "");
+        }
+    }
+
+    free_document(shadow);
+    free_intern_table(names);
+    kpy_document_close(document);
+    free(text);
+}
+
+int main(void) {
+    edit_function_body();
+
+    size_t capacity = 1 << 16;
+    char *text = malloc(capacity);
+    size_t length = strlen(initial);
+    memcpy(text, initial, length);
+    kpy_document *document = kpy_document_open(text, length);
+    compare(document, text, length, 0);
+
+    for (int edit = 1; edit <= 5000; edit++) {
+        size_t start = random_boundary(text, length);
+        size_t end = test_random_below(3) == 0 ? random_boundary(text, length) : start;
+        if (end < start) {
+            size_t swap = start;
+            start = end;
+            end = swap;
+        }
+        // Keep the text from growing without bound
+        if (end - start > 200 || (length > 4000 && end == start)) {
+            end = start + (length - start < 40 ? length - start : 40);
+            while (end < length && (text[end] & 0xC0) == 0x80) {
+                end++;
+            }
+        }
+        const char *insert = snippets[test_random_below(sizeof(snippets) / sizeof(snippets[0]))];
+        size_t insert_length = test_random_below(4) == 0 ? 0 : strlen(insert);
+
+        CHECK(kpy_document_edit(document, start, end - start, insert, insert_length) == KPY_OK,
+              "edit %d failed", edit);
+        memmove(text + start + insert_length, text + end, length - end);
+        memcpy(text + start, insert, insert_length);
+        length = length - (end - start) + insert_length;
+        compare(document, text, length, edit);
+    }
+
+    kpy_document_close(document);
+    free(text);
+    return test_finish("incremental");
+}
@@ -0,0 +1,195 @@
+//test_integer.c
+#include <string.h>
+#include "../include/integer.h"
+#include "test.h"
+
+static char *to_string(Integer value) {
+    Buffer buffer;
+    buffer_init(&buffer);
+    integer_append(&buffer, value);
+    buffer_append(&buffer, "", 0);
+    return buffer.data;
+}
+
+static Integer parse(const char *text) {
+    bool negative = text[0] == '-';
+    Integer magnitude = integer_from_decimal(text + negative, strlen(text + negative));
+    if (!negative) {
+        return magnitude;
+    }
+    Integer value = integer_neg(magnitude);
+    integer_free(&magnitude);
+    return value;
+}
+
+// Up to `max_digits` random digits with a random sign, weighted towards
+// the 64-bit boundary where values switch between inline and BigInt
+static Integer random_integer(size_t max_digits) {
+    char digits[128];
+    size_t length = 1 + test_random_below(max_digits);
+    if (test_random_below(4) == 0) {
+        length = 18 + test_random_below(3);
+    }
+    for (size_t i = 0; i < length; i++) {
+        digits[i] = (char)('0' + test_random_below(10));
+    }
+    // Runs of nines and zeros make the limbs all ones or all zeros
+    if (test_random_below(4) == 0) {
+        memset(digits + length / 2, test_random_below(2) ? '9' : '0', length - length / 2);
+    }
+    Integer magnitude = integer_from_decimal(digits, length);
+    if (test_random_below(2) == 0) {
+        return magnitude;
+    }
+    Integer value = integer_neg(magnitude);
+    integer_free(&magnitude);
+    return value;
+}
+
+static void check_narrow(Integer value, const char *operation) {
+    if (!integer_is_small(value)) {
+        Integer max = integer_from_int64(INT64_MAX);
+        Integer min = integer_from_int64(INT64_MIN);
+        CHECK(integer_compare(value, max) > 0 || integer_compare(value, min) < 0,
+              "%s left a 64-bit value in a BigInt", operation);
+    }
+}
+
+static void check_equal(Integer actual, Integer expected, const char *what) {
+    if (integer_compare(actual, expected) != 0) {
+        char *a = to_string(actual);
+        char *e = to_string(expected);
+        CHECK(false, "%s: got %s, expected %s", what, a, e);
+        free(a);
+        free(e);
+    }
+}
+
+static void check_known(void) {
+    struct {
+        const char *a;
+        const char *b;
+        const char *sum;
+        const char *product;
+        const char *quotient;
+        const char *remainder;
+    } cases[] = {
+        {"9223372036854775807", "1", "9223372036854775808", "9223372036854775807", "9223372036854775807", "0"},
+        {"-9223372036854775808", "-1", "-9223372036854775809", "9223372036854775808", "9223372036854775808", "0"},
+        {"1000000000000000000000000000000", "7", "1000000000000000000000000000007",
+         "7000000000000000000000000000000", "142857142857142857142857142857", "1"},
+        {"-1000000000000000000000000000000", "7", "-999999999999999999999999999993",
+         "-7000000000000000000000000000000", "-142857142857142857142857142858", "6"},
+        {"7", "-2", "5", "-14", "-4", "-1"},
+        {"-7", "2", "-5", "-14", "-4", "1"},
+        {"340282366920938463463374607431768211456", "18446744073709551616",
+         "340282366920938463481821351505477763072",
+         "6277101735386680763835789423207666416102355444464034512896", "18446744073709551616", "0"},
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        Integer a = parse(cases[i].a);
+        Integer b = parse(cases[i].b);
+        Integer expected[4] = {parse(cases[i].sum), parse(cases[i].product), parse(cases[i].quotient),
+                               parse(cases[i].remainder)};
+        Integer actual[4];
+        actual[0] = integer_add(a, b);
+        actual[1] = integer_mul(a, b);
+        CHECK(integer_divmod(a, b, &actual[2], &actual[3]), "%s divmod %s failed", cases[i].a, cases[i].b);
+        const char *names[4] = {"sum", "product", "quotient", "remainder"};
+        for (int j = 0; j < 4; j++) {
+            check_equal(actual[j], expected[j], names[j]);
+            integer_free(&actual[j]);
+            integer_free(&expected[j]);
+        }
+        char *text = to_string(a);
+        CHECK(strcmp(text, cases[i].a) == 0, "printed %s as %s", cases[i].a, text);
+        free(text);
+        integer_free(&a);
+        integer_free(&b);
+    }
+
+    Integer one = integer_from_int64(1);
+    Integer power = integer_shift_left(one, 64);
+    char *text = to_string(power);
+    CHECK(strcmp(text, "18446744073709551616") == 0, "1 << 64 printed as %s", text);
+    free(text);
+    integer_free(&power);
+
+    Integer zero = integer_from_int64(0);
+    Integer unused;
+    CHECK(!integer_floordiv(one, zero, &unused), "division by zero succeeded");
+}
+
+// Identities that must hold for any operands
+static void check_random(int rounds) {
+    for (int round = 0; round < rounds; round++) {
+        Integer a = random_integer(60);
+        Integer b = random_integer(test_random_below(2) ? 60 : 20);
+        Integer c = random_integer(30);
+
+        Integer sum = integer_add(a, b);
+        Integer difference = integer_sub(sum, b);
+        check_equal(difference, a, "(a + b) - b");
+        check_narrow(sum, "add");
+        check_narrow(difference, "sub");
+
+        Integer ab = integer_mul(a, b);
+        Integer ba = integer_mul(b, a);
+        check_equal(ab, ba, "a * b vs b * a");
+        check_narrow(ab, "mul");
+
+        // (a + b) * c == a * c + b * c
+        Integer left = integer_mul(sum, c);
+        Integer ac = integer_mul(a, c);
+        Integer bc = integer_mul(b, c);
+        Integer right = integer_add(ac, bc);
+        check_equal(left, right, "distributivity");
+
+        // a == q * b + r, with r between 0 and b
+        Integer quotient, remainder;
+        if (integer_divmod(a, b, &quotient, &remainder)) {
+            Integer qb = integer_mul(quotient, b);
+            Integer back = integer_add(qb, remainder);
+            check_equal(back, a, "q * b + r");
+            Integer zero = integer_from_int64(0);
+            int r_sign = integer_compare(remainder, zero);
+            int b_sign = integer_compare(b, zero);
+            CHECK(r_sign == 0 || r_sign == b_sign, "remainder has the wrong sign");
+            Integer past = integer_sub(remainder, b);
+            // |r| < |b| means r - b has the opposite sign of b
+            CHECK(integer_compare(past, zero) == -b_sign, "remainder is not smaller than the divisor");
+            check_narrow(quotient, "floordiv");
+            check_narrow(remainder, "mod");
+
+            Integer floor, mod;
+            CHECK(integer_floordiv(a, b, &floor), "floordiv failed");
+            CHECK(integer_mod(a, b, &mod), "mod failed");
+            check_equal(floor, quotient, "floordiv vs divmod");
+            check_equal(mod, remainder, "mod vs divmod");
+            integer_free(&floor);
+            integer_free(&mod);
+            integer_free(&past);
+            integer_free(&qb);
+            integer_free(&back);
+            integer_free(&quotient);
+            integer_free(&remainder);
+        }
+
+        // Printing and parsing give back the same value
+        char *text = to_string(ab);
+        Integer parsed = parse(text);
+        check_equal(parsed, ab, "print then parse");
+        free(text);
+
+        Integer *owned[] = {&a, &b, &c, &sum, &difference, &ab, &ba, &left, &ac, &bc, &right, &parsed};
+        for (size_t i = 0; i < sizeof(owned) / sizeof(owned[0]); i++) {
+            integer_free(owned[i]);
+        }
+    }
+}
+
+int main(void) {
+    check_known();
+    check_random(20000);
+    return test_finish("integer");
+}
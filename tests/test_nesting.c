@@ -0,0 +1,156 @@
+//test_nesting.c
+#include <string.h>
+#include "../include/compiler.h"
+#include "../include/kannada.h"
+#include "../include/parser.h"
+#include "test.h"
+
+// Lists and dictionaries nested far deeper than the C stack would allow a
+// call per level, printed and compared; and source nested that deep, which
+// the parser must refuse with an error. tests/programs/cycles.kpy has
+// lists and dictionaries that hold themselves.
+#define LIST_DEPTH 2000000
+// Dictionaries take much more memory a level
+#define DICT_DEPTH 200000
+
+// Run the program, which must succeed, and return what it printed
+static char *run(const char *source, size_t *length) {
+    char *output;
+    FILE *stream = open_memstream(&output, length);
+    ErrorList errors;
+    init_error_list(&errors);
+    RunOptions options = {0};
+    bool ok = run_source(source, strlen(source), stream, &errors, &options);
+    fclose(stream);
+    CHECK(ok, "%s", errors.count > 0 ? errors.errors[0].message : "failed");
+    free_error_list(&errors);
+    return output;
+}
+
+// Whether `output` is `answers` and then `depth` copies of `open`, the
+// given innermost container, and `depth` closing brackets, on a line
+static bool printed(const char *output, size_t length, const char *answers, const char *open, const char *innermost,
+                    char close, size_t depth) {
+    size_t answers_length = strlen(answers);
+    size_t open_length = strlen(open);
+    size_t innermost_length = strlen(innermost);
+    if (length != answers_length + depth * (open_length + 1) + innermost_length + 1 ||
+        memcmp(output, answers, answers_length) != 0) {
+        return false;
+    }
+    const char *p = output + answers_length;
+    for (size_t i = 0; i < depth; i++, p += open_length) {
+        if (memcmp(p, open, open_length) != 0) {
+            return false;
+        }
+    }
+    if (memcmp(p, innermost, innermost_length) != 0) {
+        return false;
+    }
+    p += innermost_length;
+    for (size_t i = 0; i < depth; i++) {
+        if (*p++ != close) {
+            return false;
+        }
+    }
+    return *p == '\n';
+}
+
+// Source of `depth` copies of `open`, then `middle`, then `depth` copies of
+// `close`, between `before` and `after`
+static char *nested_source(const char *before, const char *open, const char *middle, const char *close,
+                           const char *after, int depth) {
+    size_t open_length = strlen(open);
+    size_t close_length = strlen(close);
+    char *source = malloc(strlen(before) + depth * (open_length + close_length) + strlen(middle) + strlen(after) + 1);
+    char *p = source;
+    p += sprintf(p, "%s", before);
+    for (int i = 0; i < depth; i++, p += open_length) {
+        memcpy(p, open, open_length);
+    }
+    p += sprintf(p, "%s", middle);
+    for (int i = 0; i < depth; i++, p += close_length) {
+        memcpy(p, close, close_length);
+    }
+    sprintf(p, "%s", after);
+    return source;
+}
+
+// Compile the source with kpy_compile; it must succeed if `nested_ok`,
+// else fail with a single parser error
+static void check_compile(const char *what, const char *source, bool nested_ok) {
+    kpy_result result;
+    kpy_status status = kpy_compile(source, strlen(source), NULL, &result);
+    if (nested_ok) {
+        CHECK(status == KPY_OK, "%s: %s", what, kpy_status_string(status));
+    } else {
+        CHECK(status == KPY_ERROR_COMPILE && result.diagnostic_count == 1 &&
+                  result.diagnostics[0].kind == KPY_DIAGNOSTIC_PARSER,
+              "%s: %s, %zu diagnostics", what, kpy_status_string(status), result.diagnostic_count);
+    }
+    kpy_result_free(&result);
+}
+
+static void check_source_nesting(void) {
+    static const struct {
+        const char *what;
+        const char *before;
+        const char *open;
+        const char *middle;
+        const char *close;
+        const char *after;
+    } shapes[] = {
+        {"parentheses", "ಅ = ", "(", "1", ")", ";\n"},
+        {"negations", "ಅ = ", "-", "1", "", ";\n"},
+        {"lists", "ಅ = ", "[", "", "]", ";\n"},
+        {"sums", "ಅ = ", "1 + (", "1", ")", ";\n"},
+        {"ifs", "ಅ = 1;\n", "ಯದಿ ಅ {\n", "ಮುದ್ರಿಸು(ಅ);\n", "}\n", "ಮುದ್ರಿಸು(2);\n"},
+    };
+    for (size_t i = 0; i < sizeof(shapes) / sizeof(shapes[0]); i++) {
+        const int depths[] = {MAX_NESTING_DEPTH / 2 - 1, 100000};
+        for (int d = 0; d < 2; d++) {
+            char *source = nested_source(shapes[i].before, shapes[i].open, shapes[i].middle, shapes[i].close,
+                                         shapes[i].after, depths[d]);
+            check_compile(shapes[i].what, source, d == 0);
+            free(source);
+        }
+    }
+}
+
+int main(void) {
+    check_source_nesting();
+
+    char source[1024];
+    snprintf(source, sizeof(source),
+             "ಪ = [];\n"
+             "ಕ = [];\n"
+             "ಪ್ರತಿ ಅ ಒಳಗೆ ವ್ಯಾಪ್ತಿ(%d) { ಪ = [ಪ]; ಕ = [ಕ]; }\n"
+             "ಮುದ್ರಿಸು(ಪ == ಕ);\n"
+             "ಮುದ್ರಿಸು(ಪ < ಕ);\n"
+             "ಸೇರಿಸು(ಕ, 1);\n"
+             "ಮುದ್ರಿಸು(ಪ == ಕ);\n"
+             "ಮುದ್ರಿಸು(ಪ < ಕ);\n"
+             "ಮುದ್ರಿಸು(ಕ < ಪ);\n"
+             "ಮುದ್ರಿಸು(ಪ);\n",
+             LIST_DEPTH);
+    size_t length;
+    char *output = run(source, &length);
+    CHECK(printed(output, length, "ನಿಜ\nಸುಳ್ಳು\nಸುಳ್ಳು\nನಿಜ\nಸುಳ್ಳು\n", "[", "[]", ']', LIST_DEPTH),
+          "lists: printed %.100s", output);
+    free(output);
+
+    snprintf(source, sizeof(source),
+             "ದ = {};\n"
+             "ಎ = {};\n"
+             "ಪ್ರತಿ ಅ ಒಳಗೆ ವ್ಯಾಪ್ತಿ(%d) { ದ = {1: ದ}; ಎ = {1: ಎ}; }\n"
+             "ಮುದ್ರಿಸು(ದ == ಎ);\n"
+             "ಎ[2] = 2;\n"
+             "ಮುದ್ರಿಸು(ದ == ಎ);\n"
+             "ಮುದ್ರಿಸು(ದ);\n",
+             DICT_DEPTH);
+    output = run(source, &length);
+    CHECK(printed(output, length, "ನಿಜ\nಸುಳ್ಳು\n", "{೧: ", "{}", '}', DICT_DEPTH), "dictionaries: printed %.100s",
+          output);
+    free(output);
+    return test_finish("nesting");
+}
@@ -0,0 +1,161 @@
+//test_parallel.c
+#include <string.h>
+#include "../include/compiler.h"
+#include "test.h"
+
+// Programs with LOOP where a loop may run in parallel. Each is run with
+// the loops sequential, as ಪ್ರತಿ, and then parallel on various numbers of
+// threads; every run must print the same and fail the same way.
+static const char *const programs[] = {
+    // Reductions of every kind, over iterations of uneven cost, with
+    // enough work in all that the loop is shared out
+    "ಮೊ = 0;\n"
+    "ಪದ = \"\";\n"
+    "ಕಿ = 1000000;\n"
+    "ಗ = 0 - 1;\n"
+    "LOOP ಅ ಒಳಗೆ ವ್ಯಾಪ್ತಿ(3000) {\n"
+    "    ಕ = 0;\n"
+    "    ಪ್ರತಿ ಬ ಒಳಗೆ ವ್ಯಾಪ್ತಿ(ಅ % 50) { ಕ = ಕ + ಬ * ಅ; }\n"
+    "    ಯದಿ ಅ % 100 == 0 { ಮುದ್ರಿಸು(ಕ); }\n"
+    "    ಮೊ = ಮೊ + ಕ * 1000000000000000;\n"
+    "    ಯದಿ ಅ % 7 == 0 { ಪದ = ಪದ + \"ಕ\"; } ಅನ್ಯಥಾ { ಪದ = ಪದ + \"ಗ\"; }\n"
+    "    ಕಿ = ಕನಿಷ್ಠ([ಕಿ, (ಅ * 7919) % 1009]);\n"
+    "    ಗ = ಗರಿಷ್ಠ([ಗ, (ಅ * 7919) % 1009]);\n"
+    "}\n"
+    "ಮುದ್ರಿಸು(ಮೊ);\n"
+    "ಮುದ್ರಿಸು(ಪದ);\n"
+    "ಮುದ್ರಿಸು(ಕಿ);\n"
+    "ಮುದ್ರಿಸು(ಗ);\n",
+
+    // Private variables and the loop variable read after the loop, with
+    // some assigned only by a few iterations, some by none, and a string
+    // built up in a nested loop
+    "ಬ = 0;\n"
+    "ಮ = \"ಮೊದಲು\";\n"
+    "ಯ = 5;\n"
+    "LOOP ಅ ಒಳಗೆ ವ್ಯಾಪ್ತಿ(0, 20000) { ಬ = ಅ * 2; }\n"
+    "ಮುದ್ರಿಸು(ಬ);\n"
+    "ಮುದ್ರಿಸು(ಅ);\n"
+    "LOOP ಕ ಒಳಗೆ ವ್ಯಾಪ್ತಿ(5000, 0, 0 - 3) {\n"
+    "    ಪ = \"\";\n"
+    "    ಪ್ರತಿ ಗ ಒಳಗೆ ವ್ಯಾಪ್ತಿ(ಕ % 4) { ಪ = ಪ + \"ಗ\"; }\n"
+    "    ಯದಿ ಕ % 1000 == 2 { ಮ = ಕ; }\n"
+    "    ಯದಿ ಕ < 0 { ಯ = ಕ; }\n"
+    "    ಲ = [ಕ, ಪ];\n"
+    "}\n"
+    "ಮುದ್ರಿಸು(ಕ);\n"
+    "ಮುದ್ರಿಸು(ಪ);\n"
+    "ಮುದ್ರಿಸು(ಮ);\n"
+    "ಮುದ್ರಿಸು(ಯ);\n"
+    "ಮುದ್ರಿಸು(ಗ);\n"
+    "ಮುದ್ರಿಸು(ಲ[1]);\n",
+
+    // Many short loops one after another, which reuse the same workers
+    "ಒಟ್ಟು = 0;\n"
+    "ಪ್ರತಿ ಅ ಒಳಗೆ ವ್ಯಾಪ್ತಿ(400) {\n"
+    "    ಒ = 0;\n"
+    "    LOOP ಬ ಒಳಗೆ ವ್ಯಾಪ್ತಿ(ಅ % 13) {\n"
+    "        ಪ = [ಅ, ಬ, ಅ * ಬ];\n"
+    "        ಒ = ಒ + ಪ[2];\n"
+    "    }\n"
+    "    ಒಟ್ಟು = ಒಟ್ಟು + ಒ;\n"
+    "    ಯದಿ ಅ % 50 == 0 { ಮುದ್ರಿಸು(ಒಟ್ಟು); }\n"
+    "}\n"
+    "ಮುದ್ರಿಸು(ಒಟ್ಟು);\n",
+
+    // A failure part way through, after which nothing more is printed
+    "ಪ = [1, 2, 3];\n"
+    "LOOP ಅ ಒಳಗೆ ವ್ಯಾಪ್ತಿ(2000) {\n"
+    "    ಕ = 0;\n"
+    "    ಪ್ರತಿ ಬ ಒಳಗೆ ವ್ಯಾಪ್ತಿ(100) { ಕ = ಕ + ಬ; }\n"
+    "    ಮುದ್ರಿಸು(ಅ + ಕ);\n"
+    "    ಯದಿ ಅ == 1234 ಅಥವಾ ಅ == 1700 { ಮುದ್ರಿಸು(ಪ[5]); }\n"
+    "}\n"
+    "ಮುದ್ರಿಸು(\"ಮುಗಿಯಿತು\");\n",
+
+    // Loops inside iterations, directly and in a function, allocating
+    // enough for the workers' heaps to be collected
+    "ಕಾರ್ಯ ಕೂಡು(ಅ) {\n"
+    "    ಒ = 0;\n"
+    "    LOOP ಬ ಒಳಗೆ ವ್ಯಾಪ್ತಿ(50) {\n"
+    "        ಲ = [ಅ, ಬ, [ಅ + ಬ]];\n"
+    "        ಒ = ಒ + ಲ[2][0];\n"
+    "    }\n"
+    "    ಹಿಂತಿರುಗಿಸು ಒ;\n"
+    "}\n"
+    "ಹಂಚು = [10, 20, 30];\n"
+    "LOOP ಅ ಒಳಗೆ ವ್ಯಾಪ್ತಿ(600) {\n"
+    "    ಪದ = \"\";\n"
+    "    LOOP ಬ ಒಳಗೆ ವ್ಯಾಪ್ತಿ(3) {\n"
+    "        ಪದ = ಪದ + \"ಕ\";\n"
+    "    }\n"
+    "    ಮುದ್ರಿಸು(ಕೂಡು(ಅ) + ಹಂಚು[ಅ % 3]);\n"
+    "    ಮುದ್ರಿಸು(ಪದ);\n"
+    "}\n",
+};
+
+typedef struct {
+    bool ok;
+    char *output;
+    size_t length;
+    ErrorList errors;
+} Run;
+
+// Run `program` with every LOOP replaced by `keyword`
+static Run run(const char *program, const char *keyword, int threads) {
+    char source[8192];
+    size_t length = 0;
+    for (const char *p = program; *p != '\0';) {
+        if (strncmp(p, "LOOP", 4) == 0) {
+            length += (size_t)snprintf(source + length, sizeof(source) - length, "%s", keyword);
+            p += 4;
+        } else {
+            source[length++] = *p++;
+        }
+    }
+    source[length] = '\0';
+
+    Run result;
+    FILE *output = open_memstream(&result.output, &result.length);
+    init_error_list(&result.errors);
+    RunOptions options = {0};
+    options.threads = threads;
+    result.ok = run_source(source, length, output, &result.errors, &options);
+    fclose(output);
+    return result;
+}
+
+static void free_run(Run *run) {
+    free(run->output);
+    free_error_list(&run->errors);
+}
+
+int main(void) {
+    const int thread_counts[] = {1, 2, 3, 8};
+    for (size_t p = 0; p < sizeof(programs) / sizeof(programs[0]); p++) {
+        Run expected = run(programs[p], "ಪ್ರತಿ", 1);
+        CHECK(expected.length > 0, "program %zu printed nothing", p);
+        for (size_t t = 0; t < sizeof(thread_counts) / sizeof(thread_counts[0]); t++) {
+            // Repeated, as the split of the work changes from run to run
+            for (int round = 0; round < 3; round++) {
+                Run actual = run(programs[p], "ಸಮಾನಾಂತರ", thread_counts[t]);
+                CHECK(actual.ok == expected.ok, "program %zu on %d threads: %s", p, thread_counts[t],
+                      actual.ok ? "succeeded" : actual.errors.errors[0].message);
+                CHECK(actual.length == expected.length && memcmp(actual.output, expected.output, actual.length) == 0,
+                      "program %zu on %d threads printed something else", p, thread_counts[t]);
+                CHECK(actual.errors.count == expected.errors.count, "program %zu on %d threads: %d errors, not %d", p,
+                      thread_counts[t], actual.errors.count, expected.errors.count);
+                for (int i = 0; i < actual.errors.count && i < expected.errors.count; i++) {
+                    Error *a = &actual.errors.errors[i];
+                    Error *e = &expected.errors.errors[i];
+                    CHECK(a->line == e->line && strcmp(a->message, e->message) == 0,
+                          "program %zu on %d threads: error %d:%s, not %d:%s", p, thread_counts[t], a->line,
+                          a->message, e->line, e->message);
+                }
+                free_run(&actual);
+            }
+        }
+        free_run(&expected);
+    }
+    return test_finish("parallel");
+}
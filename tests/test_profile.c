@@ -0,0 +1,146 @@
+//test_profile.c
+#include <string.h>
+#include "../include/compiler.h"
+#include "test.h"
+
+// A call inside a loop that takes nearly all of the run. The loop and the
+// call site must be charged the time spent in the calls, recursion must
+// not count a line more than once, and the collapsed stacks must put the
+// function under the line that called it.
+static const char fibonacci[] =
+    "ಕಾರ್ಯ ಫಿಬ್(ನ) {\n"
+    "    ಯದಿ ನ < 2 {\n"
+    "        ಹಿಂತಿರುಗಿಸು ನ;\n"
+    "    }\n"
+    "    ಹಿಂತಿರುಗಿಸು ಫಿಬ್(ನ - 1) + ಫಿಬ್(ನ - 2);\n"
+    "}\n"
+    "ಸ = 0;\n"
+    "ಪ್ರತಿ ಅ ಒಳಗೆ ವ್ಯಾಪ್ತಿ(40) {\n"
+    "    ಸ = ಸ + ಫಿಬ್(20);\n"
+    "}\n"
+    "ಮುದ್ರಿಸು(ಸ);\n";
+enum { DEFINITION = 1, RECURSION = 5, LOOP = 8, CALL = 9 };
+
+// Generators resumed from loops and from a function that returns while
+// one is suspended, with calls inside them; every call and resume must
+// be popped again
+static const char generators[] =
+    "ಕಾರ್ಯ ವರ್ಗ(ಅ) { ಹಿಂತಿರುಗಿಸು ಅ * ಅ; }\n"
+    "ಉತ್ಪಾದಕ ಎಣಿಕೆ(ಮಿತಿ) {\n"
+    "    ಪ್ರತಿ ಅ ಒಳಗೆ ವ್ಯಾಪ್ತಿ(ಮಿತಿ) {\n"
+    "        ನೀಡು ವರ್ಗ(ಅ);\n"
+    "    }\n"
+    "}\n"
+    "ಕಾರ್ಯ ಮೊದಲನೆಯದು(ಮೂಲ) {\n"
+    "    ಪ್ರತಿ ಅ ಒಳಗೆ ಮೂಲ {\n"
+    "        ಹಿಂತಿರುಗಿಸು ಅ;\n"
+    "    }\n"
+    "    ಹಿಂತಿರುಗಿಸು ಶೂನ್ಯ;\n"
+    "}\n"
+    "ಉ = ಎಣಿಕೆ(1000);\n"
+    "ಪ್ರತಿ ಅ ಒಳಗೆ ವ್ಯಾಪ್ತಿ(500) {\n"
+    "    ಮುದ್ರಿಸು(ಮೊದಲನೆಯದು(ಉ));\n"
+    "}\n"
+    "ಪ್ರತಿ ಅ ಒಳಗೆ ಉ {\n"
+    "    ಮುದ್ರಿಸು(ವರ್ಗ(ಅ));\n"
+    "}\n";
+
+// Run `source` compiled for profiling and return its profile, sampled
+static Profile *profile_run(const char *source, InternTable *names) {
+    ErrorList errors;
+    init_error_list(&errors);
+    ASTNode *ast = parse_source(source, strlen(source), &errors, names, false);
+    CHECK(ast != NULL, "the program does not parse");
+    SymbolTable *symbol_table = create_symbol_table(128);
+    Chunk chunk;
+    init_chunk(&chunk);
+    char *output = NULL;
+    size_t output_length = 0;
+    FILE *stream = open_memstream(&output, &output_length);
+    VM vm;
+    init_vm(&vm, stream);
+    vm.profile = create_profile(ast);
+    CHECK(compile_bytecode(ast, symbol_table, &chunk, &vm.heap, &errors, 0, true), "the program does not compile");
+    CHECK(start_profile(vm.profile), "the sampler did not start");
+    CHECK(run_chunk(&vm, &chunk, &errors), "the program failed");
+    stop_profile(vm.profile);
+    output_flush(&vm.output);
+
+    Profile *profile = vm.profile;
+    free_vm(&vm);
+    fclose(stream);
+    free(output);
+    free_chunk(&chunk);
+    free_symbol_table(symbol_table);
+    free_ast(ast);
+    free_error_list(&errors);
+    return profile;
+}
+
+static void check_fibonacci(InternTable *names) {
+    Profile *profile = profile_run(fibonacci, names);
+    const LineProfile *lines = profile->lines;
+    uint64_t elapsed = profile->elapsed_ns;
+    CHECK(atomic_load(&profile->call_depth) == 0, "%d calls left on the stack", atomic_load(&profile->call_depth));
+    CHECK(lines[LOOP].total_nanoseconds > elapsed / 2, "the loop took %llu of %llu ns",
+          (unsigned long long)lines[LOOP].total_nanoseconds, (unsigned long long)elapsed);
+    CHECK(lines[CALL].total_nanoseconds > elapsed / 2, "the call site took %llu of %llu ns",
+          (unsigned long long)lines[CALL].total_nanoseconds, (unsigned long long)elapsed);
+    CHECK(lines[CALL].total_nanoseconds >= lines[RECURSION].total_nanoseconds,
+          "the call site took less than the calls it made");
+    CHECK(lines[CALL].nanoseconds < lines[CALL].total_nanoseconds / 10, "the call site took %llu ns of its own",
+          (unsigned long long)lines[CALL].nanoseconds);
+    for (int line = 1; line < profile->line_count; line++) {
+        CHECK(lines[line].total_nanoseconds <= elapsed, "line %d took %llu of %llu ns", line,
+              (unsigned long long)lines[line].total_nanoseconds, (unsigned long long)elapsed);
+        CHECK(lines[line].nanoseconds <= lines[line].total_nanoseconds, "line %d took more of its own than in all",
+              line);
+    }
+
+    // Stacks by call path: most of the time is in the function called
+    // from inside the loop, and the function is never a root with
+    // anything under it
+    char *stacks = NULL;
+    size_t length = 0;
+    FILE *stream = open_memstream(&stacks, &length);
+    write_collapsed_stacks(profile, fibonacci, sizeof(fibonacci) - 1, stream);
+    fclose(stream);
+    char prefix[64];
+    snprintf(prefix, sizeof(prefix), "%d: ", LOOP);
+    char call_path[64];
+    snprintf(call_path, sizeof(call_path), ";%d: ", CALL);
+    char callee[64];
+    snprintf(callee, sizeof(callee), ";%d: ", DEFINITION);
+    unsigned long long all = 0;
+    unsigned long long called = 0;
+    for (char *line = strtok(stacks, "\n"); line != NULL; line = strtok(NULL, "\n")) {
+        char *time = strrchr(line, ' ');
+        CHECK(time != NULL, "no time in %s", line);
+        unsigned long long microseconds = strtoull(time + 1, NULL, 10);
+        all += microseconds;
+        char *call = strstr(line, call_path);
+        if (strncmp(line, prefix, strlen(prefix)) == 0 && call != NULL && strstr(call, callee) != NULL) {
+            called += microseconds;
+        }
+        CHECK(strncmp(line, "1: ", 3) != 0 || strchr(line, ';') == NULL, "the function is a root: %.80s", line);
+    }
+    CHECK(called > all / 2, "%llu of %llu us under the call site", called, all);
+    free(stacks);
+    free_profile(profile);
+}
+
+static void check_generators(InternTable *names) {
+    Profile *profile = profile_run(generators, names);
+    CHECK(atomic_load(&profile->call_depth) == 0, "%d calls left on the stack", atomic_load(&profile->call_depth));
+    CHECK(profile->lines[4].hits == 1000, "the generator yielded %llu times",
+          (unsigned long long)profile->lines[4].hits);
+    free_profile(profile);
+}
+
+int main(void) {
+    InternTable *names = create_intern_table(256);
+    check_fibonacci(names);
+    check_generators(names);
+    free_intern_table(names);
+    return test_finish("profile");
+}
@@ -0,0 +1,80 @@
+//test_repl.c
+#include <string.h>
+#include <unistd.h>
+#include "../include/repl.h"
+#include "test.h"
+
+// A REPL session fed through a stream. Each input builds a list and then
+// fails at runtime, so it never reaches the end of its code; what it
+// allocated must still be collected before the next input, or a long
+// session grows without bound. The collector's statistics, which go to
+// stderr, say how often it ran.
+#define INPUTS 1000
+#define ELEMENTS 200
+
+int main(void) {
+    char *source;
+    size_t source_length;
+    FILE *input = open_memstream(&source, &source_length);
+    fprintf(input, "ಎ = 0;\n");
+    for (int i = 0; i < INPUTS; i++) {
+        fprintf(input, "ಲ = [");
+        for (int j = 0; j < ELEMENTS; j++) {
+            fprintf(input, "%s[%d]", j > 0 ? ", " : "", j);
+        }
+        fprintf(input, "]; ಎ = ಎ + ಲ[%d][0]; ಮುದ್ರಿಸು(ಲ[%d]);\n", i % ELEMENTS, ELEMENTS);
+    }
+    fprintf(input, "ಮುದ್ರಿಸು(ಎ);\n");
+    fclose(input);
+
+    char *output;
+    size_t output_length;
+    FILE *stream = open_memstream(&output, &output_length);
+    input = fmemopen(source, source_length, "r");
+    FILE *diagnostics = tmpfile();
+    int saved_stderr = dup(STDERR_FILENO);
+    fflush(stderr);
+    dup2(fileno(diagnostics), STDERR_FILENO);
+
+    RunOptions options = {0};
+    options.gc_stats = true;
+    options.heap_limit = 4 * 1024 * 1024;
+    bool ok = run_repl(input, stream, &options);
+
+    fflush(stderr);
+    dup2(saved_stderr, STDERR_FILENO);
+    close(saved_stderr);
+    fclose(input);
+    fclose(stream);
+
+    CHECK(!ok, "the failing inputs were not reported");
+    // The sum of i % ELEMENTS over the inputs, in Kannada digits
+    CHECK(strcmp(output, "೯೯೫೦೦\n") == 0, "printed %s", output);
+
+    size_t minor = 0;
+    size_t major = 0;
+    int failures = 0;
+    bool out_of_memory = false;
+    char line[512];
+    rewind(diagnostics);
+    while (fgets(line, sizeof(line), diagnostics) != NULL) {
+        size_t m;
+        size_t n;
+        if (sscanf(line, "GC: %zu minor, %zu major collections", &m, &n) == 2) {
+            minor = m;
+            major = n;
+        }
+        failures += strstr(line, "Runtime error") != NULL;
+        out_of_memory |= strstr(line, "Out of memory") != NULL;
+    }
+    fclose(diagnostics);
+    CHECK(failures == INPUTS, "%d inputs failed, not %d", failures, INPUTS);
+    CHECK(!out_of_memory, "ran out of memory");
+    // Each input allocates about 14 KB, enough between them to fill the
+    // young generation several times over
+    CHECK(minor + major >= 5, "only %zu collections", minor + major);
+
+    free(source);
+    free(output);
+    return test_finish("repl");
+}
@@ -0,0 +1,148 @@
+//test_stream.c
+#include <poll.h>
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+#include "../include/kannada.h"
+#include "../include/stream.h"
+#include "test.h"
+
+// compile_stream reading a program through a pipe. Code for each statement
+// must come out as soon as the statement is complete, before the rest of
+// the input has been written; and all of it together must be what
+// kpy_compile makes of the whole program.
+#define STATEMENTS 20000
+
+typedef struct {
+    FILE *input;
+    FILE *output;
+    bool ok;
+} Compile;
+
+static void *compile_thread(void *argument) {
+    Compile *compile = argument;
+    compile->ok = compile_stream(compile->input, compile->output);
+    fclose(compile->output);
+    fclose(compile->input);
+    return NULL;
+}
+
+typedef struct {
+    int fd;
+    const char *text;
+    size_t length;
+} Writer;
+
+// Write all of the text and close the pipe; in a thread of its own, since
+// the compiler's output has to be read meanwhile
+static void *write_thread(void *argument) {
+    Writer *writer = argument;
+    while (writer->length > 0) {
+        ssize_t written = write(writer->fd, writer->text, writer->length);
+        if (written <= 0) {
+            break;
+        }
+        writer->text += written;
+        writer->length -= (size_t)written;
+    }
+    close(writer->fd);
+    return NULL;
+}
+
+// Read from `fd` onto `buffer` until it holds `length` bytes or the pipe
+// is closed; gives up after a few seconds without output
+static void read_until(int fd, char **buffer, size_t *filled, size_t *capacity, size_t length) {
+    while (*filled < length) {
+        struct pollfd ready = {fd, POLLIN, 0};
+        if (poll(&ready, 1, 5000) <= 0) {
+            return;
+        }
+        if (*capacity - *filled < 65536) {
+            *capacity = *capacity * 2 + 65536;
+            *buffer = realloc(*buffer, *capacity);
+        }
+        ssize_t count = read(fd, *buffer + *filled, *capacity - *filled);
+        if (count <= 0) {
+            return;
+        }
+        *filled += (size_t)count;
+    }
+}
+
+// A function name for `number`, whose digits are spelled with letters,
+// since ASCII digits cannot be part of a name
+static const char *function_name(int number) {
+    static const char *const letters[] = {"ಕ", "ಗ", "ಚ", "ಜ", "ಟ", "ಡ", "ತ", "ದ", "ನ", "ಪ"};
+    static char name[64];
+    char digits[16];
+    snprintf(digits, sizeof(digits), "%d", number);
+    strcpy(name, "ಫ");
+    for (const char *digit = digits; *digit != '\0'; digit++) {
+        strcat(name, letters[*digit - '0']);
+    }
+    return name;
+}
+
+int main(void) {
+    const char *head = "ಅ = 1;\n"
+                       "ಮುದ್ರಿಸು(ಅ);\n"
+                       "ಯದಿ ಅ > 0 {\n"
+                       "    ಮುದ್ರಿಸು(ಅ);\n"
+                       "}\n";
+    // Only these have come out until more input shows whether the if has an else
+    const char *head_code = "ಅ = 1;\nprint(ಅ);\n";
+
+    char *source;
+    size_t source_length;
+    FILE *text = open_memstream(&source, &source_length);
+    fputs(head, text);
+    fputs("ಅನ್ಯಥಾ {\n    ಮುದ್ರಿಸು(0);\n}\n", text);
+    for (int i = 0; i < STATEMENTS; i++) {
+        if (i % 100 == 0) {
+            fprintf(text, "ಕಾರ್ಯ %s(ಬ) {\n    ಹಿಂತಿರುಗಿಸು ಬ * %d;\n}\n", function_name(i), i);
+        } else {
+            fprintf(text, "ಅ = ಅ + %s(%d);\n", function_name(i - i % 100), i);
+        }
+    }
+    fputs("ಮುದ್ರಿಸು(ಅ);\n", text);
+    fclose(text);
+
+    kpy_result expected;
+    CHECK(kpy_compile(source, source_length, NULL, &expected) == KPY_OK, "the program does not compile");
+
+    int input[2];
+    int output[2];
+    if (pipe(input) != 0 || pipe(output) != 0) {
+        perror("pipe");
+        return 1;
+    }
+    Compile compile = {fdopen(input[0], "r"), fdopen(output[1], "w"), false};
+    pthread_t thread;
+    pthread_create(&thread, NULL, compile_thread, &compile);
+
+    char *code = NULL;
+    size_t filled = 0;
+    size_t capacity = 0;
+    size_t head_length = strlen(head);
+    CHECK(write(input[1], source, head_length) == (ssize_t)head_length, "could not write");
+    read_until(output[0], &code, &filled, &capacity, strlen(head_code));
+    CHECK(filled == strlen(head_code) && memcmp(code, head_code, filled) == 0,
+          "before the rest of the input, printed %.*s", (int)filled, code ? code : "");
+
+    Writer rest = {input[1], source + head_length, source_length - head_length};
+    pthread_t writer;
+    pthread_create(&writer, NULL, write_thread, &rest);
+    read_until(output[0], &code, &filled, &capacity, SIZE_MAX);
+    pthread_join(writer, NULL);
+    pthread_join(thread, NULL);
+    close(output[0]);
+
+    CHECK(compile.ok, "compile_stream failed");
+    CHECK(filled == expected.output_length && memcmp(code, expected.output, filled) == 0,
+          "printed %zu bytes, not the %zu of kpy_compile", filled, expected.output_length);
+
+    kpy_result_free(&expected);
+    free(code);
+    free(source);
+    return test_finish("stream");
+}